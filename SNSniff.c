@@ -19,15 +19,15 @@
 #include <Protocol/DevicePath.h>
 #include <Guid/GlobalVariable.h>
 #include <Guid/FileInfo.h>
+#include <Guid/SmBios.h>
 #include <IndustryStandard/SmBios.h>
 #include <Protocol/Smbios.h>
 #include <Protocol/SimpleNetwork.h>
+#include <Protocol/PciIo.h>
+#include <IndustryStandard/Pci.h>
+#include <Library/DevicePathLib.h>
 
 // Стандартные GUID для переменных
-static EFI_GUID mCustomVarGuid = {
-  0x12345678, 0x1234, 0x1234, {0x12, 0x34, 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc}
-};
-
 static EFI_GUID mGlobalVarGuid = EFI_GLOBAL_VARIABLE;
 
 // Дополнительные распространенные GUID
@@ -39,6 +39,15 @@ static EFI_GUID mSystemVarGuid = {
   0xEC87D643, 0xEBA4, 0x4BB5, {0xA1, 0xE5, 0x3F, 0x3E, 0x36, 0xB2, 0x0D, 0xA9}
 };
 
+static EFI_GUID mAmiTseSetupGuid = {
+  0xC811FA38, 0x42C8, 0x4579, {0xA9, 0xBB, 0x60, 0xE9, 0x4E, 0xDD, 0xFB, 0x34}
+};
+
+// Переменная Setup (SYSTEM_CONFIGURATION) прошивок Insyde H2O
+static EFI_GUID mInsydeSetupGuid = {
+  0xA04A27F4, 0xDF00, 0x4D42, {0xB5, 0x52, 0x39, 0x51, 0x13, 0x02, 0x11, 0x3D}
+};
+
 // Структура для хранения GUID
 typedef struct {
   EFI_GUID  *Guid;
@@ -48,19 +57,174 @@ typedef struct {
 // Максимальная длина для буферов
 #define MAX_BUFFER_SIZE 256
 
+// Размер блока символов, накапливаемого перед одним вызовом Print
+#define PRINT_CHUNK_CHARS     128
+// Количество байт в строке дампа
+#define DUMP_BYTES_PER_LINE   16
+// Количество строк дампа, формируемых за один блок вывода
+#define DUMP_CHUNK_LINES      64
+// Размер строки дампа с запасом: смещение, байты, ASCII и перевод строки
+#define DUMP_LINE_SIZE        (10 + DUMP_BYTES_PER_LINE * 4 + 4)
+
+static CONST CHAR16 mHexDigits[] = L"0123456789ABCDEF";
+
 // Определения для типов SMBIOS записей
 #define SMBIOS_TYPE_SYSTEM_INFORMATION    1
 #define SMBIOS_TYPE_BASEBOARD_INFORMATION 2
 
-// Массив известных GUID
-GUID_ENTRY mKnownGuids[] = {
-  {&mCustomVarGuid,  L"Custom"},
-  {&mGlobalVarGuid,  L"Global"},
-  {&mMsftVarGuid,    L"Microsoft"},
-  {&mSystemVarGuid,  L"System"},
+// Количество возможных типов SMBIOS записей
+#define SMBIOS_TYPE_COUNT                 256
+
+// Предельный размер записи SMBIOS при поиске конца строковой части
+#define SMBIOS_RECORD_MAX_SIZE            0x10000
+
+// Строка записи SMBIOS: положение в записи, без копирования
+typedef struct {
+  UINT32    Offset;                 // Смещение строки от начала записи
+  UINT32    Length;                 // Длина строки без NUL
+} SMBIOS_STRING_ENTRY;
+
+// Запись SMBIOS с точными границами и таблицей строк
+typedef struct {
+  EFI_SMBIOS_TABLE_HEADER  *Header;       // Начало записи
+  UINTN                    Size;          // Размер записи со строками и двойным NUL
+  UINT32                   FirstString;   // Первая строка записи в SMBIOS_INDEX.Strings
+  UINT32                   StringCount;   // Количество строк записи
+} SMBIOS_RECORD;
+
+// Представление ASCII строки без копирования (не обязательно завершается NUL)
+typedef struct {
+  CONST CHAR8  *Text;               // Начало строки
+  UINTN        Length;              // Длина строки
+} ASCII_VIEW;
+
+// Кодировка данных, определённая TextClassify
+typedef enum {
+  TEXT_ENCODING_BINARY,             // Не текст
+  TEXT_ENCODING_ASCII,              // 7-битный ASCII
+  TEXT_ENCODING_UTF8,               // UTF-8 (есть символы вне ASCII или BOM)
+  TEXT_ENCODING_UCS2                // UCS-2 little-endian
+} TEXT_ENCODING;
+
+// Результат классификации буфера (TextClassify)
+typedef struct {
+  TEXT_ENCODING  Encoding;          // Кодировка
+  UINTN          Offset;            // Начало текста в байтах (после BOM)
+  UINTN          Length;            // Длина текста без NUL: байты для ASCII/UTF-8, CHAR16 для UCS-2
+  BOOLEAN        Bom;               // Текст начинается с BOM
+  BOOLEAN        Terminated;        // Текст завершается NUL внутри буфера
+} TEXT_INFO;
+
+// Маски для проверки 8 байт за раз: каждый байт (или CHAR16) в диапазоне 0x20..0x7F
+#define TEXT_ASCII_LOW_BYTES    0x2020202020202020ULL
+#define TEXT_ASCII_HIGH_BITS    0x8080808080808080ULL
+#define TEXT_UCS2_LOW_UNITS     0x0020002000200020ULL
+#define TEXT_UCS2_HIGH_BITS     0xFF80FF80FF80FF80ULL
+
+// Представление строки ASCII или UCS-2 без копирования (не обязательно завершается NUL)
+typedef struct {
+  CONST VOID  *Data;                // Начало строки (для UCS-2 может быть не выровнено)
+  UINTN       Length;               // Длина строки в символах
+  BOOLEAN     Wide;                 // TRUE - UCS-2, FALSE - ASCII
+} TEXT_VIEW;
+
+// Правила сравнения серийных номеров
+#define SN_MATCH_TRIM           BIT0  // Не учитывать пробелы и табуляции по краям
+#define SN_MATCH_CASE_FOLD      BIT1  // Не учитывать регистр
+#define SN_MATCH_STRIP_PAD      BIT2  // Не учитывать символы заполнения в конце строки
+#define SN_MATCH_PLACEHOLDER    BIT3  // Считать заглушки ("To Be Filled By O.E.M.") пустой строкой
+#define SN_MATCH_DEFAULT        (SN_MATCH_TRIM | SN_MATCH_STRIP_PAD)
+
+// Символ заполнения по умолчанию (байт стёртой флеш-памяти)
+#define SN_MATCH_DEFAULT_PAD    0xFF
+
+// Настройки сравнения серийных номеров (--sn-match, --sn-pad)
+typedef struct {
+  UINT32  Rules;                    // Набор флагов SN_MATCH_*
+  CHAR16  PadChar;                  // Символ заполнения для SN_MATCH_STRIP_PAD
+} SN_MATCH_RULES;
+
+// Handle, обозначающий отсутствие родительской платы
+#define SMBIOS_NO_PARENT                  0xFFFF
+
+// Плата из записи Type 2 и её место в иерархии плат
+typedef struct {
+  CONST SMBIOS_RECORD  *Record;       // Запись Type 2
+  UINT16               Handle;        // Handle записи
+  UINT16               ParentHandle;  // Плата, в ContainedObjectHandles которой указана эта
+  UINT8                FeatureFlags;  // Флаги платы (BASE_BOARD_FEATURE_FLAGS)
+  UINT8                BoardType;     // Тип платы
+} BASEBOARD_INSTANCE;
+
+// Строка записи SMBIOS, обновляемая через EFI_SMBIOS_PROTOCOL.UpdateString
+typedef struct {
+  EFI_SMBIOS_HANDLE  Handle;        // Handle записи
+  UINTN              StringNumber;  // Номер строки в записи (0 - строки нет)
+} SMBIOS_STRING_TARGET;
+
+// Индекс SMBIOS: записи сгруппированы по типу в порядке обхода таблицы
+typedef struct {
+  BOOLEAN                  Valid;                            // Индекс построен и актуален
+  SMBIOS_RECORD            *Records;                         // Записи, упорядоченные по типу
+  UINTN                    Count;                            // Количество записей
+  SMBIOS_STRING_ENTRY      *Strings;                         // Строки всех записей
+  UINTN                    StringCount;                      // Количество строк
+  UINTN                    StringCapacity;                   // Ёмкость массива строк
+  CONST CHAR16             *Source;                          // Источник записей (точка входа или протокол)
+  UINT32                   TypeStart[SMBIOS_TYPE_COUNT + 1]; // Начало группы каждого типа в Records
+} SMBIOS_INDEX;
+
+// Общий индекс SMBIOS на время запуска
+static SMBIOS_INDEX mSmbiosIndex;
+
+// Встроенные GUID реестра (порядок задаёт приоритет при равной статистике).
+// Промежуточные переменные SN/MAC лежат под GUID AMI и Insyde, поэтому они первыми
+GUID_ENTRY mBuiltinGuids[] = {
+  {&mSystemVarGuid,      L"AMI Setup"},
+  {&mAmiTseSetupGuid,    L"AMI TSE Setup"},
+  {&mInsydeSetupGuid,    L"Insyde Setup"},
+  {&mGlobalVarGuid,      L"Global"},
+  {&mMsftVarGuid,        L"Microsoft"},
   {NULL, NULL}
 };
 
+// Файл реестра GUID на ESP (строки "GUID Имя", '#' - комментарий)
+#define GUID_REGISTRY_FILE        L"SNSniffGuids.txt"
+// Файл статистики попаданий реестра (строки "GUID Счётчик"), ведётся только рядом с загруженным файлом реестра
+#define GUID_REGISTRY_STATS_FILE  L"SNSniffGuids.hit"
+// Максимальное количество GUID, проверяемых прямым GetVariable до построения индекса
+#define GUID_PROBE_LIMIT          4
+// Количество попаданий без изменения порядка, после которого статистика сохраняется
+#define GUID_STATS_SAVE_INTERVAL  16
+// Максимальная длина дружественного имени GUID
+#define GUID_NAME_LENGTH          48
+
+// Запись реестра GUID
+typedef struct {
+  EFI_GUID  Guid;                       // GUID производителя
+  CHAR16    Name[GUID_NAME_LENGTH];     // Дружественное имя
+  UINT32    Hits;                       // Количество попаданий (сохраняется между запусками)
+  BOOLEAN   FromFile;                   // Запись загружена из файла на ESP
+} GUID_REGISTRY_ENTRY;
+
+// Реестр GUID с хеш-таблицей (открытая адресация) и порядком проверки по статистике
+typedef struct {
+  BOOLEAN              Loaded;          // Реестр загружен
+  BOOLEAN              StatsDirty;      // Статистику нужно сохранить при выходе
+  UINTN                UnsavedHits;     // Попадания за запуск после последнего сохранения статистики
+  GUID_REGISTRY_ENTRY  *Entries;        // Записи реестра
+  UINTN                Count;           // Количество записей
+  UINTN                Capacity;        // Ёмкость массива записей
+  UINT32               *Slots;          // Хеш-таблица: индекс записи + 1 (0 - пустой слот)
+  UINTN                SlotCount;       // Количество слотов (степень двойки)
+  UINT32               *ProbeOrder;     // Индексы записей по убыванию попаданий
+  CONST CHAR16         *FilePath;       // Путь к файлу реестра
+  CHAR16               *StatsPath;      // Путь к файлу статистики в каталоге файла реестра (NULL - файла реестра нет)
+} GUID_REGISTRY;
+
+// Реестр GUID, общий для всего запуска
+static GUID_REGISTRY mGuidRegistry = { FALSE, FALSE, 0, NULL, 0, 0, NULL, 0, NULL, GUID_REGISTRY_FILE, NULL };
+
 // Перечисление типов вывода
 typedef enum {
   OUTPUT_ALL,
@@ -69,6 +233,36 @@ typedef enum {
   OUTPUT_UCS
 } OUTPUT_TYPE;
 
+// Способ проверки серийного номера после прошивки
+typedef enum {
+  FLASH_VERIFY_AUTO,                // Таблица SMBIOS в памяти, при несовпадении - чтение через AMIDEEFI
+  FLASH_VERIFY_SMBIOS,              // Только таблица SMBIOS в памяти
+  FLASH_VERIFY_READBACK             // Только чтение записанных значений через AMIDEEFI
+} FLASH_VERIFY_MODE;
+
+// Файл для вывода AMIDEEFI при чтении записанных значений, лежит рядом с AMIDEEFIx64.efi
+#define AMIDEEFI_READBACK_FILE  L"SNSniffReadback.txt"
+
+// Расположение сетевого порта: PCI-функция и номер порта на ней
+typedef struct {
+  UINTN   Segment;
+  UINTN   Bus;
+  UINTN   Device;
+  UINTN   Function;
+  UINTN   Port;                     // Узел Controller пути устройства или порядковый номер на функции
+} NIC_LOCATION;
+
+// MAC-адрес, закреплённый за физическим портом (--mac-at)
+typedef struct {
+  NIC_LOCATION  Location;
+  UINT64        Key;                // Ожидаемый MAC-адрес (MacToKey)
+} MAC_PIN;
+
+// Наибольшее количество портов с закреплённым MAC-адресом
+#define MAC_PIN_MAX               16
+// Размер имени сетевого интерфейса "PCI SSSS:BB:DD.F port N [VVVV:DDDD]" (с NUL)
+#define NIC_NAME_SIZE             64
+
 // Структура конфигурации для проверки SN и MAC
 typedef struct {
   CHAR16    *SerialVarName;         // Имя переменной UEFI с серийным номером для прошивки/проверки
@@ -78,14 +272,383 @@ typedef struct {
   BOOLEAN   CheckMac;               // Флаг проверки MAC
   BOOLEAN   CheckOnly;              // Флаг режима только проверки без прошивки
   BOOLEAN   PowerDown;              // Флаг выключения/перезагрузки системы
+  BOOLEAN   ForceWrite;             // Писать в NV хранилище даже при риске reclaim
+  BOOLEAN   DiffStore;              // Показывать изменения хранилища после каждой прошивки
   EFI_GUID  *SerialVarGuid;         // GUID для переменной с серийным номером
   EFI_GUID  *MacVarGuid;            // GUID для переменной с MAC-адресом
+  CHAR16    *BoardLocation;         // Расположение платы (Type 2) для сверки SN, NULL - основные платы
+  FLASH_VERIFY_MODE VerifyMode;     // Способ проверки SN после прошивки
+  BOOLEAN   SyncSmbios;             // Обновлять SN в таблице SMBIOS в памяти после прошивки
+  CHAR16    *MacBase;               // Базовый MAC-адрес строкой (--mac-base), NULL - из переменной MacVarName
+  UINTN     MacCount;               // Количество портов блока MAC (--mac-count), 0 - проверяется один адрес
+  MAC_PIN   MacPins[MAC_PIN_MAX];   // MAC-адреса, закреплённые за портами (--mac-at)
+  UINTN     MacPinCount;            // Количество закреплённых адресов
 } CHECK_CONFIG;
 
+// Части кэша проверки, сбрасываемые по отдельности (VerifyContextInvalidate)
+#define VERIFY_CACHE_VARIABLES    BIT0  // Данные и GUID переменных SN и MAC
+#define VERIFY_CACHE_SMBIOS       BIT1  // Записи SMBIOS (общий индекс mSmbiosIndex)
+#define VERIFY_CACHE_NICS         BIT2  // MAC-адреса сетевых интерфейсов
+// Прошивка через AMIDEEFI меняет только DMI: переменные-источники и сетевые карты остаются прежними
+#define VERIFY_CACHE_FLASHED      VERIFY_CACHE_SMBIOS
+
+// Переменная, прочитанная один раз за проверку
+typedef struct {
+  BOOLEAN     Loaded;               // Переменная уже читалась (Status актуален)
+  EFI_STATUS  Status;               // Результат чтения
+  VOID        *Data;                // Данные переменной
+  UINTN       Size;                 // Размер данных
+  EFI_GUID    Guid;                 // Найденный GUID переменной
+} VERIFY_VARIABLE;
+
+// Размер MAC-адреса Ethernet и его строки XX:XX:XX:XX:XX:XX (с NUL)
+#define MAC_ADDRESS_SIZE          6
+#define MAC_STRING_SIZE           18
+// Наибольший 48-битный ключ MAC-адреса
+#define MAC_KEY_MAX               0xFFFFFFFFFFFFULL
+// Наибольшее количество MAC-адресов в одной переменной (по одному на порт)
+#define MAC_LIST_MAX              64
+
+// MAC-адрес сетевого интерфейса
+typedef struct {
+  UINT64        Key;                // Текущий MAC-адрес, упакованный в 48 бит (MacToKey)
+  UINT64        PermanentKey;       // Заводской MAC-адрес (PermanentAddress), 0 - драйвер его не сообщает
+  UINTN         Interface;          // Номер интерфейса в порядке перечисления SNP
+  UINT32        State;              // Состояние SNP
+  BOOLEAN       OnPci;              // Путь устройства ведёт к PCI-функции, Location действителен
+  NIC_LOCATION  Location;           // Расположение порта, не зависит от порядка подключения драйверов
+  BOOLEAN       PortInPath;         // Номер порта взят из узла Controller пути устройства
+  UINT16        VendorId;           // Идентификаторы PCI-функции
+  UINT16        DeviceId;
+} NIC_ADDRESS;
+
+// Контекст проверки: всё, что прочитано за время CheckAndFlashValues
+typedef struct {
+  VERIFY_VARIABLE  Serial;          // Переменная с серийным номером
+  VERIFY_VARIABLE  Mac;             // Переменная с MAC-адресом
+  BOOLEAN          NicsLoaded;      // Сетевые интерфейсы уже перечислялись
+  EFI_STATUS       NicStatus;       // Результат перечисления
+  NIC_ADDRESS      *Nics;           // MAC-адреса сетевых интерфейсов, по возрастанию ключа
+  UINTN            NicCount;        // Количество интерфейсов
+} VERIFY_CONTEXT;
+
+// Начальное количество корзин индекса хранилища переменных (степень двойки)
+#define VAR_INDEX_INITIAL_BUCKETS   2048
+// Начальный размер пула имён индекса (в символах CHAR16)
+#define VAR_INDEX_INITIAL_NAME_POOL (32 * 1024)
+// Признак конца цепочки корзины
+#define VAR_INDEX_NO_ENTRY          MAX_UINT32
+
+// Флаги записи индекса
+#define VAR_ENTRY_INFO_VALID        0x01  // DataSize и Attributes заполнены
+#define VAR_ENTRY_DUPLICATE         0x02  // Имя встречается под несколькими GUID
+#define VAR_ENTRY_CRC_VALID         0x04  // Crc32 заполнен (слепок хранилища)
+#define VAR_ENTRY_SEEN              0x08  // Запись сопоставлена при сравнении слепков
+
+// Запись индекса хранилища переменных
+typedef struct {
+  EFI_GUID  Guid;                   // GUID переменной
+  UINT32    NameOffset;             // Смещение имени в пуле имён (в CHAR16)
+  UINT32    Hash;                   // Хеш имени
+  UINT32    Next;                   // Следующая запись в цепочке корзины
+  UINT32    Attributes;             // Атрибуты переменной (если VAR_ENTRY_INFO_VALID)
+  UINTN     DataSize;               // Размер данных (если VAR_ENTRY_INFO_VALID)
+  UINT32    Crc32;                  // CRC32 данных (если VAR_ENTRY_CRC_VALID)
+  UINT8     Flags;                  // Флаги VAR_ENTRY_*
+} VAR_INDEX_ENTRY;
+
+// Индекс хранилища переменных: имя -> список GUID с размером и атрибутами
+typedef struct {
+  BOOLEAN          Valid;           // Индекс построен и актуален
+  VAR_INDEX_ENTRY  *Entries;        // Массив записей
+  UINTN            EntryCount;      // Количество записей
+  UINTN            EntryCapacity;   // Ёмкость массива записей
+  UINT32           *Buckets;        // Корзины хеш-таблицы (индексы первых записей)
+  UINTN            BucketCount;     // Количество корзин (степень двойки)
+  CHAR16           *NamePool;       // Пул имён переменных
+  UINTN            NamePoolUsed;    // Занято в пуле имён (в CHAR16)
+  UINTN            NamePoolSize;    // Размер пула имён (в CHAR16)
+  UINTN            DuplicateNames;  // Количество имён под несколькими GUID
+} VAR_STORE_INDEX;
+
+// Размер блока буферизованной записи в файл
+#define FILE_WRITER_BLOCK_SIZE  (64 * 1024)
+
+// Буферизованная запись в файл крупными блоками
+typedef struct {
+  SHELL_FILE_HANDLE  Handle;        // Хендл файла
+  UINT8              *Buffer;       // Буфер блока
+  UINTN              Used;          // Заполнено в буфере
+  UINT64             Offset;        // Текущее смещение в файле
+  EFI_STATUS         Status;        // Первая ошибка записи
+} FILE_WRITER;
+
+// Размер блока текста дампа SMBIOS, выводимого за один вызов
+#define SMBIOS_DUMP_CHUNK_SIZE    4096
+
+// Максимальная длина форматированной строки дампа SMBIOS
+#define SMBIOS_DUMP_LINE_SIZE     160
+
+// Вывод дампа SMBIOS: текст копится блоками и уходит на экран или в файл
+typedef struct {
+  BOOLEAN       ToFile;                            // Вывод в файл (иначе на экран)
+  FILE_WRITER   Writer;                            // Буферизованная запись в файл
+  UINTN         Used;                              // Заполнено байт в Chunk
+  CHAR8         Chunk[SMBIOS_DUMP_CHUNK_SIZE];     // Накопленный текст
+  CHAR16        WideChunk[SMBIOS_DUMP_CHUNK_SIZE]; // Тот же текст в UCS-2 для консоли
+} SMBIOS_DUMP;
+
+// Разбор записи SMBIOS одного типа для дампа
+typedef
+VOID
+(*SMBIOS_DECODE_FUNC) (
+  IN OUT SMBIOS_DUMP          *Dump,
+  IN     CONST SMBIOS_RECORD  *Record
+  );
+
+// Известный тип записи SMBIOS: название и разбор (NULL - только строки)
+typedef struct {
+  UINT8               Type;
+  CONST CHAR8         *Name;
+  SMBIOS_DECODE_FUNC  Decode;
+} SMBIOS_DECODER;
+
+//
+// Формат снимка хранилища переменных (--snapshot). Все поля little-endian,
+// записи выровнены на 8 байт. Описание формата должно совпадать с Tools/snsnap.c.
+//
+//   SNAPSHOT_HEADER
+//   SNAPSHOT_RECORD + имя (UCS-2, с NUL) + данные + выравнивание   x RecordCount
+//   UINT64 смещения записей от начала файла                        x RecordCount
+//   SNAPSHOT_FOOTER
+//
+#define SNAPSHOT_SIGNATURE        "SNSNAP01"
+#define SNAPSHOT_INDEX_SIGNATURE  "SNSNIDX1"
+#define SNAPSHOT_VERSION          1
+#define SNAPSHOT_ALIGNMENT        8
+
+// Флаги записи снимка
+#define SNAPSHOT_RECORD_READ_ERROR  0x00000001  // Данные не удалось прочитать
+
+#pragma pack(1)
+typedef struct {
+  UINT8     Signature[8];       // SNAPSHOT_SIGNATURE
+  UINT32    Version;            // SNAPSHOT_VERSION
+  UINT32    HeaderSize;         // sizeof (SNAPSHOT_HEADER)
+  UINT32    RecordHeaderSize;   // sizeof (SNAPSHOT_RECORD)
+  UINT32    Flags;              // Зарезервировано, 0
+  EFI_TIME  Time;               // Время снятия снимка (нули, если недоступно)
+} SNAPSHOT_HEADER;
+
+typedef struct {
+  UINT32    RecordSize;         // Полный размер записи с выравниванием
+  UINT32    Attributes;         // Атрибуты переменной
+  EFI_GUID  Guid;               // GUID переменной
+  UINT32    NameSize;           // Размер имени в байтах, включая NUL
+  UINT32    DataSize;           // Размер данных в байтах
+  UINT32    DataCrc32;          // CRC32 данных
+  UINT32    Flags;              // SNAPSHOT_RECORD_*
+} SNAPSHOT_RECORD;
+
+typedef struct {
+  UINT64    IndexOffset;        // Смещение таблицы смещений записей
+  UINT32    RecordCount;        // Количество записей
+  UINT32    IndexCrc32;         // CRC32 таблицы смещений
+  UINT8     Signature[8];       // SNAPSHOT_INDEX_SIGNATURE
+} SNAPSHOT_FOOTER;
+#pragma pack()
+
+// Состояние записи снимка
+typedef struct {
+  FILE_WRITER  Writer;          // Выходной файл
+  UINT64       *Offsets;        // Смещения записей
+  UINTN        Count;           // Количество записей
+  UINTN        Capacity;        // Ёмкость массива смещений
+  UINTN        ReadErrors;      // Переменные, которые не удалось прочитать
+  UINT64       DataBytes;       // Суммарный объём данных
+} SNAPSHOT_CONTEXT;
+
+// Классы атрибутов, для которых QueryVariableInfo сообщает размеры хранилища
+typedef struct {
+  UINT32        Attributes;         // Атрибуты класса
+  CONST CHAR16  *Label;             // Название для вывода
+} STORE_CLASS;
+
+// Статистика хранилища по одному GUID
+typedef struct {
+  EFI_GUID  Guid;                   // GUID производителя
+  UINTN     Count;                  // Количество переменных
+  UINT64    Bytes;                  // Суммарный размер данных
+  UINT64    NvBytes;                // Из них в энергонезависимых переменных
+} STORE_GUID_STATS;
+
+// Накопитель статистики хранилища по GUID
+typedef struct {
+  STORE_GUID_STATS  *Stats;         // Статистика по GUID
+  UINTN             Count;          // Количество GUID
+  UINTN             Capacity;       // Ёмкость массива
+  UINTN             Variables;      // Всего переменных
+  UINTN             Unreadable;     // Переменные без размера (ошибка чтения)
+} STORE_STATS_CONTEXT;
+
+// Максимальная длина значения для --find-value (в символах)
+#define FIND_VALUE_MAX_LENGTH   128
+// Максимальное количество кодировок одного значения в автомате поиска
+#define AC_MAX_PATTERNS         8
+
+// Одно представление искомого значения
+typedef struct {
+  UINT8         *Bytes;             // Последовательность байт
+  UINTN         Length;             // Длина последовательности
+  CONST CHAR16  *Encoding;          // Название кодировки для вывода
+} SEARCH_PATTERN;
+
+// Автомат Ахо-Корасик по всем представлениям значения. Переходы достроены
+// до полного детерминированного автомата: один переход на каждый байт данных
+typedef struct {
+  UINT16          (*Next)[256];     // Таблица переходов по состояниям
+  UINT32          *Output;          // Маска образцов, оканчивающихся в состоянии
+  UINTN           StateCount;       // Количество состояний
+  SEARCH_PATTERN  Patterns[AC_MAX_PATTERNS];
+  UINTN           PatternCount;     // Количество образцов
+} AC_AUTOMATON;
+
+// Контекст поиска значения по данным всех переменных
+typedef struct {
+  AC_AUTOMATON  *Automaton;         // Автомат поиска
+  UINTN         Matches;            // Найдено совпадений
+  UINTN         Variables;          // Просмотрено переменных
+  UINTN         Unreadable;         // Переменные, которые не удалось прочитать
+} FIND_VALUE_CONTEXT;
+
+// Запас свободного места NV хранилища (в процентах от максимума), ниже которого
+// запись, скорее всего, вызовет reclaim (сборку мусора) при следующей загрузке или прямо во время записи
+#define NV_RECLAIM_MARGIN_PERCENT     10
+// Оценка служебных данных на одну переменную в NV хранилище (заголовок, выравнивание)
+#define NV_VARIABLE_HEADER_OVERHEAD   64
+// Оценка объёма NV записей, выполняемых AMIDEEFI при прошивке SN
+#define NV_WRITE_ESTIMATE_AMIDEEFI    (4 * 1024)
+
+static STORE_CLASS mStoreClasses[] = {
+  { EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS, L"NV+BS+RT" },
+  { EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,                               L"NV+BS" },
+  { EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,                             L"BS+RT" },
+  { EFI_VARIABLE_BOOTSERVICE_ACCESS,                                                           L"BS" },
+  { EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS |
+    EFI_VARIABLE_HARDWARE_ERROR_RECORD,                                                        L"HR" },
+  { 0, NULL }
+};
+
+// Количество шестнадцатеричных цифр в GUID
+#define GUID_PATTERN_NIBBLES  32
+
+// Шаблон GUID: префикс из шестнадцатеричных цифр в порядке текстовой записи GUID
+typedef struct {
+  UINT8   Nibbles[GUID_PATTERN_NIBBLES];  // Цифры префикса
+  UINTN   Count;                          // Количество цифр (32 - полный GUID)
+} GUID_PATTERN;
+
+// Список имён (пакетный режим)
+typedef struct {
+  CHAR16  **Names;                  // Массив имён
+  UINTN   Count;                    // Количество имён
+  UINTN   Capacity;                 // Ёмкость массива
+} NAME_LIST;
+
+// Вид поля SMBIOS для сверки
+typedef enum {
+  VERIFY_FIELD_STRING,                      // Строковое поле (номер строки), сравнение без пробелов по краям
+  VERIFY_FIELD_SERIAL,                      // Серийный номер, сравнение по правилам SnEquals
+  VERIFY_FIELD_UUID                         // UUID записи Type 1
+} VERIFY_FIELD_KIND;
+
+// Поле SMBIOS, доступное для сверки (--verify)
+typedef struct {
+  CONST CHAR16       *Name;                 // Имя поля в спецификации ("1.Serial")
+  UINT8              Type;                  // Тип записи
+  UINTN              Offset;                // Смещение поля в записи
+  VERIFY_FIELD_KIND  Kind;                  // Вид поля
+} VERIFY_FIELD;
+
+// Источник ожидаемого значения
+typedef enum {
+  VERIFY_SOURCE_VARIABLE,                   // var:ИМЯ[@GUID]
+  VERIFY_SOURCE_LITERAL,                    // lit:ТЕКСТ
+  VERIFY_SOURCE_FILE                        // file:ПУТЬ (первая строка файла)
+} VERIFY_SOURCE_KIND;
+
+// Результат сверки поля
+typedef enum {
+  VERIFY_MATCH,
+  VERIFY_MISMATCH,
+  VERIFY_NO_SOURCE,                         // Ожидаемое значение не получено
+  VERIFY_NO_FIELD,                          // Поля нет в SMBIOS
+  VERIFY_PENDING                            // Ожидаемое значение получено, сверка не выполнена
+} VERIFY_RESULT;
+
+// Строка таблицы сверки: поле SMBIOS и источник ожидаемого значения
+typedef struct {
+  CONST VERIFY_FIELD  *Field;               // Поле SMBIOS
+  VERIFY_SOURCE_KIND  SourceKind;           // Вид источника
+  CHAR16              *Source;              // Имя переменной, текст или путь (копия)
+  GUID_PATTERN        Guid;                 // Префикс GUID переменной (var:ИМЯ@GUID)
+  BOOLEAN             GuidSpecified;        // Префикс GUID задан
+  CHAR16              Expected[MAX_BUFFER_SIZE]; // Ожидаемое значение
+  CHAR16              Actual[MAX_BUFFER_SIZE];   // Значение из SMBIOS
+  VERIFY_RESULT       Result;               // Результат сверки
+} VERIFY_ENTRY;
+
+// Таблица сверки полей (--verify, --verify-file)
+typedef struct {
+  VERIFY_ENTRY  *Entries;                   // Строки таблицы
+  UINTN         Count;                      // Количество строк
+  UINTN         Capacity;                   // Ёмкость массива
+} VERIFY_PLAN;
+
+// Обработчик переменной при перечислении хранилища
+typedef
+EFI_STATUS
+(*VAR_ENUM_CALLBACK) (
+  IN CONST CHAR16    *Name,
+  IN CONST EFI_GUID  *Guid,
+  IN VOID            *Context
+  );
+
+// Контекст вывода переменных по шаблонам имени и GUID
+typedef struct {
+  CONST CHAR16        *NamePattern;   // Шаблон имени
+  CONST GUID_PATTERN  *GuidPattern;   // Префикс GUID (может быть NULL)
+  OUTPUT_TYPE         OutputType;     // Тип вывода
+  UINTN               MatchCount;     // Количество совпадений
+  CHAR16              *FirstName;     // Имя первого совпадения
+  EFI_GUID            FirstGuid;      // GUID первого совпадения
+} VAR_MATCH_CONTEXT;
+
+// Индекс хранилища переменных, общий для всех поисков за время запуска
+static VAR_STORE_INDEX mVarIndex;
+
+// Имена, найденные быстрой проверкой GUID реестра до построения индекса.
+// Проверяются на дубликаты, когда индекс будет построен
+#define VAR_PROBED_NAMES_MAX        8
+static CHAR16  *mProbedNames[VAR_PROBED_NAMES_MAX];
+static UINTN   mProbedNameCount = 0;
+
+// Начальный размер общего буфера чтения переменных
+#define VAR_READ_BUFFER_INITIAL_SIZE  (4 * 1024)
+
+// Общий буфер чтения переменных, переиспользуемый всеми чтениями за время запуска
+static VOID   *mVarReadBuffer = NULL;
+static UINTN  mVarReadBufferSize = 0;
+
 // Прототипы функций
+VOID
+CheckProbedVariableNames (
+  VOID
+  );
+
 EFI_STATUS
 RebootToBoot (
-  VOID
+  IN BOOLEAN  ForceWrite
   );
 
 EFI_STATUS
@@ -101,28 +664,8 @@ RunAmideefi (
 
 BOOLEAN
 CheckSerialNumber (
-  IN  CONST CHAR16    *SerialVarName,
-  IN  EFI_GUID        *SerialVarGuid
-  );
-
-EFI_STATUS
-GetSystemSerialNumber (
-  OUT CHAR16    *SystemSerialNumber,
-  IN  UINTN     BufferSize
-  );
-
-EFI_STATUS
-GetBaseBoardSerialNumber (
-  OUT CHAR16    *BaseBoardSerialNumber,
-  IN  UINTN     BufferSize
-  );
-
-EFI_STATUS
-GetSmbiosString (
-  IN  UINT8     StringNumber,
-  IN  CHAR8     *StringTable,
-  OUT CHAR16    *StringBuffer,
-  IN  UINTN     StringBufferSize
+  IN  CONST TEXT_VIEW *Target,
+  IN  CONST CHAR16    *BoardLocation OPTIONAL
   );
 
 VOID
@@ -135,8 +678,14 @@ DisplayBaseBoardInfo (
   VOID
   );
 
+VOID
+InvalidateSmbiosIndex (
+  VOID
+  );
+
 /**
   Функция для вывода HEX-дампа данных.
+  Каждая строка из 16 байт собирается в буфере и выводится одним вызовом Print.
   
   @param Data     Указатель на данные
   @param DataSize Размер данных в байтах
@@ -149,1604 +698,8443 @@ PrintHexDump (
 {
   CONST UINT8 *Bytes;
   UINTN       Index;
+  UINTN       Used;
+  CHAR16      Line[DUMP_BYTES_PER_LINE * 3 + 2];
   
   Bytes = (CONST UINT8*)Data;
+  Used = 0;
   
   for (Index = 0; Index < DataSize; Index++) {
-    Print (L"%02X ", Bytes[Index]);
+    Line[Used++] = mHexDigits[Bytes[Index] >> 4];
+    Line[Used++] = mHexDigits[Bytes[Index] & 0x0F];
+    Line[Used++] = L' ';
     
     // Перенос строки каждые 16 байт для удобства чтения
-    if ((Index + 1) % 16 == 0) {
-      Print (L"\n");
+    if ((Index + 1) % DUMP_BYTES_PER_LINE == 0 || Index + 1 == DataSize) {
+      Line[Used++] = L'\n';
+      Line[Used] = L'\0';
+      Print (L"%s", Line);
+      Used = 0;
     }
   }
-  
-  // Добавляем перенос строки, если последняя строка не закончилась им
-  if (DataSize % 16 != 0) {
-    Print (L"\n");
-  }
 }
 
+// Названия кодировок для вывода (индекс - TEXT_ENCODING)
+static CONST CHAR16 *CONST mTextEncodingNames[] = {
+  L"binary",
+  L"ASCII",
+  L"UTF-8",
+  L"UCS-2"
+};
+
 /**
-  Функция для вывода данных в виде ASCII-строки.
+  Проверяет, допустим ли управляющий символ внутри текста.
   
-  @param Data     Указатель на данные
-  @param DataSize Размер данных в байтах
+  @param Char   Символ (меньше 0x20)
+  
+  @retval TRUE  Табуляция или перевод строки
+  @retval FALSE Другой управляющий символ
 **/
-VOID
-PrintAsciiString (
-  IN CONST VOID  *Data,
-  IN UINTN       DataSize
+BOOLEAN
+TextIsAllowedControl (
+  IN UINT32  Char
   )
 {
-  UINT8 *AsciiData = (UINT8*)Data;
-  for (UINTN Index = 0; Index < DataSize; Index++) {
-    // Выводим только печатаемые ASCII символы
-    if (AsciiData[Index] >= 0x20 && AsciiData[Index] <= 0x7E) {
-      Print (L"%c", AsciiData[Index]);
-    } else if (AsciiData[Index] == 0) {
-      // Нулевой байт - конец строки
-      break;
-    } else {
-      // Непечатаемый символ
-      Print (L".");
-    }
-  }
-  Print (L"\n");
+  return (Char == L'\t' || Char == L'\r' || Char == L'\n');
 }
 
 /**
-  Функция для вывода данных в виде UCS-2 строки.
+  Разбирает одну последовательность UTF-8. Отклоняются избыточные (overlong)
+  формы, суррогаты и значения больше U+10FFFF.
   
-  @param Data     Указатель на данные
-  @param DataSize Размер данных в байтах
+  @param Bytes      Начало последовательности (первый байт не меньше 0x80)
+  @param Size       Количество доступных байт
+  @param CodePoint  Код символа (может быть NULL)
+  
+  @return Длина последовательности в байтах, 0 - последовательность неверна
 **/
-VOID
-PrintUcsString (
-  IN CONST VOID  *Data,
-  IN UINTN       DataSize
+UINTN
+TextUtf8Sequence (
+  IN  CONST UINT8  *Bytes,
+  IN  UINTN        Size,
+  OUT UINT32       *CodePoint OPTIONAL
   )
 {
-  if (DataSize >= 2) { // Хотя бы один символ CHAR16
-    Print (L"%s\n", (CHAR16*)Data);
+  UINT32  Char;
+  UINTN   Length;
+  UINTN   Index;
+  
+  if (Bytes[0] >= 0xC2 && Bytes[0] <= 0xDF) {
+    Length = 2;
+    Char   = Bytes[0] & 0x1F;
+  } else if (Bytes[0] >= 0xE0 && Bytes[0] <= 0xEF) {
+    Length = 3;
+    Char   = Bytes[0] & 0x0F;
+  } else if (Bytes[0] >= 0xF0 && Bytes[0] <= 0xF4) {
+    Length = 4;
+    Char   = Bytes[0] & 0x07;
   } else {
-    Print (L"(too small for UCS-2 string)\n");
+    return 0;
+  }
+  
+  if (Length > Size) {
+    return 0;
   }
+  
+  for (Index = 1; Index < Length; Index++) {
+    if ((Bytes[Index] & 0xC0) != 0x80) {
+      return 0;
+    }
+    Char = (Char << 6) | (Bytes[Index] & 0x3F);
+  }
+  
+  if ((Length == 3 && (Char < 0x800 || (Char >= 0xD800 && Char <= 0xDFFF))) ||
+      (Length == 4 && (Char < 0x10000 || Char > 0x10FFFF))) {
+    return 0;
+  }
+  
+  if (CodePoint != NULL) {
+    *CodePoint = Char;
+  }
+  return Length;
 }
 
 /**
-  Функция парсинга GUID из строки.
+  Проверяет, что после завершающего NUL идёт только заполнение (0x00 или 0xFF).
   
-  @param GuidString  Строка с GUID или префиксом GUID
-  @param Guid        Указатель на структуру EFI_GUID для результата
+  @param Bytes  Данные
+  @param Index  Первый байт после NUL
+  @param Size   Размер данных
   
-  @retval TRUE       GUID или префикс успешно распарсен
-  @retval FALSE      Ошибка при парсинге
+  @retval TRUE  Хвост пуст или состоит из заполнения
+  @retval FALSE В хвосте есть данные
 **/
 BOOLEAN
-ParseGuidPrefix (
-  IN  CONST CHAR16  *GuidString,
-  OUT EFI_GUID      *Guid
+TextTailIsPadding (
+  IN CONST UINT8  *Bytes,
+  IN UINTN        Index,
+  IN UINTN        Size
   )
 {
-  UINTN     BufferLen;
-  CHAR16    *TempBuffer;
-  BOOLEAN   Result;
-  
-  if (GuidString == NULL || Guid == NULL) {
-    return FALSE;
-  }
+  UINT64  Word;
   
-  // Проверка длины строки
-  BufferLen = StrLen (GuidString);
-  if (BufferLen < 1) {
-    return FALSE;
+  while (Index + sizeof (UINT64) <= Size) {
+    Word = ReadUnaligned64 ((CONST UINT64 *)(Bytes + Index));
+    if (Word != 0 && Word != MAX_UINT64) {
+      break;
+    }
+    Index += sizeof (UINT64);
   }
   
-  // Если строка короче полного GUID, дополняем её символами
-  if (BufferLen < 36) {
-    TempBuffer = AllocateZeroPool ((36 + 1) * sizeof (CHAR16));
-    if (TempBuffer == NULL) {
+  for ( ; Index < Size; Index++) {
+    if (Bytes[Index] != 0x00 && Bytes[Index] != 0xFF) {
       return FALSE;
     }
-    
-    // Копируем префикс и дополняем остаток нулями
-    StrCpyS (TempBuffer, 37, GuidString);
-    for (UINTN i = BufferLen; i < 36; i++) {
-      if (i == 8 || i == 13 || i == 18 || i == 23) {
-        TempBuffer[i] = L'-';
-      } else {
-        TempBuffer[i] = L'0';
-      }
-    }
-    
-    // Парсим полученный GUID
-    Result = StrToGuid (TempBuffer, Guid);
-    FreePool (TempBuffer);
-    return Result;
-  } else {
-    // Полный GUID, парсим напрямую
-    return StrToGuid (GuidString, Guid);
   }
+  
+  return TRUE;
 }
 
 /**
-  Получает содержимое переменной UEFI.
-  Если VariableGuid равен NULL, ищет переменную по всем доступным GUID.
-
-  @param VariableName   Имя переменной
-  @param VariableGuid   GUID переменной (может быть NULL для поиска по всем GUID)
-  @param VariableData   Указатель на буфер для данных (будет выделен)
-  @param VariableSize   Указатель на размер данных
-  @param FoundGuid      Указатель на буфер для найденного GUID (может быть NULL)
-
-  @retval EFI_SUCCESS   Переменная успешно прочитана
-  @retval другое        Ошибка при чтении переменной
+  Проверяет данные как UCS-2, начиная с Info->Offset. Без BOM текст принимается,
+  только если больше половины символов из диапазона Latin-1: иначе ASCII строка
+  с NUL после первого символа была бы прочитана как UCS-2. Стёртые байты 0xFF
+  до конца данных без NUL считаются заполнением, а не символами U+FFFF.
+  
+  @param Bytes  Данные
+  @param Size   Размер данных
+  @param Info   Результат классификации (Offset и Bom заполнены)
+  
+  @retval TRUE  Данные - текст UCS-2, Info заполнен
+  @retval FALSE Данные не являются текстом UCS-2
 **/
-EFI_STATUS
-GetVariableData (
-  IN  CONST CHAR16    *VariableName,
-  IN  EFI_GUID        *VariableGuid,
-  OUT VOID            **VariableData,
-  OUT UINTN           *VariableSize,
-  OUT EFI_GUID        *FoundGuid OPTIONAL
+BOOLEAN
+TextScanUcs2 (
+  IN     CONST UINT8  *Bytes,
+  IN     UINTN        Size,
+  IN OUT TEXT_INFO    *Info
   )
 {
-  EFI_STATUS  Status;
-  UINT32      Attributes = 0;
-  UINTN       Index;
-  CHAR16      *Name = NULL;
-  UINTN       NameSize = 256 * sizeof(CHAR16);
-  EFI_GUID    TempGuid;
-  BOOLEAN     Found = FALSE;
-  
-  // Проверяем входные параметры
-  if (VariableName == NULL || VariableData == NULL || VariableSize == NULL) {
-    return EFI_INVALID_PARAMETER;
-  }
-  
-  // Инициализируем выходные параметры
-  *VariableData = NULL;
-  *VariableSize = 0;
-  
-  // Если GUID указан, ищем только по нему
-  if (VariableGuid != NULL) {
-    // Получаем размер переменной
-    Status = gRT->GetVariable (
-                    (CHAR16*)VariableName,
-                    VariableGuid,
-                    &Attributes,
-                    VariableSize,
-                    NULL
-                    );
-                    
-    if (Status == EFI_BUFFER_TOO_SMALL) {
-      // Выделяем память для данных
-      *VariableData = AllocateZeroPool (*VariableSize);
-      if (*VariableData == NULL) {
-        return EFI_OUT_OF_RESOURCES;
+  UINTN    Index;
+  UINTN    Count;
+  UINTN    Latin;
+  UINT64   Word;
+  UINT16   Unit;
+  UINT16   Next;
+  BOOLEAN  Terminated;
+  
+  Index      = Info->Offset;
+  Count      = 0;
+  Latin      = 0;
+  Terminated = FALSE;
+  
+  while (Index + sizeof (CHAR16) <= Size) {
+    // Четыре печатаемых символа ASCII подряд проверяются одним сравнением
+    if (Index + sizeof (UINT64) <= Size) {
+      Word = ReadUnaligned64 ((CONST UINT64 *)(Bytes + Index));
+      if ((((Word - TEXT_UCS2_LOW_UNITS) | Word) & TEXT_UCS2_HIGH_BITS) == 0) {
+        Index += sizeof (UINT64);
+        Count += 4;
+        Latin += 4;
+        continue;
       }
-      
-      // Получаем значение переменной
-      Status = gRT->GetVariable (
-                      (CHAR16*)VariableName,
-                      VariableGuid,
-                      &Attributes,
-                      VariableSize,
-                      *VariableData
-                      );
-                      
-      if (EFI_ERROR (Status)) {
-        FreePool (*VariableData);
-        *VariableData = NULL;
-        *VariableSize = 0;
-      } else if (FoundGuid != NULL) {
-        CopyMem(FoundGuid, VariableGuid, sizeof(EFI_GUID));
+    }
+    
+    Unit = ReadUnaligned16 ((CONST UINT16 *)(Bytes + Index));
+    if (Unit == 0) {
+      Terminated = TRUE;
+      Index += sizeof (CHAR16);
+      break;
+    }
+    
+    if (Unit < 0x20 && !TextIsAllowedControl (Unit)) {
+      return FALSE;
+    }
+    
+    // Суррогатная пара допустима только целиком
+    if (Unit >= 0xD800 && Unit <= 0xDBFF) {
+      if (Index + 2 * sizeof (CHAR16) > Size) {
+        return FALSE;
+      }
+      Next = ReadUnaligned16 ((CONST UINT16 *)(Bytes + Index + sizeof (CHAR16)));
+      if (Next < 0xDC00 || Next > 0xDFFF) {
+        return FALSE;
       }
+      Index += 2 * sizeof (CHAR16);
+      Count += 2;
+      continue;
+    }
+    if (Unit == 0xFFFF && TextTailIsPadding (Bytes, Index, Size)) {
+      Index = Size;
+      break;
+    }
+    if ((Unit >= 0xDC00 && Unit <= 0xDFFF) || Unit >= 0xFFFE) {
+      return FALSE;
     }
     
-    return Status;
+    if (Unit < 0x100) {
+      Latin++;
+    }
+    Index += sizeof (CHAR16);
+    Count++;
   }
   
-  // Если GUID не указан, сначала ищем по известным GUID
-  for (Index = 0; mKnownGuids[Index].Guid != NULL && !Found; Index++) {
-    // Получаем размер переменной
-    Status = gRT->GetVariable (
-                    (CHAR16*)VariableName,
-                    mKnownGuids[Index].Guid,
-                    &Attributes,
-                    VariableSize,
-                    NULL
-                    );
-                    
-    if (Status == EFI_BUFFER_TOO_SMALL) {
-      // Выделяем память для данных
-      *VariableData = AllocateZeroPool (*VariableSize);
-      if (*VariableData == NULL) {
-        return EFI_OUT_OF_RESOURCES;
-      }
-      
-      // Получаем значение переменной
-      Status = gRT->GetVariable (
-                      (CHAR16*)VariableName,
-                      mKnownGuids[Index].Guid,
-                      &Attributes,
-                      VariableSize,
-                      *VariableData
-                      );
-                      
-      if (!EFI_ERROR (Status)) {
-        Found = TRUE;
-        if (FoundGuid != NULL) {
-          CopyMem(FoundGuid, mKnownGuids[Index].Guid, sizeof(EFI_GUID));
-        }
-      } else {
-        FreePool (*VariableData);
-        *VariableData = NULL;
-        *VariableSize = 0;
-      }
+  // Нечётный размер: последний байт допустим только как NUL
+  if (!Terminated && Index < Size) {
+    if (Bytes[Index] != 0) {
+      return FALSE;
     }
+    Terminated = TRUE;
+    Index++;
   }
   
-  // Если не нашли в известных GUID, перебираем все GUID в системе
-  if (!Found) {
-    // Выделяем буфер для имени переменной
-    Name = AllocateZeroPool (NameSize);
-    if (Name == NULL) {
-      return EFI_OUT_OF_RESOURCES;
+  if (Terminated && !TextTailIsPadding (Bytes, Index, Size)) {
+    return FALSE;
+  }
+  
+  if (!Info->Bom && (Count == 0 || Latin * 2 <= Count)) {
+    return FALSE;
+  }
+  
+  Info->Encoding   = TEXT_ENCODING_UCS2;
+  Info->Length     = Count;
+  Info->Terminated = Terminated;
+  return TRUE;
+}
+
+/**
+  Проверяет данные как ASCII или UTF-8, начиная с Info->Offset. Стёртые байты
+  0xFF до конца данных без NUL считаются заполнением.
+  
+  @param Bytes  Данные
+  @param Size   Размер данных
+  @param Info   Результат классификации (Offset и Bom заполнены)
+  
+  @retval TRUE  Данные - текст ASCII или UTF-8, Info заполнен
+  @retval FALSE Данные не являются текстом
+**/
+BOOLEAN
+TextScan8Bit (
+  IN     CONST UINT8  *Bytes,
+  IN     UINTN        Size,
+  IN OUT TEXT_INFO    *Info
+  )
+{
+  UINTN    Index;
+  UINTN    Length;
+  UINT64   Word;
+  BOOLEAN  NonAscii;
+  
+  Index    = Info->Offset;
+  NonAscii = FALSE;
+  
+  while (Index < Size) {
+    // Восемь печатаемых символов ASCII подряд проверяются одним сравнением
+    if (Index + sizeof (UINT64) <= Size) {
+      Word = ReadUnaligned64 ((CONST UINT64 *)(Bytes + Index));
+      if ((((Word - TEXT_ASCII_LOW_BYTES) | Word) & TEXT_ASCII_HIGH_BITS) == 0) {
+        Index += sizeof (UINT64);
+        continue;
+      }
     }
     
-    // Инициализируем переменные для начала поиска
-    ZeroMem (&TempGuid, sizeof (EFI_GUID));
-    Name[0] = 0;
+    if (Bytes[Index] == 0) {
+      Info->Terminated = TRUE;
+      break;
+    }
     
-    // Перебираем все переменные в системе
-    while (!Found) {
-      NameSize = 256 * sizeof(CHAR16);  // Восстанавливаем размер буфера
-      Status = gRT->GetNextVariableName (&NameSize, Name, &TempGuid);
-      
-      if (Status == EFI_BUFFER_TOO_SMALL) {
-        // Буфер слишком мал, увеличиваем его размер
-        FreePool (Name);
-        Name = AllocateZeroPool (NameSize);
-        if (Name == NULL) {
-          return EFI_OUT_OF_RESOURCES;
-        }
-        
-        // Повторяем попытку с увеличенным буфером
-        Status = gRT->GetNextVariableName (&NameSize, Name, &TempGuid);
-      }
-      
-      if (EFI_ERROR (Status)) {
-        if (Status == EFI_NOT_FOUND) {
-          // Больше переменных нет, завершаем поиск
-          Status = EFI_NOT_FOUND;
-          break;
-        } else {
-          // Другая ошибка
-          break;
-        }
-      }
-      
-      // Проверяем, совпадает ли имя с искомым
-      if (StrCmp (Name, VariableName) == 0) {
-        // Нашли переменную с нужным именем, получаем ее значение
-        *VariableSize = 0;
-        Status = gRT->GetVariable (Name, &TempGuid, &Attributes, VariableSize, NULL);
-        
-        if (Status == EFI_BUFFER_TOO_SMALL) {
-          // Выделяем память под данные
-          *VariableData = AllocateZeroPool (*VariableSize);
-          if (*VariableData == NULL) {
-            FreePool (Name);
-            return EFI_OUT_OF_RESOURCES;
-          }
-          
-          // Получаем значение переменной
-          Status = gRT->GetVariable (Name, &TempGuid, &Attributes, VariableSize, *VariableData);
-          
-          if (!EFI_ERROR (Status)) {
-            Found = TRUE;
-            if (FoundGuid != NULL) {
-              CopyMem(FoundGuid, &TempGuid, sizeof(EFI_GUID));
-            }
-            break; // Нашли переменную, выходим из цикла
-          } else {
-            FreePool (*VariableData);
-            *VariableData = NULL;
-            *VariableSize = 0;
-          }
-        }
+    if (Bytes[Index] == 0xFF && TextTailIsPadding (Bytes, Index, Size)) {
+      break;
+    }
+    
+    if (Bytes[Index] < 0x80) {
+      if (Bytes[Index] < 0x20 && !TextIsAllowedControl (Bytes[Index])) {
+        return FALSE;
       }
+      Index++;
+      continue;
     }
     
-    // Освобождаем память, выделенную для имени
-    if (Name != NULL) {
-      FreePool (Name);
+    Length = TextUtf8Sequence (Bytes + Index, Size - Index, NULL);
+    if (Length == 0) {
+      return FALSE;
     }
+    NonAscii = TRUE;
+    Index += Length;
   }
   
-  if (!Found) {
-    return EFI_NOT_FOUND;
+  if (Info->Terminated && !TextTailIsPadding (Bytes, Index + 1, Size)) {
+    return FALSE;
   }
   
-  return EFI_SUCCESS;
+  Info->Encoding = (NonAscii || Info->Bom) ? TEXT_ENCODING_UTF8 : TEXT_ENCODING_ASCII;
+  Info->Length   = Index - Info->Offset;
+  return TRUE;
 }
 
 /**
-  Функция поиска переменной по имени и префиксу GUID.
+  Определяет кодировку данных: UCS-2 (с BOM FF FE или без), UTF-8 (с BOM EF BB BF
+  или без), ASCII или двоичные данные. Текст может завершаться NUL, после которого
+  допускается только заполнение 0x00/0xFF; нечётный размер допустим.
+  Все функции, которым нужно прочитать данные как строку, используют эту классификацию.
+  
+  @param Data       Данные
+  @param DataSize   Размер данных
+  @param Info       Результат классификации
+**/
+VOID
+TextClassify (
+  IN  CONST VOID  *Data,
+  IN  UINTN       DataSize,
+  OUT TEXT_INFO   *Info
+  )
+{
+  CONST UINT8  *Bytes;
   
-  @param VariableName   Имя искомой переменной
-  @param GuidPrefix     Префикс GUID (может быть NULL)
-  @param OutputType     Тип вывода
+  Bytes = (CONST UINT8 *)Data;
+  ZeroMem (Info, sizeof (TEXT_INFO));
   
-  @retval EFI_SUCCESS   Переменная найдена и выведена
-  @retval другое        Ошибка при поиске или выводе
+  // BOM однозначно задаёт кодировку
+  if (DataSize >= 2 && Bytes[0] == 0xFF && Bytes[1] == 0xFE) {
+    Info->Bom    = TRUE;
+    Info->Offset = 2;
+    if (TextScanUcs2 (Bytes, DataSize, Info)) {
+      return;
+    }
+  } else if (DataSize >= 3 && Bytes[0] == 0xEF && Bytes[1] == 0xBB && Bytes[2] == 0xBF) {
+    Info->Bom    = TRUE;
+    Info->Offset = 3;
+    if (TextScan8Bit (Bytes, DataSize, Info)) {
+      return;
+    }
+  } else if (DataSize >= 2 && Bytes[0] != 0 && Bytes[1] == 0) {
+    // Первый символ с нулевым старшим байтом - вероятно UCS-2
+    if (TextScanUcs2 (Bytes, DataSize, Info)) {
+      return;
+    }
+    Info->Terminated = FALSE;
+    if (TextScan8Bit (Bytes, DataSize, Info)) {
+      return;
+    }
+  } else if (TextScan8Bit (Bytes, DataSize, Info)) {
+    return;
+  }
+  
+  ZeroMem (Info, sizeof (TEXT_INFO));
+  Info->Encoding = TEXT_ENCODING_BINARY;
+  Info->Length   = DataSize;
+}
+
+/**
+  Преобразует классифицированные данные в строку UCS-2. Символы ASCII копируются
+  по 8 за раз; символы вне BMP и неверные последовательности заменяются на U+FFFD.
+  Двоичные данные копируются побайтно до первого нуля.
+  
+  @param Data       Данные
+  @param Info       Результат TextClassify для этих данных
+  @param Text       Буфер строки
+  @param TextSize   Размер буфера в символах
+  
+  @return Количество записанных символов (без NUL)
 **/
-EFI_STATUS
-FindAndPrintVariable (
-  IN CONST CHAR16    *VariableName,
-  IN CONST CHAR16    *GuidPrefix,
-  IN OUTPUT_TYPE     OutputType
+UINTN
+TextDecode (
+  IN  CONST VOID       *Data,
+  IN  CONST TEXT_INFO  *Info,
+  OUT CHAR16           *Text,
+  IN  UINTN            TextSize
   )
 {
-  EFI_STATUS  Status;
-  VOID        *VariableData = NULL;
-  UINTN       VariableSize = 0;
-  UINT32      Attributes = 0;
-  EFI_GUID    TargetGuid;
-  BOOLEAN     GuidSpecified = FALSE;
-  UINTN       Index;
-  BOOLEAN     Found = FALSE;
-  EFI_GUID    FoundGuid;
+  CONST UINT8  *Bytes;
+  UINTN        Index;
+  UINTN        Used;
+  UINTN        Length;
+  UINT64       Word;
+  UINT32       Char;
   
-  // Если указан префикс GUID, пытаемся его распарсить
-  if (GuidPrefix != NULL && StrLen (GuidPrefix) > 0) {
-    GuidSpecified = ParseGuidPrefix (GuidPrefix, &TargetGuid);
-    if (!GuidSpecified) {
-      Print (L"Error: Invalid GUID prefix '%s'\n", GuidPrefix);
-      return EFI_INVALID_PARAMETER;
-    }
+  if (TextSize == 0) {
+    return 0;
   }
   
-  // Если GUID не указан, ищем переменную по всем доступным GUID
-  if (!GuidSpecified) {
-    Status = GetVariableData(
-              VariableName,
-              NULL,  // Ищем по всем GUID
-              &VariableData,
-              &VariableSize,
-              &FoundGuid
-              );
-              
-    if (!EFI_ERROR(Status)) {
-      Found = TRUE;
-      
-      // Проверяем, есть ли это GUID в известных GUID для более дружественного отображения
-      CHAR16 *GuidName = L"Unknown";
-      for (Index = 0; mKnownGuids[Index].Guid != NULL; Index++) {
-        if (CompareGuid (mKnownGuids[Index].Guid, &FoundGuid)) {
-          GuidName = mKnownGuids[Index].Name;
-          break;
+  Bytes = (CONST UINT8 *)Data + Info->Offset;
+  Used  = 0;
+  Index = 0;
+  
+  if (Info->Encoding == TEXT_ENCODING_UCS2) {
+    while (Index < Info->Length && Used + 1 < TextSize) {
+      Char = ReadUnaligned16 ((CONST UINT16 *)(Bytes + Index * sizeof (CHAR16)));
+      if (Char >= 0xD800 && Char <= 0xDBFF) {
+        // Символ вне BMP (суррогатная пара) не представим в UCS-2
+        Char = 0xFFFD;
+        Index++;
+      }
+      Text[Used++] = (CHAR16)Char;
+      Index++;
+    }
+  } else if (Info->Encoding == TEXT_ENCODING_BINARY) {
+    while (Index < Info->Length && Used + 1 < TextSize && Bytes[Index] != 0) {
+      Text[Used++] = (CHAR16)Bytes[Index++];
+    }
+  } else {
+    while (Index < Info->Length && Used + 1 < TextSize) {
+      // Восемь символов ASCII расширяются за один проход
+      if (Index + sizeof (UINT64) <= Info->Length && Used + sizeof (UINT64) < TextSize) {
+        Word = ReadUnaligned64 ((CONST UINT64 *)(Bytes + Index));
+        if ((Word & TEXT_ASCII_HIGH_BITS) == 0) {
+          Text[Used + 0] = (CHAR16)(UINT8)(Word);
+          Text[Used + 1] = (CHAR16)(UINT8)(Word >> 8);
+          Text[Used + 2] = (CHAR16)(UINT8)(Word >> 16);
+          Text[Used + 3] = (CHAR16)(UINT8)(Word >> 24);
+          Text[Used + 4] = (CHAR16)(UINT8)(Word >> 32);
+          Text[Used + 5] = (CHAR16)(UINT8)(Word >> 40);
+          Text[Used + 6] = (CHAR16)(UINT8)(Word >> 48);
+          Text[Used + 7] = (CHAR16)(UINT8)(Word >> 56);
+          Used  += sizeof (UINT64);
+          Index += sizeof (UINT64);
+          continue;
         }
       }
       
-      // Если режим вывода не "только данные", выводим информацию о переменной
-      if (OutputType == OUTPUT_ALL) {
-        Print (L"Variable Name: %s\n", VariableName);
-        Print (L"GUID: %s (%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X)\n", 
-               GuidName,
-               FoundGuid.Data1, FoundGuid.Data2, FoundGuid.Data3,
-               FoundGuid.Data4[0], FoundGuid.Data4[1], FoundGuid.Data4[2],
-               FoundGuid.Data4[3], FoundGuid.Data4[4], FoundGuid.Data4[5],
-               FoundGuid.Data4[6], FoundGuid.Data4[7]);
-        
-        // Получаем атрибуты переменной
-        gRT->GetVariable(
-               (CHAR16*)VariableName,
-               &FoundGuid,
-               &Attributes,
-               &VariableSize,
-               VariableData
-               );
-        
-        Print (L"Size: %d bytes\n", VariableSize);
-        Print (L"Attributes: 0x%08X\n\n", Attributes);
-        
-        Print (L"Hexadecimal dump:\n");
-        PrintHexDump (VariableData, VariableSize);
-        
-        Print (L"\nAs string (UCS-2): ");
-        PrintUcsString (VariableData, VariableSize);
-        
-        Print (L"As string (ASCII): ");
-        PrintAsciiString (VariableData, VariableSize);
-      } else {
-        // Выводим только в указанном формате
-        switch (OutputType) {
-          case OUTPUT_HEX:
-            PrintHexDump (VariableData, VariableSize);
-            break;
-          case OUTPUT_ASCII:
-            PrintAsciiString (VariableData, VariableSize);
-            break;
-          case OUTPUT_UCS:
-            PrintUcsString (VariableData, VariableSize);
-            break;
-          default:
-            break;
-        }
+      if (Bytes[Index] < 0x80) {
+        Text[Used++] = (CHAR16)Bytes[Index++];
+        continue;
       }
-    }
-  } else {
-    // Ищем по указанному GUID
-    Status = GetVariableData(
-              VariableName,
-              &TargetGuid,
-              &VariableData,
-              &VariableSize,
-              NULL
-              );
-              
-    if (!EFI_ERROR(Status)) {
-      Found = TRUE;
       
-      // Если режим вывода не "только данные", выводим информацию о переменной
-      if (OutputType == OUTPUT_ALL) {
-        Print (L"Variable Name: %s\n", VariableName);
-        Print (L"GUID: ");
-        Print (L"%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X\n",
-               TargetGuid.Data1, TargetGuid.Data2, TargetGuid.Data3,
-               TargetGuid.Data4[0], TargetGuid.Data4[1], TargetGuid.Data4[2],
-               TargetGuid.Data4[3], TargetGuid.Data4[4], TargetGuid.Data4[5],
-               TargetGuid.Data4[6], TargetGuid.Data4[7]);
-        
-        // Получаем атрибуты переменной
-        gRT->GetVariable(
-               (CHAR16*)VariableName,
-               &TargetGuid,
-               &Attributes,
-               &VariableSize,
-               VariableData
-               );
-        
-        Print (L"Size: %d bytes\n", VariableSize);
-        Print (L"Attributes: 0x%08X\n\n", Attributes);
-        
-        Print (L"Hexadecimal dump:\n");
-        PrintHexDump (VariableData, VariableSize);
-        
-        Print (L"\nAs string (UCS-2): ");
-        PrintUcsString (VariableData, VariableSize);
-        
-        Print (L"As string (ASCII): ");
-        PrintAsciiString (VariableData, VariableSize);
+      Length = TextUtf8Sequence (Bytes + Index, Info->Length - Index, &Char);
+      if (Length == 0) {
+        Text[Used++] = 0xFFFD;
+        Index++;
       } else {
-        // Выводим только в указанном формате
-        switch (OutputType) {
-          case OUTPUT_HEX:
-            PrintHexDump (VariableData, VariableSize);
-            break;
-          case OUTPUT_ASCII:
-            PrintAsciiString (VariableData, VariableSize);
-            break;
-          case OUTPUT_UCS:
-            PrintUcsString (VariableData, VariableSize);
-            break;
-          default:
-            break;
-        }
+        Text[Used++] = (Char > 0xFFFF) ? 0xFFFD : (CHAR16)Char;
+        Index += Length;
       }
     }
   }
   
-  // Освобождаем память, если была выделена
-  if (VariableData != NULL) {
-    FreePool (VariableData);
+  Text[Used] = L'\0';
+  return Used;
+}
+
+/**
+  Выводит данные как текст в определённой кодировке. Строка выводится через
+  ConOut целиком, управляющие символы заменяются точкой.
+  
+  @param Data       Данные
+  @param DataSize   Размер данных
+**/
+VOID
+PrintDecodedString (
+  IN CONST VOID  *Data,
+  IN UINTN       DataSize
+  )
+{
+  TEXT_INFO  Info;
+  CHAR16     *Text;
+  UINTN      Length;
+  UINTN      Index;
+  
+  TextClassify (Data, DataSize, &Info);
+  Print (L"(%s%s) ", mTextEncodingNames[Info.Encoding], Info.Bom ? L", BOM" : L"");
+  if (Info.Encoding == TEXT_ENCODING_BINARY) {
+    Print (L"not text\n");
+    return;
   }
   
-  if (!Found) {
-    Print (L"Variable '%s' not found", VariableName);
-    if (GuidSpecified) {
-      Print (L" with specified GUID");
+  Text = AllocatePool ((Info.Length + 1) * sizeof (CHAR16));
+  if (Text == NULL) {
+    Print (L"(out of memory)\n");
+    return;
+  }
+  
+  Length = TextDecode (Data, &Info, Text, Info.Length + 1);
+  for (Index = 0; Index < Length; Index++) {
+    if (Text[Index] < 0x20 || Text[Index] == 0x7F) {
+      Text[Index] = L'.';
     }
-    Print (L"\n");
-    return EFI_NOT_FOUND;
   }
   
-  return EFI_SUCCESS;
+  gST->ConOut->OutputString (gST->ConOut, Text);
+  Print (L"\n");
+  FreePool (Text);
 }
 
 /**
-  Перезагружает систему с загрузкой через BOOTx64.efi.
-  Ожидает нажатия клавиши перед перезагрузкой.
+  Функция для вывода данных в виде ASCII-строки.
+  Вывод ограничен DataSize и идёт блоками по PRINT_CHUNK_CHARS символов.
   
-  @retval EFI_SUCCESS   Команда перезагрузки отправлена
-  @retval другое        Ошибка при отправке команды перезагрузки
+  @param Data     Указатель на данные
+  @param DataSize Размер данных в байтах
+**/
+VOID
+PrintAsciiString (
+  IN CONST VOID  *Data,
+  IN UINTN       DataSize
+  )
+{
+  CONST UINT8 *AsciiData = (CONST UINT8*)Data;
+  CHAR16      Chunk[PRINT_CHUNK_CHARS + 1];
+  UINTN       Used = 0;
+  UINTN       Index;
+  
+  for (Index = 0; Index < DataSize; Index++) {
+    // Нулевой байт - конец строки
+    if (AsciiData[Index] == 0) {
+      break;
+    }
+    
+    // Выводим только печатаемые ASCII символы, остальные заменяем точкой
+    Chunk[Used++] = (AsciiData[Index] >= 0x20 && AsciiData[Index] <= 0x7E) ? (CHAR16)AsciiData[Index] : L'.';
+    if (Used == PRINT_CHUNK_CHARS) {
+      Chunk[Used] = L'\0';
+      Print (L"%s", Chunk);
+      Used = 0;
+    }
+  }
+  
+  Chunk[Used] = L'\0';
+  Print (L"%s\n", Chunk);
+}
+
+/**
+  Функция для вывода данных в виде UCS-2 строки.
+  Строка не обязана заканчиваться NUL: вывод ограничен DataSize, данные
+  читаются побайтно и могут быть не выровнены.
+  
+  @param Data     Указатель на данные
+  @param DataSize Размер данных в байтах
+**/
+VOID
+PrintUcsString (
+  IN CONST VOID  *Data,
+  IN UINTN       DataSize
+  )
+{
+  CONST UINT8 *Bytes = (CONST UINT8*)Data;
+  CHAR16      Chunk[PRINT_CHUNK_CHARS + 1];
+  CHAR16      Char;
+  UINTN       Used = 0;
+  UINTN       Index;
+  
+  if (DataSize < 2) { // Нет ни одного символа CHAR16
+    Print (L"(too small for UCS-2 string)\n");
+    return;
+  }
+  
+  for (Index = 0; Index + 1 < DataSize; Index += 2) {
+    Char = (CHAR16)(Bytes[Index] | (Bytes[Index + 1] << 8));
+    if (Char == L'\0') {
+      break;
+    }
+    
+    // Управляющие символы заменяем точкой, чтобы не портить консоль
+    Chunk[Used++] = (Char < 0x20 || Char == 0x7F) ? L'.' : Char;
+    if (Used == PRINT_CHUNK_CHARS) {
+      Chunk[Used] = L'\0';
+      Print (L"%s", Chunk);
+      Used = 0;
+    }
+  }
+  
+  Chunk[Used] = L'\0';
+  Print (L"%s\n", Chunk);
+}
+
+/**
+  Создаёт файл для записи. Существующий файл удаляется, чтобы не оставлять
+  хвост от прежнего содержимого.
+  
+  @param FilePath   Путь к файлу
+  @param FileHandle Указатель на хендл открытого файла
+  
+  @retval EFI_SUCCESS   Файл создан
+  @retval другое        Ошибка при создании файла
 **/
 EFI_STATUS
-RebootToBoot (
-  VOID
+CreateOutputFile (
+  IN  CONST CHAR16       *FilePath,
+  OUT SHELL_FILE_HANDLE  *FileHandle
   )
 {
   EFI_STATUS  Status;
-  EFI_GUID    BootGuid = EFI_GLOBAL_VARIABLE;
-  CHAR16      *BootFileName = L"\\EFI\\BOOT\\BOOTx64.EFI";
-  CHAR16      *BootOptionName = L"SNSniffReboot";
-  UINT16      BootOrder = 0;
-  EFI_INPUT_KEY Key;
   
-  // Устанавливаем загрузочный вариант
-  Status = gRT->SetVariable (
-                  BootOptionName,
-                  &BootGuid,
-                  EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
-                  StrSize (BootFileName),
-                  BootFileName
-                  );
-                  
-  if (EFI_ERROR (Status)) {
-    Print (L"Error: Failed to set boot option\n");
-    return Status;
+  Status = ShellOpenFileByName (FilePath, FileHandle, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0);
+  if (!EFI_ERROR (Status)) {
+    ShellDeleteFile (FileHandle);
   }
   
-  // Устанавливаем порядок загрузки
-  Status = gRT->SetVariable (
-                  L"BootOrder",
-                  &BootGuid,
-                  EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
-                  sizeof (UINT16),
-                  &BootOrder
-                  );
-                  
+  return ShellOpenFileByName (
+           FilePath,
+           FileHandle,
+           EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE,
+           0
+           );
+}
+
+/**
+  Открывает файл для буферизованной записи крупными блоками.
+  
+  @param Writer     Указатель на структуру записи
+  @param FilePath   Путь к файлу
+  
+  @retval EFI_SUCCESS           Файл открыт
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+  @retval другое                Ошибка при создании файла
+**/
+EFI_STATUS
+OpenFileWriter (
+  OUT FILE_WRITER   *Writer,
+  IN  CONST CHAR16  *FilePath
+  )
+{
+  EFI_STATUS  Status;
+  
+  ZeroMem (Writer, sizeof (FILE_WRITER));
+  
+  Writer->Buffer = AllocatePool (FILE_WRITER_BLOCK_SIZE);
+  if (Writer->Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  
+  Status = CreateOutputFile (FilePath, &Writer->Handle);
   if (EFI_ERROR (Status)) {
-    Print (L"Error: Failed to set boot order\n");
+    FreePool (Writer->Buffer);
+    Writer->Buffer = NULL;
     return Status;
   }
   
-  // Ждем нажатия клавиши перед перезагрузкой
-  Print (L"Press any key to reboot to BOOTx64.efi...\n");
-  gBS->WaitForEvent (1, &gST->ConIn->WaitForKey, NULL);
-  gST->ConIn->ReadKeyStroke (gST->ConIn, &Key);
+  return EFI_SUCCESS;
+}
+
+/**
+  Записывает накопленный блок в файл.
+  
+  @param Writer   Указатель на структуру записи
+  
+  @retval EFI_SUCCESS   Блок записан
+  @retval другое        Ошибка записи (сохраняется в Writer->Status)
+**/
+EFI_STATUS
+FlushFileWriter (
+  IN OUT FILE_WRITER  *Writer
+  )
+{
+  UINTN  Size;
+  
+  if (!EFI_ERROR (Writer->Status) && Writer->Used > 0) {
+    Size = Writer->Used;
+    Writer->Status = ShellWriteFile (Writer->Handle, &Size, Writer->Buffer);
+    if (!EFI_ERROR (Writer->Status) && Size != Writer->Used) {
+      Writer->Status = EFI_VOLUME_FULL;
+    }
+  }
+  Writer->Used = 0;
+  
+  return Writer->Status;
+}
+
+/**
+  Добавляет данные в буфер записи. Данные крупнее блока пишутся напрямую.
+  
+  @param Writer   Указатель на структуру записи
+  @param Data     Данные
+  @param Size     Размер данных
+  
+  @retval EFI_SUCCESS   Данные приняты
+  @retval другое        Ошибка записи (первая ошибка сохраняется в Writer->Status)
+**/
+EFI_STATUS
+WriteFileWriter (
+  IN OUT FILE_WRITER  *Writer,
+  IN     CONST VOID   *Data,
+  IN     UINTN        Size
+  )
+{
+  UINTN  Written;
+  
+  if (EFI_ERROR (Writer->Status)) {
+    return Writer->Status;
+  }
+  
+  if (Writer->Used + Size > FILE_WRITER_BLOCK_SIZE) {
+    if (EFI_ERROR (FlushFileWriter (Writer))) {
+      return Writer->Status;
+    }
+  }
+  
+  if (Size >= FILE_WRITER_BLOCK_SIZE) {
+    Written = Size;
+    Writer->Status = ShellWriteFile (Writer->Handle, &Written, (VOID *)Data);
+    if (!EFI_ERROR (Writer->Status) && Written != Size) {
+      Writer->Status = EFI_VOLUME_FULL;
+    }
+  } else {
+    CopyMem (&Writer->Buffer[Writer->Used], Data, Size);
+    Writer->Used += Size;
+  }
+  
+  if (!EFI_ERROR (Writer->Status)) {
+    Writer->Offset += Size;
+  }
+  
+  return Writer->Status;
+}
+
+/**
+  Сбрасывает буфер, закрывает файл и освобождает ресурсы записи.
+  
+  @param Writer   Указатель на структуру записи
+  
+  @retval EFI_SUCCESS   Все данные записаны
+  @retval другое        Первая ошибка, возникшая при записи
+**/
+EFI_STATUS
+CloseFileWriter (
+  IN OUT FILE_WRITER  *Writer
+  )
+{
+  EFI_STATUS  Status;
+  
+  FlushFileWriter (Writer);
+  Status = Writer->Status;
+  
+  if (Writer->Handle != NULL) {
+    ShellCloseFile (&Writer->Handle);
+    Writer->Handle = NULL;
+  }
+  if (Writer->Buffer != NULL) {
+    FreePool (Writer->Buffer);
+    Writer->Buffer = NULL;
+  }
+  
+  return Status;
+}
+
+/**
+  Разбирает префикс GUID в шаблон из шестнадцатеричных цифр.
+  Дефисы необязательны и игнорируются, регистр цифр не важен.
+  
+  @param GuidString  Строка с GUID или префиксом GUID
+  @param Pattern     Указатель на шаблон для результата
+  
+  @retval TRUE       Префикс успешно разобран
+  @retval FALSE      Ошибка при разборе
+**/
+BOOLEAN
+ParseGuidPattern (
+  IN  CONST CHAR16  *GuidString,
+  OUT GUID_PATTERN  *Pattern
+  )
+{
+  CHAR16  Char;
+  
+  if (GuidString == NULL || Pattern == NULL) {
+    return FALSE;
+  }
+  
+  ZeroMem (Pattern, sizeof (GUID_PATTERN));
+  
+  for (; *GuidString != 0; GuidString++) {
+    Char = *GuidString;
+    if (Char == L'-') {
+      continue;
+    }
+    if (Pattern->Count == GUID_PATTERN_NIBBLES) {
+      return FALSE;
+    }
+    
+    if (Char >= L'0' && Char <= L'9') {
+      Pattern->Nibbles[Pattern->Count++] = (UINT8)(Char - L'0');
+    } else if (Char >= L'a' && Char <= L'f') {
+      Pattern->Nibbles[Pattern->Count++] = (UINT8)(Char - L'a' + 10);
+    } else if (Char >= L'A' && Char <= L'F') {
+      Pattern->Nibbles[Pattern->Count++] = (UINT8)(Char - L'A' + 10);
+    } else {
+      return FALSE;
+    }
+  }
+  
+  return Pattern->Count > 0;
+}
+
+/**
+  Раскладывает GUID на шестнадцатеричные цифры в порядке его текстовой записи.
+  
+  @param Guid     GUID
+  @param Nibbles  Буфер для GUID_PATTERN_NIBBLES цифр
+**/
+VOID
+GuidToNibbles (
+  IN  CONST EFI_GUID  *Guid,
+  OUT UINT8           *Nibbles
+  )
+{
+  UINTN  Index;
+  
+  for (Index = 0; Index < 8; Index++) {
+    Nibbles[Index] = (UINT8)((Guid->Data1 >> (28 - 4 * Index)) & 0xF);
+  }
+  for (Index = 0; Index < 4; Index++) {
+    Nibbles[8 + Index]  = (UINT8)((Guid->Data2 >> (12 - 4 * Index)) & 0xF);
+    Nibbles[12 + Index] = (UINT8)((Guid->Data3 >> (12 - 4 * Index)) & 0xF);
+  }
+  for (Index = 0; Index < 8; Index++) {
+    Nibbles[16 + 2 * Index]     = (UINT8)(Guid->Data4[Index] >> 4);
+    Nibbles[16 + 2 * Index + 1] = (UINT8)(Guid->Data4[Index] & 0xF);
+  }
+}
+
+/**
+  Проверяет, является ли шаблон полным GUID, и при необходимости собирает его.
+  
+  @param Pattern  Шаблон GUID
+  @param Guid     Указатель на GUID для результата (может быть NULL)
+  
+  @retval TRUE    Шаблон задаёт полный GUID
+  @retval FALSE   Шаблон является префиксом
+**/
+BOOLEAN
+GuidPatternToGuid (
+  IN  CONST GUID_PATTERN  *Pattern,
+  OUT EFI_GUID            *Guid OPTIONAL
+  )
+{
+  UINTN  Index;
+  
+  if (Pattern->Count != GUID_PATTERN_NIBBLES) {
+    return FALSE;
+  }
+  
+  if (Guid != NULL) {
+    ZeroMem (Guid, sizeof (EFI_GUID));
+    for (Index = 0; Index < 8; Index++) {
+      Guid->Data1 = (Guid->Data1 << 4) | Pattern->Nibbles[Index];
+    }
+    for (Index = 0; Index < 4; Index++) {
+      Guid->Data2 = (UINT16)((Guid->Data2 << 4) | Pattern->Nibbles[8 + Index]);
+      Guid->Data3 = (UINT16)((Guid->Data3 << 4) | Pattern->Nibbles[12 + Index]);
+    }
+    for (Index = 0; Index < 8; Index++) {
+      Guid->Data4[Index] = (UINT8)((Pattern->Nibbles[16 + 2 * Index] << 4) | Pattern->Nibbles[16 + 2 * Index + 1]);
+    }
+  }
+  
+  return TRUE;
+}
+
+/**
+  Проверяет, начинается ли текстовая запись GUID с заданного префикса.
+  
+  @param Pattern  Шаблон GUID (NULL или пустой шаблон - любой GUID)
+  @param Guid     Проверяемый GUID
+  
+  @retval TRUE    GUID соответствует шаблону
+  @retval FALSE   GUID не соответствует шаблону
+**/
+BOOLEAN
+MatchGuidPattern (
+  IN CONST GUID_PATTERN  *Pattern OPTIONAL,
+  IN CONST EFI_GUID      *Guid
+  )
+{
+  UINT8  Nibbles[GUID_PATTERN_NIBBLES];
+  
+  if (Pattern == NULL || Pattern->Count == 0) {
+    return TRUE;
+  }
+  
+  GuidToNibbles (Guid, Nibbles);
+  return CompareMem (Nibbles, Pattern->Nibbles, Pattern->Count) == 0;
+}
+
+/**
+  Проверяет, содержит ли имя символы шаблона ('*' или '?').
+  
+  @param Name     Имя или шаблон имени
+  
+  @retval TRUE    Имя является шаблоном
+  @retval FALSE   Обычное имя
+**/
+BOOLEAN
+IsNamePattern (
+  IN CONST CHAR16  *Name
+  )
+{
+  for (; *Name != 0; Name++) {
+    if (*Name == L'*' || *Name == L'?') {
+      return TRUE;
+    }
+  }
+  
+  return FALSE;
+}
+
+/**
+  Сопоставляет имя переменной с шаблоном ('*' - любая последовательность,
+  '?' - любой символ). Сравнение чувствительно к регистру, как имена переменных UEFI.
+  
+  @param Pattern  Шаблон имени
+  @param Name     Имя переменной
+  
+  @retval TRUE    Имя соответствует шаблону
+  @retval FALSE   Имя не соответствует шаблону
+**/
+BOOLEAN
+MatchNamePattern (
+  IN CONST CHAR16  *Pattern,
+  IN CONST CHAR16  *Name
+  )
+{
+  CONST CHAR16  *StarPattern;
+  CONST CHAR16  *StarName;
+  
+  StarPattern = NULL;
+  StarName = NULL;
+  
+  while (*Name != 0) {
+    if (*Pattern == L'?' || *Pattern == *Name) {
+      Pattern++;
+      Name++;
+    } else if (*Pattern == L'*') {
+      // Запоминаем позицию для возврата, если дальнейшее сопоставление не удастся
+      StarPattern = Pattern++;
+      StarName = Name;
+    } else if (StarPattern != NULL) {
+      Pattern = StarPattern + 1;
+      Name = ++StarName;
+    } else {
+      return FALSE;
+    }
+  }
+  
+  while (*Pattern == L'*') {
+    Pattern++;
+  }
+  
+  return *Pattern == 0;
+}
+
+/**
+  Вычисляет хеш GUID для таблицы реестра.
+  
+  @param Guid     GUID
+  
+  @retval         Значение хеша
+**/
+UINT32
+HashGuid (
+  IN CONST EFI_GUID  *Guid
+  )
+{
+  CONST UINT32  *Words;
+  UINT32        Hash;
+  
+  Words = (CONST UINT32 *)Guid;
+  Hash = Words[0] ^ (Words[1] * 0x9E3779B1U) ^ (Words[2] * 0x85EBCA77U) ^ (Words[3] * 0xC2B2AE3DU);
+  return Hash ^ (Hash >> 16);
+}
+
+/**
+  Ищет GUID в реестре через хеш-таблицу.
+  
+  @param Registry Указатель на реестр
+  @param Guid     Искомый GUID
+  
+  @retval         Индекс записи или MAX_UINTN, если GUID не зарегистрирован
+**/
+UINTN
+GuidRegistryFind (
+  IN CONST GUID_REGISTRY  *Registry,
+  IN CONST EFI_GUID       *Guid
+  )
+{
+  UINTN  Slot;
+  
+  if (Registry->SlotCount == 0) {
+    return MAX_UINTN;
+  }
+  
+  for (Slot = HashGuid (Guid) & (Registry->SlotCount - 1);
+       Registry->Slots[Slot] != 0;
+       Slot = (Slot + 1) & (Registry->SlotCount - 1)) {
+    if (CompareGuid (&Registry->Entries[Registry->Slots[Slot] - 1].Guid, Guid)) {
+      return Registry->Slots[Slot] - 1;
+    }
+  }
+  
+  return MAX_UINTN;
+}
+
+/**
+  Перестраивает хеш-таблицу реестра под новое количество слотов.
+  
+  @param Registry   Указатель на реестр
+  @param SlotCount  Новое количество слотов (степень двойки)
+  
+  @retval EFI_SUCCESS           Таблица перестроена
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+**/
+EFI_STATUS
+GuidRegistryRehash (
+  IN OUT GUID_REGISTRY  *Registry,
+  IN     UINTN          SlotCount
+  )
+{
+  UINT32  *Slots;
+  UINTN   Index;
+  UINTN   Slot;
+  
+  Slots = AllocateZeroPool (SlotCount * sizeof (UINT32));
+  if (Slots == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  
+  for (Index = 0; Index < Registry->Count; Index++) {
+    Slot = HashGuid (&Registry->Entries[Index].Guid) & (SlotCount - 1);
+    while (Slots[Slot] != 0) {
+      Slot = (Slot + 1) & (SlotCount - 1);
+    }
+    Slots[Slot] = (UINT32)(Index + 1);
+  }
+  
+  if (Registry->Slots != NULL) {
+    FreePool (Registry->Slots);
+  }
+  Registry->Slots = Slots;
+  Registry->SlotCount = SlotCount;
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Добавляет GUID в реестр. Для уже зарегистрированного GUID обновляет имя.
+  
+  @param Registry Указатель на реестр
+  @param Guid     GUID производителя
+  @param Name     Дружественное имя
+  @param FromFile TRUE, если запись загружена из файла на ESP
+  
+  @retval EFI_SUCCESS           Запись добавлена или обновлена
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+**/
+EFI_STATUS
+GuidRegistryAdd (
+  IN OUT GUID_REGISTRY   *Registry,
+  IN     CONST EFI_GUID  *Guid,
+  IN     CONST CHAR16    *Name,
+  IN     BOOLEAN         FromFile
+  )
+{
+  EFI_STATUS           Status;
+  GUID_REGISTRY_ENTRY  *Entry;
+  UINTN                Index;
+  UINTN                Slot;
+  UINTN                NewCapacity;
+  GUID_REGISTRY_ENTRY  *NewEntries;
+  UINT32               *NewProbeOrder;
+  
+  Index = GuidRegistryFind (Registry, Guid);
+  if (Index == MAX_UINTN) {
+    // Увеличиваем массив записей и порядок проверки при необходимости
+    if (Registry->Count == Registry->Capacity) {
+      NewCapacity = (Registry->Capacity == 0) ? 32 : Registry->Capacity * 2;
+      // Ёмкость меняется только после успешного увеличения обоих массивов
+      NewEntries = ReallocatePool (
+                     Registry->Capacity * sizeof (GUID_REGISTRY_ENTRY),
+                     NewCapacity * sizeof (GUID_REGISTRY_ENTRY),
+                     Registry->Entries
+                     );
+      if (NewEntries == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+      }
+      Registry->Entries = NewEntries;
+      
+      NewProbeOrder = ReallocatePool (
+                        Registry->Capacity * sizeof (UINT32),
+                        NewCapacity * sizeof (UINT32),
+                        Registry->ProbeOrder
+                        );
+      if (NewProbeOrder == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+      }
+      Registry->ProbeOrder = NewProbeOrder;
+      Registry->Capacity = NewCapacity;
+    }
+    
+    // Держим заполнение хеш-таблицы не выше половины
+    if ((Registry->Count + 1) * 2 > Registry->SlotCount) {
+      Status = GuidRegistryRehash (Registry, MAX (Registry->SlotCount * 2, 64));
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+    
+    Index = Registry->Count;
+    ZeroMem (&Registry->Entries[Index], sizeof (GUID_REGISTRY_ENTRY));
+    CopyGuid (&Registry->Entries[Index].Guid, Guid);
+    Registry->ProbeOrder[Index] = (UINT32)Index;
+    Registry->Count++;
+    
+    // Вставляем в хеш-таблицу
+    Slot = HashGuid (Guid) & (Registry->SlotCount - 1);
+    while (Registry->Slots[Slot] != 0) {
+      Slot = (Slot + 1) & (Registry->SlotCount - 1);
+    }
+    Registry->Slots[Slot] = (UINT32)(Index + 1);
+  }
+  
+  Entry = &Registry->Entries[Index];
+  StrnCpyS (Entry->Name, GUID_NAME_LENGTH, Name, GUID_NAME_LENGTH - 1);
+  Entry->FromFile = Entry->FromFile || FromFile;
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Сортирует порядок проверки GUID: по убыванию попаданий, при равенстве -
+  порядок регистрации (встроенные GUID раньше файла). Иначе большой файл
+  реестра вытеснил бы из быстрой проверки промежуточные GUID AMI и Insyde.
+  
+  @param Registry Указатель на реестр
+**/
+VOID
+GuidRegistrySortProbeOrder (
+  IN OUT GUID_REGISTRY  *Registry
+  )
+{
+  UINTN                Index;
+  UINTN                Pos;
+  UINT32               Current;
+  GUID_REGISTRY_ENTRY  *A;
+  GUID_REGISTRY_ENTRY  *B;
+  
+  // Сортировка вставками: записей немного, и порядок почти всегда уже верный
+  for (Index = 1; Index < Registry->Count; Index++) {
+    Current = Registry->ProbeOrder[Index];
+    A = &Registry->Entries[Current];
+    for (Pos = Index; Pos > 0; Pos--) {
+      B = &Registry->Entries[Registry->ProbeOrder[Pos - 1]];
+      if (A->Hits < B->Hits ||
+          (A->Hits == B->Hits && Current > Registry->ProbeOrder[Pos - 1])) {
+        break;
+      }
+      Registry->ProbeOrder[Pos] = Registry->ProbeOrder[Pos - 1];
+    }
+    Registry->ProbeOrder[Pos] = Current;
+  }
+}
+
+/**
+  Разбирает строку файла реестра вида "GUID остаток".
+  
+  @param Line     Строка файла (изменяется: обрезаются завершающие пробелы)
+  @param Guid     Указатель на разобранный GUID
+  @param Rest     Указатель на остаток строки после GUID
+  
+  @retval TRUE    Строка содержит GUID
+  @retval FALSE   Пустая строка, комментарий или ошибка формата
+**/
+BOOLEAN
+ParseGuidRegistryLine (
+  IN OUT CHAR16    *Line,
+  OUT    EFI_GUID  *Guid,
+  OUT    CHAR16    **Rest
+  )
+{
+  CHAR16  GuidText[37];
+  UINTN   Length;
+  
+  while (*Line == L' ' || *Line == L'\t') {
+    Line++;
+  }
+  
+  // Обрезаем завершающие пробелы и перевод строки
+  Length = StrLen (Line);
+  while (Length > 0 && (Line[Length - 1] == L' ' || Line[Length - 1] == L'\t' ||
+                        Line[Length - 1] == L'\r' || Line[Length - 1] == L'\n')) {
+    Line[--Length] = 0;
+  }
+  
+  if (Length < 36 || Line[0] == L'#') {
+    return FALSE;
+  }
+  
+  CopyMem (GuidText, Line, 36 * sizeof (CHAR16));
+  GuidText[36] = 0;
+  if (EFI_ERROR (StrToGuid (GuidText, Guid))) {
+    return FALSE;
+  }
+  
+  Line += 36;
+  while (*Line == L' ' || *Line == L'\t') {
+    Line++;
+  }
+  *Rest = Line;
+  
+  return TRUE;
+}
+
+/**
+  Загружает дополнительные GUID из файла на ESP.
+  
+  @param Registry Указатель на реестр
+  @param FilePath Путь к файлу реестра
+  
+  @retval EFI_SUCCESS   Файл загружен
+  @retval другое        Файл отсутствует или не читается
+**/
+EFI_STATUS
+GuidRegistryLoadFile (
+  IN OUT GUID_REGISTRY  *Registry,
+  IN     CONST CHAR16   *FilePath
+  )
+{
+  EFI_STATUS         Status;
+  SHELL_FILE_HANDLE  FileHandle;
+  CHAR16             *Line;
+  CHAR16             *Name;
+  BOOLEAN            Ascii;
+  EFI_GUID           Guid;
+  
+  Status = ShellOpenFileByName (FilePath, &FileHandle, EFI_FILE_MODE_READ, 0);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  while (!ShellFileHandleEof (FileHandle)) {
+    Line = ShellFileHandleReadLine (FileHandle, &Ascii);
+    if (Line == NULL) {
+      break;
+    }
+    
+    if (ParseGuidRegistryLine (Line, &Guid, &Name)) {
+      Status = GuidRegistryAdd (Registry, &Guid, (*Name != 0) ? Name : L"Vendor", TRUE);
+    } else if (Line[0] != 0 && Line[0] != L'#') {
+      Print (L"Warning: Skipping malformed line in '%s': %s\n", FilePath, Line);
+    }
+    
+    FreePool (Line);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+  
+  ShellCloseFile (&FileHandle);
+  return Status;
+}
+
+/**
+  Загружает сохранённую статистику попаданий для GUID реестра.
+  
+  @param Registry Указатель на реестр
+**/
+VOID
+GuidRegistryLoadStats (
+  IN OUT GUID_REGISTRY  *Registry
+  )
+{
+  EFI_STATUS         Status;
+  SHELL_FILE_HANDLE  FileHandle;
+  CHAR16             *Line;
+  CHAR16             *Count;
+  BOOLEAN            Ascii;
+  EFI_GUID           Guid;
+  UINTN              Index;
+  
+  if (Registry->StatsPath == NULL) {
+    return;
+  }
+  
+  Status = ShellOpenFileByName (Registry->StatsPath, &FileHandle, EFI_FILE_MODE_READ, 0);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+  
+  while (!ShellFileHandleEof (FileHandle)) {
+    Line = ShellFileHandleReadLine (FileHandle, &Ascii);
+    if (Line == NULL) {
+      break;
+    }
+    
+    if (ParseGuidRegistryLine (Line, &Guid, &Count)) {
+      Index = GuidRegistryFind (Registry, &Guid);
+      if (Index != MAX_UINTN) {
+        Registry->Entries[Index].Hits = (UINT32)MIN (StrDecimalToUintn (Count), MAX_UINT32 / 2);
+      }
+    }
+    
+    FreePool (Line);
+  }
+  
+  ShellCloseFile (&FileHandle);
+}
+
+/**
+  Загружает реестр GUID: встроенные записи, файл на ESP и статистику попаданий
+  (только если файл реестра найден). Повторные вызовы ничего не делают.
+  
+  @retval EFI_SUCCESS           Реестр готов
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+**/
+EFI_STATUS
+LoadGuidRegistry (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+  UINTN       DirLength;
+  UINTN       PathSize;
+  
+  if (mGuidRegistry.Loaded) {
+    return EFI_SUCCESS;
+  }
+  
+  for (Index = 0; mBuiltinGuids[Index].Guid != NULL; Index++) {
+    Status = GuidRegistryAdd (&mGuidRegistry, mBuiltinGuids[Index].Guid, mBuiltinGuids[Index].Name, FALSE);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+  
+  // Файл реестра необязателен
+  Status = GuidRegistryLoadFile (&mGuidRegistry, mGuidRegistry.FilePath);
+  if (Status == EFI_OUT_OF_RESOURCES) {
+    return Status;
+  }
+  
+  // Статистика хранится рядом с файлом реестра. Без файла реестра она не ведётся:
+  // путь по умолчанию относительный, и файл статистики появился бы в текущем каталоге
+  if (!EFI_ERROR (Status) && mGuidRegistry.StatsPath == NULL) {
+    DirLength = StrLen (mGuidRegistry.FilePath);
+    while (DirLength > 0 &&
+           mGuidRegistry.FilePath[DirLength - 1] != L'\\' &&
+           mGuidRegistry.FilePath[DirLength - 1] != L'/' &&
+           mGuidRegistry.FilePath[DirLength - 1] != L':') {
+      DirLength--;
+    }
+    
+    PathSize = (DirLength + StrLen (GUID_REGISTRY_STATS_FILE) + 1) * sizeof (CHAR16);
+    mGuidRegistry.StatsPath = AllocatePool (PathSize);
+    if (mGuidRegistry.StatsPath == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    CopyMem (mGuidRegistry.StatsPath, mGuidRegistry.FilePath, DirLength * sizeof (CHAR16));
+    StrCpyS (&mGuidRegistry.StatsPath[DirLength], PathSize / sizeof (CHAR16) - DirLength, GUID_REGISTRY_STATS_FILE);
+  }
+  
+  GuidRegistryLoadStats (&mGuidRegistry);
+  GuidRegistrySortProbeOrder (&mGuidRegistry);
+  mGuidRegistry.Loaded = TRUE;
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Возвращает дружественное имя GUID из реестра.
+  
+  @param Guid     GUID
+  
+  @retval         Имя GUID или "Unknown"
+**/
+CONST CHAR16 *
+GetGuidName (
+  IN CONST EFI_GUID  *Guid
+  )
+{
+  UINTN  Index;
+  
+  if (EFI_ERROR (LoadGuidRegistry ())) {
+    return L"Unknown";
+  }
+  
+  Index = GuidRegistryFind (&mGuidRegistry, Guid);
+  return (Index == MAX_UINTN) ? L"Unknown" : mGuidRegistry.Entries[Index].Name;
+}
+
+/**
+  Возвращает позицию GUID в порядке проверки реестра (меньше - предпочтительнее).
+  
+  @param Guid     GUID для проверки
+  
+  @retval         Позиция в порядке проверки или MAX_UINTN для незарегистрированного GUID
+**/
+UINTN
+GetGuidProbeRank (
+  IN CONST EFI_GUID  *Guid
+  )
+{
+  UINTN  Index;
+  UINTN  Pos;
+  
+  if (EFI_ERROR (LoadGuidRegistry ())) {
+    return MAX_UINTN;
+  }
+  
+  Index = GuidRegistryFind (&mGuidRegistry, Guid);
+  if (Index == MAX_UINTN) {
+    return MAX_UINTN;
+  }
+  
+  for (Pos = 0; Pos < mGuidRegistry.Count; Pos++) {
+    if (mGuidRegistry.ProbeOrder[Pos] == Index) {
+      return Pos;
+    }
+  }
+  
+  return MAX_UINTN;
+}
+
+/**
+  Учитывает попадание по GUID и обновляет порядок проверки. Счётчики в памяти
+  растут при каждом попадании, а файл статистики помечается к сохранению только
+  при изменении порядка, при попадании вне быстрой проверки или после
+  GUID_STATS_SAVE_INTERVAL попаданий: иначе ESP перезаписывался бы каждый запуск.
+  
+  @param Guid     GUID, под которым найдена переменная
+**/
+VOID
+GuidRegistryRecordHit (
+  IN CONST EFI_GUID  *Guid
+  )
+{
+  UINTN  Index;
+  UINTN  OldRank;
+  
+  Index = GuidRegistryFind (&mGuidRegistry, Guid);
+  if (Index == MAX_UINTN) {
+    return;
+  }
+  
+  OldRank = GetGuidProbeRank (Guid);
+  mGuidRegistry.Entries[Index].Hits++;
+  mGuidRegistry.UnsavedHits++;
+  GuidRegistrySortProbeOrder (&mGuidRegistry);
+  
+  // GUID вне быстрой проверки сохраняем сразу, чтобы его счётчик рос между
+  // запусками и он мог подняться в быструю проверку
+  if (GetGuidProbeRank (Guid) != OldRank ||
+      OldRank >= GUID_PROBE_LIMIT ||
+      mGuidRegistry.UnsavedHits >= GUID_STATS_SAVE_INTERVAL) {
+    mGuidRegistry.StatsDirty = TRUE;
+  }
+}
+
+/**
+  Сохраняет статистику попаданий реестра на ESP, если она помечена к сохранению
+  (см. GuidRegistryRecordHit). Файл пишется один раз при выходе.
+**/
+VOID
+SaveGuidRegistryStats (
+  VOID
+  )
+{
+  EFI_STATUS         Status;
+  SHELL_FILE_HANDLE  FileHandle;
+  CHAR8              *Buffer;
+  UINTN              BufferSize;
+  UINTN              Used;
+  UINTN              Index;
+  
+  if (!mGuidRegistry.Loaded || !mGuidRegistry.StatsDirty || mGuidRegistry.StatsPath == NULL) {
+    return;
+  }
+  
+  // Каждая строка: GUID (36) + пробел + счётчик (до 10) + CRLF
+  BufferSize = mGuidRegistry.Count * 50 + 1;
+  Buffer = AllocateZeroPool (BufferSize);
+  if (Buffer == NULL) {
+    return;
+  }
+  
+  Used = 0;
+  for (Index = 0; Index < mGuidRegistry.Count; Index++) {
+    if (mGuidRegistry.Entries[Index].Hits != 0) {
+      Used += AsciiSPrint (
+                &Buffer[Used],
+                BufferSize - Used,
+                "%g %u\r\n",
+                &mGuidRegistry.Entries[Index].Guid,
+                mGuidRegistry.Entries[Index].Hits
+                );
+    }
+  }
+  
+  Status = CreateOutputFile (mGuidRegistry.StatsPath, &FileHandle);
+  if (!EFI_ERROR (Status)) {
+    ShellWriteFile (FileHandle, &Used, Buffer);
+    ShellCloseFile (&FileHandle);
+  }
+  
+  FreePool (Buffer);
+  mGuidRegistry.StatsDirty = FALSE;
+  mGuidRegistry.UnsavedHits = 0;
+}
+
+/**
+  Освобождает память реестра GUID.
+**/
+VOID
+FreeGuidRegistry (
+  VOID
+  )
+{
+  if (mGuidRegistry.Entries != NULL) {
+    FreePool (mGuidRegistry.Entries);
+  }
+  if (mGuidRegistry.Slots != NULL) {
+    FreePool (mGuidRegistry.Slots);
+  }
+  if (mGuidRegistry.ProbeOrder != NULL) {
+    FreePool (mGuidRegistry.ProbeOrder);
+  }
+  if (mGuidRegistry.StatsPath != NULL) {
+    FreePool (mGuidRegistry.StatsPath);
+  }
+  mGuidRegistry.Entries = NULL;
+  mGuidRegistry.Slots = NULL;
+  mGuidRegistry.ProbeOrder = NULL;
+  mGuidRegistry.StatsPath = NULL;
+  mGuidRegistry.UnsavedHits = 0;
+  mGuidRegistry.Count = 0;
+  mGuidRegistry.Capacity = 0;
+  mGuidRegistry.SlotCount = 0;
+  mGuidRegistry.Loaded = FALSE;
+}
+
+/**
+  Вычисляет хеш имени переменной (FNV-1a по символам CHAR16).
+  
+  @param Name     Имя переменной
+  
+  @retval         Значение хеша
+**/
+UINT32
+HashVariableName (
+  IN CONST CHAR16  *Name
+  )
+{
+  UINT32  Hash;
+  
+  Hash = 2166136261U;
+  while (*Name != 0) {
+    Hash ^= (UINT32)*Name;
+    Hash *= 16777619U;
+    Name++;
+  }
+  
+  return Hash;
+}
+
+/**
+  Освобождает память индекса хранилища переменных и помечает его недействительным.
+  
+  @param Index    Указатель на индекс
+**/
+VOID
+FreeVariableIndex (
+  IN OUT VAR_STORE_INDEX  *Index
+  )
+{
+  if (Index->Entries != NULL) {
+    FreePool (Index->Entries);
+  }
+  if (Index->Buckets != NULL) {
+    FreePool (Index->Buckets);
+  }
+  if (Index->NamePool != NULL) {
+    FreePool (Index->NamePool);
+  }
+  ZeroMem (Index, sizeof (VAR_STORE_INDEX));
+}
+
+/**
+  Помечает общий индекс хранилища переменных устаревшим.
+  Вызывается после операций, которые могут изменить NV хранилище.
+**/
+VOID
+InvalidateVariableIndex (
+  VOID
+  )
+{
+  FreeVariableIndex (&mVarIndex);
+}
+
+/**
+  Возвращает имя переменной для записи индекса.
+  
+  @param Index    Указатель на индекс
+  @param Entry    Запись индекса
+  
+  @retval         Имя переменной из пула имён
+**/
+CONST CHAR16 *
+VarIndexEntryName (
+  IN CONST VAR_STORE_INDEX  *Index,
+  IN CONST VAR_INDEX_ENTRY  *Entry
+  )
+{
+  return &Index->NamePool[Entry->NameOffset];
+}
+
+/**
+  Перестраивает корзины индекса под новое количество корзин.
+  
+  @param Index        Указатель на индекс
+  @param BucketCount  Новое количество корзин (степень двойки)
+  
+  @retval EFI_SUCCESS           Корзины перестроены
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+**/
+EFI_STATUS
+VarIndexRehash (
+  IN OUT VAR_STORE_INDEX  *Index,
+  IN     UINTN            BucketCount
+  )
+{
+  UINT32  *Buckets;
+  UINTN   Bucket;
+  UINTN   Entry;
+  
+  Buckets = AllocatePool (BucketCount * sizeof (UINT32));
+  if (Buckets == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  SetMem (Buckets, BucketCount * sizeof (UINT32), 0xFF);
+  
+  // Перекладываем записи в обратном порядке, чтобы сохранить порядок перечисления в цепочках
+  for (Entry = Index->EntryCount; Entry > 0; Entry--) {
+    Bucket = Index->Entries[Entry - 1].Hash & (BucketCount - 1);
+    Index->Entries[Entry - 1].Next = Buckets[Bucket];
+    Buckets[Bucket] = (UINT32)(Entry - 1);
+  }
+  
+  if (Index->Buckets != NULL) {
+    FreePool (Index->Buckets);
+  }
+  Index->Buckets = Buckets;
+  Index->BucketCount = BucketCount;
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Добавляет переменную в индекс. Отмечает имена, встречающиеся под несколькими GUID.
+  
+  @param Index    Указатель на индекс
+  @param Name     Имя переменной
+  @param Guid     GUID переменной
+  
+  @retval EFI_SUCCESS           Запись добавлена
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+**/
+EFI_STATUS
+VarIndexInsert (
+  IN OUT VAR_STORE_INDEX  *Index,
+  IN     CONST CHAR16     *Name,
+  IN     CONST EFI_GUID   *Guid
+  )
+{
+  EFI_STATUS       Status;
+  VAR_INDEX_ENTRY  *Entry;
+  UINTN            NameLen;
+  UINTN            NewSize;
+  UINT32           Hash;
+  UINT32           Bucket;
+  UINT32           Current;
+  UINT32           Tail;
+  VAR_INDEX_ENTRY  *NewEntries;
+  CHAR16           *NewNamePool;
+  
+  // Увеличиваем массив записей при необходимости
+  if (Index->EntryCount == Index->EntryCapacity) {
+    NewSize = (Index->EntryCapacity == 0) ? VAR_INDEX_INITIAL_BUCKETS : Index->EntryCapacity * 2;
+    NewEntries = ReallocatePool (
+                   Index->EntryCapacity * sizeof (VAR_INDEX_ENTRY),
+                   NewSize * sizeof (VAR_INDEX_ENTRY),
+                   Index->Entries
+                   );
+    if (NewEntries == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Index->Entries = NewEntries;
+    Index->EntryCapacity = NewSize;
+  }
+  
+  // Держим коэффициент заполнения хеш-таблицы не выше единицы
+  if (Index->EntryCount >= Index->BucketCount) {
+    Status = VarIndexRehash (
+               Index,
+               (Index->BucketCount == 0) ? VAR_INDEX_INITIAL_BUCKETS : Index->BucketCount * 2
+               );
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+  
+  // Копируем имя в пул имён
+  NameLen = StrLen (Name) + 1;
+  if (Index->NamePoolUsed + NameLen > Index->NamePoolSize) {
+    NewSize = MAX (Index->NamePoolSize * 2, VAR_INDEX_INITIAL_NAME_POOL);
+    while (NewSize < Index->NamePoolUsed + NameLen) {
+      NewSize *= 2;
+    }
+    NewNamePool = ReallocatePool (
+                    Index->NamePoolSize * sizeof (CHAR16),
+                    NewSize * sizeof (CHAR16),
+                    Index->NamePool
+                    );
+    if (NewNamePool == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Index->NamePool = NewNamePool;
+    Index->NamePoolSize = NewSize;
+  }
+  CopyMem (&Index->NamePool[Index->NamePoolUsed], Name, NameLen * sizeof (CHAR16));
+  
+  Hash = HashVariableName (Name);
+  Bucket = Hash & (UINT32)(Index->BucketCount - 1);
+  
+  Entry = &Index->Entries[Index->EntryCount];
+  ZeroMem (Entry, sizeof (VAR_INDEX_ENTRY));
+  CopyGuid (&Entry->Guid, Guid);
+  Entry->NameOffset = (UINT32)Index->NamePoolUsed;
+  Entry->Hash = Hash;
+  Entry->Next = VAR_INDEX_NO_ENTRY;
+  Index->NamePoolUsed += NameLen;
+  
+  // Ищем то же имя в цепочке (под другим GUID) и находим конец цепочки
+  Tail = VAR_INDEX_NO_ENTRY;
+  for (Current = Index->Buckets[Bucket]; Current != VAR_INDEX_NO_ENTRY; Current = Index->Entries[Current].Next) {
+    if (Index->Entries[Current].Hash == Hash &&
+        StrCmp (VarIndexEntryName (Index, &Index->Entries[Current]), Name) == 0) {
+      if ((Index->Entries[Current].Flags & VAR_ENTRY_DUPLICATE) == 0) {
+        Index->Entries[Current].Flags |= VAR_ENTRY_DUPLICATE;
+        Index->DuplicateNames++;
+      }
+      Entry->Flags |= VAR_ENTRY_DUPLICATE;
+    }
+    Tail = Current;
+  }
+  
+  // Добавляем в конец цепочки, чтобы сохранить порядок перечисления
+  if (Tail == VAR_INDEX_NO_ENTRY) {
+    Index->Buckets[Bucket] = (UINT32)Index->EntryCount;
+  } else {
+    Index->Entries[Tail].Next = (UINT32)Index->EntryCount;
+  }
+  Index->EntryCount++;
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Строит индекс хранилища переменных за один проход GetNextVariableName.
+  Если задан обработчик, он вызывается для каждой переменной по ходу перечисления.
+  
+  @param Index    Указатель на индекс (прежнее содержимое освобождается)
+  @param Callback Обработчик переменной (может быть NULL)
+  @param Context  Контекст обработчика
+  
+  @retval EFI_SUCCESS           Индекс построен
+  @retval другое                Ошибка при перечислении переменных или в обработчике
+**/
+EFI_STATUS
+BuildVariableIndex (
+  IN OUT VAR_STORE_INDEX    *Index,
+  IN     VAR_ENUM_CALLBACK  Callback OPTIONAL,
+  IN     VOID               *Context OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+  CHAR16      *Name;
+  CHAR16      *NewName;
+  UINTN       NameBufferSize;
+  UINTN       NameSize;
+  EFI_GUID    Guid;
+  
+  FreeVariableIndex (Index);
+  
+  NameBufferSize = 256 * sizeof (CHAR16);
+  Name = AllocateZeroPool (NameBufferSize);
+  if (Name == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  ZeroMem (&Guid, sizeof (EFI_GUID));
+  
+  while (TRUE) {
+    NameSize = NameBufferSize;
+    Status = gRT->GetNextVariableName (&NameSize, Name, &Guid);
+    
+    if (Status == EFI_BUFFER_TOO_SMALL) {
+      // Увеличиваем буфер, сохраняя текущее имя для продолжения перечисления
+      NewName = ReallocatePool (NameBufferSize, NameSize, Name);
+      if (NewName == NULL) {
+        FreePool (Name);
+        FreeVariableIndex (Index);
+        return EFI_OUT_OF_RESOURCES;
+      }
+      Name = NewName;
+      NameBufferSize = NameSize;
+      Status = gRT->GetNextVariableName (&NameSize, Name, &Guid);
+    }
+    
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+    
+    Status = VarIndexInsert (Index, Name, &Guid);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+    
+    if (Callback != NULL) {
+      Status = Callback (Name, &Guid, Context);
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+    }
+  }
+  
+  FreePool (Name);
+  
+  // EFI_NOT_FOUND означает штатное окончание перечисления
+  if (Status != EFI_NOT_FOUND) {
+    FreeVariableIndex (Index);
+    return Status;
+  }
+  
+  Index->Valid = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Возвращает общий индекс хранилища, строя его при первом обращении.
+  
+  @param Index    Указатель на указатель индекса
+  
+  @retval EFI_SUCCESS   Индекс готов
+  @retval другое        Ошибка при построении индекса
+**/
+EFI_STATUS
+GetVariableIndex (
+  OUT VAR_STORE_INDEX  **Index
+  )
+{
+  EFI_STATUS  Status;
+  
+  if (!mVarIndex.Valid) {
+    Status = BuildVariableIndex (&mVarIndex, NULL, NULL);
+    if (EFI_ERROR (Status)) {
+      Print (L"Error: Failed to enumerate variable store: %r\n", Status);
+      return Status;
+    }
+    CheckProbedVariableNames ();
+  }
+  
+  *Index = &mVarIndex;
+  return EFI_SUCCESS;
+}
+
+/**
+  Вызывает обработчик для каждой переменной хранилища. Если индекс уже построен,
+  перечисление идёт по нему без обращений к прошивке; иначе выполняется один проход
+  GetNextVariableName, который заодно строит общий индекс.
+  
+  @param Callback Обработчик переменной
+  @param Context  Контекст обработчика
+  
+  @retval EFI_SUCCESS   Все переменные обработаны
+  @retval другое        Ошибка при перечислении или в обработчике
+**/
+EFI_STATUS
+EnumerateVariables (
+  IN VAR_ENUM_CALLBACK  Callback,
+  IN VOID               *Context OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+  
+  if (!mVarIndex.Valid) {
+    Status = BuildVariableIndex (&mVarIndex, Callback, Context);
+    if (EFI_ERROR (Status) && Status != EFI_ABORTED) {
+      Print (L"Error: Failed to enumerate variable store: %r\n", Status);
+    }
+    if (mVarIndex.Valid) {
+      CheckProbedVariableNames ();
+    }
+    return Status;
+  }
+  
+  for (Index = 0; Index < mVarIndex.EntryCount; Index++) {
+    Status = Callback (
+               VarIndexEntryName (&mVarIndex, &mVarIndex.Entries[Index]),
+               &mVarIndex.Entries[Index].Guid,
+               Context
+               );
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Ищет переменную в индексе по имени и, при необходимости, GUID.
+  
+  @param Index    Указатель на индекс
+  @param Name     Имя переменной
+  @param Guid     GUID переменной (NULL - первая запись с таким именем)
+  
+  @retval         Найденная запись или NULL
+**/
+VAR_INDEX_ENTRY *
+VarIndexFind (
+  IN CONST VAR_STORE_INDEX  *Index,
+  IN CONST CHAR16           *Name,
+  IN CONST EFI_GUID         *Guid OPTIONAL
+  )
+{
+  UINT32  Hash;
+  UINT32  Current;
+  
+  if (!Index->Valid || Index->BucketCount == 0) {
+    return NULL;
+  }
+  
+  Hash = HashVariableName (Name);
+  for (Current = Index->Buckets[Hash & (UINT32)(Index->BucketCount - 1)];
+       Current != VAR_INDEX_NO_ENTRY;
+       Current = Index->Entries[Current].Next) {
+    if (Index->Entries[Current].Hash == Hash &&
+        (Guid == NULL || CompareGuid (&Index->Entries[Current].Guid, Guid)) &&
+        StrCmp (VarIndexEntryName (Index, &Index->Entries[Current]), Name) == 0) {
+      return &Index->Entries[Current];
+    }
+  }
+  
+  return NULL;
+}
+
+/**
+  Возвращает следующую запись индекса с тем же именем (другой GUID).
+  
+  @param Index    Указатель на индекс
+  @param Entry    Текущая запись
+  
+  @retval         Следующая запись с тем же именем или NULL
+**/
+VAR_INDEX_ENTRY *
+VarIndexFindNext (
+  IN CONST VAR_STORE_INDEX  *Index,
+  IN CONST VAR_INDEX_ENTRY  *Entry
+  )
+{
+  UINT32  Current;
+  
+  if ((Entry->Flags & VAR_ENTRY_DUPLICATE) == 0) {
+    return NULL;
+  }
+  
+  for (Current = Entry->Next; Current != VAR_INDEX_NO_ENTRY; Current = Index->Entries[Current].Next) {
+    if (Index->Entries[Current].Hash == Entry->Hash &&
+        StrCmp (VarIndexEntryName (Index, &Index->Entries[Current]),
+                VarIndexEntryName (Index, Entry)) == 0) {
+      return &Index->Entries[Current];
+    }
+  }
+  
+  return NULL;
+}
+
+/**
+  Находит переменную в индексе по имени и, при необходимости, префиксу GUID.
+  Если имя встречается под несколькими подходящими GUID, выводит их список и выбирает
+  GUID, стоящий выше в порядке проверки реестра (иначе - первый найденный).
+  
+  @param Index       Указатель на индекс
+  @param Name        Имя переменной
+  @param GuidPattern Префикс GUID (может быть NULL)
+  
+  @retval            Выбранная запись или NULL, если переменной нет
+**/
+VAR_INDEX_ENTRY *
+VarIndexResolveName (
+  IN CONST VAR_STORE_INDEX  *Index,
+  IN CONST CHAR16           *Name,
+  IN CONST GUID_PATTERN     *GuidPattern OPTIONAL
+  )
+{
+  VAR_INDEX_ENTRY  *Entry;
+  VAR_INDEX_ENTRY  *Best;
+  UINTN            Matches;
+  
+  Best = NULL;
+  Matches = 0;
+  for (Entry = VarIndexFind (Index, Name, NULL); Entry != NULL; Entry = VarIndexFindNext (Index, Entry)) {
+    if (!MatchGuidPattern (GuidPattern, &Entry->Guid)) {
+      continue;
+    }
+    Matches++;
+    if (Best == NULL || GetGuidProbeRank (&Entry->Guid) < GetGuidProbeRank (&Best->Guid)) {
+      Best = Entry;
+    }
+  }
+  
+  if (Matches > 1) {
+    Print (L"Warning: Variable '%s' exists under more than one GUID:\n", Name);
+    for (Entry = VarIndexFind (Index, Name, NULL); Entry != NULL; Entry = VarIndexFindNext (Index, Entry)) {
+      if (MatchGuidPattern (GuidPattern, &Entry->Guid)) {
+        Print (L"  %g%s\n", &Entry->Guid, (Entry == Best) ? L" (used)" : L"");
+      }
+    }
+  }
+  
+  return Best;
+}
+
+/**
+  Запоминает имя переменной, найденной быстрой проверкой GUID реестра до
+  построения индекса. Дубликаты такого имени выводятся, когда индекс построен.
+  
+  @param Name     Имя переменной
+**/
+VOID
+RememberProbedVariableName (
+  IN CONST CHAR16  *Name
+  )
+{
+  UINTN  Index;
+  
+  for (Index = 0; Index < mProbedNameCount; Index++) {
+    if (StrCmp (mProbedNames[Index], Name) == 0) {
+      return;
+    }
+  }
+  
+  if (mProbedNameCount < VAR_PROBED_NAMES_MAX) {
+    mProbedNames[mProbedNameCount] = AllocateCopyPool (StrSize (Name), Name);
+    if (mProbedNames[mProbedNameCount] != NULL) {
+      mProbedNameCount++;
+    }
+  }
+}
+
+/**
+  Проверяет имена, найденные быстрой проверкой, по построенному общему индексу.
+  Имя под несколькими GUID выводится так же, как при поиске по индексу:
+  быстрая проверка идёт в порядке реестра и выбирает тот же GUID.
+**/
+VOID
+CheckProbedVariableNames (
+  VOID
+  )
+{
+  UINTN  Index;
+  
+  for (Index = 0; Index < mProbedNameCount; Index++) {
+    if (mVarIndex.Valid) {
+      VarIndexResolveName (&mVarIndex, mProbedNames[Index], NULL);
+    }
+    FreePool (mProbedNames[Index]);
+    mProbedNames[Index] = NULL;
+  }
+  mProbedNameCount = 0;
+}
+
+/**
+  Читает переменную в общий буфер запуска одним вызовом GetVariable.
+  Повторный вызов выполняется только при EFI_BUFFER_TOO_SMALL после увеличения буфера.
+  Возвращаемые данные действительны до следующего чтения через общий буфер.
+  
+  @param VariableName   Имя переменной
+  @param VariableGuid   GUID переменной
+  @param VariableData   Указатель на данные в общем буфере
+  @param VariableSize   Указатель на размер данных
+  @param Attributes     Указатель на атрибуты переменной (может быть NULL)
+  
+  @retval EFI_SUCCESS   Переменная успешно прочитана
+  @retval другое        Ошибка при чтении переменной
+**/
+EFI_STATUS
+ReadVariablePooled (
+  IN  CONST CHAR16    *VariableName,
+  IN  CONST EFI_GUID  *VariableGuid,
+  OUT VOID            **VariableData,
+  OUT UINTN           *VariableSize,
+  OUT UINT32          *Attributes OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Attr = 0;
+  UINTN       Size;
+  
+  *VariableData = NULL;
+  *VariableSize = 0;
+  
+  if (mVarReadBuffer == NULL) {
+    mVarReadBuffer = AllocatePool (VAR_READ_BUFFER_INITIAL_SIZE);
+    if (mVarReadBuffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    mVarReadBufferSize = VAR_READ_BUFFER_INITIAL_SIZE;
+  }
+  
+  Size = mVarReadBufferSize;
+  Status = gRT->GetVariable (
+                  (CHAR16*)VariableName,
+                  (EFI_GUID*)VariableGuid,
+                  &Attr,
+                  &Size,
+                  mVarReadBuffer
+                  );
+  
+  if (Status == EFI_BUFFER_TOO_SMALL) {
+    // Увеличиваем буфер с запасом, прежнее содержимое не нужно
+    FreePool (mVarReadBuffer);
+    mVarReadBufferSize = MAX (Size, mVarReadBufferSize * 2);
+    mVarReadBuffer = AllocatePool (mVarReadBufferSize);
+    if (mVarReadBuffer == NULL) {
+      mVarReadBufferSize = 0;
+      return EFI_OUT_OF_RESOURCES;
+    }
+    
+    Size = mVarReadBufferSize;
+    Status = gRT->GetVariable (
+                    (CHAR16*)VariableName,
+                    (EFI_GUID*)VariableGuid,
+                    &Attr,
+                    &Size,
+                    mVarReadBuffer
+                    );
+  }
+  
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  *VariableData = mVarReadBuffer;
+  *VariableSize = Size;
+  if (Attributes != NULL) {
+    *Attributes = Attr;
+  }
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Освобождает общий буфер чтения переменных.
+**/
+VOID
+FreeVariableReadBuffer (
+  VOID
+  )
+{
+  if (mVarReadBuffer != NULL) {
+    FreePool (mVarReadBuffer);
+    mVarReadBuffer = NULL;
+  }
+  mVarReadBufferSize = 0;
+}
+
+/**
+  Находит и читает переменную UEFI в общий буфер запуска.
+  Если VariableGuid равен NULL, сначала используется индекс хранилища (если он уже
+  построен), затем первые GUID реестра в порядке статистики попаданий, а при промахе
+  индекс строится одним проходом по хранилищу и переиспользуется всеми последующими
+  поисками. Имена, найденные первыми GUID реестра, проверяются на дубликаты, когда
+  индекс построен. Данные действительны до следующего чтения через общий буфер.
+
+  @param VariableName   Имя переменной
+  @param VariableGuid   GUID переменной (может быть NULL для поиска по всем GUID)
+  @param VariableData   Указатель на данные в общем буфере
+  @param VariableSize   Указатель на размер данных
+  @param Attributes     Указатель на атрибуты переменной (может быть NULL)
+  @param FoundGuid      Указатель на буфер для найденного GUID (может быть NULL)
+
+  @retval EFI_SUCCESS   Переменная успешно прочитана
+  @retval другое        Ошибка при чтении переменной
+**/
+EFI_STATUS
+LookupVariable (
+  IN  CONST CHAR16    *VariableName,
+  IN  EFI_GUID        *VariableGuid OPTIONAL,
+  OUT VOID            **VariableData,
+  OUT UINTN           *VariableSize,
+  OUT UINT32          *Attributes OPTIONAL,
+  OUT EFI_GUID        *FoundGuid OPTIONAL
+  )
+{
+  EFI_STATUS       Status;
+  UINT32           Attr;
+  UINTN            Index;
+  VAR_STORE_INDEX  *VarIndex;
+  VAR_INDEX_ENTRY  *Entry;
+  EFI_GUID         ProbeGuid;
+  
+  // Проверяем входные параметры
+  if (VariableName == NULL || VariableData == NULL || VariableSize == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  
+  // Инициализируем выходные параметры
+  *VariableData = NULL;
+  *VariableSize = 0;
+  
+  // Если GUID указан, читаем только по нему
+  if (VariableGuid != NULL) {
+    Status = ReadVariablePooled (VariableName, VariableGuid, VariableData, VariableSize, Attributes);
+    if (!EFI_ERROR (Status) && FoundGuid != NULL) {
+      CopyGuid (FoundGuid, VariableGuid);
+    }
+    return Status;
+  }
+  
+  // Если индекс хранилища ещё не построен, сначала пробуем наиболее вероятные GUID реестра
+  if (!mVarIndex.Valid && !EFI_ERROR (LoadGuidRegistry ())) {
+    for (Index = 0; Index < MIN (mGuidRegistry.Count, GUID_PROBE_LIMIT); Index++) {
+      CopyGuid (&ProbeGuid, &mGuidRegistry.Entries[mGuidRegistry.ProbeOrder[Index]].Guid);
+      Status = ReadVariablePooled (VariableName, &ProbeGuid, VariableData, VariableSize, Attributes);
+      if (!EFI_ERROR (Status)) {
+        GuidRegistryRecordHit (&ProbeGuid);
+        RememberProbedVariableName (VariableName);
+        if (FoundGuid != NULL) {
+          CopyGuid (FoundGuid, &ProbeGuid);
+        }
+        return EFI_SUCCESS;
+      }
+      if (Status == EFI_OUT_OF_RESOURCES) {
+        return Status;
+      }
+    }
+  }
+  
+  // Ищем по индексу хранилища (строится один раз за запуск)
+  Status = GetVariableIndex (&VarIndex);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  Entry = VarIndexResolveName (VarIndex, VariableName, NULL);
+  if (Entry == NULL) {
+    return EFI_NOT_FOUND;
+  }
+  
+  Status = ReadVariablePooled (VariableName, &Entry->Guid, VariableData, VariableSize, &Attr);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  // Запоминаем размер и атрибуты в индексе
+  Entry->DataSize = *VariableSize;
+  Entry->Attributes = Attr;
+  Entry->Flags |= VAR_ENTRY_INFO_VALID;
+  GuidRegistryRecordHit (&Entry->Guid);
+  
+  if (Attributes != NULL) {
+    *Attributes = Attr;
+  }
+  if (FoundGuid != NULL) {
+    CopyGuid (FoundGuid, &Entry->Guid);
+  }
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Получает содержимое переменной UEFI в отдельный буфер, принадлежащий вызывающему.
+  Поиск выполняется так же, как в LookupVariable.
+
+  @param VariableName   Имя переменной
+  @param VariableGuid   GUID переменной (может быть NULL для поиска по всем GUID)
+  @param VariableData   Указатель на буфер для данных (будет выделен)
+  @param VariableSize   Указатель на размер данных
+  @param FoundGuid      Указатель на буфер для найденного GUID (может быть NULL)
+
+  @retval EFI_SUCCESS   Переменная успешно прочитана
+  @retval другое        Ошибка при чтении переменной
+**/
+EFI_STATUS
+GetVariableData (
+  IN  CONST CHAR16    *VariableName,
+  IN  EFI_GUID        *VariableGuid,
+  OUT VOID            **VariableData,
+  OUT UINTN           *VariableSize,
+  OUT EFI_GUID        *FoundGuid OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+  VOID        *PooledData;
+  
+  if (VariableData == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  *VariableData = NULL;
+  
+  Status = LookupVariable (VariableName, VariableGuid, &PooledData, VariableSize, NULL, FoundGuid);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  // Копируем данные из общего буфера (пустая переменная получает отдельный буфер)
+  *VariableData = AllocateCopyPool (MAX (*VariableSize, 1), PooledData);
+  if (*VariableData == NULL) {
+    *VariableSize = 0;
+    return EFI_OUT_OF_RESOURCES;
+  }
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Разрешает GUID переменной по префиксу GUID. Полный GUID используется как есть,
+  неполный префикс сопоставляется с GUID переменной в индексе хранилища.
+  
+  @param VariableName Имя переменной
+  @param GuidPattern  Префикс GUID
+  @param Guid         Указатель на разрешённый GUID
+  
+  @retval EFI_SUCCESS   GUID разрешён
+  @retval EFI_NOT_FOUND Переменная с таким префиксом GUID не найдена
+  @retval другое        Ошибка при построении индекса
+**/
+EFI_STATUS
+ResolveVariableGuid (
+  IN  CONST CHAR16        *VariableName,
+  IN  CONST GUID_PATTERN  *GuidPattern,
+  OUT EFI_GUID            *Guid
+  )
+{
+  EFI_STATUS       Status;
+  VAR_STORE_INDEX  *VarIndex;
+  VAR_INDEX_ENTRY  *Entry;
+  
+  if (GuidPatternToGuid (GuidPattern, Guid)) {
+    return EFI_SUCCESS;
+  }
+  
+  Status = GetVariableIndex (&VarIndex);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  Entry = VarIndexResolveName (VarIndex, VariableName, GuidPattern);
+  if (Entry == NULL) {
+    return EFI_NOT_FOUND;
+  }
+  
+  CopyGuid (Guid, &Entry->Guid);
+  return EFI_SUCCESS;
+}
+
+/**
+  Выводит переменную в заданном формате.
+  
+  @param VariableName   Имя переменной
+  @param VariableGuid   GUID переменной
+  @param VariableData   Данные переменной
+  @param VariableSize   Размер данных
+  @param Attributes     Атрибуты переменной
+  @param OutputType     Тип вывода
+**/
+VOID
+PrintVariable (
+  IN CONST CHAR16    *VariableName,
+  IN CONST EFI_GUID  *VariableGuid,
+  IN CONST VOID      *VariableData,
+  IN UINTN           VariableSize,
+  IN UINT32          Attributes,
+  IN OUTPUT_TYPE     OutputType
+  )
+{
+  // Если режим вывода не "только данные", выводим информацию о переменной
+  if (OutputType == OUTPUT_ALL) {
+    Print (L"Variable Name: %s\n", VariableName);
+    Print (L"GUID: %s (%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X)\n", 
+           GetGuidName (VariableGuid),
+           VariableGuid->Data1, VariableGuid->Data2, VariableGuid->Data3,
+           VariableGuid->Data4[0], VariableGuid->Data4[1], VariableGuid->Data4[2],
+           VariableGuid->Data4[3], VariableGuid->Data4[4], VariableGuid->Data4[5],
+           VariableGuid->Data4[6], VariableGuid->Data4[7]);
+    
+    Print (L"Size: %d bytes\n", VariableSize);
+    Print (L"Attributes: 0x%08X\n\n", Attributes);
+    
+    Print (L"Hexadecimal dump:\n");
+    PrintHexDump (VariableData, VariableSize);
+    
+    Print (L"\nAs string (UCS-2): ");
+    PrintUcsString (VariableData, VariableSize);
+    
+    Print (L"As string (ASCII): ");
+    PrintAsciiString (VariableData, VariableSize);
+    
+    Print (L"As detected text: ");
+    PrintDecodedString (VariableData, VariableSize);
+  } else {
+    // Выводим только в указанном формате
+    switch (OutputType) {
+      case OUTPUT_HEX:
+        PrintHexDump (VariableData, VariableSize);
+        break;
+      case OUTPUT_ASCII:
+        PrintAsciiString (VariableData, VariableSize);
+        break;
+      case OUTPUT_UCS:
+        PrintUcsString (VariableData, VariableSize);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+/**
+  Обработчик перечисления для ListMatchingVariables: выводит переменную,
+  если её имя и GUID соответствуют шаблонам.
+  
+  @param Name     Имя переменной
+  @param Guid     GUID переменной
+  @param Context  Указатель на VAR_MATCH_CONTEXT
+  
+  @retval EFI_SUCCESS           Переменная обработана
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+**/
+EFI_STATUS
+ListMatchCallback (
+  IN CONST CHAR16    *Name,
+  IN CONST EFI_GUID  *Guid,
+  IN VOID            *Context
+  )
+{
+  EFI_STATUS         Status;
+  VAR_MATCH_CONTEXT  *Match;
+  VOID               *Data;
+  UINTN              DataSize;
+  UINT32             Attributes;
+  
+  Match = (VAR_MATCH_CONTEXT *)Context;
+  
+  if (!MatchGuidPattern (Match->GuidPattern, Guid) || !MatchNamePattern (Match->NamePattern, Name)) {
+    return EFI_SUCCESS;
+  }
+  
+  Status = ReadVariablePooled (Name, Guid, &Data, &DataSize, &Attributes);
+  if (Status == EFI_OUT_OF_RESOURCES) {
+    return Status;
+  }
+  
+  if (Match->OutputType == OUTPUT_ALL) {
+    if (Match->MatchCount == 0) {
+      Print (L"%-36s  %-20s  %8s  %-10s  %s\n", L"GUID", L"Vendor", L"Size", L"Attributes", L"Name");
+      
+      // Запоминаем первое совпадение для подробного вывода, если оно окажется единственным
+      Match->FirstName = AllocateCopyPool (StrSize (Name), Name);
+      if (Match->FirstName == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+      }
+      CopyGuid (&Match->FirstGuid, Guid);
+    }
+    
+    if (EFI_ERROR (Status)) {
+      Print (L"%g  %-20s  %8s  %-10s  %s (%r)\n", Guid, GetGuidName (Guid), L"?", L"?", Name, Status);
+    } else {
+      Print (L"%g  %-20s  %8u  0x%08X  %s\n", Guid, GetGuidName (Guid), DataSize, Attributes, Name);
+    }
+  } else {
+    Print (L"%s (%g): ", Name, Guid);
+    if (EFI_ERROR (Status)) {
+      Print (L"<%r>\n", Status);
+    } else {
+      if (Match->OutputType == OUTPUT_HEX) {
+        Print (L"\n");
+      }
+      PrintVariable (Name, Guid, Data, DataSize, Attributes, Match->OutputType);
+    }
+  }
+  
+  Match->MatchCount++;
+  return EFI_SUCCESS;
+}
+
+/**
+  Выводит все переменные, имена которых соответствуют шаблону, а GUID - префиксу,
+  за один потоковый проход по хранилищу.
+  
+  @param NamePattern  Шаблон имени ('*' и '?')
+  @param GuidPattern  Префикс GUID (может быть NULL)
+  @param OutputType   Тип вывода
+  
+  @retval EFI_SUCCESS   Найдено хотя бы одно совпадение
+  @retval EFI_NOT_FOUND Совпадений нет
+  @retval другое        Ошибка при перечислении
+**/
+EFI_STATUS
+ListMatchingVariables (
+  IN CONST CHAR16        *NamePattern,
+  IN CONST GUID_PATTERN  *GuidPattern OPTIONAL,
+  IN OUTPUT_TYPE         OutputType
+  )
+{
+  EFI_STATUS         Status;
+  VAR_MATCH_CONTEXT  Match;
+  VOID               *Data;
+  UINTN              DataSize;
+  UINT32             Attributes;
+  
+  ZeroMem (&Match, sizeof (Match));
+  Match.NamePattern = NamePattern;
+  Match.GuidPattern = GuidPattern;
+  Match.OutputType = OutputType;
+  
+  Status = EnumerateVariables (ListMatchCallback, &Match);
+  
+  if (!EFI_ERROR (Status) && OutputType == OUTPUT_ALL) {
+    if (Match.MatchCount == 1) {
+      // Единственное совпадение выводим подробно, как при точном поиске
+      Print (L"\n");
+      Status = ReadVariablePooled (Match.FirstName, &Match.FirstGuid, &Data, &DataSize, &Attributes);
+      if (!EFI_ERROR (Status)) {
+        PrintVariable (Match.FirstName, &Match.FirstGuid, Data, DataSize, Attributes, OutputType);
+      }
+    } else if (Match.MatchCount > 1) {
+      Print (L"\n%u matching variables\n", Match.MatchCount);
+    }
+  }
+  
+  if (Match.FirstName != NULL) {
+    FreePool (Match.FirstName);
+  }
+  
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  if (Match.MatchCount == 0) {
+    Print (L"No variables match '%s'\n", NamePattern);
+    return EFI_NOT_FOUND;
+  }
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Функция поиска переменной по имени и префиксу GUID.
+  Шаблон имени или неполный префикс GUID выводят список всех совпадений.
+  
+  @param VariableName   Имя искомой переменной или шаблон имени
+  @param GuidPrefix     Префикс GUID (может быть NULL)
+  @param OutputType     Тип вывода
+  
+  @retval EFI_SUCCESS   Переменная найдена и выведена
+  @retval другое        Ошибка при поиске или выводе
+**/
+EFI_STATUS
+FindAndPrintVariable (
+  IN CONST CHAR16    *VariableName,
+  IN CONST CHAR16    *GuidPrefix,
+  IN OUTPUT_TYPE     OutputType
+  )
+{
+  EFI_STATUS    Status;
+  VOID          *VariableData = NULL;
+  UINTN         VariableSize = 0;
+  UINT32        Attributes = 0;
+  EFI_GUID      TargetGuid;
+  GUID_PATTERN  GuidPattern;
+  BOOLEAN       GuidSpecified = FALSE;
+  EFI_GUID      FoundGuid;
+  
+  // Если указан префикс GUID, пытаемся его распарсить
+  if (GuidPrefix != NULL && StrLen (GuidPrefix) > 0) {
+    GuidSpecified = ParseGuidPattern (GuidPrefix, &GuidPattern);
+    if (!GuidSpecified) {
+      Print (L"Error: Invalid GUID prefix '%s'\n", GuidPrefix);
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+  
+  // Шаблон имени или неполный GUID - выводим все совпадения за один проход по хранилищу
+  if (IsNamePattern (VariableName) || (GuidSpecified && !GuidPatternToGuid (&GuidPattern, &TargetGuid))) {
+    return ListMatchingVariables (VariableName, GuidSpecified ? &GuidPattern : NULL, OutputType);
+  }
+  
+  // Ищем по указанному GUID или, если GUID не указан, по всем доступным GUID
+  Status = LookupVariable (
+             VariableName,
+             GuidSpecified ? &TargetGuid : NULL,
+             &VariableData,
+             &VariableSize,
+             &Attributes,
+             &FoundGuid
+             );
+            
+  if (EFI_ERROR(Status)) {
+    Print (L"Variable '%s' not found", VariableName);
+    if (GuidSpecified) {
+      Print (L" with specified GUID");
+    }
+    Print (L"\n");
+    return EFI_NOT_FOUND;
+  }
+  
+  PrintVariable (VariableName, &FoundGuid, VariableData, VariableSize, Attributes, OutputType);
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Разбирает неотрицательное число в десятичной или шестнадцатеричной (0x...) записи.
+  
+  @param Text   Исходная строка
+  @param Value  Указатель на результат
+  
+  @retval TRUE  Строка целиком является числом
+  @retval FALSE Некорректная запись числа
+**/
+BOOLEAN
+ParseNumber (
+  IN  CONST CHAR16  *Text,
+  OUT UINTN         *Value
+  )
+{
+  EFI_STATUS  Status;
+  CHAR16      *End;
+  
+  if (Text == NULL || *Text == L'\0') {
+    return FALSE;
+  }
+  
+  if (Text[0] == L'0' && (Text[1] == L'x' || Text[1] == L'X')) {
+    Status = StrHexToUintnS (Text, &End, Value);
+  } else {
+    Status = StrDecimalToUintnS (Text, &End, Value);
+  }
+  
+  return (!EFI_ERROR (Status) && *End == L'\0');
+}
+
+/**
+  Формирует одну строку дампа: смещение, до 16 байт и их ASCII-представление.
+  
+  @param Line     Буфер строки (не менее DUMP_LINE_SIZE символов)
+  @param Offset   Смещение первого байта строки
+  @param Bytes    Байты строки
+  @param Count    Количество байт (не более DUMP_BYTES_PER_LINE)
+  
+  @retval         Длина строки без завершающего NUL
+**/
+UINTN
+FormatDumpLine (
+  OUT CHAR8        *Line,
+  IN  UINTN        Offset,
+  IN  CONST UINT8  *Bytes,
+  IN  UINTN        Count
+  )
+{
+  UINTN  Used;
+  UINTN  Index;
+  
+  Used = 0;
+  for (Index = 0; Index < 8; Index++) {
+    Line[Used++] = (CHAR8)mHexDigits[(Offset >> ((7 - Index) * 4)) & 0x0F];
+  }
+  Line[Used++] = ':';
+  Line[Used++] = ' ';
+  
+  for (Index = 0; Index < DUMP_BYTES_PER_LINE; Index++) {
+    if (Index < Count) {
+      Line[Used++] = (CHAR8)mHexDigits[Bytes[Index] >> 4];
+      Line[Used++] = (CHAR8)mHexDigits[Bytes[Index] & 0x0F];
+    } else {
+      Line[Used++] = ' ';
+      Line[Used++] = ' ';
+    }
+    Line[Used++] = ' ';
+  }
+  Line[Used++] = ' ';
+  
+  for (Index = 0; Index < Count; Index++) {
+    Line[Used++] = (Bytes[Index] >= 0x20 && Bytes[Index] <= 0x7E) ? (CHAR8)Bytes[Index] : '.';
+  }
+  
+  Line[Used++] = '\r';
+  Line[Used++] = '\n';
+  Line[Used] = '\0';
+  
+  return Used;
+}
+
+/**
+  Записывает диапазон данных в файл строкой формата --rawtype ascii или ucs
+  по тем же правилам, что PrintAsciiString и PrintUcsString: строка
+  заканчивается на NUL, непечатаемые символы заменяются точкой. Строка
+  UCS-2 записывается в UCS-2 little-endian.
+  
+  @param Writer       Открытый файл
+  @param Data         Данные диапазона
+  @param DataSize     Размер данных в байтах
+  @param OutputType   OUTPUT_ASCII или OUTPUT_UCS
+  @param Buffer       Рабочий буфер
+  @param BufferSize   Размер буфера в байтах (не меньше 4)
+  
+  @retval EFI_SUCCESS   Строка записана
+  @retval другое        Ошибка записи
+**/
+EFI_STATUS
+WriteRangeText (
+  IN OUT FILE_WRITER  *Writer,
+  IN     CONST UINT8  *Data,
+  IN     UINTN        DataSize,
+  IN     OUTPUT_TYPE  OutputType,
+  IN     CHAR8        *Buffer,
+  IN     UINTN        BufferSize
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+  UINTN       Step;
+  UINTN       Used;
+  CHAR16      Char;
+  
+  Step = (OutputType == OUTPUT_UCS) ? 2 : 1;
+  Used = 0;
+  
+  for (Index = 0; Index + Step <= DataSize; Index += Step) {
+    if (OutputType == OUTPUT_UCS) {
+      Char = (CHAR16)(Data[Index] | (Data[Index + 1] << 8));
+      if (Char == L'\0') {
+        break;
+      }
+      Char = (Char < 0x20 || Char == 0x7F) ? L'.' : Char;
+    } else {
+      if (Data[Index] == 0) {
+        break;
+      }
+      Char = (Data[Index] >= 0x20 && Data[Index] <= 0x7E) ? Data[Index] : L'.';
+    }
+    
+    // Место под символ и завершающий CRLF
+    if (Used + 3 * Step > BufferSize) {
+      Status = WriteFileWriter (Writer, Buffer, Used);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+      Used = 0;
+    }
+    
+    Buffer[Used++] = (CHAR8)Char;
+    if (Step == 2) {
+      Buffer[Used++] = (CHAR8)(Char >> 8);
+    }
+  }
+  
+  if (Used + 2 * Step > BufferSize) {
+    Status = WriteFileWriter (Writer, Buffer, Used);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    Used = 0;
+  }
+  
+  Buffer[Used++] = '\r';
+  if (Step == 2) {
+    Buffer[Used++] = '\0';
+  }
+  Buffer[Used++] = '\n';
+  if (Step == 2) {
+    Buffer[Used++] = '\0';
+  }
+  
+  return WriteFileWriter (Writer, Buffer, Used);
+}
+
+/**
+  Выводит диапазон данных переменной со смещениями, блоками по DUMP_CHUNK_LINES
+  строк, на экран или в файл. Форматы ascii и ucs выводятся строкой и в файл.
+  
+  GetVariable не умеет читать часть переменной, поэтому данные один раз читаются
+  целиком в общий буфер чтения; дальше вывод идёт без копий и без роста памяти.
+  
+  @param VariableName   Имя переменной
+  @param GuidPrefix     Префикс GUID или полный GUID (может быть NULL)
+  @param Offset         Смещение начала диапазона
+  @param Length         Длина диапазона (0 - до конца переменной)
+  @param OutPath        Файл для вывода (NULL - на экран)
+  @param OutputType     Тип вывода
+  
+  @retval EFI_SUCCESS   Диапазон выведен
+  @retval другое        Переменная не найдена, неверный диапазон или ошибка записи
+**/
+EFI_STATUS
+DumpVariableRange (
+  IN CONST CHAR16    *VariableName,
+  IN CONST CHAR16    *GuidPrefix OPTIONAL,
+  IN UINTN           Offset,
+  IN UINTN           Length,
+  IN CONST CHAR16    *OutPath OPTIONAL,
+  IN OUTPUT_TYPE     OutputType
+  )
+{
+  EFI_STATUS    Status;
+  GUID_PATTERN  GuidPattern;
+  EFI_GUID      TargetGuid;
+  EFI_GUID      FoundGuid;
+  BOOLEAN       GuidSpecified;
+  UINT8         *Data;
+  UINTN         DataSize;
+  UINT32        Attributes;
+  UINTN         Position;
+  UINTN         End;
+  UINTN         Lines;
+  UINTN         Used;
+  FILE_WRITER   Writer;
+  UINTN         Index;
+  CHAR8         *Chunk;
+  CHAR16        *WideChunk;
+  
+  if (IsNamePattern (VariableName)) {
+    Print (L"Error: --offset, --length and --out need a single variable name, not a pattern\n");
+    return EFI_INVALID_PARAMETER;
+  }
+  
+  GuidSpecified = FALSE;
+  if (GuidPrefix != NULL && StrLen (GuidPrefix) > 0) {
+    if (!ParseGuidPattern (GuidPrefix, &GuidPattern)) {
+      Print (L"Error: Invalid GUID prefix '%s'\n", GuidPrefix);
+      return EFI_INVALID_PARAMETER;
+    }
+    Status = ResolveVariableGuid (VariableName, &GuidPattern, &TargetGuid);
+    if (EFI_ERROR (Status)) {
+      Print (L"Variable '%s' not found with specified GUID\n", VariableName);
+      return EFI_NOT_FOUND;
+    }
+    GuidSpecified = TRUE;
+  }
+  
+  Status = LookupVariable (
+             VariableName,
+             GuidSpecified ? &TargetGuid : NULL,
+             (VOID **)&Data,
+             &DataSize,
+             &Attributes,
+             &FoundGuid
+             );
+  if (EFI_ERROR (Status)) {
+    Print (L"Variable '%s' not found\n", VariableName);
+    return EFI_NOT_FOUND;
+  }
+  
+  if (Offset > DataSize) {
+    Print (L"Error: Offset 0x%x is beyond the end of '%s' (%u bytes)\n", Offset, VariableName, DataSize);
+    return EFI_INVALID_PARAMETER;
+  }
+  if (Length == 0 || Length > DataSize - Offset) {
+    Length = DataSize - Offset;
+  }
+  End = Offset + Length;
+  
+  // Строковые форматы выводим по диапазону как есть
+  if (OutPath == NULL && (OutputType == OUTPUT_ASCII || OutputType == OUTPUT_UCS)) {
+    if (OutputType == OUTPUT_ASCII) {
+      PrintAsciiString (Data + Offset, Length);
+    } else {
+      PrintUcsString (Data + Offset, Length);
+    }
+    return EFI_SUCCESS;
+  }
+  
+  if (OutputType == OUTPUT_ALL) {
+    Print (L"Variable Name: %s\n", VariableName);
+    Print (L"GUID: %s (%g)\n", GetGuidName (&FoundGuid), &FoundGuid);
+    Print (L"Size: %d bytes\n", DataSize);
+    Print (L"Attributes: 0x%08X\n", Attributes);
+    Print (L"Range: 0x%x-0x%x (%u bytes)\n\n", Offset, End, Length);
+  }
+  
+  // Блоки вывода занимают около 15 КБ, держим их в пуле, а не на стеке
+  Chunk = AllocatePool (DUMP_CHUNK_LINES * DUMP_LINE_SIZE);
+  WideChunk = (OutPath == NULL) ? AllocatePool (DUMP_CHUNK_LINES * DUMP_LINE_SIZE * sizeof (CHAR16)) : NULL;
+  if (Chunk == NULL || (OutPath == NULL && WideChunk == NULL)) {
+    if (Chunk != NULL) {
+      FreePool (Chunk);
+    }
+    return EFI_OUT_OF_RESOURCES;
+  }
+  
+  if (OutPath != NULL) {
+    Status = OpenFileWriter (&Writer, OutPath);
+    if (EFI_ERROR (Status)) {
+      Print (L"Error: Cannot create output file '%s': %r\n", OutPath, Status);
+      FreePool (Chunk);
+      return Status;
+    }
+  }
+  
+  if (OutPath != NULL && (OutputType == OUTPUT_ASCII || OutputType == OUTPUT_UCS)) {
+    // Строковые форматы пишем в файл строкой, ошибка записи сохраняется в Writer
+    WriteRangeText (&Writer, Data + Offset, Length, OutputType, Chunk, DUMP_CHUNK_LINES * DUMP_LINE_SIZE);
+  } else {
+    Used = 0;
+    Lines = 0;
+    for (Position = Offset; Position < End; Position += DUMP_BYTES_PER_LINE) {
+      Used += FormatDumpLine (
+                &Chunk[Used],
+                Position,
+                Data + Position,
+                MIN (DUMP_BYTES_PER_LINE, End - Position)
+                );
+      Lines++;
+    
+      // Блок готов или данные закончились - выводим его целиком
+      if (Lines == DUMP_CHUNK_LINES || Position + DUMP_BYTES_PER_LINE >= End) {
+        if (OutPath != NULL) {
+          if (EFI_ERROR (WriteFileWriter (&Writer, Chunk, Used))) {
+            break;
+          }
+        } else {
+          // Блок больше буфера Print, поэтому выводим его напрямую в консоль
+          for (Index = 0; Index <= Used; Index++) {
+            WideChunk[Index] = (CHAR16)Chunk[Index];
+          }
+          gST->ConOut->OutputString (gST->ConOut, WideChunk);
+        }
+        Used = 0;
+        Lines = 0;
+      }
+    }
+  }
+  
+  FreePool (Chunk);
+  if (WideChunk != NULL) {
+    FreePool (WideChunk);
+  }
+  
+  if (OutPath != NULL) {
+    Status = CloseFileWriter (&Writer);
+    if (EFI_ERROR (Status)) {
+      Print (L"Error: Failed to write '%s': %r\n", OutPath, Status);
+      return Status;
+    }
+    Print (L"Dumped %u bytes (0x%x-0x%x) of '%s' to %s\n", Length, Offset, End, VariableName, OutPath);
+  }
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Добавляет имя в список имён.
+  
+  @param List     Указатель на список
+  @param Name     Имя (не обязательно завершённое нулём)
+  @param Length   Длина имени в символах
+  
+  @retval EFI_SUCCESS           Имя добавлено
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+**/
+EFI_STATUS
+NameListAdd (
+  IN OUT NAME_LIST     *List,
+  IN     CONST CHAR16  *Name,
+  IN     UINTN         Length
+  )
+{
+  UINTN   NewCapacity;
+  CHAR16  **NewNames;
+  
+  if (List->Count == List->Capacity) {
+    NewCapacity = (List->Capacity == 0) ? 16 : List->Capacity * 2;
+    NewNames = ReallocatePool (
+                 List->Capacity * sizeof (CHAR16 *),
+                 NewCapacity * sizeof (CHAR16 *),
+                 List->Names
+                 );
+    if (NewNames == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    List->Names = NewNames;
+    List->Capacity = NewCapacity;
+  }
+  
+  List->Names[List->Count] = AllocateZeroPool ((Length + 1) * sizeof (CHAR16));
+  if (List->Names[List->Count] == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  CopyMem (List->Names[List->Count], Name, Length * sizeof (CHAR16));
+  List->Count++;
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Добавляет в список имена из строки, разделённые запятыми.
+  Пробелы вокруг имён отбрасываются, пустые элементы пропускаются.
+  
+  @param List     Указатель на список
+  @param Text     Строка с именами
+  
+  @retval EFI_SUCCESS           Имена добавлены
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+**/
+EFI_STATUS
+NameListAddSeparated (
+  IN OUT NAME_LIST     *List,
+  IN     CONST CHAR16  *Text
+  )
+{
+  EFI_STATUS    Status;
+  CONST CHAR16  *Start;
+  CONST CHAR16  *End;
+  
+  while (*Text != 0) {
+    // Пропускаем разделители и пробелы в начале элемента
+    while (*Text == L',' || *Text == L' ' || *Text == L'\t' || *Text == L'\r' || *Text == L'\n') {
+      Text++;
+    }
+    
+    Start = Text;
+    while (*Text != 0 && *Text != L',' && *Text != L'\r' && *Text != L'\n') {
+      Text++;
+    }
+    
+    // Обрезаем пробелы в конце элемента
+    End = Text;
+    while (End > Start && (End[-1] == L' ' || End[-1] == L'\t')) {
+      End--;
+    }
+    
+    if (End > Start) {
+      Status = NameListAdd (List, Start, End - Start);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+  }
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Добавляет в список имена из текстового файла (по одному или через запятую в строке,
+  '#' - комментарий).
+  
+  @param List     Указатель на список
+  @param FilePath Путь к файлу
+  
+  @retval EFI_SUCCESS   Имена добавлены
+  @retval другое        Ошибка при чтении файла
+**/
+EFI_STATUS
+NameListAddFromFile (
+  IN OUT NAME_LIST     *List,
+  IN     CONST CHAR16  *FilePath
+  )
+{
+  EFI_STATUS         Status;
+  SHELL_FILE_HANDLE  FileHandle;
+  CHAR16             *Line;
+  CHAR16             *Text;
+  BOOLEAN            Ascii;
+  
+  Status = ShellOpenFileByName (FilePath, &FileHandle, EFI_FILE_MODE_READ, 0);
+  if (EFI_ERROR (Status)) {
+    Print (L"Error: Failed to open '%s': %r\n", FilePath, Status);
+    return Status;
+  }
+  
+  while (!EFI_ERROR (Status) && !ShellFileHandleEof (FileHandle)) {
+    Line = ShellFileHandleReadLine (FileHandle, &Ascii);
+    if (Line == NULL) {
+      break;
+    }
+    
+    Text = Line;
+    while (*Text == L' ' || *Text == L'\t') {
+      Text++;
+    }
+    if (*Text != L'#') {
+      Status = NameListAddSeparated (List, Text);
+    }
+    
+    FreePool (Line);
+  }
+  
+  ShellCloseFile (&FileHandle);
+  return Status;
+}
+
+/**
+  Освобождает список имён.
+  
+  @param List     Указатель на список
+**/
+VOID
+FreeNameList (
+  IN OUT NAME_LIST  *List
+  )
+{
+  UINTN  Index;
+  
+  for (Index = 0; Index < List->Count; Index++) {
+    FreePool (List->Names[Index]);
+  }
+  if (List->Names != NULL) {
+    FreePool (List->Names);
+  }
+  ZeroMem (List, sizeof (NAME_LIST));
+}
+
+/**
+  Пакетный режим: находит все переменные из списка за один проход по хранилищу
+  и выводит каждую в заданном формате.
+  
+  @param Names      Список имён переменных
+  @param GuidPrefix Префикс GUID (может быть NULL)
+  @param OutputType Тип вывода
+  
+  @retval EFI_SUCCESS   Все переменные найдены и выведены
+  @retval EFI_NOT_FOUND Часть переменных не найдена
+  @retval другое        Ошибка при поиске
+**/
+EFI_STATUS
+PrintVariableBatch (
+  IN CONST NAME_LIST  *Names,
+  IN CONST CHAR16     *GuidPrefix,
+  IN OUTPUT_TYPE      OutputType
+  )
+{
+  EFI_STATUS       Status;
+  EFI_STATUS       Result;
+  VAR_STORE_INDEX  *VarIndex;
+  VAR_INDEX_ENTRY  *Entry;
+  EFI_GUID         TargetGuid;
+  GUID_PATTERN     GuidPattern;
+  BOOLEAN          GuidSpecified;
+  CONST EFI_GUID   *Guid;
+  VOID             *Data;
+  UINTN            DataSize;
+  UINT32           Attributes;
+  UINTN            Index;
+  
+  VarIndex = NULL;
+  GuidSpecified = FALSE;
+  
+  if (GuidPrefix != NULL && StrLen (GuidPrefix) > 0) {
+    if (!ParseGuidPattern (GuidPrefix, &GuidPattern)) {
+      Print (L"Error: Invalid GUID prefix '%s'\n", GuidPrefix);
+      return EFI_INVALID_PARAMETER;
+    }
+    GuidSpecified = TRUE;
+  }
+  
+  // Все имена разрешаются по одному проходу GetNextVariableName (кроме полного GUID)
+  if (!GuidSpecified || !GuidPatternToGuid (&GuidPattern, &TargetGuid)) {
+    Status = GetVariableIndex (&VarIndex);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+  
+  Result = EFI_SUCCESS;
+  for (Index = 0; Index < Names->Count; Index++) {
+    if (VarIndex != NULL) {
+      Entry = VarIndexResolveName (VarIndex, Names->Names[Index], GuidSpecified ? &GuidPattern : NULL);
+      Guid = (Entry != NULL) ? &Entry->Guid : NULL;
+    } else {
+      Guid = &TargetGuid;
+    }
+    
+    Status = EFI_NOT_FOUND;
+    if (Guid != NULL) {
+      Status = ReadVariablePooled (Names->Names[Index], Guid, &Data, &DataSize, &Attributes);
+    }
+    
+    if (EFI_ERROR (Status)) {
+      Print (L"%s: <not found>\n", Names->Names[Index]);
+      Result = EFI_NOT_FOUND;
+      continue;
+    }
+    
+    if (OutputType == OUTPUT_ALL) {
+      PrintVariable (Names->Names[Index], Guid, Data, DataSize, Attributes, OutputType);
+      Print (L"\n");
+    } else {
+      Print (L"%s: ", Names->Names[Index]);
+      if (OutputType == OUTPUT_HEX) {
+        Print (L"\n");
+      }
+      PrintVariable (Names->Names[Index], Guid, Data, DataSize, Attributes, OutputType);
+    }
+  }
+  
+  return Result;
+}
+
+/**
+  Записывает одну переменную в снимок хранилища.
+  
+  @param Name     Имя переменной
+  @param Guid     GUID переменной
+  @param Context  Указатель на SNAPSHOT_CONTEXT
+  
+  @retval EFI_SUCCESS   Запись добавлена (в т.ч. с флагом ошибки чтения)
+  @retval другое        Ошибка записи в файл или нехватка памяти
+**/
+EFI_STATUS
+SnapshotRecordCallback (
+  IN CONST CHAR16    *Name,
+  IN CONST EFI_GUID  *Guid,
+  IN VOID            *Context
+  )
+{
+  SNAPSHOT_CONTEXT  *Snapshot;
+  SNAPSHOT_RECORD   Record;
+  EFI_STATUS        Status;
+  VOID              *Data;
+  UINTN             DataSize;
+  UINT32            Attributes;
+  UINT32            Crc;
+  UINTN             Unaligned;
+  UINT64            *NewOffsets;
+  UINTN             NewCapacity;
+  STATIC CONST UINT8  Padding[SNAPSHOT_ALIGNMENT] = {0};
+  
+  Snapshot = (SNAPSHOT_CONTEXT *)Context;
+  
+  if (Snapshot->Count == Snapshot->Capacity) {
+    NewCapacity = (Snapshot->Capacity == 0) ? 256 : Snapshot->Capacity * 2;
+    NewOffsets = ReallocatePool (
+                   Snapshot->Capacity * sizeof (UINT64),
+                   NewCapacity * sizeof (UINT64),
+                   Snapshot->Offsets
+                   );
+    if (NewOffsets == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Snapshot->Offsets = NewOffsets;
+    Snapshot->Capacity = NewCapacity;
+  }
+  
+  ZeroMem (&Record, sizeof (Record));
+  CopyGuid (&Record.Guid, Guid);
+  Record.NameSize = (UINT32)StrSize (Name);
+  
+  // Данные читаются в общий буфер и сразу уходят в файл, без промежуточных копий
+  Status = ReadVariablePooled (Name, Guid, &Data, &DataSize, &Attributes);
+  if (EFI_ERROR (Status)) {
+    Record.Flags |= SNAPSHOT_RECORD_READ_ERROR;
+    Data = NULL;
+    DataSize = 0;
+    Snapshot->ReadErrors++;
+  } else {
+    Record.Attributes = Attributes;
+    Record.DataSize = (UINT32)DataSize;
+    if (DataSize > 0) {
+      Crc = 0;
+      gBS->CalculateCrc32 (Data, DataSize, &Crc);
+      Record.DataCrc32 = Crc;
+    }
+    Snapshot->DataBytes += DataSize;
+  }
+  
+  Unaligned = (sizeof (Record) + Record.NameSize + DataSize) % SNAPSHOT_ALIGNMENT;
+  Record.RecordSize = (UINT32)(sizeof (Record) + Record.NameSize + DataSize);
+  if (Unaligned != 0) {
+    Record.RecordSize += (UINT32)(SNAPSHOT_ALIGNMENT - Unaligned);
+  }
+  
+  Snapshot->Offsets[Snapshot->Count++] = Snapshot->Writer.Offset;
+  
+  WriteFileWriter (&Snapshot->Writer, &Record, sizeof (Record));
+  WriteFileWriter (&Snapshot->Writer, Name, Record.NameSize);
+  if (DataSize > 0) {
+    WriteFileWriter (&Snapshot->Writer, Data, DataSize);
+  }
+  if (Unaligned != 0) {
+    WriteFileWriter (&Snapshot->Writer, Padding, SNAPSHOT_ALIGNMENT - Unaligned);
+  }
+  
+  return Snapshot->Writer.Status;
+}
+
+/**
+  Сохраняет всё хранилище переменных в двоичный снимок за один проход.
+  Формат описан у SNAPSHOT_HEADER; для разбора на хосте служит Tools/snsnap.c.
+  
+  @param FilePath   Путь к файлу снимка
+  
+  @retval EFI_SUCCESS   Снимок записан
+  @retval другое        Ошибка перечисления или записи
+**/
+EFI_STATUS
+WriteVariableSnapshot (
+  IN CONST CHAR16  *FilePath
+  )
+{
+  EFI_STATUS        Status;
+  EFI_STATUS        CloseStatus;
+  SNAPSHOT_CONTEXT  Snapshot;
+  SNAPSHOT_HEADER   Header;
+  SNAPSHOT_FOOTER   Footer;
+  UINT32            Crc;
+  
+  ZeroMem (&Snapshot, sizeof (Snapshot));
+  
+  Status = OpenFileWriter (&Snapshot.Writer, FilePath);
+  if (EFI_ERROR (Status)) {
+    Print (L"Error: Cannot create snapshot file '%s': %r\n", FilePath, Status);
+    return Status;
+  }
+  
+  ZeroMem (&Header, sizeof (Header));
+  CopyMem (Header.Signature, SNAPSHOT_SIGNATURE, sizeof (Header.Signature));
+  Header.Version = SNAPSHOT_VERSION;
+  Header.HeaderSize = sizeof (SNAPSHOT_HEADER);
+  Header.RecordHeaderSize = sizeof (SNAPSHOT_RECORD);
+  if (EFI_ERROR (gRT->GetTime (&Header.Time, NULL))) {
+    ZeroMem (&Header.Time, sizeof (Header.Time));
+  }
+  WriteFileWriter (&Snapshot.Writer, &Header, sizeof (Header));
+  
+  Status = EnumerateVariables (SnapshotRecordCallback, &Snapshot);
+  
+  if (!EFI_ERROR (Status)) {
+    // Таблица смещений и завершающая запись позволяют найти любую запись без полного разбора
+    ZeroMem (&Footer, sizeof (Footer));
+    Footer.IndexOffset = Snapshot.Writer.Offset;
+    Footer.RecordCount = (UINT32)Snapshot.Count;
+    CopyMem (Footer.Signature, SNAPSHOT_INDEX_SIGNATURE, sizeof (Footer.Signature));
+    if (Snapshot.Count > 0) {
+      Crc = 0;
+      gBS->CalculateCrc32 (Snapshot.Offsets, Snapshot.Count * sizeof (UINT64), &Crc);
+      Footer.IndexCrc32 = Crc;
+      WriteFileWriter (&Snapshot.Writer, Snapshot.Offsets, Snapshot.Count * sizeof (UINT64));
+    }
+    WriteFileWriter (&Snapshot.Writer, &Footer, sizeof (Footer));
+  }
+  
+  CloseStatus = CloseFileWriter (&Snapshot.Writer);
+  if (!EFI_ERROR (Status)) {
+    Status = CloseStatus;
+  }
+  
+  if (EFI_ERROR (Status)) {
+    Print (L"Error: Failed to write snapshot '%s': %r\n", FilePath, Status);
+  } else {
+    Print (L"Snapshot: %u variables, %lu data bytes written to %s\n", Snapshot.Count, Snapshot.DataBytes, FilePath);
+    if (Snapshot.ReadErrors > 0) {
+      Print (L"Warning: %u variables could not be read and were stored without data\n", Snapshot.ReadErrors);
+    }
+  }
+  
+  if (Snapshot.Offsets != NULL) {
+    FreePool (Snapshot.Offsets);
+  }
+  
+  return Status;
+}
+
+/**
+  Учитывает одну переменную в статистике хранилища по GUID. Данные не читаются:
+  GetVariable с нулевым буфером возвращает только размер и атрибуты.
+  
+  @param Name     Имя переменной
+  @param Guid     GUID переменной
+  @param Context  Указатель на STORE_STATS_CONTEXT
+  
+  @retval EFI_SUCCESS           Переменная учтена
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+**/
+EFI_STATUS
+StoreStatsCallback (
+  IN CONST CHAR16    *Name,
+  IN CONST EFI_GUID  *Guid,
+  IN VOID            *Context
+  )
+{
+  STORE_STATS_CONTEXT  *StatsContext;
+  STORE_GUID_STATS     *Stats;
+  STORE_GUID_STATS     *NewStats;
+  EFI_STATUS           Status;
+  UINT32               Attributes;
+  UINTN                DataSize;
+  UINTN                NewCapacity;
+  UINTN                Index;
+  
+  StatsContext = (STORE_STATS_CONTEXT *)Context;
+  StatsContext->Variables++;
+  
+  Attributes = 0;
+  DataSize = 0;
+  Status = gRT->GetVariable ((CHAR16 *)Name, (EFI_GUID *)Guid, &Attributes, &DataSize, NULL);
+  if (Status != EFI_BUFFER_TOO_SMALL && EFI_ERROR (Status)) {
+    StatsContext->Unreadable++;
+    return EFI_SUCCESS;
+  }
+  
+  // Различных GUID в хранилище единицы-десятки, линейного поиска достаточно
+  Stats = NULL;
+  for (Index = 0; Index < StatsContext->Count; Index++) {
+    if (CompareGuid (&StatsContext->Stats[Index].Guid, Guid)) {
+      Stats = &StatsContext->Stats[Index];
+      break;
+    }
+  }
+  
+  if (Stats == NULL) {
+    if (StatsContext->Count == StatsContext->Capacity) {
+      NewCapacity = (StatsContext->Capacity == 0) ? 16 : StatsContext->Capacity * 2;
+      NewStats = ReallocatePool (
+                   StatsContext->Capacity * sizeof (STORE_GUID_STATS),
+                   NewCapacity * sizeof (STORE_GUID_STATS),
+                   StatsContext->Stats
+                   );
+      if (NewStats == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+      }
+      StatsContext->Stats = NewStats;
+      StatsContext->Capacity = NewCapacity;
+    }
+    Stats = &StatsContext->Stats[StatsContext->Count++];
+    ZeroMem (Stats, sizeof (STORE_GUID_STATS));
+    CopyGuid (&Stats->Guid, Guid);
+  }
+  
+  Stats->Count++;
+  Stats->Bytes += DataSize;
+  if ((Attributes & EFI_VARIABLE_NON_VOLATILE) != 0) {
+    Stats->NvBytes += DataSize;
+  }
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Выводит размеры хранилища по классам атрибутов (QueryVariableInfo) и
+  количество и объём переменных по GUID за один проход перечисления.
+  
+  @retval EFI_SUCCESS   Статистика выведена
+  @retval другое        Ошибка при перечислении хранилища
+**/
+EFI_STATUS
+PrintStoreStats (
+  VOID
+  )
+{
+  EFI_STATUS           Status;
+  STORE_STATS_CONTEXT  StatsContext;
+  STORE_GUID_STATS     Swap;
+  UINT64               MaxStorage;
+  UINT64               Remaining;
+  UINT64               MaxVariable;
+  UINT64               TotalBytes;
+  UINT64               TotalNvBytes;
+  UINTN                Index;
+  UINTN                Inner;
+  
+  Print (L"=== Variable Store Capacity ===\n");
+  Print (L"%-10s  %12s  %12s  %12s  %5s\n", L"Class", L"Maximum", L"Remaining", L"MaxVariable", L"Used");
+  
+  for (Index = 0; mStoreClasses[Index].Label != NULL; Index++) {
+    Status = gRT->QueryVariableInfo (mStoreClasses[Index].Attributes, &MaxStorage, &Remaining, &MaxVariable);
+    if (EFI_ERROR (Status)) {
+      Print (L"%-10s  %r\n", mStoreClasses[Index].Label, Status);
+      continue;
+    }
+    Print (
+      L"%-10s  %12lu  %12lu  %12lu  %4lu%%\n",
+      mStoreClasses[Index].Label,
+      MaxStorage,
+      Remaining,
+      MaxVariable,
+      (MaxStorage == 0) ? 0 : DivU64x64Remainder (MultU64x32 (MaxStorage - Remaining, 100), MaxStorage, NULL)
+      );
+  }
+  
+  ZeroMem (&StatsContext, sizeof (StatsContext));
+  Status = EnumerateVariables (StoreStatsCallback, &StatsContext);
+  if (EFI_ERROR (Status)) {
+    if (StatsContext.Stats != NULL) {
+      FreePool (StatsContext.Stats);
+    }
+    return Status;
+  }
+  
+  // Сортируем по объёму данных, крупнейшие потребители хранилища - первыми
+  for (Index = 1; Index < StatsContext.Count; Index++) {
+    CopyMem (&Swap, &StatsContext.Stats[Index], sizeof (Swap));
+    for (Inner = Index; Inner > 0 && StatsContext.Stats[Inner - 1].Bytes < Swap.Bytes; Inner--) {
+      CopyMem (&StatsContext.Stats[Inner], &StatsContext.Stats[Inner - 1], sizeof (Swap));
+    }
+    CopyMem (&StatsContext.Stats[Inner], &Swap, sizeof (Swap));
+  }
+  
+  Print (L"\n=== Variables by GUID ===\n");
+  Print (L"%-36s  %-20s  %6s  %10s  %10s\n", L"GUID", L"Vendor", L"Count", L"Bytes", L"NV Bytes");
+  
+  TotalBytes = 0;
+  TotalNvBytes = 0;
+  for (Index = 0; Index < StatsContext.Count; Index++) {
+    Print (
+      L"%g  %-20s  %6u  %10lu  %10lu\n",
+      &StatsContext.Stats[Index].Guid,
+      GetGuidName (&StatsContext.Stats[Index].Guid),
+      StatsContext.Stats[Index].Count,
+      StatsContext.Stats[Index].Bytes,
+      StatsContext.Stats[Index].NvBytes
+      );
+    TotalBytes += StatsContext.Stats[Index].Bytes;
+    TotalNvBytes += StatsContext.Stats[Index].NvBytes;
+  }
+  
+  Print (L"\nTotal: %u variables under %u GUIDs, %lu bytes (%lu non-volatile)\n",
+         StatsContext.Variables, StatsContext.Count, TotalBytes, TotalNvBytes);
+  if (StatsContext.Unreadable > 0) {
+    Print (L"Warning: Size of %u variables could not be queried\n", StatsContext.Unreadable);
+  }
+  
+  if (StatsContext.Stats != NULL) {
+    FreePool (StatsContext.Stats);
+  }
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Проверяет, хватит ли NV хранилища для предстоящей записи без reclaim.
+  
+  QueryVariableInfo обычно включает в Remaining место удалённых переменных, которое
+  освобождается только reclaim, поэтому порог задан запасом NV_RECLAIM_MARGIN_PERCENT
+  от максимума, а не точным значением.
+  
+  @param Bytes        Оценка объёма записи (данные, имена и заголовки)
+  @param Operation    Описание операции для сообщений
+  @param ForceWrite   Разрешить запись при риске reclaim (--force-write)
+  
+  @retval EFI_SUCCESS           Запись допустима
+  @retval EFI_OUT_OF_RESOURCES  Запись не поместится в хранилище
+  @retval EFI_ACCESS_DENIED     Запись, вероятно, вызовет reclaim, и --force-write не задан
+**/
+EFI_STATUS
+CheckNvWriteBudget (
+  IN UINT64        Bytes,
+  IN CONST CHAR16  *Operation,
+  IN BOOLEAN       ForceWrite
+  )
+{
+  EFI_STATUS  Status;
+  UINT64      MaxStorage;
+  UINT64      Remaining;
+  UINT64      MaxVariable;
+  UINT64      Margin;
+  
+  Status = gRT->QueryVariableInfo (
+                  EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
+                  &MaxStorage,
+                  &Remaining,
+                  &MaxVariable
+                  );
+  if (EFI_ERROR (Status)) {
+    // Без QueryVariableInfo оценить запас нельзя, поведение остаётся прежним
+    Print (L"Warning: Cannot query NV store before %s: %r\n", Operation, Status);
+    return EFI_SUCCESS;
+  }
+  
+  if (Remaining < Bytes) {
+    Print (L"Error: NV store has %lu bytes left, %s needs about %lu\n", Remaining, Operation, Bytes);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  
+  Margin = DivU64x32 (MultU64x32 (MaxStorage, NV_RECLAIM_MARGIN_PERCENT), 100);
+  if (Remaining - Bytes >= Margin) {
+    return EFI_SUCCESS;
+  }
+  
+  Print (L"Warning: NV store is nearly full (%lu of %lu bytes left), %s may trigger a reclaim\n",
+         Remaining, MaxStorage, Operation);
+  if (ForceWrite) {
+    Print (L"Warning: Continuing because --force-write is set\n");
+    return EFI_SUCCESS;
+  }
+  
+  Print (L"Error: Refusing to write; use --force-write to override\n");
+  return EFI_ACCESS_DENIED;
+}
+
+/**
+  Разбирает строку шестнадцатеричных байт с необязательными разделителями
+  (':', '-', '.', пробел), например MAC-адрес в любом из принятых форматов.
+  
+  @param Text       Исходная строка
+  @param Bytes      Буфер для байт
+  @param MaxBytes   Размер буфера
+  @param Count      Указатель на количество разобранных байт
+  
+  @retval TRUE      Строка состоит только из пар шестнадцатеричных цифр
+  @retval FALSE     Строка не является шестнадцатеричной или не помещается в буфер
+**/
+BOOLEAN
+ParseHexBytes (
+  IN  CONST CHAR16  *Text,
+  OUT UINT8         *Bytes,
+  IN  UINTN         MaxBytes,
+  OUT UINTN         *Count
+  )
+{
+  UINTN   Digits;
+  UINT8   Nibble;
+  CHAR16  Char;
+  
+  Digits = 0;
+  for (; *Text != L'\0'; Text++) {
+    Char = *Text;
+    if (Char == L':' || Char == L'-' || Char == L'.' || Char == L' ') {
+      continue;
+    }
+    
+    if (Char >= L'0' && Char <= L'9') {
+      Nibble = (UINT8)(Char - L'0');
+    } else if (Char >= L'A' && Char <= L'F') {
+      Nibble = (UINT8)(Char - L'A' + 10);
+    } else if (Char >= L'a' && Char <= L'f') {
+      Nibble = (UINT8)(Char - L'a' + 10);
+    } else {
+      return FALSE;
+    }
+    
+    if (Digits / 2 >= MaxBytes) {
+      return FALSE;
+    }
+    if ((Digits & 1) == 0) {
+      Bytes[Digits / 2] = (UINT8)(Nibble << 4);
+    } else {
+      Bytes[Digits / 2] |= Nibble;
+    }
+    Digits++;
+  }
+  
+  *Count = Digits / 2;
+  return (Digits > 0 && (Digits & 1) == 0);
+}
+
+/**
+  Добавляет образец в автомат, если такой последовательности ещё нет.
+  
+  @param Automaton  Указатель на автомат
+  @param Bytes      Последовательность байт (копируется)
+  @param Length     Длина последовательности
+  @param Encoding   Название кодировки
+  
+  @retval EFI_SUCCESS           Образец добавлен или уже есть
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти или слишком много образцов
+**/
+EFI_STATUS
+AcAddPattern (
+  IN OUT AC_AUTOMATON  *Automaton,
+  IN     CONST VOID    *Bytes,
+  IN     UINTN         Length,
+  IN     CONST CHAR16  *Encoding
+  )
+{
+  SEARCH_PATTERN  *Pattern;
+  UINTN           Index;
+  
+  if (Length == 0) {
+    return EFI_SUCCESS;
+  }
+  
+  for (Index = 0; Index < Automaton->PatternCount; Index++) {
+    if (Automaton->Patterns[Index].Length == Length &&
+        CompareMem (Automaton->Patterns[Index].Bytes, Bytes, Length) == 0) {
+      return EFI_SUCCESS;
+    }
+  }
+  
+  if (Automaton->PatternCount == AC_MAX_PATTERNS) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  
+  Pattern = &Automaton->Patterns[Automaton->PatternCount];
+  Pattern->Bytes = AllocateCopyPool (Length, Bytes);
+  if (Pattern->Bytes == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Pattern->Length = Length;
+  Pattern->Encoding = Encoding;
+  Automaton->PatternCount++;
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Строит автомат Ахо-Корасик по добавленным образцам: бор, затем обход в ширину
+  с вычислением суффиксных ссылок и достраиванием всех переходов.
+  
+  @param Automaton  Указатель на автомат с образцами
+  
+  @retval EFI_SUCCESS           Автомат построен
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+**/
+EFI_STATUS
+AcBuild (
+  IN OUT AC_AUTOMATON  *Automaton
+  )
+{
+  UINT16  *Fail;
+  UINT16  *Queue;
+  UINTN   Capacity;
+  UINTN   Head;
+  UINTN   Tail;
+  UINTN   Index;
+  UINTN   Pos;
+  UINTN   State;
+  UINTN   Child;
+  UINTN   Char;
+  
+  // Верхняя граница числа состояний - корень плюс сумма длин образцов
+  Capacity = 1;
+  for (Index = 0; Index < Automaton->PatternCount; Index++) {
+    Capacity += Automaton->Patterns[Index].Length;
+  }
+  if (Capacity > MAX_UINT16) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  
+  Automaton->Next = AllocateZeroPool (Capacity * sizeof (*Automaton->Next));
+  Automaton->Output = AllocateZeroPool (Capacity * sizeof (UINT32));
+  Fail = AllocateZeroPool (Capacity * sizeof (UINT16));
+  Queue = AllocatePool (Capacity * sizeof (UINT16));
+  if (Automaton->Next == NULL || Automaton->Output == NULL || Fail == NULL || Queue == NULL) {
+    if (Fail != NULL) {
+      FreePool (Fail);
+    }
+    if (Queue != NULL) {
+      FreePool (Queue);
+    }
+    return EFI_OUT_OF_RESOURCES;
+  }
+  
+  // Бор: переход в корень (0) означает отсутствие ребра, в корень ничто не ведёт
+  Automaton->StateCount = 1;
+  for (Index = 0; Index < Automaton->PatternCount; Index++) {
+    State = 0;
+    for (Pos = 0; Pos < Automaton->Patterns[Index].Length; Pos++) {
+      Char = Automaton->Patterns[Index].Bytes[Pos];
+      if (Automaton->Next[State][Char] == 0) {
+        Automaton->Next[State][Char] = (UINT16)Automaton->StateCount++;
+      }
+      State = Automaton->Next[State][Char];
+    }
+    Automaton->Output[State] |= (1U << Index);
+  }
+  
+  // Обход в ширину: суффиксные ссылки и недостающие переходы
+  Head = 0;
+  Tail = 0;
+  for (Char = 0; Char < 256; Char++) {
+    if (Automaton->Next[0][Char] != 0) {
+      Queue[Tail++] = Automaton->Next[0][Char];
+    }
+  }
+  
+  while (Head < Tail) {
+    State = Queue[Head++];
+    Automaton->Output[State] |= Automaton->Output[Fail[State]];
+    
+    for (Char = 0; Char < 256; Char++) {
+      Child = Automaton->Next[State][Char];
+      if (Child != 0) {
+        Fail[Child] = Automaton->Next[Fail[State]][Char];
+        Queue[Tail++] = (UINT16)Child;
+      } else {
+        Automaton->Next[State][Char] = Automaton->Next[Fail[State]][Char];
+      }
+    }
+  }
+  
+  FreePool (Fail);
+  FreePool (Queue);
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Освобождает ресурсы автомата.
+  
+  @param Automaton  Указатель на автомат
+**/
+VOID
+AcFree (
+  IN OUT AC_AUTOMATON  *Automaton
+  )
+{
+  UINTN  Index;
+  
+  for (Index = 0; Index < Automaton->PatternCount; Index++) {
+    if (Automaton->Patterns[Index].Bytes != NULL) {
+      FreePool (Automaton->Patterns[Index].Bytes);
+    }
+  }
+  if (Automaton->Next != NULL) {
+    FreePool (Automaton->Next);
+  }
+  if (Automaton->Output != NULL) {
+    FreePool (Automaton->Output);
+  }
+  ZeroMem (Automaton, sizeof (AC_AUTOMATON));
+}
+
+/**
+  Ищет все представления значения в данных одной переменной за один проход.
+  
+  @param Name     Имя переменной
+  @param Guid     GUID переменной
+  @param Context  Указатель на FIND_VALUE_CONTEXT
+  
+  @retval EFI_SUCCESS   Переменная обработана
+**/
+EFI_STATUS
+FindValueCallback (
+  IN CONST CHAR16    *Name,
+  IN CONST EFI_GUID  *Guid,
+  IN VOID            *Context
+  )
+{
+  FIND_VALUE_CONTEXT  *Find;
+  AC_AUTOMATON        *Automaton;
+  EFI_STATUS          Status;
+  UINT8               *Data;
+  UINTN               DataSize;
+  UINTN               Offset;
+  UINTN               State;
+  UINTN               Index;
+  UINT32              Output;
+  
+  Find = (FIND_VALUE_CONTEXT *)Context;
+  Automaton = Find->Automaton;
+  Find->Variables++;
+  
+  Status = ReadVariablePooled (Name, Guid, (VOID **)&Data, &DataSize, NULL);
+  if (EFI_ERROR (Status)) {
+    Find->Unreadable++;
+    return EFI_SUCCESS;
+  }
+  
+  State = 0;
+  for (Offset = 0; Offset < DataSize; Offset++) {
+    State = Automaton->Next[State][Data[Offset]];
+    Output = Automaton->Output[State];
+    if (Output == 0) {
+      continue;
+    }
+    
+    for (Index = 0; Index < Automaton->PatternCount; Index++) {
+      if ((Output & (1U << Index)) != 0) {
+        Print (
+          L"%g  0x%06x  %-10s  %s\n",
+          Guid,
+          Offset + 1 - Automaton->Patterns[Index].Length,
+          Automaton->Patterns[Index].Encoding,
+          Name
+          );
+        Find->Matches++;
+      }
+    }
+  }
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Ищет значение в данных всех переменных хранилища сразу во всех кодировках:
+  ASCII, UCS-2, а для шестнадцатеричных значений (например, MAC) также в виде
+  двоичных байт и шестнадцатеричной строки без разделителей.
+  
+  @param Value  Искомое значение
+  
+  @retval EFI_SUCCESS           Найдено хотя бы одно совпадение
+  @retval EFI_NOT_FOUND         Совпадений нет
+  @retval EFI_INVALID_PARAMETER Пустое или слишком длинное значение
+  @retval другое                Ошибка при перечислении или нехватка памяти
+**/
+EFI_STATUS
+FindValueInVariables (
+  IN CONST CHAR16  *Value
+  )
+{
+  EFI_STATUS          Status;
+  AC_AUTOMATON        Automaton;
+  FIND_VALUE_CONTEXT  Find;
+  CHAR8               Ascii[FIND_VALUE_MAX_LENGTH + 1];
+  UINT8               Binary[FIND_VALUE_MAX_LENGTH / 2];
+  CHAR8               HexUpper[FIND_VALUE_MAX_LENGTH + 1];
+  CHAR8               HexLower[FIND_VALUE_MAX_LENGTH + 1];
+  CHAR16              HexWide[FIND_VALUE_MAX_LENGTH + 1];
+  UINTN               Length;
+  UINTN               BinarySize;
+  UINTN               Index;
+  BOOLEAN             IsAscii;
+  
+  Length = StrLen (Value);
+  if (Length == 0 || Length > FIND_VALUE_MAX_LENGTH) {
+    Print (L"Error: Search value must be 1 to %u characters long\n", FIND_VALUE_MAX_LENGTH);
+    return EFI_INVALID_PARAMETER;
+  }
+  
+  ZeroMem (&Automaton, sizeof (Automaton));
+  
+  IsAscii = TRUE;
+  for (Index = 0; Index < Length; Index++) {
+    if (Value[Index] > 0x7F) {
+      IsAscii = FALSE;
+      break;
+    }
+    Ascii[Index] = (CHAR8)Value[Index];
+  }
+  Ascii[Length] = '\0';
+  
+  Status = EFI_SUCCESS;
+  if (IsAscii) {
+    Status = AcAddPattern (&Automaton, Ascii, Length, L"ascii");
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = AcAddPattern (&Automaton, Value, Length * sizeof (CHAR16), L"ucs2");
+  }
+  
+  // Шестнадцатеричное значение (MAC в любом формате) ищем также в двоичном и компактном виде
+  if (!EFI_ERROR (Status) && ParseHexBytes (Value, Binary, sizeof (Binary), &BinarySize)) {
+    for (Index = 0; Index < BinarySize; Index++) {
+      AsciiSPrint (&HexUpper[Index * 2], 3, "%02X", Binary[Index]);
+      AsciiSPrint (&HexLower[Index * 2], 3, "%02x", Binary[Index]);
+      UnicodeSPrint (&HexWide[Index * 2], 3 * sizeof (CHAR16), L"%02X", Binary[Index]);
+    }
+    
+    Status = AcAddPattern (&Automaton, Binary, BinarySize, L"binary");
+    if (!EFI_ERROR (Status)) {
+      Status = AcAddPattern (&Automaton, HexUpper, BinarySize * 2, L"hex");
+    }
+    if (!EFI_ERROR (Status)) {
+      Status = AcAddPattern (&Automaton, HexLower, BinarySize * 2, L"hex-lower");
+    }
+    if (!EFI_ERROR (Status)) {
+      Status = AcAddPattern (&Automaton, HexWide, BinarySize * 2 * sizeof (CHAR16), L"hex-ucs2");
+    }
+  }
+  
+  if (!EFI_ERROR (Status)) {
+    Status = AcBuild (&Automaton);
+  }
+  if (EFI_ERROR (Status)) {
+    Print (L"Error: Failed to prepare search: %r\n", Status);
+    AcFree (&Automaton);
+    return Status;
+  }
+  
+  Print (L"Searching for '%s' in %u encodings...\n\n", Value, Automaton.PatternCount);
+  Print (L"%-36s  %8s  %-10s  %s\n", L"GUID", L"Offset", L"Encoding", L"Name");
+  
+  ZeroMem (&Find, sizeof (Find));
+  Find.Automaton = &Automaton;
+  Status = EnumerateVariables (FindValueCallback, &Find);
+  
+  AcFree (&Automaton);
+  
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  Print (L"\n%u matches in %u variables\n", Find.Matches, Find.Variables);
+  if (Find.Unreadable > 0) {
+    Print (L"Warning: %u variables could not be read\n", Find.Unreadable);
+  }
+  
+  return (Find.Matches > 0) ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
+
+/**
+  Дополняет только что добавленную запись слепка размером, атрибутами и CRC32 данных.
+  Вызывается из BuildVariableIndex сразу после вставки записи.
+  
+  @param Name     Имя переменной
+  @param Guid     GUID переменной
+  @param Context  Указатель на строящийся VAR_STORE_INDEX
+  
+  @retval EFI_SUCCESS   Запись обработана
+**/
+EFI_STATUS
+StoreDigestCallback (
+  IN CONST CHAR16    *Name,
+  IN CONST EFI_GUID  *Guid,
+  IN VOID            *Context
+  )
+{
+  VAR_STORE_INDEX  *Digest;
+  VAR_INDEX_ENTRY  *Entry;
+  EFI_STATUS       Status;
+  VOID             *Data;
+  UINTN            DataSize;
+  UINT32           Attributes;
+  UINT32           Crc;
+  
+  Digest = (VAR_STORE_INDEX *)Context;
+  Entry = &Digest->Entries[Digest->EntryCount - 1];
+  
+  // Данные читаются в общий буфер только для подсчёта CRC и не сохраняются
+  Status = ReadVariablePooled (Name, Guid, &Data, &DataSize, &Attributes);
+  if (EFI_ERROR (Status)) {
+    return EFI_SUCCESS;
+  }
+  
+  Crc = 0;
+  if (DataSize > 0) {
+    gBS->CalculateCrc32 (Data, DataSize, &Crc);
+  }
+  
+  Entry->Attributes = Attributes;
+  Entry->DataSize = DataSize;
+  Entry->Crc32 = Crc;
+  Entry->Flags |= VAR_ENTRY_INFO_VALID | VAR_ENTRY_CRC_VALID;
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Строит слепок хранилища: имя и GUID -> размер, атрибуты и CRC32 данных.
+  
+  @param Digest   Указатель на индекс для слепка
+  
+  @retval EFI_SUCCESS   Слепок построен
+  @retval другое        Ошибка при перечислении хранилища
+**/
+EFI_STATUS
+BuildStoreDigest (
+  OUT VAR_STORE_INDEX  *Digest
+  )
+{
+  ZeroMem (Digest, sizeof (VAR_STORE_INDEX));
+  return BuildVariableIndex (Digest, StoreDigestCallback, Digest);
+}
+
+/**
+  Выводит различия двух слепков хранилища: добавленные, удалённые и изменённые
+  переменные. Сравниваются только размеры, атрибуты и CRC32, данные не читаются.
+  
+  @param Before   Слепок до изменения
+  @param After    Слепок после изменения
+  
+  @retval         Количество различий
+**/
+UINTN
+PrintStoreDiff (
+  IN OUT VAR_STORE_INDEX  *Before,
+  IN     VAR_STORE_INDEX  *After
+  )
+{
+  VAR_INDEX_ENTRY  *Old;
+  VAR_INDEX_ENTRY  *New;
+  UINTN            Index;
+  UINTN            Added;
+  UINTN            Removed;
+  UINTN            Changed;
+  
+  Added = 0;
+  Removed = 0;
+  Changed = 0;
+  
+  for (Index = 0; Index < Before->EntryCount; Index++) {
+    Before->Entries[Index].Flags &= ~VAR_ENTRY_SEEN;
+  }
+  
+  for (Index = 0; Index < After->EntryCount; Index++) {
+    New = &After->Entries[Index];
+    Old = VarIndexFind (Before, VarIndexEntryName (After, New), &New->Guid);
+    
+    if (Old == NULL) {
+      Print (L"  + %g  %s (%u bytes)\n", &New->Guid, VarIndexEntryName (After, New), New->DataSize);
+      Added++;
+      continue;
+    }
+    
+    Old->Flags |= VAR_ENTRY_SEEN;
+    if (((Old->Flags ^ New->Flags) & VAR_ENTRY_CRC_VALID) != 0 ||
+        Old->DataSize != New->DataSize ||
+        Old->Attributes != New->Attributes ||
+        Old->Crc32 != New->Crc32) {
+      Print (
+        L"  ~ %g  %s (%u -> %u bytes, attributes 0x%08x -> 0x%08x)\n",
+        &New->Guid,
+        VarIndexEntryName (After, New),
+        Old->DataSize,
+        New->DataSize,
+        Old->Attributes,
+        New->Attributes
+        );
+      Changed++;
+    }
+  }
+  
+  for (Index = 0; Index < Before->EntryCount; Index++) {
+    Old = &Before->Entries[Index];
+    if ((Old->Flags & VAR_ENTRY_SEEN) == 0) {
+      Print (L"  - %g  %s (%u bytes)\n", &Old->Guid, VarIndexEntryName (Before, Old), Old->DataSize);
+      Removed++;
+    }
+  }
+  
+  Print (L"  %u added, %u removed, %u changed\n", Added, Removed, Changed);
+  
+  return Added + Removed + Changed;
+}
+
+/**
+  Перезагружает систему с загрузкой через BOOTx64.efi.
+  Ожидает нажатия клавиши перед перезагрузкой.
+  
+  @param ForceWrite     Писать в NV хранилище даже при риске reclaim
+  
+  @retval EFI_SUCCESS   Команда перезагрузки отправлена
+  @retval другое        Ошибка при отправке команды перезагрузки
+**/
+EFI_STATUS
+RebootToBoot (
+  IN BOOLEAN  ForceWrite
+  )
+{
+  EFI_STATUS  Status;
+  EFI_GUID    BootGuid = EFI_GLOBAL_VARIABLE;
+  CHAR16      *BootFileName = L"\\EFI\\BOOT\\BOOTx64.EFI";
+  CHAR16      *BootOptionName = L"SNSniffReboot";
+  UINT16      BootOrder = 0;
+  EFI_INPUT_KEY Key;
+  
+  // Две NV записи: загрузочный вариант и порядок загрузки
+  Status = CheckNvWriteBudget (
+             StrSize (BootOptionName) + StrSize (BootFileName) + StrSize (L"BootOrder") + sizeof (UINT16) +
+             2 * NV_VARIABLE_HEADER_OVERHEAD,
+             L"boot option update",
+             ForceWrite
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  // Устанавливаем загрузочный вариант
+  Status = gRT->SetVariable (
+                  BootOptionName,
+                  &BootGuid,
+                  EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
+                  StrSize (BootFileName),
+                  BootFileName
+                  );
+                  
+  if (EFI_ERROR (Status)) {
+    Print (L"Error: Failed to set boot option\n");
+    return Status;
+  }
+  
+  // Устанавливаем порядок загрузки
+  Status = gRT->SetVariable (
+                  L"BootOrder",
+                  &BootGuid,
+                  EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
+                  sizeof (UINT16),
+                  &BootOrder
+                  );
+                  
+  if (EFI_ERROR (Status)) {
+    Print (L"Error: Failed to set boot order\n");
+    return Status;
+  }
+  
+  // Ждем нажатия клавиши перед перезагрузкой
+  Print (L"Press any key to reboot to BOOTx64.efi...\n");
+  gBS->WaitForEvent (1, &gST->ConIn->WaitForKey, NULL);
+  gST->ConIn->ReadKeyStroke (gST->ConIn, &Key);
+  
+  // ResetSystem не возвращает управление, поэтому статистику реестра сохраняем до него
+  SaveGuidRegistryStats ();
+  
+  // Перезагружаем систему
+  Print (L"Rebooting system to BOOTx64.efi...\n");
+  gRT->ResetSystem (EfiResetWarm, EFI_SUCCESS, 0, NULL);
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Запускает внешнюю EFI программу через прямую командную строку.
+  
+  @param AmideEfiPath   Путь к AMIDEEFIx64.efi
+  @param SerialNumber   Серийный номер для прошивки
+  
+  @retval EFI_SUCCESS   Программа успешно выполнена
+  @retval другое        Ошибка при запуске программы или её код завершения
+**/
+EFI_STATUS
+RunAmideefi (
+  IN CONST CHAR16    *AmideEfiPath,
+  IN CONST CHAR16    *SerialNumber
+  )
+{
+  CHAR16 CommandLine[MAX_BUFFER_SIZE];
+  EFI_STATUS Status;
+  EFI_STATUS CommandStatus;
+  
+  // Проверяем существование файла
+  if (ShellIsFile((CHAR16*)AmideEfiPath) != EFI_SUCCESS) {
+    Print(L"Error: AMIDEEFIx64.efi not found at '%s'\n", AmideEfiPath);
+    return EFI_NOT_FOUND;
+  }
+  
+  // Формируем командную строку со всеми необходимыми параметрами
+  ZeroMem(CommandLine, sizeof(CommandLine));
+  UnicodeSPrint(CommandLine, sizeof(CommandLine), 
+                L"%s /SS %s /BS %s", 
+                AmideEfiPath, SerialNumber, SerialNumber);
+  
+  Print(L"Executing: %s\n", CommandLine);
+  
+  // Запускаем как отдельную команду через Shell
+  Status = ShellExecute(&gImageHandle, CommandLine, TRUE, NULL, &CommandStatus);
+  
+  // Утилита могла изменить NV хранилище, индекс больше не актуален
+  // (SMBIOS сбрасывает вызывающий через VerifyContextInvalidate)
+  InvalidateVariableIndex ();
+  
+  if (EFI_ERROR(Status)) {
+    Print(L"Error: Failed to execute AMIDEEFIx64.efi: %r\n", Status);
+  } else if (EFI_ERROR(CommandStatus)) {
+    // Утилита запустилась, но прошивка не удалась: проверять нечего
+    Print(L"Error: AMIDEEFIx64.efi failed: %r\n", CommandStatus);
+    Status = CommandStatus;
+  } else {
+    Print(L"AMIDEEFIx64.efi executed successfully\n");
+  }
+  
+  return Status;
+}
+
+/**
+  Проверяет, есть ли в строке вывода утилиты метка поля. Регистр и пробелы
+  не учитываются: "Base Board Serial" совпадает с "Baseboard Serial".
+  
+  @param Line     Строка вывода
+  @param Label    Метка поля
+  
+  @retval TRUE    Метка найдена
+  @retval FALSE   Метки в строке нет
+**/
+BOOLEAN
+OutputLineHasLabel (
+  IN CONST CHAR16  *Line,
+  IN CONST CHAR16  *Label
+  )
+{
+  CONST CHAR16  *Start;
+  CONST CHAR16  *Text;
+  CONST CHAR16  *Pattern;
+  
+  for (Start = Line; *Start != L'\0'; Start++) {
+    Text    = Start;
+    Pattern = Label;
+    while (*Pattern != L'\0') {
+      if (*Pattern == L' ') {
+        Pattern++;
+        continue;
+      }
+      while (*Text == L' ') {
+        Text++;
+      }
+      if (CharToUpper (*Text) != CharToUpper (*Pattern)) {
+        break;
+      }
+      Text++;
+      Pattern++;
+    }
+    if (*Pattern == L'\0') {
+      return TRUE;
+    }
+  }
+  
+  return FALSE;
+}
+
+/**
+  Читает текущее значение поля DMI через AMIDEEFI (опция без значения выводит
+  значение из постоянного хранилища DMI, а не из таблицы SMBIOS в памяти).
+  Вывод утилиты перенаправляется в файл в каталоге утилиты (текущий каталог
+  может быть только для чтения) и разбирается: значением считается последняя
+  строка в кавычках в строке вывода с опцией или меткой поля. Строки баннера
+  и сообщений об ошибках не рассматриваются.
+  
+  @param AmideEfiPath   Путь к AMIDEEFIx64.efi
+  @param Option         Опция AMIDEEFI (например, L"/SS")
+  @param Label          Метка поля в выводе утилиты (например, L"System Serial")
+  @param Value          Буфер для значения
+  @param ValueSize      Размер буфера в символах
+  
+  @retval EFI_SUCCESS   Значение прочитано
+  @retval EFI_NOT_FOUND Утилита не найдена или значение не найдено в выводе
+  @retval другое        Ошибка запуска утилиты, её код завершения или ошибка чтения вывода
+**/
+EFI_STATUS
+ReadAmideefiString (
+  IN  CONST CHAR16  *AmideEfiPath,
+  IN  CONST CHAR16  *Option,
+  IN  CONST CHAR16  *Label,
+  OUT CHAR16        *Value,
+  IN  UINTN         ValueSize
+  )
+{
+  EFI_STATUS         Status;
+  EFI_STATUS         CommandStatus;
+  CHAR16             CommandLine[MAX_BUFFER_SIZE];
+  CHAR16             ReadbackPath[MAX_BUFFER_SIZE];
+  UINTN              DirLength;
+  SHELL_FILE_HANDLE  FileHandle;
+  CHAR16             *Line;
+  CHAR16             *Open;
+  CHAR16             *Close;
+  BOOLEAN            Ascii;
+  BOOLEAN            Found;
+  
+  Value[0] = L'\0';
+  
+  if (ShellIsFile ((CHAR16 *)AmideEfiPath) != EFI_SUCCESS) {
+    return EFI_NOT_FOUND;
+  }
+  
+  // Файл вывода кладём в каталог утилиты, а не в текущий каталог
+  DirLength = StrLen (AmideEfiPath);
+  while (DirLength > 0 &&
+         AmideEfiPath[DirLength - 1] != L'\\' &&
+         AmideEfiPath[DirLength - 1] != L'/' &&
+         AmideEfiPath[DirLength - 1] != L':') {
+    DirLength--;
+  }
+  if (DirLength + StrLen (AMIDEEFI_READBACK_FILE) >= MAX_BUFFER_SIZE) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  CopyMem (ReadbackPath, AmideEfiPath, DirLength * sizeof (CHAR16));
+  StrCpyS (&ReadbackPath[DirLength], MAX_BUFFER_SIZE - DirLength, AMIDEEFI_READBACK_FILE);
+  
+  // Вывод утилиты перенаправляем в файл в ASCII
+  UnicodeSPrint (
+    CommandLine,
+    sizeof (CommandLine),
+    L"%s %s >a %s",
+    AmideEfiPath,
+    Option,
+    ReadbackPath
+    );
+  
+  Status = ShellExecute (&gImageHandle, CommandLine, FALSE, NULL, &CommandStatus);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  Status = ShellOpenFileByName (ReadbackPath, &FileHandle, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0);
+  if (EFI_ERROR (Status)) {
+    return EFI_ERROR (CommandStatus) ? CommandStatus : Status;
+  }
+  
+  // Утилита завершилась с ошибкой: её вывод - не значение поля
+  if (EFI_ERROR (CommandStatus)) {
+    ShellDeleteFile (&FileHandle);
+    return CommandStatus;
+  }
+  
+  Found = FALSE;
+  while (!ShellFileHandleEof (FileHandle)) {
+    Line = ShellFileHandleReadLine (FileHandle, &Ascii);
+    if (Line == NULL) {
+      break;
+    }
+    
+    // Значение берётся только из строки запрошенного поля
+    if (StrStr (Line, Option) == NULL && !OutputLineHasLabel (Line, Label)) {
+      FreePool (Line);
+      continue;
+    }
+    
+    // Берём последнюю строку в кавычках: AMIDEEFI печатает значение в конце строки
+    Close = Line + StrLen (Line);
+    while (Close > Line && *Close != L'"') {
+      Close--;
+    }
+    Open = Close;
+    while (Open > Line && *(Open - 1) != L'"') {
+      Open--;
+    }
+    if (Open > Line && Close > Line) {
+      *Close = L'\0';
+      StrnCpyS (Value, ValueSize, Open, MIN ((UINTN)(Close - Open), ValueSize - 1));
+      Found = TRUE;
+    }
+    
+    FreePool (Line);
+  }
+  
+  // Временный файл больше не нужен
+  ShellDeleteFile (&FileHandle);
+  
+  return Found ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
+
+/**
+  Освобождает индекс SMBIOS. Указатели на записи после этого недействительны.
+**/
+VOID
+FreeSmbiosIndex (
+  VOID
+  )
+{
+  if (mSmbiosIndex.Records != NULL) {
+    FreePool (mSmbiosIndex.Records);
+  }
+  if (mSmbiosIndex.Strings != NULL) {
+    FreePool (mSmbiosIndex.Strings);
+  }
+  ZeroMem (&mSmbiosIndex, sizeof (SMBIOS_INDEX));
+}
+
+/**
+  Помечает индекс SMBIOS как устаревший (например, после прошивки SMBIOS данных).
+  Следующее обращение заново обойдёт таблицу.
+**/
+VOID
+InvalidateSmbiosIndex (
+  VOID
+  )
+{
+  FreeSmbiosIndex ();
+}
+
+/**
+  Добавляет запись в список обхода SMBIOS.
+  
+  @param Walk       Указатель на массив записей
+  @param Count      Указатель на количество записей
+  @param Capacity   Указатель на ёмкость массива
+  @param Header     Начало записи
+  @param Size       Размер записи со строками и двойным NUL
+  
+  @retval EFI_SUCCESS           Запись добавлена
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+**/
+EFI_STATUS
+SmbiosWalkAppend (
+  IN OUT SMBIOS_RECORD            **Walk,
+  IN OUT UINTN                    *Count,
+  IN OUT UINTN                    *Capacity,
+  IN     EFI_SMBIOS_TABLE_HEADER  *Header,
+  IN     UINTN                    Size
+  )
+{
+  SMBIOS_RECORD  *NewWalk;
+  
+  if (*Count == *Capacity) {
+    NewWalk = ReallocatePool (
+                *Capacity * sizeof (SMBIOS_RECORD),
+                (*Capacity + 64) * sizeof (SMBIOS_RECORD),
+                *Walk
+                );
+    if (NewWalk == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    *Walk = NewWalk;
+    *Capacity += 64;
+  }
+  
+  ZeroMem (&(*Walk)[*Count], sizeof (SMBIOS_RECORD));
+  (*Walk)[*Count].Header = Header;
+  (*Walk)[*Count].Size = Size;
+  (*Count)++;
+  return EFI_SUCCESS;
+}
+
+/**
+  Находит конец записи SMBIOS (двойной NUL после строк), не выходя за MaxSize.
+  
+  @param Header   Начало записи
+  @param MaxSize  Максимально допустимый размер записи
+  @param Size     Указатель на размер записи со строками и двойным NUL
+  
+  @retval TRUE    Конец записи найден в пределах MaxSize
+  @retval FALSE   Запись повреждена или выходит за границу
+**/
+BOOLEAN
+SmbiosMeasureRecord (
+  IN  CONST EFI_SMBIOS_TABLE_HEADER  *Header,
+  IN  UINTN                          MaxSize,
+  OUT UINTN                          *Size
+  )
+{
+  CONST UINT8  *Bytes;
+  UINTN        End;
+  
+  if (MaxSize < sizeof (EFI_SMBIOS_TABLE_HEADER) ||
+      Header->Length < sizeof (EFI_SMBIOS_TABLE_HEADER) ||
+      Header->Length > MaxSize) {
+    return FALSE;
+  }
+  
+  Bytes = (CONST UINT8 *)Header;
+  End = Header->Length;
+  while (End + 1 < MaxSize && (Bytes[End] != 0 || Bytes[End + 1] != 0)) {
+    End++;
+  }
+  if (End + 1 >= MaxSize) {
+    return FALSE;
+  }
+  
+  *Size = End + 2;
+  return TRUE;
+}
+
+/**
+  Разбирает строковую часть записи в таблицу смещений и длин. Строки не
+  копируются; разбор ограничен фактическим концом записи.
+  
+  @param Record   Запись (заполняются FirstString и StringCount)
+  
+  @retval EFI_SUCCESS           Строки разобраны
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+**/
+EFI_STATUS
+SmbiosIndexStrings (
+  IN OUT SMBIOS_RECORD  *Record
+  )
+{
+  CONST UINT8          *Bytes;
+  UINTN                Offset;
+  UINTN                Start;
+  UINTN                StringsEnd;
+  SMBIOS_STRING_ENTRY  *NewStrings;
+  
+  Bytes = (CONST UINT8 *)Record->Header;
+  Record->FirstString = (UINT32)mSmbiosIndex.StringCount;
+  Record->StringCount = 0;
+  
+  // Последние два байта записи - завершающий двойной NUL
+  StringsEnd = Record->Size - 1;
+  Offset = Record->Header->Length;
+  
+  // Запись без строк содержит только двойной NUL
+  if (Bytes[Offset] == 0) {
+    return EFI_SUCCESS;
+  }
+  
+  // Номера строк в записях - UINT8, строки после 255-й недоступны
+  while (Offset < StringsEnd && Record->StringCount < MAX_UINT8) {
+    Start = Offset;
+    while (Offset < StringsEnd && Bytes[Offset] != 0) {
+      Offset++;
+    }
+    
+    if (mSmbiosIndex.StringCount == mSmbiosIndex.StringCapacity) {
+      NewStrings = ReallocatePool (
+                     mSmbiosIndex.StringCapacity * sizeof (SMBIOS_STRING_ENTRY),
+                     (mSmbiosIndex.StringCapacity + 256) * sizeof (SMBIOS_STRING_ENTRY),
+                     mSmbiosIndex.Strings
+                     );
+      if (NewStrings == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+      }
+      mSmbiosIndex.Strings = NewStrings;
+      mSmbiosIndex.StringCapacity += 256;
+    }
+    
+    mSmbiosIndex.Strings[mSmbiosIndex.StringCount].Offset = (UINT32)Start;
+    mSmbiosIndex.Strings[mSmbiosIndex.StringCount].Length = (UINT32)(Offset - Start);
+    mSmbiosIndex.StringCount++;
+    Record->StringCount++;
+    
+    // Пропускаем NUL текущей строки; NUL на месте следующей строки - конец набора
+    Offset++;
+    if (Offset >= StringsEnd || Bytes[Offset] == 0) {
+      break;
+    }
+  }
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Проверяет контрольную сумму точки входа SMBIOS (сумма байт равна нулю).
+  
+  @param Data     Начало области
+  @param Length   Длина области
+  
+  @retval TRUE    Контрольная сумма верна
+**/
+BOOLEAN
+SmbiosChecksumValid (
+  IN CONST UINT8  *Data,
+  IN UINTN        Length
+  )
+{
+  UINT8  Sum;
+  UINTN  Index;
+  
+  Sum = 0;
+  for (Index = 0; Index < Length; Index++) {
+    Sum = (UINT8)(Sum + Data[Index]);
+  }
+  
+  return (BOOLEAN)(Sum == 0);
+}
+
+/**
+  Находит таблицу структур SMBIOS через точку входа в gST->ConfigurationTable.
+  Точка входа SMBIOS 3.x предпочтительнее 2.x; обе проверяются по сигнатуре и
+  контрольной сумме.
+  
+  @param Table    Указатель на начало таблицы структур
+  @param Size     Указатель на размер таблицы (для 3.x - максимальный)
+  @param Source   Указатель на описание найденной точки входа
+  
+  @retval EFI_SUCCESS     Таблица найдена
+  @retval EFI_NOT_FOUND   Корректной точки входа нет
+**/
+EFI_STATUS
+LocateSmbiosTable (
+  OUT UINT8          **Table,
+  OUT UINTN          *Size,
+  OUT CONST CHAR16   **Source
+  )
+{
+  UINTN                         Index;
+  SMBIOS_TABLE_3_0_ENTRY_POINT  *Entry3;
+  SMBIOS_TABLE_ENTRY_POINT      *Entry2;
+  
+  for (Index = 0; Index < gST->NumberOfTableEntries; Index++) {
+    if (!CompareGuid (&gST->ConfigurationTable[Index].VendorGuid, &gEfiSmbios3TableGuid)) {
+      continue;
+    }
+    Entry3 = (SMBIOS_TABLE_3_0_ENTRY_POINT *)gST->ConfigurationTable[Index].VendorTable;
+    if (Entry3 == NULL ||
+        CompareMem (Entry3->AnchorString, "_SM3_", 5) != 0 ||
+        Entry3->EntryPointLength < sizeof (SMBIOS_TABLE_3_0_ENTRY_POINT) ||
+        !SmbiosChecksumValid ((UINT8 *)Entry3, Entry3->EntryPointLength) ||
+        Entry3->TableAddress == 0 ||
+        Entry3->TableMaximumSize == 0 ||
+        Entry3->TableAddress > MAX_ADDRESS - Entry3->TableMaximumSize) {
+      break;
+    }
+    *Table = (UINT8 *)(UINTN)Entry3->TableAddress;
+    *Size = Entry3->TableMaximumSize;
+    *Source = L"SMBIOS 3.x entry point";
+    return EFI_SUCCESS;
+  }
+  
+  for (Index = 0; Index < gST->NumberOfTableEntries; Index++) {
+    if (!CompareGuid (&gST->ConfigurationTable[Index].VendorGuid, &gEfiSmbiosTableGuid)) {
+      continue;
+    }
+    Entry2 = (SMBIOS_TABLE_ENTRY_POINT *)gST->ConfigurationTable[Index].VendorTable;
+    if (Entry2 == NULL ||
+        CompareMem (Entry2->AnchorString, "_SM_", 4) != 0 ||
+        Entry2->EntryPointLength < 0x1E ||
+        !SmbiosChecksumValid ((UINT8 *)Entry2, Entry2->EntryPointLength) ||
+        CompareMem (Entry2->IntermediateAnchorString, "_DMI_", 5) != 0 ||
+        !SmbiosChecksumValid (Entry2->IntermediateAnchorString, 0x0F) ||
+        Entry2->TableAddress == 0 ||
+        Entry2->TableLength == 0) {
+      break;
+    }
+    *Table = (UINT8 *)(UINTN)Entry2->TableAddress;
+    *Size = Entry2->TableLength;
+    *Source = L"SMBIOS 2.x entry point";
+    return EFI_SUCCESS;
+  }
+  
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Разбирает таблицу структур SMBIOS на месте, без копирования и без вызовов
+  протокола. Каждая запись проверяется на выход за границы таблицы; разбор
+  заканчивается на записи Type 127 или в конце таблицы. Повреждённая запись
+  в любом месте делает таблицу непригодной: записи Type 1/2 после неё были бы
+  молча потеряны.
+  
+  @param Table      Начало таблицы структур
+  @param Size       Размер таблицы
+  @param Walk       Указатель на массив записей
+  @param Count      Указатель на количество записей
+  @param Capacity   Указатель на ёмкость массива
+  
+  @retval EFI_SUCCESS           Таблица разобрана целиком
+  @retval EFI_VOLUME_CORRUPTED  Таблица пуста или в ней есть повреждённая запись
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+**/
+EFI_STATUS
+SmbiosCollectFromTable (
+  IN     UINT8                    *Table,
+  IN     UINTN                    Size,
+  IN OUT SMBIOS_RECORD            **Walk,
+  IN OUT UINTN                    *Count,
+  IN OUT UINTN                    *Capacity
+  )
+{
+  EFI_STATUS               Status;
+  EFI_SMBIOS_TABLE_HEADER  *Record;
+  UINTN                    Offset;
+  UINTN                    RecordSize;
+  
+  Offset = 0;
+  while (Size - Offset >= sizeof (EFI_SMBIOS_TABLE_HEADER)) {
+    Record = (EFI_SMBIOS_TABLE_HEADER *)(Table + Offset);
+    
+    // Запись вместе со строками и двойным NUL должна уместиться в таблицу
+    if (!SmbiosMeasureRecord (Record, Size - Offset, &RecordSize)) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+    
+    Status = SmbiosWalkAppend (Walk, Count, Capacity, Record, RecordSize);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    
+    if (Record->Type == SMBIOS_TYPE_END_OF_TABLE) {
+      break;
+    }
+    Offset += RecordSize;
+  }
+  
+  return (*Count > 0) ? EFI_SUCCESS : EFI_VOLUME_CORRUPTED;
+}
+
+/**
+  Собирает записи SMBIOS через EFI_SMBIOS_PROTOCOL.GetNext.
+  
+  @param Walk       Указатель на массив записей
+  @param Count      Указатель на количество записей
+  @param Capacity   Указатель на ёмкость массива
+  
+  @retval EFI_SUCCESS           Записи собраны
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+  @retval другое                SMBIOS протокол недоступен
+**/
+EFI_STATUS
+SmbiosCollectFromProtocol (
+  IN OUT SMBIOS_RECORD            **Walk,
+  IN OUT UINTN                    *Count,
+  IN OUT UINTN                    *Capacity
+  )
+{
+  EFI_STATUS               Status;
+  EFI_SMBIOS_PROTOCOL      *Smbios;
+  EFI_SMBIOS_HANDLE        SmbiosHandle;
+  EFI_SMBIOS_TABLE_HEADER  *Record;
+  UINTN                    RecordSize;
+  
+  // Получаем доступ к SMBIOS протоколу
+  Status = gBS->LocateProtocol (
+                &gEfiSmbiosProtocolGuid,
+                NULL,
+                (VOID **)&Smbios
+                );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  SmbiosHandle = SMBIOS_HANDLE_PI_RESERVED;
+  while (!EFI_ERROR (Smbios->GetNext (Smbios, &SmbiosHandle, NULL, &Record, NULL))) {
+    // Протокол не сообщает размер записи; повреждённые записи пропускаем
+    if (!SmbiosMeasureRecord (Record, SMBIOS_RECORD_MAX_SIZE, &RecordSize)) {
+      continue;
+    }
+    Status = SmbiosWalkAppend (Walk, Count, Capacity, Record, RecordSize);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Обходит таблицу SMBIOS один раз и строит индекс "тип -> список записей".
+  Основной источник - таблица из gST->ConfigurationTable, разбираемая на месте;
+  если её нет или в ней есть повреждённая запись, используется EFI_SMBIOS_PROTOCOL.
+  
+  @retval EFI_SUCCESS           Индекс построен
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+  @retval другое                SMBIOS недоступен
+**/
+EFI_STATUS
+BuildSmbiosIndex (
+  VOID
+  )
+{
+  EFI_STATUS               Status;
+  SMBIOS_RECORD            *Walk;
+  UINTN                    WalkCount;
+  UINTN                    WalkCapacity;
+  UINT8                    *Table;
+  UINTN                    TableSize;
+  CONST CHAR16             *Source;
+  UINT32                   Fill[SMBIOS_TYPE_COUNT];
+  UINTN                    Index;
+  
+  FreeSmbiosIndex ();
+  
+  Walk = NULL;
+  WalkCount = 0;
+  WalkCapacity = 0;
+  
+  Status = LocateSmbiosTable (&Table, &TableSize, &Source);
+  if (!EFI_ERROR (Status)) {
+    Status = SmbiosCollectFromTable (Table, TableSize, &Walk, &WalkCount, &WalkCapacity);
+    if (EFI_ERROR (Status) && Status != EFI_OUT_OF_RESOURCES) {
+      Print (L"Warning: %s is damaged, falling back to SMBIOS protocol\n", Source);
+    }
+  }
+  
+  if (EFI_ERROR (Status) && Status != EFI_OUT_OF_RESOURCES) {
+    WalkCount = 0;
+    Source = L"SMBIOS protocol";
+    Status = SmbiosCollectFromProtocol (&Walk, &WalkCount, &WalkCapacity);
+    if (EFI_ERROR (Status) && Status != EFI_OUT_OF_RESOURCES) {
+      Print (L"Error: No SMBIOS entry point and failed to locate SMBIOS protocol: %r\n", Status);
+    }
+  }
+  
+  if (!EFI_ERROR (Status)) {
+    mSmbiosIndex.Records = AllocatePool (MAX (WalkCount, 1) * sizeof (SMBIOS_RECORD));
+    if (mSmbiosIndex.Records == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
+    }
+  }
+  
+  if (EFI_ERROR (Status)) {
+    if (Walk != NULL) {
+      FreePool (Walk);
+    }
+    return Status;
+  }
+  
+  // Группируем по типу подсчётом, сохраняя порядок записей внутри типа
+  for (Index = 0; Index < WalkCount; Index++) {
+    mSmbiosIndex.TypeStart[Walk[Index].Header->Type + 1]++;
+  }
+  for (Index = 0; Index < SMBIOS_TYPE_COUNT; Index++) {
+    mSmbiosIndex.TypeStart[Index + 1] += mSmbiosIndex.TypeStart[Index];
+    Fill[Index] = mSmbiosIndex.TypeStart[Index];
+  }
+  for (Index = 0; Index < WalkCount; Index++) {
+    CopyMem (&mSmbiosIndex.Records[Fill[Walk[Index].Header->Type]++], &Walk[Index], sizeof (SMBIOS_RECORD));
+  }
+  
+  if (Walk != NULL) {
+    FreePool (Walk);
+  }
+  
+  // Строки каждой записи разбираются один раз, дальше читаются по номеру без поиска
+  for (Index = 0; Index < WalkCount; Index++) {
+    Status = SmbiosIndexStrings (&mSmbiosIndex.Records[Index]);
+    if (EFI_ERROR (Status)) {
+      FreeSmbiosIndex ();
+      return Status;
+    }
+  }
+  
+  mSmbiosIndex.Count = WalkCount;
+  mSmbiosIndex.Source = Source;
+  mSmbiosIndex.Valid = TRUE;
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Находит запись SMBIOS по типу и порядковому номеру среди записей этого типа.
+  Таблица обходится только при первом обращении или после InvalidateSmbiosIndex.
+  
+  @param Type       Тип записи
+  @param Instance   Номер записи среди записей этого типа (с 0)
+  @param Record     Указатель на найденную запись
+  
+  @retval EFI_SUCCESS     Запись найдена
+  @retval EFI_NOT_FOUND   Записи такого типа с таким номером нет
+  @retval другое          Ошибка построения индекса
+**/
+EFI_STATUS
+SmbiosFindRecord (
+  IN  UINT8                Type,
+  IN  UINTN                Instance,
+  OUT CONST SMBIOS_RECORD  **Record
+  )
+{
+  EFI_STATUS  Status;
+  
+  *Record = NULL;
+  
+  if (!mSmbiosIndex.Valid) {
+    Status = BuildSmbiosIndex ();
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+  
+  if (Instance >= (UINTN)(mSmbiosIndex.TypeStart[Type + 1] - mSmbiosIndex.TypeStart[Type])) {
+    return EFI_NOT_FOUND;
+  }
+  
+  *Record = &mSmbiosIndex.Records[mSmbiosIndex.TypeStart[Type] + Instance];
+  return EFI_SUCCESS;
+}
+
+/**
+  Возвращает строку записи SMBIOS, на которую ссылается поле записи, без копирования.
+  Поле за пределами форматированной части записи (старые версии SMBIOS) считается
+  незаданным.
+  
+  @param Record       Запись
+  @param FieldOffset  Смещение поля с номером строки (OFFSET_OF)
+  @param View         Указатель на представление строки
+  
+  @retval EFI_SUCCESS     Строка найдена (может быть пустой)
+  @retval EFI_NOT_FOUND   Поле отсутствует, равно 0 или ссылается за пределы строк
+**/
+EFI_STATUS
+SmbiosGetString (
+  IN  CONST SMBIOS_RECORD  *Record,
+  IN  UINTN                FieldOffset,
+  OUT ASCII_VIEW           *View
+  )
+{
+  UINT8                      StringNumber;
+  CONST SMBIOS_STRING_ENTRY  *Entry;
+  
+  View->Text = NULL;
+  View->Length = 0;
+  
+  if (FieldOffset >= Record->Header->Length) {
+    return EFI_NOT_FOUND;
+  }
+  
+  StringNumber = ((CONST UINT8 *)Record->Header)[FieldOffset];
+  if (StringNumber == 0 || StringNumber > Record->StringCount) {
+    return EFI_NOT_FOUND;
+  }
+  
+  Entry = &mSmbiosIndex.Strings[Record->FirstString + StringNumber - 1];
+  View->Text = (CONST CHAR8 *)Record->Header + Entry->Offset;
+  View->Length = Entry->Length;
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Копирует строку SMBIOS в буфер UCS-2 (для сравнения с данными переменных).
+  Строки UTF-8 декодируются, прочие байты копируются как есть.
+  
+  @param View         Представление строки
+  @param Buffer       Буфер
+  @param BufferSize   Размер буфера в символах
+**/
+VOID
+AsciiViewToUnicode (
+  IN  CONST ASCII_VIEW  *View,
+  OUT CHAR16            *Buffer,
+  IN  UINTN             BufferSize
+  )
+{
+  TEXT_INFO  Info;
+  
+  TextClassify (View->Text, View->Length, &Info);
+  TextDecode (View->Text, &Info, Buffer, BufferSize);
+}
+
+/**
+  Выводит строковое поле записи SMBIOS в формате "Label: value".
+  
+  @param Label        Название поля
+  @param Record       Запись
+  @param FieldOffset  Смещение поля с номером строки (OFFSET_OF)
+**/
+VOID
+PrintSmbiosString (
+  IN CONST CHAR16         *Label,
+  IN CONST SMBIOS_RECORD  *Record,
+  IN UINTN                FieldOffset
+  )
+{
+  ASCII_VIEW  View;
+  
+  if (EFI_ERROR (SmbiosGetString (Record, FieldOffset, &View))) {
+    Print (L"%s: <Not Specified>\n", Label);
+  } else {
+    Print (L"%s: %.*a\n", Label, View.Length, View.Text);
+  }
+}
+
+/**
+  Читает поле фиксированной части записи SMBIOS с проверкой длины записи.
+  
+  @param Record       Запись
+  @param FieldOffset  Смещение поля (OFFSET_OF)
+  @param Size         Размер поля
+  @param Value        Буфер для значения
+  
+  @retval TRUE        Поле есть в записи
+  @retval FALSE       Запись короче (старая версия SMBIOS)
+**/
+BOOLEAN
+SmbiosReadField (
+  IN  CONST SMBIOS_RECORD  *Record,
+  IN  UINTN                FieldOffset,
+  IN  UINTN                Size,
+  OUT VOID                 *Value
+  )
+{
+  if (FieldOffset + Size > Record->Header->Length) {
+    return FALSE;
+  }
+  
+  CopyMem (Value, (CONST UINT8 *)Record->Header + FieldOffset, Size);
+  return TRUE;
+}
+
+/**
+  Возвращает название значения из таблицы или NULL, если значение вне таблицы.
+  
+  @param Names    Таблица названий
+  @param Count    Количество элементов таблицы
+  @param Value    Значение
+**/
+CONST CHAR8 *
+SmbiosEnumName (
+  IN CONST CHAR8  *CONST  *Names,
+  IN UINTN                Count,
+  IN UINTN                Value
+  )
+{
+  if (Value >= Count || Names[Value] == NULL) {
+    return NULL;
+  }
+  return Names[Value];
+}
+
+// Тип платы (Type 2)
+static CONST CHAR8 *CONST mSmbiosBoardTypes[] = {
+  NULL, "Unknown", "Other", "Server Blade", "Connectivity Switch",
+  "System Management Module", "Processor Module", "I/O Module", "Memory Module",
+  "Daughter Board", "Motherboard", "Processor/Memory Module", "Processor/IO Module",
+  "Interconnect Board"
+};
+
+// Тип шасси (Type 3)
+static CONST CHAR8 *CONST mSmbiosChassisTypes[] = {
+  NULL, "Other", "Unknown", "Desktop", "Low Profile Desktop", "Pizza Box",
+  "Mini Tower", "Tower", "Portable", "Laptop", "Notebook", "Hand Held",
+  "Docking Station", "All In One", "Sub Notebook", "Space-saving", "Lunch Box",
+  "Main Server Chassis", "Expansion Chassis", "Sub Chassis", "Bus Expansion Chassis",
+  "Peripheral Chassis", "RAID Chassis", "Rack Mount Chassis", "Sealed-case PC",
+  "Multi-system", "CompactPCI", "AdvancedTCA", "Blade", "Blade Enclosure",
+  "Tablet", "Convertible", "Detachable", "IoT Gateway", "Embedded PC", "Mini PC",
+  "Stick PC"
+};
+
+// Состояние шасси (Type 3)
+static CONST CHAR8 *CONST mSmbiosChassisStates[] = {
+  NULL, "Other", "Unknown", "Safe", "Warning", "Critical", "Non-recoverable"
+};
+
+// Тип процессора (Type 4)
+static CONST CHAR8 *CONST mSmbiosProcessorTypes[] = {
+  NULL, "Other", "Unknown", "Central Processor", "Math Processor", "DSP Processor",
+  "Video Processor"
+};
+
+// Состояние процессора (Type 4, биты 0-2 поля Status)
+static CONST CHAR8 *CONST mSmbiosProcessorStates[] = {
+  "Unknown", "Enabled", "Disabled By User", "Disabled By BIOS", "Idle", NULL,
+  NULL, "Other"
+};
+
+// Использование слота (Type 9)
+static CONST CHAR8 *CONST mSmbiosSlotUsage[] = {
+  NULL, "Other", "Unknown", "Available", "In Use", "Unavailable"
+};
+
+// Форм-фактор модуля памяти (Type 17)
+static CONST CHAR8 *CONST mSmbiosMemoryFormFactors[] = {
+  NULL, "Other", "Unknown", "SIMM", "SIP", "Chip", "DIP", "ZIP", "Proprietary Card",
+  "DIMM", "TSOP", "Row Of Chips", "RIMM", "SODIMM", "SRIMM", "FB-DIMM", "Die"
+};
+
+// Тип памяти (Type 17)
+static CONST CHAR8 *CONST mSmbiosMemoryTypes[] = {
+  NULL, "Other", "Unknown", "DRAM", "EDRAM", "VRAM", "SRAM", "RAM", "ROM", "Flash",
+  "EEPROM", "FEPROM", "EPROM", "CDRAM", "3DRAM", "SDRAM", "SGRAM", "RDRAM", "DDR",
+  "DDR2", "DDR2 FB-DIMM", NULL, NULL, NULL, "DDR3", "FBD2", "DDR4", "LPDDR",
+  "LPDDR2", "LPDDR3", "LPDDR4", "Logical non-volatile device", "HBM", "HBM2",
+  "DDR5", "LPDDR5"
+};
+
+/**
+  Возвращает количество записей SMBIOS заданного типа.
+  
+  @param Type   Тип записи
+  
+  @retval       Количество записей (0, если таблица SMBIOS недоступна)
+**/
+UINTN
+SmbiosRecordCount (
+  IN UINT8  Type
+  )
+{
+  if (!mSmbiosIndex.Valid && EFI_ERROR (BuildSmbiosIndex ())) {
+    return 0;
+  }
+  
+  return mSmbiosIndex.TypeStart[Type + 1] - mSmbiosIndex.TypeStart[Type];
+}
+
+/**
+  Собирает все платы (записи Type 2) за один проход по индексу SMBIOS и
+  определяет вложенность плат по спискам ContainedObjectHandles.
+  
+  @param Boards   Указатель на массив плат (освобождается вызывающим)
+  @param Count    Указатель на количество плат
+  
+  @retval EFI_SUCCESS           Платы собраны
+  @retval EFI_NOT_FOUND         Записей Type 2 нет
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+**/
+EFI_STATUS
+CollectBaseBoards (
+  OUT BASEBOARD_INSTANCE  **Boards,
+  OUT UINTN               *Count
+  )
+{
+  BASEBOARD_INSTANCE   *List;
+  CONST SMBIOS_RECORD  *Record;
+  UINTN                BoardCount;
+  UINTN                Index;
+  UINTN                Other;
+  UINTN                Contained;
+  UINT8                ContainedCount;
+  UINT16               Handle;
+  
+  *Boards = NULL;
+  *Count = 0;
+  
+  BoardCount = SmbiosRecordCount (SMBIOS_TYPE_BASEBOARD_INFORMATION);
+  if (BoardCount == 0) {
+    return EFI_NOT_FOUND;
+  }
+  
+  List = AllocateZeroPool (BoardCount * sizeof (BASEBOARD_INSTANCE));
+  if (List == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  
+  for (Index = 0; Index < BoardCount; Index++) {
+    SmbiosFindRecord (SMBIOS_TYPE_BASEBOARD_INFORMATION, Index, &Record);
+    List[Index].Record = Record;
+    List[Index].Handle = Record->Header->Handle;
+    List[Index].ParentHandle = SMBIOS_NO_PARENT;
+    SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, FeatureFlag), sizeof (UINT8), &List[Index].FeatureFlags);
+    SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, BoardType), sizeof (UINT8), &List[Index].BoardType);
+  }
+  
+  // Плата, указанная в ContainedObjectHandles другой платы (райзер, дочерняя плата), вложена в неё
+  for (Index = 0; Index < BoardCount; Index++) {
+    if (!SmbiosReadField (
+           List[Index].Record,
+           OFFSET_OF (SMBIOS_TABLE_TYPE2, NumberOfContainedObjectHandles),
+           sizeof (UINT8),
+           &ContainedCount
+           )) {
+      continue;
+    }
+    for (Contained = 0; Contained < ContainedCount; Contained++) {
+      if (!SmbiosReadField (
+             List[Index].Record,
+             OFFSET_OF (SMBIOS_TABLE_TYPE2, ContainedObjectHandles) + Contained * sizeof (UINT16),
+             sizeof (UINT16),
+             &Handle
+             )) {
+        break;
+      }
+      for (Other = 0; Other < BoardCount; Other++) {
+        if (Other != Index && List[Other].Handle == Handle) {
+          List[Other].ParentHandle = List[Index].Handle;
+        }
+      }
+    }
+  }
+  
+  *Boards = List;
+  *Count = BoardCount;
+  return EFI_SUCCESS;
+}
+
+/**
+  Сравнивает строку SMBIOS с текстом без учёта регистра.
+  
+  @param View   Строка записи
+  @param Text   Текст
+  
+  @retval TRUE  Строки совпадают
+  @retval FALSE Строки различаются
+**/
+BOOLEAN
+AsciiViewEqualsText (
+  IN CONST ASCII_VIEW  *View,
+  IN CONST CHAR16      *Text
+  )
+{
+  UINTN  Index;
+  
+  for (Index = 0; Index < View->Length; Index++) {
+    if (Text[Index] == L'\0' ||
+        CharToUpper ((CHAR16)(UINT8)View->Text[Index]) != CharToUpper (Text[Index])) {
+      return FALSE;
+    }
+  }
+  
+  return (Text[Index] == L'\0');
+}
+
+/**
+  Создаёт представление строки SMBIOS.
+  
+  @param Ascii  Строка записи SMBIOS
+  @param View   Представление строки
+**/
+VOID
+TextViewFromAscii (
+  IN  CONST ASCII_VIEW  *Ascii,
+  OUT TEXT_VIEW         *View
+  )
+{
+  View->Data   = Ascii->Text;
+  View->Length = Ascii->Length;
+  View->Wide   = FALSE;
+}
+
+/**
+  Создаёт представление строки UCS-2, завершённой NUL.
+  
+  @param Text   Строка
+  @param View   Представление строки
+**/
+VOID
+TextViewFromString (
+  IN  CONST CHAR16  *Text,
+  OUT TEXT_VIEW     *View
+  )
+{
+  View->Data   = Text;
+  View->Length = StrLen (Text);
+  View->Wide   = TRUE;
+}
+
+/**
+  Создаёт представление данных переменной как строки. Кодировка определяется
+  TextClassify; строка UTF-8 представляется байтами (серийные номера - ASCII),
+  двоичные данные - байтами до первого нуля.
+  
+  @param Data       Данные переменной
+  @param DataSize   Размер данных
+  @param View       Представление строки
+**/
+VOID
+TextViewFromData (
+  IN  CONST VOID  *Data,
+  IN  UINTN       DataSize,
+  OUT TEXT_VIEW   *View
+  )
+{
+  TEXT_INFO    Info;
+  CONST UINT8  *Bytes;
+  UINTN        Index;
+  
+  TextClassify (Data, DataSize, &Info);
+  Bytes = (CONST UINT8 *)Data + Info.Offset;
+  
+  View->Data   = Bytes;
+  View->Length = Info.Length;
+  View->Wide   = (Info.Encoding == TEXT_ENCODING_UCS2);
+  
+  if (Info.Encoding == TEXT_ENCODING_BINARY) {
+    for (Index = 0; Index < DataSize && Bytes[Index] != 0; Index++) {
+    }
+    View->Length = Index;
+  }
+}
+
+/**
+  Возвращает символ представления строки.
+  
+  @param View   Представление строки
+  @param Index  Номер символа (меньше View->Length)
+  
+  @return Символ строки
+**/
+CHAR16
+TextViewCharAt (
+  IN CONST TEXT_VIEW  *View,
+  IN UINTN            Index
+  )
+{
+  if (View->Wide) {
+    return ReadUnaligned16 ((CONST UINT16 *)((CONST UINT8 *)View->Data + Index * sizeof (CHAR16)));
+  }
+  
+  return (CHAR16)((CONST UINT8 *)View->Data)[Index];
+}
+
+// Значения-заглушки, которые прошивки оставляют в незаполненных строках SMBIOS
+static CONST CHAR8 *CONST mSnPlaceholders[] = {
+  "To Be Filled By O.E.M.",
+  "Default string",
+  "Not Specified",
+  "Not Applicable",
+  "System Serial Number",
+  "Base Board Serial Number",
+  "Chassis Serial Number",
+  "0123456789",
+  "None",
+  "N/A"
+};
+
+// Правила сравнения серийных номеров на время запуска
+static SN_MATCH_RULES mSnMatchRules = { SN_MATCH_DEFAULT, SN_MATCH_DEFAULT_PAD };
+
+/**
+  Выделяет значимую часть серийного номера по правилам сравнения: отбрасывает
+  пробелы по краям, символы заполнения в конце и заглушки. Данные не копируются,
+  результат указывает внутрь исходной строки.
+  
+  @param View         Исходная строка
+  @param Rules        Правила сравнения
+  @param Core         Значимая часть строки
+  
+  @retval TRUE        Строка - заглушка (Core пустая)
+  @retval FALSE       Строка не заглушка
+**/
+BOOLEAN
+SnNormalize (
+  IN  CONST TEXT_VIEW       *View,
+  IN  CONST SN_MATCH_RULES  *Rules,
+  OUT TEXT_VIEW             *Core
+  )
+{
+  UINTN   Start;
+  UINTN   End;
+  UINTN   Index;
+  UINTN   Length;
+  CHAR16  Char;
+  
+  Start = 0;
+  End   = View->Length;
+  
+  // Заполнение стоит после значения, пробелы могут стоять и между ними
+  while (End > Start) {
+    Char = TextViewCharAt (View, End - 1);
+    if ((Rules->Rules & SN_MATCH_STRIP_PAD) != 0 && Char == Rules->PadChar) {
+      End--;
+    } else if ((Rules->Rules & SN_MATCH_TRIM) != 0 && (Char == L' ' || Char == L'\t')) {
+      End--;
+    } else {
+      break;
+    }
+  }
+  
+  if ((Rules->Rules & SN_MATCH_TRIM) != 0) {
+    while (Start < End) {
+      Char = TextViewCharAt (View, Start);
+      if (Char != L' ' && Char != L'\t') {
+        break;
+      }
+      Start++;
+    }
+  }
+  
+  Core->Data   = (CONST UINT8 *)View->Data + Start * (View->Wide ? sizeof (CHAR16) : sizeof (CHAR8));
+  Core->Length = End - Start;
+  Core->Wide   = View->Wide;
+  
+  if ((Rules->Rules & SN_MATCH_PLACEHOLDER) == 0) {
+    return FALSE;
+  }
+  
+  // Заглушки сравниваются всегда без учёта регистра
+  for (Index = 0; Index < ARRAY_SIZE (mSnPlaceholders); Index++) {
+    Length = AsciiStrLen (mSnPlaceholders[Index]);
+    if (Length != Core->Length) {
+      continue;
+    }
+    while (Length > 0 &&
+           CharToUpper (TextViewCharAt (Core, Length - 1)) == CharToUpper ((CHAR16)mSnPlaceholders[Index][Length - 1])) {
+      Length--;
+    }
+    if (Length == 0) {
+      Core->Length = 0;
+      return TRUE;
+    }
+  }
+  
+  return FALSE;
+}
+
+/**
+  Сравнивает две нормализованные строки посимвольно.
+  
+  @param First      Первая строка
+  @param Second     Вторая строка
+  @param CaseFold   TRUE - без учёта регистра
+  
+  @retval TRUE      Строки совпадают
+  @retval FALSE     Строки различаются
+**/
+BOOLEAN
+TextViewCoresEqual (
+  IN CONST TEXT_VIEW  *First,
+  IN CONST TEXT_VIEW  *Second,
+  IN BOOLEAN          CaseFold
+  )
+{
+  UINTN   Index;
+  CHAR16  FirstChar;
+  CHAR16  SecondChar;
+  
+  if (First->Length != Second->Length) {
+    return FALSE;
+  }
+  
+  for (Index = 0; Index < First->Length; Index++) {
+    FirstChar  = TextViewCharAt (First, Index);
+    SecondChar = TextViewCharAt (Second, Index);
+    if (CaseFold) {
+      FirstChar  = CharToUpper (FirstChar);
+      SecondChar = CharToUpper (SecondChar);
+    }
+    if (FirstChar != SecondChar) {
+      return FALSE;
+    }
+  }
+  
+  return TRUE;
+}
+
+/**
+  Сравнивает серийные номера по правилам сравнения запуска (mSnMatchRules).
+  Строки могут быть в разных кодировках, данные не копируются. Пустое после
+  нормализации значение или заглушка не совпадает ни с чем: иначе стёртая
+  (0xFF) переменная совпала бы с пустым серийным номером в SMBIOS.
+  
+  @param First    Первая строка
+  @param Second   Вторая строка
+  
+  @retval TRUE    Серийные номера совпадают
+  @retval FALSE   Серийные номера различаются, пусты или являются заглушкой
+**/
+BOOLEAN
+SnEquals (
+  IN CONST TEXT_VIEW  *First,
+  IN CONST TEXT_VIEW  *Second
+  )
+{
+  TEXT_VIEW  FirstCore;
+  TEXT_VIEW  SecondCore;
+  
+  if (SnNormalize (First, &mSnMatchRules, &FirstCore) ||
+      SnNormalize (Second, &mSnMatchRules, &SecondCore)) {
+    return FALSE;
+  }
+  
+  if (FirstCore.Length == 0) {
+    return FALSE;
+  }
+  
+  return TextViewCoresEqual (&FirstCore, &SecondCore, (mSnMatchRules.Rules & SN_MATCH_CASE_FOLD) != 0);
+}
+
+/**
+  Сравнивает строковые поля SMBIOS без учёта пробелов по краям. В отличие от
+  SnEquals пустые значения и заглушки ("Default string") сравниваются как есть:
+  у производителя, модели или метки они допустимы.
+  
+  @param First    Первая строка
+  @param Second   Вторая строка
+  
+  @retval TRUE    Строки совпадают
+  @retval FALSE   Строки различаются
+**/
+BOOLEAN
+TextEqualsTrimmed (
+  IN CONST TEXT_VIEW  *First,
+  IN CONST TEXT_VIEW  *Second
+  )
+{
+  STATIC CONST SN_MATCH_RULES  TrimRules = { SN_MATCH_TRIM, 0 };
+  TEXT_VIEW                    FirstCore;
+  TEXT_VIEW                    SecondCore;
+  
+  SnNormalize (First, &TrimRules, &FirstCore);
+  SnNormalize (Second, &TrimRules, &SecondCore);
+  return TextViewCoresEqual (&FirstCore, &SecondCore, FALSE);
+}
+
+/**
+  Копирует значимую часть серийного номера в строку для прошивки: отбрасываются
+  пробелы и символы заполнения по правилам запуска, регистр сохраняется.
+  
+  @param View         Исходная строка
+  @param Buffer       Буфер строки
+  @param BufferSize   Размер буфера в символах
+**/
+VOID
+SnCopyForFlash (
+  IN  CONST TEXT_VIEW  *View,
+  OUT CHAR16           *Buffer,
+  IN  UINTN            BufferSize
+  )
+{
+  SN_MATCH_RULES  Rules;
+  TEXT_VIEW       Core;
+  UINTN           Index;
+  
+  Rules.Rules   = mSnMatchRules.Rules & (SN_MATCH_TRIM | SN_MATCH_STRIP_PAD);
+  Rules.PadChar = mSnMatchRules.PadChar;
+  SnNormalize (View, &Rules, &Core);
+  
+  for (Index = 0; Index < Core.Length && Index + 1 < BufferSize; Index++) {
+    Buffer[Index] = TextViewCharAt (&Core, Index);
+  }
+  Buffer[Index] = L'\0';
+}
+
+/**
+  Разбирает список правил сравнения серийных номеров (--sn-match):
+  exact или перечисление trim, nocase, pad, placeholder через запятую.
+  
+  @param Spec   Список правил
+  @param Rules  Набор флагов SN_MATCH_*
+  
+  @retval EFI_SUCCESS           Список разобран
+  @retval EFI_INVALID_PARAMETER Неизвестное правило
+**/
+EFI_STATUS
+ParseSnMatchRules (
+  IN  CONST CHAR16  *Spec,
+  OUT UINT32        *Rules
+  )
+{
+  CHAR16        Name[16];
+  CONST CHAR16  *End;
+  UINTN         Length;
+  
+  *Rules = 0;
+  
+  while (*Spec != L'\0') {
+    End = Spec;
+    while (*End != L'\0' && *End != L',') {
+      End++;
+    }
+    Length = (UINTN)(End - Spec);
+    if (Length >= ARRAY_SIZE (Name)) {
+      return EFI_INVALID_PARAMETER;
+    }
+    CopyMem (Name, Spec, Length * sizeof (CHAR16));
+    Name[Length] = L'\0';
+    
+    if (StrCmp (Name, L"exact") == 0) {
+      // Точное сравнение: правила не добавляются
+    } else if (StrCmp (Name, L"trim") == 0) {
+      *Rules |= SN_MATCH_TRIM;
+    } else if (StrCmp (Name, L"nocase") == 0) {
+      *Rules |= SN_MATCH_CASE_FOLD;
+    } else if (StrCmp (Name, L"pad") == 0) {
+      *Rules |= SN_MATCH_STRIP_PAD;
+    } else if (StrCmp (Name, L"placeholder") == 0) {
+      *Rules |= SN_MATCH_PLACEHOLDER;
+    } else {
+      Print (L"Error: Unknown SN match rule '%s'\n", Name);
+      return EFI_INVALID_PARAMETER;
+    }
+    
+    Spec = (*End == L',') ? End + 1 : End;
+  }
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Определяет, сверяется ли серийный номер платы с целевым значением.
+  
+  Если задано расположение, сверяются платы с таким LocationInChassis. Иначе
+  сверяются основные платы: не вложенные в другие платы и с флагом Hosting Board.
+  Если ни у одной платы нет этого флага (так бывает у старых прошивок), основными
+  считаются все невложенные платы.
+  
+  @param Boards         Массив плат
+  @param Count          Количество плат
+  @param Index          Номер проверяемой платы
+  @param BoardLocation  Расположение платы (может быть NULL)
+  
+  @retval TRUE          Плата участвует в сверке
+  @retval FALSE         Плата только выводится для информации
+**/
+BOOLEAN
+IsBaseBoardSelected (
+  IN CONST BASEBOARD_INSTANCE  *Boards,
+  IN UINTN                     Count,
+  IN UINTN                     Index,
+  IN CONST CHAR16              *BoardLocation OPTIONAL
+  )
+{
+  ASCII_VIEW  View;
+  UINTN       Other;
+  BOOLEAN     AnyHosting;
+  
+  if (BoardLocation != NULL) {
+    return (!EFI_ERROR (SmbiosGetString (Boards[Index].Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, LocationInChassis), &View)) &&
+            AsciiViewEqualsText (&View, BoardLocation));
+  }
+  
+  if (Boards[Index].ParentHandle != SMBIOS_NO_PARENT) {
+    return FALSE;
+  }
+  
+  AnyHosting = FALSE;
+  for (Other = 0; Other < Count; Other++) {
+    if (Boards[Other].ParentHandle == SMBIOS_NO_PARENT && (Boards[Other].FeatureFlags & BIT0) != 0) {
+      AnyHosting = TRUE;
+      break;
+    }
+  }
+  
+  return (!AnyHosting || (Boards[Index].FeatureFlags & BIT0) != 0);
+}
+
+/**
+  Выводит информацию о системе из всех записей SMBIOS Type 1.
+**/
+VOID
+PrintSystemInfo (
+  VOID
+  )
+{
+  CONST SMBIOS_RECORD  *Record;
+  SMBIOS_TABLE_TYPE1   *Type1Record;
+  UINTN                Count;
+  UINTN                Index;
+  
+  Count = SmbiosRecordCount (SMBIOS_TYPE_SYSTEM_INFORMATION);
+  
+  for (Index = 0; Index < Count; Index++) {
+    // Получаем запись Type 1 (System Information)
+    SmbiosFindRecord (SMBIOS_TYPE_SYSTEM_INFORMATION, Index, &Record);
+    Type1Record = (SMBIOS_TABLE_TYPE1 *)Record->Header;
+    
+    if (Count > 1) {
+      Print (L"\n===== System Information (%u of %u) =====\n\n", Index + 1, Count);
+    } else {
+      Print (L"\n===== System Information =====\n\n");
+    }
+    
+    // Строковые поля читаются по таблице смещений без копирования
+    PrintSmbiosString (L"Manufacturer", Record, OFFSET_OF (SMBIOS_TABLE_TYPE1, Manufacturer));
+    PrintSmbiosString (L"Product Name", Record, OFFSET_OF (SMBIOS_TABLE_TYPE1, ProductName));
+    PrintSmbiosString (L"Version", Record, OFFSET_OF (SMBIOS_TABLE_TYPE1, Version));
+    PrintSmbiosString (L"Serial Number", Record, OFFSET_OF (SMBIOS_TABLE_TYPE1, SerialNumber));
+    
+    // Выводим UUID если он доступен (поле есть только начиная с SMBIOS 2.1)
+    if (Type1Record->Hdr.Length < OFFSET_OF (SMBIOS_TABLE_TYPE1, WakeUpType) || !Type1Record->Uuid.Data1) {
+      Print (L"UUID: <Not Specified>\n");
+    } else {
+      Print (L"UUID: %08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X\n",
+             Type1Record->Uuid.Data1, Type1Record->Uuid.Data2, Type1Record->Uuid.Data3,
+             Type1Record->Uuid.Data4[0], Type1Record->Uuid.Data4[1], Type1Record->Uuid.Data4[2],
+             Type1Record->Uuid.Data4[3], Type1Record->Uuid.Data4[4], Type1Record->Uuid.Data4[5],
+             Type1Record->Uuid.Data4[6], Type1Record->Uuid.Data4[7]);
+    }
+  }
+}
+
+/**
+  Выводит подробную информацию обо всех платах (записи Type 2) из SMBIOS.
+  
+  @retval EFI_SUCCESS         Информация успешно выведена
+  @retval другое              Ошибка при получении информации
+**/
+EFI_STATUS
+DisplayBaseBoardInfo (
+  VOID
+  )
+{
+  EFI_STATUS           Status;
+  BASEBOARD_INSTANCE   *Boards;
+  UINTN                Count;
+  UINTN                Index;
+  CONST SMBIOS_RECORD  *Record;
+  CONST CHAR8          *BoardTypeName;
+  
+  // Собираем все платы за один проход по общему индексу SMBIOS
+  Status = CollectBaseBoards (&Boards, &Count);
+  if (EFI_ERROR (Status)) {
+    Print (L"Error: Baseboard Information record not found in SMBIOS: %r\n", Status);
+    return Status;
+  }
+  
+  Print (L"\nSMBIOS Source: %s\n", mSmbiosIndex.Source);
+  
+  for (Index = 0; Index < Count; Index++) {
+    Record = Boards[Index].Record;
+    
+    if (Count > 1) {
+      Print (L"\n===== Baseboard Information (%u of %u) =====\n\n", Index + 1, Count);
+    } else {
+      Print (L"\n===== Baseboard Information =====\n\n");
+    }
+    
+    Print (L"Handle: 0x%04X\n", Boards[Index].Handle);
+    if (Boards[Index].ParentHandle != SMBIOS_NO_PARENT) {
+      Print (L"Contained In: 0x%04X\n", Boards[Index].ParentHandle);
+    }
+    
+    // Строковые поля читаются по таблице смещений без копирования
+    PrintSmbiosString (L"Manufacturer", Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, Manufacturer));
+    PrintSmbiosString (L"Product Name", Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, ProductName));
+    PrintSmbiosString (L"Version", Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, Version));
+    PrintSmbiosString (L"Serial Number", Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, SerialNumber));
+    PrintSmbiosString (L"Asset Tag", Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, AssetTag));
+    
+    // Выводим особенности платы
+    Print (L"Feature Flags: 0x%02X\n", Boards[Index].FeatureFlags);
+    if ((Boards[Index].FeatureFlags & BIT0) != 0)   Print(L"  - Hosting Board\n");
+    if ((Boards[Index].FeatureFlags & BIT1) != 0)   Print(L"  - Requires Daughter Board\n");
+    if ((Boards[Index].FeatureFlags & BIT2) != 0)   Print(L"  - Removable\n");
+    if ((Boards[Index].FeatureFlags & BIT3) != 0)   Print(L"  - Replaceable\n");
+    if ((Boards[Index].FeatureFlags & BIT4) != 0)   Print(L"  - Hot Swappable\n");
+    
+    // Выводим расположение в шасси
+    PrintSmbiosString (L"Location in Chassis", Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, LocationInChassis));
+    
+    // Выводим тип платы
+    BoardTypeName = SmbiosEnumName (mSmbiosBoardTypes, ARRAY_SIZE (mSmbiosBoardTypes), Boards[Index].BoardType);
+    if (BoardTypeName != NULL) {
+      Print (L"Board Type: %a\n", BoardTypeName);
+    } else {
+      Print (L"Board Type: Unknown (%d)\n", Boards[Index].BoardType);
+    }
+  }
+  
+  FreePool (Boards);
+  
+  // Выводим дополнительную информацию о системе из Type 1
+  PrintSystemInfo();
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Выводит накопленный текст дампа SMBIOS на экран или в файл.
+  
+  @param Dump   Вывод дампа
+**/
+VOID
+SmbiosDumpFlush (
+  IN OUT SMBIOS_DUMP  *Dump
+  )
+{
+  UINTN  Index;
+  
+  if (Dump->Used == 0) {
+    return;
+  }
+  
+  if (Dump->ToFile) {
+    WriteFileWriter (&Dump->Writer, Dump->Chunk, Dump->Used);
+  } else {
+    // Блок больше буфера Print, поэтому выводим его напрямую в консоль
+    for (Index = 0; Index < Dump->Used; Index++) {
+      Dump->WideChunk[Index] = (CHAR16)(UINT8)Dump->Chunk[Index];
+    }
+    Dump->WideChunk[Dump->Used] = L'\0';
+    gST->ConOut->OutputString (gST->ConOut, Dump->WideChunk);
+  }
+  Dump->Used = 0;
+}
+
+/**
+  Добавляет данные в вывод дампа SMBIOS. Крупные двоичные блоки (сырой режим)
+  пишутся в файл напрямую, на экран - частями размером с блок.
+  
+  @param Dump   Вывод дампа
+  @param Data   Данные
+  @param Size   Размер данных
+**/
+VOID
+SmbiosDumpWrite (
+  IN OUT SMBIOS_DUMP  *Dump,
+  IN     CONST VOID   *Data,
+  IN     UINTN        Size
+  )
+{
+  CONST UINT8  *Bytes;
+  UINTN        Piece;
+  
+  // Последний символ блока резервируется под NUL для консоли
+  if (Dump->Used + Size >= SMBIOS_DUMP_CHUNK_SIZE) {
+    SmbiosDumpFlush (Dump);
+  }
+  
+  if (Size >= SMBIOS_DUMP_CHUNK_SIZE && Dump->ToFile) {
+    WriteFileWriter (&Dump->Writer, Data, Size);
+    return;
+  }
+  
+  Bytes = (CONST UINT8 *)Data;
+  while (Size > 0) {
+    Piece = MIN (Size, SMBIOS_DUMP_CHUNK_SIZE - 1 - Dump->Used);
+    CopyMem (&Dump->Chunk[Dump->Used], Bytes, Piece);
+    Dump->Used += Piece;
+    Bytes += Piece;
+    Size -= Piece;
+    
+    if (Size > 0) {
+      SmbiosDumpFlush (Dump);
+    }
+  }
+}
+
+/**
+  Добавляет в дамп SMBIOS форматированную строку (формат PrintLib, ASCII) и перевод строки.
+  
+  @param Dump     Вывод дампа
+  @param Format   Строка формата
+  @param ...      Аргументы формата
+**/
+VOID
+EFIAPI
+SmbiosDumpLine (
+  IN OUT SMBIOS_DUMP  *Dump,
+  IN     CONST CHAR8  *Format,
+  ...
+  )
+{
+  VA_LIST  Marker;
+  CHAR8    Line[SMBIOS_DUMP_LINE_SIZE];
+  UINTN    Length;
+  
+  VA_START (Marker, Format);
+  Length = AsciiVSPrint (Line, sizeof (Line) - 2, Format, Marker);
+  VA_END (Marker);
+  
+  Line[Length++] = '\r';
+  Line[Length++] = '\n';
+  SmbiosDumpWrite (Dump, Line, Length);
+}
+
+/**
+  Добавляет в дамп SMBIOS строку записи как есть, без ограничения длины.
+  Непечатаемые байты заменяются точкой.
+  
+  @param Dump     Вывод дампа
+  @param Label    Название поля
+  @param View     Строка записи
+**/
+VOID
+SmbiosDumpView (
+  IN OUT SMBIOS_DUMP       *Dump,
+  IN     CONST CHAR8       *Label,
+  IN     CONST ASCII_VIEW  *View
+  )
+{
+  UINTN  Index;
+  UINTN  Start;
+  
+  SmbiosDumpWrite (Dump, "  ", 2);
+  SmbiosDumpWrite (Dump, Label, AsciiStrLen (Label));
+  SmbiosDumpWrite (Dump, ": ", 2);
+  
+  // Строки SMBIOS не ограничены по длине, поэтому пишем их кусками по размеру блока
+  for (Start = 0; Start < View->Length; Start += SMBIOS_DUMP_CHUNK_SIZE / 2) {
+    if (Dump->Used + SMBIOS_DUMP_CHUNK_SIZE / 2 >= SMBIOS_DUMP_CHUNK_SIZE) {
+      SmbiosDumpFlush (Dump);
+    }
+    for (Index = Start; Index < View->Length && Index < Start + SMBIOS_DUMP_CHUNK_SIZE / 2; Index++) {
+      Dump->Chunk[Dump->Used++] = (View->Text[Index] >= 0x20 && View->Text[Index] <= 0x7E) ? View->Text[Index] : '.';
+    }
+  }
+  
+  SmbiosDumpWrite (Dump, "\r\n", 2);
+}
+
+/**
+  Добавляет в дамп SMBIOS строковое поле записи. Поле, которого нет в этой
+  версии записи, пропускается.
+  
+  @param Dump         Вывод дампа
+  @param Label        Название поля
+  @param Record       Запись
+  @param FieldOffset  Смещение поля с номером строки (OFFSET_OF)
+**/
+VOID
+SmbiosDumpString (
+  IN OUT SMBIOS_DUMP          *Dump,
+  IN     CONST CHAR8          *Label,
+  IN     CONST SMBIOS_RECORD  *Record,
+  IN     UINTN                FieldOffset
+  )
+{
+  ASCII_VIEW  View;
+  
+  if (FieldOffset >= Record->Header->Length) {
+    return;
+  }
+  
+  if (EFI_ERROR (SmbiosGetString (Record, FieldOffset, &View))) {
+    SmbiosDumpLine (Dump, "  %a: Not Specified", Label);
+  } else {
+    SmbiosDumpView (Dump, Label, &View);
+  }
+}
+
+/**
+  Добавляет в дамп SMBIOS байтовое поле-перечисление с названием значения.
+  
+  @param Dump         Вывод дампа
+  @param Label        Название поля
+  @param Record       Запись
+  @param FieldOffset  Смещение поля (OFFSET_OF)
+  @param Mask         Маска значимых битов
+  @param Names        Таблица названий значений
+  @param Count        Количество элементов таблицы
+**/
+VOID
+SmbiosDumpEnum (
+  IN OUT SMBIOS_DUMP          *Dump,
+  IN     CONST CHAR8          *Label,
+  IN     CONST SMBIOS_RECORD  *Record,
+  IN     UINTN                FieldOffset,
+  IN     UINT8                Mask,
+  IN     CONST CHAR8 *CONST   *Names,
+  IN     UINTN                Count
+  )
+{
+  UINT8        Value;
+  CONST CHAR8  *Name;
+  
+  if (!SmbiosReadField (Record, FieldOffset, sizeof (UINT8), &Value)) {
+    return;
+  }
+  
+  Value &= Mask;
+  Name = SmbiosEnumName (Names, Count, Value);
+  if (Name != NULL) {
+    SmbiosDumpLine (Dump, "  %a: %a", Label, Name);
+  } else {
+    SmbiosDumpLine (Dump, "  %a: 0x%02x", Label, Value);
+  }
+}
+
+/**
+  Разбор записи Type 1 (System Information).
+**/
+VOID
+SmbiosDecodeType1 (
+  IN OUT SMBIOS_DUMP          *Dump,
+  IN     CONST SMBIOS_RECORD  *Record
+  )
+{
+  EFI_GUID  Uuid;
+  
+  SmbiosDumpString (Dump, "Manufacturer", Record, OFFSET_OF (SMBIOS_TABLE_TYPE1, Manufacturer));
+  SmbiosDumpString (Dump, "Product Name", Record, OFFSET_OF (SMBIOS_TABLE_TYPE1, ProductName));
+  SmbiosDumpString (Dump, "Version", Record, OFFSET_OF (SMBIOS_TABLE_TYPE1, Version));
+  SmbiosDumpString (Dump, "Serial Number", Record, OFFSET_OF (SMBIOS_TABLE_TYPE1, SerialNumber));
+  
+  // Начиная с SMBIOS 2.6 первые три поля UUID хранятся little-endian, как в EFI_GUID
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE1, Uuid), sizeof (EFI_GUID), &Uuid)) {
+    SmbiosDumpLine (Dump, "  UUID: %g", &Uuid);
+  }
+  
+  SmbiosDumpString (Dump, "SKU Number", Record, OFFSET_OF (SMBIOS_TABLE_TYPE1, SKUNumber));
+  SmbiosDumpString (Dump, "Family", Record, OFFSET_OF (SMBIOS_TABLE_TYPE1, Family));
+}
+
+/**
+  Разбор записи Type 2 (Baseboard Information).
+**/
+VOID
+SmbiosDecodeType2 (
+  IN OUT SMBIOS_DUMP          *Dump,
+  IN     CONST SMBIOS_RECORD  *Record
+  )
+{
+  UINT8   Byte;
+  UINT8   Count;
+  UINT16  Handle;
+  UINTN   Index;
+  
+  SmbiosDumpString (Dump, "Manufacturer", Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, Manufacturer));
+  SmbiosDumpString (Dump, "Product Name", Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, ProductName));
+  SmbiosDumpString (Dump, "Version", Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, Version));
+  SmbiosDumpString (Dump, "Serial Number", Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, SerialNumber));
+  SmbiosDumpString (Dump, "Asset Tag", Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, AssetTag));
+  
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, FeatureFlag), sizeof (UINT8), &Byte)) {
+    SmbiosDumpLine (Dump, "  Feature Flags: 0x%02x", Byte);
+  }
+  
+  SmbiosDumpString (Dump, "Location In Chassis", Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, LocationInChassis));
+  
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, ChassisHandle), sizeof (UINT16), &Handle)) {
+    SmbiosDumpLine (Dump, "  Chassis Handle: 0x%04x", Handle);
+  }
+  
+  SmbiosDumpEnum (
+    Dump, "Board Type", Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, BoardType), 0xFF,
+    mSmbiosBoardTypes, ARRAY_SIZE (mSmbiosBoardTypes)
+    );
+  
+  // Список вложенных объектов ограничен фактической длиной записи
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, NumberOfContainedObjectHandles), sizeof (UINT8), &Count)) {
+    SmbiosDumpLine (Dump, "  Contained Object Handles: %u", Count);
+    for (Index = 0; Index < Count; Index++) {
+      if (!SmbiosReadField (
+             Record,
+             OFFSET_OF (SMBIOS_TABLE_TYPE2, ContainedObjectHandles) + Index * sizeof (UINT16),
+             sizeof (UINT16),
+             &Handle
+             )) {
+        break;
+      }
+      SmbiosDumpLine (Dump, "    0x%04x", Handle);
+    }
+  }
+}
+
+/**
+  Разбор записи Type 3 (System Enclosure or Chassis).
+**/
+VOID
+SmbiosDecodeType3 (
+  IN OUT SMBIOS_DUMP          *Dump,
+  IN     CONST SMBIOS_RECORD  *Record
+  )
+{
+  UINT8  Byte;
+  UINT8  ElementCount;
+  UINT8  ElementLength;
+  
+  SmbiosDumpString (Dump, "Manufacturer", Record, OFFSET_OF (SMBIOS_TABLE_TYPE3, Manufacturer));
+  SmbiosDumpEnum (
+    Dump, "Type", Record, OFFSET_OF (SMBIOS_TABLE_TYPE3, Type), 0x7F,
+    mSmbiosChassisTypes, ARRAY_SIZE (mSmbiosChassisTypes)
+    );
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE3, Type), sizeof (UINT8), &Byte)) {
+    SmbiosDumpLine (Dump, "  Lock: %a", (Byte & 0x80) != 0 ? "Present" : "Not Present");
+  }
+  SmbiosDumpString (Dump, "Version", Record, OFFSET_OF (SMBIOS_TABLE_TYPE3, Version));
+  SmbiosDumpString (Dump, "Serial Number", Record, OFFSET_OF (SMBIOS_TABLE_TYPE3, SerialNumber));
+  SmbiosDumpString (Dump, "Asset Tag", Record, OFFSET_OF (SMBIOS_TABLE_TYPE3, AssetTag));
+  SmbiosDumpEnum (
+    Dump, "Boot-up State", Record, OFFSET_OF (SMBIOS_TABLE_TYPE3, BootupState), 0xFF,
+    mSmbiosChassisStates, ARRAY_SIZE (mSmbiosChassisStates)
+    );
+  SmbiosDumpEnum (
+    Dump, "Power Supply State", Record, OFFSET_OF (SMBIOS_TABLE_TYPE3, PowerSupplyState), 0xFF,
+    mSmbiosChassisStates, ARRAY_SIZE (mSmbiosChassisStates)
+    );
+  SmbiosDumpEnum (
+    Dump, "Thermal State", Record, OFFSET_OF (SMBIOS_TABLE_TYPE3, ThermalState), 0xFF,
+    mSmbiosChassisStates, ARRAY_SIZE (mSmbiosChassisStates)
+    );
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE3, Height), sizeof (UINT8), &Byte)) {
+    if (Byte == 0) {
+      SmbiosDumpLine (Dump, "  Height: Unspecified");
+    } else {
+      SmbiosDumpLine (Dump, "  Height: %u U", Byte);
+    }
+  }
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE3, NumberofPowerCords), sizeof (UINT8), &Byte)) {
+    SmbiosDumpLine (Dump, "  Number Of Power Cords: %u", Byte);
+  }
+  
+  // SKU Number (SMBIOS 2.7+) стоит после массива вложенных элементов переменной длины
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE3, ContainedElementCount), sizeof (UINT8), &ElementCount) &&
+      SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE3, ContainedElementRecordLength), sizeof (UINT8), &ElementLength)) {
+    SmbiosDumpLine (Dump, "  Contained Elements: %u", ElementCount);
+    SmbiosDumpString (
+      Dump,
+      "SKU Number",
+      Record,
+      OFFSET_OF (SMBIOS_TABLE_TYPE3, ContainedElements) + (UINTN)ElementCount * ElementLength
+      );
+  }
+}
+
+/**
+  Разбор записи Type 4 (Processor Information).
+**/
+VOID
+SmbiosDecodeType4 (
+  IN OUT SMBIOS_DUMP          *Dump,
+  IN     CONST SMBIOS_RECORD  *Record
+  )
+{
+  UINT8        Byte;
+  UINT16       Word;
+  UINT8        Id[8];
+  CONST CHAR8  *Name;
+  
+  SmbiosDumpString (Dump, "Socket Designation", Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, Socket));
+  SmbiosDumpEnum (
+    Dump, "Type", Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, ProcessorType), 0xFF,
+    mSmbiosProcessorTypes, ARRAY_SIZE (mSmbiosProcessorTypes)
+    );
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, ProcessorFamily), sizeof (UINT8), &Byte)) {
+    SmbiosDumpLine (Dump, "  Family: 0x%02x", Byte);
+  }
+  SmbiosDumpString (Dump, "Manufacturer", Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, ProcessorManufacturer));
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, ProcessorId), sizeof (Id), Id)) {
+    SmbiosDumpLine (
+      Dump,
+      "  ID: %02X %02X %02X %02X %02X %02X %02X %02X",
+      Id[0], Id[1], Id[2], Id[3], Id[4], Id[5], Id[6], Id[7]
+      );
+  }
+  SmbiosDumpString (Dump, "Version", Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, ProcessorVersion));
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, ExternalClock), sizeof (UINT16), &Word)) {
+    SmbiosDumpLine (Dump, "  External Clock: %u MHz", Word);
+  }
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, MaxSpeed), sizeof (UINT16), &Word)) {
+    SmbiosDumpLine (Dump, "  Max Speed: %u MHz", Word);
+  }
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, CurrentSpeed), sizeof (UINT16), &Word)) {
+    SmbiosDumpLine (Dump, "  Current Speed: %u MHz", Word);
+  }
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, Status), sizeof (UINT8), &Byte)) {
+    Name = SmbiosEnumName (mSmbiosProcessorStates, ARRAY_SIZE (mSmbiosProcessorStates), Byte & 0x07);
+    SmbiosDumpLine (
+      Dump,
+      "  Status: %a, %a",
+      (Byte & 0x40) != 0 ? "Populated" : "Unpopulated",
+      Name != NULL ? Name : "Reserved"
+      );
+  }
+  SmbiosDumpString (Dump, "Serial Number", Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, SerialNumber));
+  SmbiosDumpString (Dump, "Asset Tag", Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, AssetTag));
+  SmbiosDumpString (Dump, "Part Number", Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, PartNumber));
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, CoreCount), sizeof (UINT8), &Byte)) {
+    SmbiosDumpLine (Dump, "  Core Count: %u", Byte);
+  }
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, EnabledCoreCount), sizeof (UINT8), &Byte)) {
+    SmbiosDumpLine (Dump, "  Core Enabled: %u", Byte);
+  }
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE4, ThreadCount), sizeof (UINT8), &Byte)) {
+    SmbiosDumpLine (Dump, "  Thread Count: %u", Byte);
+  }
+}
+
+/**
+  Разбор записи Type 9 (System Slots).
+**/
+VOID
+SmbiosDecodeType9 (
+  IN OUT SMBIOS_DUMP          *Dump,
+  IN     CONST SMBIOS_RECORD  *Record
+  )
+{
+  UINT8   Byte;
+  UINT16  Word;
+  UINT16  Segment;
+  UINT8   Bus;
+  UINT8   DevFunc;
+  
+  SmbiosDumpString (Dump, "Designation", Record, OFFSET_OF (SMBIOS_TABLE_TYPE9, SlotDesignation));
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE9, SlotType), sizeof (UINT8), &Byte)) {
+    SmbiosDumpLine (Dump, "  Type: 0x%02x", Byte);
+  }
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE9, SlotDataBusWidth), sizeof (UINT8), &Byte)) {
+    SmbiosDumpLine (Dump, "  Data Bus Width: 0x%02x", Byte);
+  }
+  SmbiosDumpEnum (
+    Dump, "Current Usage", Record, OFFSET_OF (SMBIOS_TABLE_TYPE9, CurrentUsage), 0xFF,
+    mSmbiosSlotUsage, ARRAY_SIZE (mSmbiosSlotUsage)
+    );
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE9, SlotID), sizeof (UINT16), &Word)) {
+    SmbiosDumpLine (Dump, "  ID: %u", Word);
+  }
+  
+  // Адрес на шине PCI есть начиная с SMBIOS 2.6
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE9, SegmentGroupNum), sizeof (UINT16), &Segment) &&
+      SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE9, BusNum), sizeof (UINT8), &Bus) &&
+      SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE9, DevFuncNum), sizeof (UINT8), &DevFunc)) {
+    if (Segment == 0xFFFF && Bus == 0xFF && DevFunc == 0xFF) {
+      SmbiosDumpLine (Dump, "  Bus Address: Not Specified");
+    } else {
+      SmbiosDumpLine (Dump, "  Bus Address: %04x:%02x:%02x.%x", Segment, Bus, DevFunc >> 3, DevFunc & 0x07);
+    }
+  }
+}
+
+/**
+  Разбор записи Type 11 (OEM Strings).
+**/
+VOID
+SmbiosDecodeType11 (
+  IN OUT SMBIOS_DUMP          *Dump,
+  IN     CONST SMBIOS_RECORD  *Record
+  )
+{
+  UINT8       Count;
+  UINTN       Index;
+  CHAR8       Label[16];
+  ASCII_VIEW  View;
+  
+  if (!SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE11, StringCount), sizeof (UINT8), &Count)) {
+    return;
+  }
+  
+  // Количество строк в записи может не совпадать с фактическим набором строк
+  for (Index = 0; Index < MIN (Count, Record->StringCount); Index++) {
+    AsciiSPrint (Label, sizeof (Label), "String %u", Index + 1);
+    View.Text = (CONST CHAR8 *)Record->Header + mSmbiosIndex.Strings[Record->FirstString + Index].Offset;
+    View.Length = mSmbiosIndex.Strings[Record->FirstString + Index].Length;
+    SmbiosDumpView (Dump, Label, &View);
+  }
+}
+
+/**
+  Разбор записи Type 17 (Memory Device).
+**/
+VOID
+SmbiosDecodeType17 (
+  IN OUT SMBIOS_DUMP          *Dump,
+  IN     CONST SMBIOS_RECORD  *Record
+  )
+{
+  UINT8   Byte;
+  UINT16  Word;
+  UINT32  ExtendedSize;
+  
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, MemoryArrayHandle), sizeof (UINT16), &Word)) {
+    SmbiosDumpLine (Dump, "  Array Handle: 0x%04x", Word);
+  }
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, TotalWidth), sizeof (UINT16), &Word) && Word != 0xFFFF) {
+    SmbiosDumpLine (Dump, "  Total Width: %u bits", Word);
+  }
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, DataWidth), sizeof (UINT16), &Word) && Word != 0xFFFF) {
+    SmbiosDumpLine (Dump, "  Data Width: %u bits", Word);
+  }
+  
+  // Размер: 0 - модуль не установлен, 0x7FFF - см. Extended Size, бит 15 - единицы KB
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, Size), sizeof (UINT16), &Word)) {
+    if (Word == 0) {
+      SmbiosDumpLine (Dump, "  Size: No Module Installed");
+    } else if (Word == 0xFFFF) {
+      SmbiosDumpLine (Dump, "  Size: Unknown");
+    } else if (Word == 0x7FFF &&
+               SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, ExtendedSize), sizeof (UINT32), &ExtendedSize)) {
+      SmbiosDumpLine (Dump, "  Size: %u MB", ExtendedSize & 0x7FFFFFFF);
+    } else if ((Word & BIT15) != 0) {
+      SmbiosDumpLine (Dump, "  Size: %u KB", Word & 0x7FFF);
+    } else {
+      SmbiosDumpLine (Dump, "  Size: %u MB", Word);
+    }
+  }
+  
+  SmbiosDumpEnum (
+    Dump, "Form Factor", Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, FormFactor), 0xFF,
+    mSmbiosMemoryFormFactors, ARRAY_SIZE (mSmbiosMemoryFormFactors)
+    );
+  SmbiosDumpString (Dump, "Locator", Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, DeviceLocator));
+  SmbiosDumpString (Dump, "Bank Locator", Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, BankLocator));
+  SmbiosDumpEnum (
+    Dump, "Type", Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, MemoryType), 0xFF,
+    mSmbiosMemoryTypes, ARRAY_SIZE (mSmbiosMemoryTypes)
+    );
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, Speed), sizeof (UINT16), &Word) && Word != 0) {
+    SmbiosDumpLine (Dump, "  Speed: %u MT/s", Word);
+  }
+  SmbiosDumpString (Dump, "Manufacturer", Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, Manufacturer));
+  SmbiosDumpString (Dump, "Serial Number", Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, SerialNumber));
+  SmbiosDumpString (Dump, "Asset Tag", Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, AssetTag));
+  SmbiosDumpString (Dump, "Part Number", Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, PartNumber));
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, Attributes), sizeof (UINT8), &Byte) && (Byte & 0x0F) != 0) {
+    SmbiosDumpLine (Dump, "  Rank: %u", Byte & 0x0F);
+  }
+  if (SmbiosReadField (Record, OFFSET_OF (SMBIOS_TABLE_TYPE17, ConfiguredMemoryClockSpeed), sizeof (UINT16), &Word) && Word != 0) {
+    SmbiosDumpLine (Dump, "  Configured Memory Speed: %u MT/s", Word);
+  }
+}
+
+// Известные типы записей SMBIOS; остальные выводятся заголовком и набором строк
+static CONST SMBIOS_DECODER mSmbiosDecoders[] = {
+  { 0,   "BIOS Information",                NULL               },
+  { 1,   "System Information",              SmbiosDecodeType1  },
+  { 2,   "Base Board Information",          SmbiosDecodeType2  },
+  { 3,   "Chassis Information",             SmbiosDecodeType3  },
+  { 4,   "Processor Information",           SmbiosDecodeType4  },
+  { 7,   "Cache Information",               NULL               },
+  { 8,   "Port Connector Information",      NULL               },
+  { 9,   "System Slot Information",         SmbiosDecodeType9  },
+  { 11,  "OEM Strings",                     SmbiosDecodeType11 },
+  { 12,  "System Configuration Options",    NULL               },
+  { 13,  "BIOS Language Information",       NULL               },
+  { 16,  "Physical Memory Array",           NULL               },
+  { 17,  "Memory Device",                   SmbiosDecodeType17 },
+  { 19,  "Memory Array Mapped Address",     NULL               },
+  { 32,  "System Boot Information",         NULL               },
+  { 127, "End Of Table",                    NULL               }
+};
+
+/**
+  Добавляет в дамп все строки записи по порядку (для типов без отдельного разбора).
+  
+  @param Dump     Вывод дампа
+  @param Record   Запись
+**/
+VOID
+SmbiosDumpAllStrings (
+  IN OUT SMBIOS_DUMP          *Dump,
+  IN     CONST SMBIOS_RECORD  *Record
+  )
+{
+  UINTN       Index;
+  CHAR8       Label[16];
+  ASCII_VIEW  View;
+  
+  for (Index = 0; Index < Record->StringCount; Index++) {
+    AsciiSPrint (Label, sizeof (Label), "String %u", Index + 1);
+    View.Text = (CONST CHAR8 *)Record->Header + mSmbiosIndex.Strings[Record->FirstString + Index].Offset;
+    View.Length = mSmbiosIndex.Strings[Record->FirstString + Index].Length;
+    SmbiosDumpView (Dump, Label, &View);
+  }
+}
+
+/**
+  Выводит все записи SMBIOS за один проход по общему индексу: разобранным
+  текстом или в сыром виде (запись вместе с набором строк). Сырой вывод в файл -
+  двоичный, на экран - шестнадцатеричный дамп каждой записи.
+  
+  @param OutPath  Файл для вывода (NULL - на экран)
+  @param Raw      Сырой вывод записей
+  
+  @retval EFI_SUCCESS   Записи выведены
+  @retval другое        Ошибка построения индекса или записи в файл
+**/
+EFI_STATUS
+DumpSmbiosTable (
+  IN CONST CHAR16  *OutPath OPTIONAL,
+  IN BOOLEAN       Raw
+  )
+{
+  EFI_STATUS            Status;
+  SMBIOS_DUMP           *Dump;
+  CONST SMBIOS_RECORD   *Record;
+  CONST SMBIOS_DECODER  *Decoder;
+  UINTN                 Index;
+  UINTN                 DecoderIndex;
+  UINTN                 Position;
+  CHAR8                 HexLine[DUMP_LINE_SIZE];
+  
+  if (!mSmbiosIndex.Valid) {
+    Status = BuildSmbiosIndex ();
+    if (EFI_ERROR (Status)) {
+      Print (L"Error: SMBIOS table not available: %r\n", Status);
+      return Status;
+    }
+  }
+  
+  // Буферы вывода заметно больше обычных локальных переменных, держим их в пуле
+  Dump = AllocateZeroPool (sizeof (SMBIOS_DUMP));
+  if (Dump == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  
+  if (OutPath != NULL) {
+    Status = OpenFileWriter (&Dump->Writer, OutPath);
+    if (EFI_ERROR (Status)) {
+      Print (L"Error: Cannot create output file '%s': %r\n", OutPath, Status);
+      FreePool (Dump);
+      return Status;
+    }
+    Dump->ToFile = TRUE;
+  }
+  
+  // Сырой вывод в файл - только записи, без текста, чтобы файл можно было разбирать как таблицу
+  if (Raw && Dump->ToFile) {
+    for (Index = 0; Index < mSmbiosIndex.Count; Index++) {
+      Record = &mSmbiosIndex.Records[Index];
+      SmbiosDumpWrite (Dump, Record->Header, Record->Size);
+    }
+  } else {
+    SmbiosDumpLine (Dump, "SMBIOS Source: %s, %u records", mSmbiosIndex.Source, mSmbiosIndex.Count);
+    
+    for (Index = 0; Index < mSmbiosIndex.Count; Index++) {
+      Record = &mSmbiosIndex.Records[Index];
+      
+      Decoder = NULL;
+      for (DecoderIndex = 0; DecoderIndex < ARRAY_SIZE (mSmbiosDecoders); DecoderIndex++) {
+        if (mSmbiosDecoders[DecoderIndex].Type == Record->Header->Type) {
+          Decoder = &mSmbiosDecoders[DecoderIndex];
+          break;
+        }
+      }
+      
+      SmbiosDumpLine (Dump, "");
+      SmbiosDumpLine (
+        Dump,
+        "Handle 0x%04x, DMI type %u, %u bytes",
+        Record->Header->Handle,
+        Record->Header->Type,
+        Record->Header->Length
+        );
+      if (Decoder != NULL) {
+        SmbiosDumpLine (Dump, "%a", Decoder->Name);
+      } else if (Record->Header->Type >= 128) {
+        SmbiosDumpLine (Dump, "OEM-specific Type");
+      } else {
+        SmbiosDumpLine (Dump, "Unknown Type");
+      }
+      
+      if (Raw) {
+        for (Position = 0; Position < Record->Size; Position += DUMP_BYTES_PER_LINE) {
+          SmbiosDumpWrite (
+            Dump,
+            HexLine,
+            FormatDumpLine (
+              HexLine,
+              Position,
+              (CONST UINT8 *)Record->Header + Position,
+              MIN (DUMP_BYTES_PER_LINE, Record->Size - Position)
+              )
+            );
+        }
+      } else if (Decoder != NULL && Decoder->Decode != NULL) {
+        Decoder->Decode (Dump, Record);
+      } else {
+        SmbiosDumpAllStrings (Dump, Record);
+      }
+    }
+  }
+  
+  SmbiosDumpFlush (Dump);
+  
+  Status = EFI_SUCCESS;
+  if (Dump->ToFile) {
+    Status = CloseFileWriter (&Dump->Writer);
+    if (EFI_ERROR (Status)) {
+      Print (L"Error: Failed to write '%s': %r\n", OutPath, Status);
+    } else {
+      Print (L"Dumped %u SMBIOS records (%a) to %s\n", mSmbiosIndex.Count, Raw ? "raw" : "text", OutPath);
+    }
+  }
+  
+  FreePool (Dump);
+  return Status;
+}
+
+/**
+  Упаковывает MAC-адрес в 48-битный ключ. Старший байт адреса становится
+  старшим байтом ключа, поэтому порядок ключей совпадает с порядком адресов.
+  
+  @param Mac    MAC-адрес (MAC_ADDRESS_SIZE байт)
+  
+  @return Ключ MAC-адреса
+**/
+UINT64
+MacToKey (
+  IN CONST UINT8  *Mac
+  )
+{
+  UINT64  Key;
+  UINTN   Index;
+  
+  Key = 0;
+  for (Index = 0; Index < MAC_ADDRESS_SIZE; Index++) {
+    Key = (Key << 8) | Mac[Index];
+  }
+  
+  return Key;
+}
+
+/**
+  Форматирует ключ MAC-адреса в строку XX:XX:XX:XX:XX:XX.
+  
+  @param Key          Ключ MAC-адреса
+  @param Buffer       Буфер строки
+  @param BufferSize   Размер буфера в символах (не меньше MAC_STRING_SIZE)
+**/
+VOID
+FormatMacKey (
+  IN  UINT64  Key,
+  OUT CHAR16  *Buffer,
+  IN  UINTN   BufferSize
+  )
+{
+  UnicodeSPrint (
+    Buffer,
+    BufferSize * sizeof (CHAR16),
+    L"%02X:%02X:%02X:%02X:%02X:%02X",
+    (UINTN)RShiftU64 (Key, 40) & 0xFF, (UINTN)RShiftU64 (Key, 32) & 0xFF,
+    (UINTN)RShiftU64 (Key, 24) & 0xFF, (UINTN)RShiftU64 (Key, 16) & 0xFF,
+    (UINTN)RShiftU64 (Key, 8) & 0xFF,  (UINTN)Key & 0xFF
+    );
+}
+
+/**
+  Формирует строку расположения сетевого порта "PCI SSSS:BB:DD.F port N".
+  
+  @param Location     Расположение порта
+  @param Buffer       Буфер строки
+  @param BufferSize   Размер буфера в символах
+**/
+VOID
+FormatNicLocation (
+  IN  CONST NIC_LOCATION  *Location,
+  OUT CHAR16              *Buffer,
+  IN  UINTN               BufferSize
+  )
+{
+  UnicodeSPrint (Buffer, BufferSize * sizeof (CHAR16), L"PCI %04x:%02x:%02x.%x port %u",
+                 Location->Segment, Location->Bus, Location->Device, Location->Function, Location->Port);
+}
+
+/**
+  Формирует имя сетевого интерфейса для отчёта: расположение на PCI
+  с идентификаторами производителя и устройства или, если интерфейс не
+  на PCI, номер в порядке перечисления SNP.
+  
+  @param Nic          Сетевой интерфейс
+  @param Buffer       Буфер имени
+  @param BufferSize   Размер буфера в символах (NIC_NAME_SIZE)
+**/
+VOID
+FormatNicName (
+  IN  CONST NIC_ADDRESS  *Nic,
+  OUT CHAR16             *Buffer,
+  IN  UINTN              BufferSize
+  )
+{
+  CHAR16  Location[NIC_NAME_SIZE];
+  
+  if (!Nic->OnPci) {
+    UnicodeSPrint (Buffer, BufferSize * sizeof (CHAR16), L"Network Interface %u", Nic->Interface);
+    return;
+  }
+  
+  FormatNicLocation (&Nic->Location, Location, NIC_NAME_SIZE);
+  UnicodeSPrint (Buffer, BufferSize * sizeof (CHAR16), L"%s [%04x:%04x]",
+                 Location, Nic->VendorId, Nic->DeviceId);
+}
+
+/**
+  Читает переменную в кэш контекста проверки. Повторные вызовы возвращают
+  результат первого чтения. Если GUID не задан, найденный GUID выводится один раз.
+  
+  @param Variable       Кэш переменной
+  @param VariableName   Имя переменной
+  @param VariableGuid   GUID переменной (может быть NULL для поиска по всем GUID)
+  
+  @retval EFI_SUCCESS   Данные переменной в Variable->Data
+  @retval другое        Ошибка при чтении переменной
+**/
+EFI_STATUS
+VerifyContextGetVariable (
+  IN OUT VERIFY_VARIABLE  *Variable,
+  IN     CONST CHAR16     *VariableName,
+  IN     EFI_GUID         *VariableGuid OPTIONAL
+  )
+{
+  if (Variable->Loaded) {
+    return Variable->Status;
+  }
+  
+  Variable->Loaded = TRUE;
+  Variable->Status = GetVariableData (
+                       VariableName,
+                       VariableGuid,
+                       &Variable->Data,
+                       &Variable->Size,
+                       &Variable->Guid
+                       );
+  if (EFI_ERROR (Variable->Status)) {
+    return Variable->Status;
+  }
+  
+  // Для информации, выводим GUID найденной переменной, если GUID не был указан явно
+  if (VariableGuid == NULL) {
+    Print (L"Found variable '%s' with GUID: %08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X\n",
+           VariableName,
+           Variable->Guid.Data1, Variable->Guid.Data2, Variable->Guid.Data3,
+           Variable->Guid.Data4[0], Variable->Guid.Data4[1], Variable->Guid.Data4[2],
+           Variable->Guid.Data4[3], Variable->Guid.Data4[4], Variable->Guid.Data4[5],
+           Variable->Guid.Data4[6], Variable->Guid.Data4[7]);
+  }
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Определяет расположение сетевого интерфейса: PCI-функцию, к которой ведёт
+  путь устройства SNP, и её идентификаторы. Если за узлом PCI в пути следует
+  узел Controller, номер порта берётся из него.
+  
+  @param Handle       Дескриптор с Simple Network Protocol
+  @param Nic          Интерфейс: заполняются Location, PortInPath, OnPci,
+                      VendorId и DeviceId
+  
+  @retval EFI_SUCCESS   Интерфейс находится на PCI-функции
+  @retval другое        Путь устройства не содержит PCI-функции
+**/
+EFI_STATUS
+ResolveNicLocation (
+  IN     EFI_HANDLE   Handle,
+  IN OUT NIC_ADDRESS  *Nic
+  )
+{
+  EFI_STATUS                Status;
+  EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
+  EFI_HANDLE                PciHandle;
+  EFI_PCI_IO_PROTOCOL       *PciIo;
+  
+  Nic->PortInPath = FALSE;
+  
+  Status = gBS->HandleProtocol (Handle, &gEfiDevicePathProtocolGuid, (VOID **)&DevicePath);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  // LocateDevicePath сдвигает DevicePath на первый узел после PCI-функции
+  Status = gBS->LocateDevicePath (&gEfiPciIoProtocolGuid, &DevicePath, &PciHandle);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  Status = gBS->HandleProtocol (PciHandle, &gEfiPciIoProtocolGuid, (VOID **)&PciIo);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  Status = PciIo->GetLocation (
+                    PciIo,
+                    &Nic->Location.Segment,
+                    &Nic->Location.Bus,
+                    &Nic->Location.Device,
+                    &Nic->Location.Function
+                    );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  // Идентификаторы нужны только для отчёта, ошибка чтения не мешает проверке
+  PciIo->Pci.Read (PciIo, EfiPciIoWidthUint16, PCI_VENDOR_ID_OFFSET, 1, &Nic->VendorId);
+  PciIo->Pci.Read (PciIo, EfiPciIoWidthUint16, PCI_DEVICE_ID_OFFSET, 1, &Nic->DeviceId);
+  
+  if (!IsDevicePathEnd (DevicePath) &&
+      DevicePathType (DevicePath) == HARDWARE_DEVICE_PATH &&
+      DevicePathSubType (DevicePath) == HW_CONTROLLER_DP) {
+    Nic->Location.Port = ((CONTROLLER_DEVICE_PATH *)DevicePath)->ControllerNumber;
+    Nic->PortInPath = TRUE;
+  }
+  
+  Nic->OnPci = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Перечисляет сетевые интерфейсы и сохраняет их MAC-адреса в контексте проверки
+  в виде упорядоченного массива 48-битных ключей.
+  Если путь устройства не содержит узла Controller, номер порта - место
+  интерфейса среди интерфейсов той же PCI-функции по возрастанию заводского
+  MAC-адреса (текущего, если заводской не сообщается). Порядок
+  LocateHandleBuffer зависит от порядка подключения драйверов и для этого
+  не подходит, а заводские адреса портов обычно идут подряд.
+  Повторные вызовы возвращают результат первого перечисления.
+  
+  @param Context    Контекст проверки
+  
+  @retval EFI_SUCCESS   Интерфейсы в Context->Nics
+  @retval другое        Сетевые интерфейсы не найдены или недостаточно памяти
+**/
+EFI_STATUS
+VerifyContextGetNics (
+  IN OUT VERIFY_CONTEXT  *Context
+  )
+{
+  EFI_STATUS                   Status;
+  EFI_HANDLE                   *HandleBuffer;
+  UINTN                        HandleCount;
+  UINTN                        Index;
+  EFI_SIMPLE_NETWORK_PROTOCOL  *Snp;
+  NIC_ADDRESS                  Entry;
+  NIC_ADDRESS                  *Nic;
+  NIC_ADDRESS                  *Other;
+  UINT64                       Order;
+  UINT64                       OtherOrder;
+  UINTN                        Slot;
+  
+  if (Context->NicsLoaded) {
+    return Context->NicStatus;
+  }
+  Context->NicsLoaded = TRUE;
+  
+  // Получаем список всех устройств с Simple Network Protocol
+  Status = gBS->LocateHandleBuffer (
+                  ByProtocol,
+                  &gEfiSimpleNetworkProtocolGuid,
+                  NULL,
+                  &HandleCount,
+                  &HandleBuffer
+                  );
+  if (EFI_ERROR (Status) || HandleCount == 0) {
+    Context->NicStatus = EFI_ERROR (Status) ? Status : EFI_NOT_FOUND;
+    return Context->NicStatus;
+  }
+  
+  Context->Nics = AllocateZeroPool (HandleCount * sizeof (NIC_ADDRESS));
+  if (Context->Nics == NULL) {
+    FreePool (HandleBuffer);
+    Context->NicStatus = EFI_OUT_OF_RESOURCES;
+    return Context->NicStatus;
+  }
+  
+  for (Index = 0; Index < HandleCount; Index++) {
+    Status = gBS->HandleProtocol (
+                    HandleBuffer[Index],
+                    &gEfiSimpleNetworkProtocolGuid,
+                    (VOID **)&Snp
+                    );
+    if (EFI_ERROR (Status) || Snp == NULL) {
+      Print (L"Warning: Failed to get SNP for interface %d. Status: %r\n", Index, Status);
+      continue;
+    }
+    
+    // Проверяем, инициализирован ли протокол
+    if (Snp->Mode == NULL) {
+      Print (L"Warning: SNP Mode is NULL for interface %d\n", Index);
+      continue;
+    }
+    
+    ZeroMem (&Entry, sizeof (NIC_ADDRESS));
+    Entry.Key          = MacToKey (&Snp->Mode->CurrentAddress.Addr[0]);
+    Entry.PermanentKey = MacToKey (&Snp->Mode->PermanentAddress.Addr[0]);
+    Entry.Interface    = Index;
+    Entry.State        = Snp->Mode->State;
+    
+    // Расположение определяется один раз за проверку, номер порта без узла
+    // Controller - после перечисления всех интерфейсов
+    ResolveNicLocation (HandleBuffer[Index], &Entry);
+    
+    // Вставка с сохранением порядка ключей: интерфейсов немного, поиск - двоичный
+    for (Slot = Context->NicCount; Slot > 0 && Context->Nics[Slot - 1].Key > Entry.Key; Slot--) {
+      Context->Nics[Slot] = Context->Nics[Slot - 1];
+    }
+    Context->Nics[Slot] = Entry;
+    Context->NicCount++;
+  }
+  
+  FreePool (HandleBuffer);
+  
+  // Номер порта без узла Controller - количество интерфейсов той же PCI-функции
+  // с меньшим заводским MAC-адресом. Равные адреса упорядочены по текущему ключу
+  for (Index = 0; Index < Context->NicCount; Index++) {
+    Nic = &Context->Nics[Index];
+    if (!Nic->OnPci || Nic->PortInPath) {
+      continue;
+    }
+    
+    Order = (Nic->PermanentKey != 0) ? Nic->PermanentKey : Nic->Key;
+    for (Slot = 0; Slot < Context->NicCount; Slot++) {
+      Other = &Context->Nics[Slot];
+      if (Slot == Index || !Other->OnPci || Other->PortInPath ||
+          Other->Location.Segment != Nic->Location.Segment || Other->Location.Bus != Nic->Location.Bus ||
+          Other->Location.Device != Nic->Location.Device || Other->Location.Function != Nic->Location.Function) {
+        continue;
+      }
+      
+      OtherOrder = (Other->PermanentKey != 0) ? Other->PermanentKey : Other->Key;
+      if (OtherOrder < Order || (OtherOrder == Order && Slot < Index)) {
+        Nic->Location.Port++;
+      }
+    }
+  }
+  
+  Context->NicStatus = EFI_SUCCESS;
+  return EFI_SUCCESS;
+}
+
+/**
+  Сбрасывает части кэша проверки, которые могли измениться. Сброшенные
+  значения будут прочитаны заново при следующем обращении.
+  
+  @param Context    Контекст проверки
+  @param Flags      Набор флагов VERIFY_CACHE_*
+**/
+VOID
+VerifyContextInvalidate (
+  IN OUT VERIFY_CONTEXT  *Context,
+  IN     UINT32          Flags
+  )
+{
+  if ((Flags & VERIFY_CACHE_VARIABLES) != 0) {
+    if (Context->Serial.Data != NULL) {
+      FreePool (Context->Serial.Data);
+    }
+    if (Context->Mac.Data != NULL) {
+      FreePool (Context->Mac.Data);
+    }
+    ZeroMem (&Context->Serial, sizeof (VERIFY_VARIABLE));
+    ZeroMem (&Context->Mac, sizeof (VERIFY_VARIABLE));
+  }
+  
+  if ((Flags & VERIFY_CACHE_SMBIOS) != 0) {
+    InvalidateSmbiosIndex ();
+  }
+  
+  if ((Flags & VERIFY_CACHE_NICS) != 0) {
+    if (Context->Nics != NULL) {
+      FreePool (Context->Nics);
+    }
+    Context->Nics       = NULL;
+    Context->NicCount   = 0;
+    Context->NicsLoaded = FALSE;
+  }
+}
+
+/**
+  Освобождает ресурсы контекста проверки. Общий индекс SMBIOS остаётся
+  действительным и освобождается при завершении приложения.
+  
+  @param Context    Контекст проверки
+**/
+VOID
+FreeVerifyContext (
+  IN OUT VERIFY_CONTEXT  *Context
+  )
+{
+  VerifyContextInvalidate (Context, VERIFY_CACHE_VARIABLES | VERIFY_CACHE_NICS);
+}
+
+/**
+  Разбирает строку MAC-адреса из 12 шестнадцатеричных цифр с любыми
+  разделителями ':', '-', '.', ' ' в 48-битный ключ.
+  
+  @param Text   Строка MAC-адреса
+  @param Key    Ключ MAC-адреса
+  
+  @retval EFI_SUCCESS           MAC-адрес разобран
+  @retval EFI_INVALID_PARAMETER Строка не является MAC-адресом
+**/
+EFI_STATUS
+MacTextToKey (
+  IN  CONST CHAR16  *Text,
+  OUT UINT64        *Key
+  )
+{
+  UINT8  Mac[MAC_ADDRESS_SIZE];
+  UINTN  Count;
+  
+  if (!ParseHexBytes (Text, Mac, MAC_ADDRESS_SIZE, &Count) || Count != MAC_ADDRESS_SIZE) {
+    return EFI_INVALID_PARAMETER;
+  }
+  
+  *Key = MacToKey (Mac);
+  return EFI_SUCCESS;
+}
+
+/**
+  Разбирает список MAC-адресов, разделённых ',', ';' или переводами строк,
+  в массив 48-битных ключей. Каждый элемент разбирается MacTextToKey,
+  пустые элементы пропускаются.
+  
+  @param Text       Строка со списком MAC-адресов
+  @param Keys       Массив ключей в порядке следования адресов
+  @param MaxKeys    Размер массива
+  @param KeyCount   Количество разобранных ключей
+  
+  @retval EFI_SUCCESS           Разобран хотя бы один адрес
+  @retval EFI_INVALID_PARAMETER Элемент списка не является MAC-адресом или список пуст
+  @retval EFI_BUFFER_TOO_SMALL  Адресов больше, чем MaxKeys
+**/
+EFI_STATUS
+MacTextToKeys (
+  IN  CONST CHAR16  *Text,
+  OUT UINT64        *Keys,
+  IN  UINTN         MaxKeys,
+  OUT UINTN         *KeyCount
+  )
+{
+  EFI_STATUS  Status;
+  CHAR16      Item[MAX_BUFFER_SIZE];
+  UINTN       Length;
+  BOOLEAN     Blank;
+  
+  *KeyCount = 0;
+  
+  while (TRUE) {
+    // Копируем очередной элемент списка до разделителя
+    Length = 0;
+    Blank  = TRUE;
+    while (*Text != L'\0' && *Text != L',' && *Text != L';' && *Text != L'\r' && *Text != L'\n') {
+      if (Length + 1 >= MAX_BUFFER_SIZE) {
+        return EFI_INVALID_PARAMETER;
+      }
+      Item[Length] = (*Text == L'\t') ? L' ' : *Text;
+      if (Item[Length] != L' ') {
+        Blank = FALSE;
+      }
+      Length++;
+      Text++;
+    }
+    Item[Length] = L'\0';
+    
+    if (!Blank) {
+      if (*KeyCount >= MaxKeys) {
+        return EFI_BUFFER_TOO_SMALL;
+      }
+      Status = MacTextToKey (Item, &Keys[*KeyCount]);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+      (*KeyCount)++;
+    }
+    
+    if (*Text == L'\0') {
+      break;
+    }
+    Text++;
+  }
+  
+  return (*KeyCount > 0) ? EFI_SUCCESS : EFI_INVALID_PARAMETER;
+}
+
+/**
+  Проверяет, есть ли в строке символы, которых не бывает в записи MAC-адреса
+  даже с опечаткой: всё, кроме букв, цифр и разделителей адресов и списка.
+  
+  @param Text   Строка
+  
+  @retval TRUE  В строке есть посторонние символы
+  @retval FALSE Строка похожа на запись MAC-адресов
+**/
+BOOLEAN
+MacTextHasForeignChars (
+  IN CONST CHAR16  *Text
+  )
+{
+  for ( ; *Text != L'\0'; Text++) {
+    if ((*Text >= L'0' && *Text <= L'9') ||
+        (*Text >= L'A' && *Text <= L'Z') ||
+        (*Text >= L'a' && *Text <= L'z') ||
+        *Text == L':' || *Text == L'-' || *Text == L'.' || *Text == L' ' || *Text == L'\t' ||
+        *Text == L',' || *Text == L';' || *Text == L'\r' || *Text == L'\n') {
+      continue;
+    }
+    return TRUE;
+  }
+  
+  return FALSE;
+}
+
+/**
+  Разбирает MAC-адреса из данных переменной в массив 48-битных ключей.
+  Двоичные данные длиной, кратной шести байтам, считаются последовательностью
+  адресов, иначе данные читаются как строка (кодировка - TextClassify)
+  и разбираются MacTextToKeys. Если строка не разобралась, длина кратна
+  шести байтам и в строке есть символы, которых не бывает в записи адреса,
+  данные разбираются как двоичные (в наборе адресов байты могут случайно
+  оказаться печатными) с предупреждением и списком полученных адресов.
+  Строка из букв, цифр и разделителей с ошибкой - опечатка, а не двоичный набор.
+  
+  @param MacData         Данные переменной с MAC-адресами
+  @param MacDataSize     Размер данных
+  @param Keys            Массив ключей в порядке следования адресов
+  @param MaxKeys         Размер массива
+  @param KeyCount        Количество разобранных ключей
+  
+  @retval EFI_SUCCESS           MAC-адреса разобраны
+  @retval EFI_INVALID_PARAMETER Данные не являются списком MAC-адресов
+  @retval EFI_BUFFER_TOO_SMALL  Адресов больше, чем MaxKeys
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
+**/
+EFI_STATUS
+MacDataToKeys (
+  IN  CONST VOID  *MacData,
+  IN  UINTN       MacDataSize,
+  OUT UINT64      *Keys,
+  IN  UINTN       MaxKeys,
+  OUT UINTN       *KeyCount
+  )
+{
+  EFI_STATUS   Status;
+  TEXT_INFO    Info;
+  CHAR16       *Text;
+  CONST UINT8  *Bytes;
+  UINTN        Index;
+  BOOLEAN      Reinterpreted;
+  CHAR16       MacText[MAC_STRING_SIZE];
+  
+  *KeyCount = 0;
+  Bytes = (CONST UINT8 *)MacData;
+  Reinterpreted = FALSE;
+  
+  // Ровно шесть байт - всегда один двоичный адрес, даже если они похожи на текст
+  if (MacDataSize == MAC_ADDRESS_SIZE) {
+    Keys[0]   = MacToKey (Bytes);
+    *KeyCount = 1;
+    return EFI_SUCCESS;
+  }
+  
+  TextClassify (MacData, MacDataSize, &Info);
+  if (Info.Encoding != TEXT_ENCODING_BINARY) {
+    // Список на много портов не помещается в MAX_BUFFER_SIZE: символов не больше, чем байт
+    Text = AllocatePool ((MacDataSize + 1) * sizeof (CHAR16));
+    if (Text == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    
+    TextDecode (MacData, &Info, Text, MacDataSize + 1);
+    Status = MacTextToKeys (Text, Keys, MaxKeys, KeyCount);
+    Reinterpreted = MacTextHasForeignChars (Text);
+    FreePool (Text);
+    
+    // Не разобралось как строка - при длине, кратной шести, и посторонних символах
+    // пробуем двоичный набор; опечатка в записи адреса остаётся ошибкой разбора
+    if (Status != EFI_INVALID_PARAMETER || (MacDataSize % MAC_ADDRESS_SIZE) != 0 || !Reinterpreted) {
+      return Status;
+    }
+    *KeyCount = 0;
+  }
+  
+  if (MacDataSize == 0 || (MacDataSize % MAC_ADDRESS_SIZE) != 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (MacDataSize / MAC_ADDRESS_SIZE > MaxKeys) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  for (Index = 0; Index < MacDataSize; Index += MAC_ADDRESS_SIZE) {
+    Keys[(*KeyCount)++] = MacToKey (Bytes + Index);
+  }
+  
+  if (Reinterpreted) {
+    Print (L"Warning: MAC data is not a MAC address text, read as %u binary addresses:", *KeyCount);
+    for (Index = 0; Index < *KeyCount; Index++) {
+      FormatMacKey (Keys[Index], MacText, MAC_STRING_SIZE);
+      Print (L" %s", MacText);
+    }
+    Print (L"\n");
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Разбирает одно поле расположения PCI и сдвигает курсор за него.
+  
+  @param Cursor   Текущая позиция в строке
+  @param Hex      TRUE - шестнадцатеричное поле, FALSE - десятичное
+  @param Value    Значение поля
+  
+  @retval TRUE    Поле разобрано
+  @retval FALSE   В текущей позиции нет числа
+**/
+BOOLEAN
+ParseLocationField (
+  IN OUT CONST CHAR16  **Cursor,
+  IN     BOOLEAN       Hex,
+  OUT    UINTN         *Value
+  )
+{
+  EFI_STATUS  Status;
+  CHAR16      *End;
+  
+  if (Hex) {
+    Status = StrHexToUintnS (*Cursor, &End, Value);
+  } else {
+    Status = StrDecimalToUintnS (*Cursor, &End, Value);
+  }
+  
+  if (EFI_ERROR (Status) || End == *Cursor) {
+    return FALSE;
+  }
+  
+  *Cursor = End;
+  return TRUE;
+}
+
+/**
+  Разбирает значение --mac-at вида [SSSS:]BB:DD.F[/PORT]=MAC: расположение
+  PCI-функции (шестнадцатеричное, сегмент по умолчанию 0), необязательный
+  десятичный номер порта на ней и ожидаемый MAC-адрес.
+  
+  @param Text   Значение опции
+  @param Pin    Ожидаемый адрес порта
+  
+  @retval TRUE  Значение разобрано
+  @retval FALSE Неверная запись расположения или MAC-адреса
+**/
+BOOLEAN
+ParseMacPin (
+  IN  CONST CHAR16  *Text,
+  OUT MAC_PIN       *Pin
+  )
+{
+  CONST CHAR16  *Cursor;
+  UINTN         Fields[3];
+  UINTN         Count;
+  
+  ZeroMem (Pin, sizeof (MAC_PIN));
+  Cursor = Text;
+  
+  // Сегмент и шина необязательны слева: SSSS:BB:DD или BB:DD
+  for (Count = 0; Count < 3; ) {
+    if (!ParseLocationField (&Cursor, TRUE, &Fields[Count])) {
+      return FALSE;
+    }
+    Count++;
+    if (*Cursor != L':') {
+      break;
+    }
+    Cursor++;
+  }
+  if (Count < 2 || *Cursor != L'.') {
+    return FALSE;
+  }
+  Cursor++;
+  
+  Pin->Location.Segment = (Count == 3) ? Fields[0] : 0;
+  Pin->Location.Bus     = Fields[Count - 2];
+  Pin->Location.Device  = Fields[Count - 1];
+  if (!ParseLocationField (&Cursor, TRUE, &Pin->Location.Function)) {
+    return FALSE;
+  }
   
-  // Перезагружаем систему
-  Print (L"Rebooting system to BOOTx64.efi...\n");
-  gRT->ResetSystem (EfiResetWarm, EFI_SUCCESS, 0, NULL);
+  if (*Cursor == L'/') {
+    Cursor++;
+    if (!ParseLocationField (&Cursor, FALSE, &Pin->Location.Port)) {
+      return FALSE;
+    }
+  }
   
-  return EFI_SUCCESS;
+  if (*Cursor != L'=' ||
+      Pin->Location.Segment > 0xFFFF || Pin->Location.Bus > 0xFF ||
+      Pin->Location.Device > 0x1F || Pin->Location.Function > 0x7) {
+    return FALSE;
+  }
+  Cursor++;
+  
+  return !EFI_ERROR (MacTextToKey (Cursor, &Pin->Key));
 }
 
 /**
-  Запускает внешнюю EFI программу через прямую командную строку.
+  Ищет сетевой интерфейс по ключу MAC-адреса двоичным поиском
+  (Context->Nics упорядочен по ключу).
   
-  @param AmideEfiPath   Путь к AMIDEEFIx64.efi
-  @param SerialNumber   Серийный номер для прошивки
+  @param Context    Контекст проверки с перечисленными интерфейсами
+  @param Key        Ключ MAC-адреса
   
-  @retval EFI_SUCCESS   Программа успешно выполнена
-  @retval другое        Ошибка при запуске программы
+  @return Интерфейс с таким адресом или NULL
 **/
-EFI_STATUS
-RunAmideefi (
-  IN CONST CHAR16    *AmideEfiPath,
-  IN CONST CHAR16    *SerialNumber
+CONST NIC_ADDRESS *
+FindNicByKey (
+  IN CONST VERIFY_CONTEXT  *Context,
+  IN UINT64                Key
   )
 {
-  CHAR16 CommandLine[MAX_BUFFER_SIZE];
-  EFI_STATUS Status;
-  
-  // Проверяем существование файла
-  if (ShellIsFile((CHAR16*)AmideEfiPath) != EFI_SUCCESS) {
-    Print(L"Error: AMIDEEFIx64.efi not found at '%s'\n", AmideEfiPath);
-    return EFI_NOT_FOUND;
+  UINTN  Low;
+  UINTN  High;
+  UINTN  Middle;
+  
+  Low  = 0;
+  High = Context->NicCount;
+  while (Low < High) {
+    Middle = Low + (High - Low) / 2;
+    if (Context->Nics[Middle].Key < Key) {
+      Low = Middle + 1;
+    } else {
+      High = Middle;
+    }
   }
   
-  // Формируем командную строку со всеми необходимыми параметрами
-  ZeroMem(CommandLine, sizeof(CommandLine));
-  UnicodeSPrint(CommandLine, sizeof(CommandLine), 
-                L"%s /SS %s /BS %s", 
-                AmideEfiPath, SerialNumber, SerialNumber);
+  if (Low < Context->NicCount && Context->Nics[Low].Key == Key) {
+    return &Context->Nics[Low];
+  }
+  return NULL;
+}
+
+/**
+  Ищет сетевой интерфейс по расположению на PCI.
   
-  Print(L"Executing: %s\n", CommandLine);
+  @param Context    Контекст проверки с перечисленными интерфейсами
+  @param Location   Расположение порта
   
-  // Запускаем как отдельную команду через Shell
-  Status = ShellExecute(&gImageHandle, CommandLine, TRUE, NULL, NULL);
+  @return Интерфейс в этом расположении или NULL
+**/
+CONST NIC_ADDRESS *
+FindNicByLocation (
+  IN CONST VERIFY_CONTEXT  *Context,
+  IN CONST NIC_LOCATION    *Location
+  )
+{
+  UINTN  Index;
   
-  if (EFI_ERROR(Status)) {
-    Print(L"Error: Failed to execute AMIDEEFIx64.efi: %r\n", Status);
-  } else {
-    Print(L"AMIDEEFIx64.efi executed successfully\n");
+  // Интерфейсов немного, таблица упорядочена по MAC-адресу
+  for (Index = 0; Index < Context->NicCount; Index++) {
+    if (Context->Nics[Index].OnPci &&
+        CompareMem (&Context->Nics[Index].Location, Location, sizeof (NIC_LOCATION)) == 0) {
+      return &Context->Nics[Index];
+    }
   }
-  
-  return Status;
+  return NULL;
 }
 
-EFI_STATUS
-GetSmbiosString (
-  IN  UINT8     StringNumber,
-  IN  CHAR8     *StringTable,
-  OUT CHAR16    *StringBuffer,
-  IN  UINTN     StringBufferSize
+/**
+  Сверяет текущий (CurrentAddress) и заводской (PermanentAddress) MAC-адреса
+  интерфейса. Расхождение означает, что адрес переопределён драйвером или
+  предыдущим запуском утилиты, а в EEPROM записан другой адрес.
+  
+  @param Nic    Сетевой интерфейс
+  
+  @retval TRUE  Адреса совпадают или заводской адрес не сообщается
+  @retval FALSE Текущий адрес отличается от заводского
+**/
+BOOLEAN
+CheckNicPermanentAddress (
+  IN CONST NIC_ADDRESS  *Nic
   )
 {
-  UINTN i;
-
-  if (StringNumber == 0 || StringTable == NULL || StringBuffer == NULL) {
-    return EFI_INVALID_PARAMETER;
-  }
-
-  // Пропускаем (StringNumber - 1) строк, каждая заканчивается нулевым байтом.
-  for (i = 1; i < StringNumber; i++) {
-    // Пропускаем символы текущей строки до нулевого байта.
-    while (*StringTable != 0) {
-      StringTable++;
-    }
-    // Переходим через нулевой байт.
-    StringTable++;
-    // Если мы достигли двойного нуля, строка не найдена.
-    if (*StringTable == 0) {
-      return EFI_NOT_FOUND;
-    }
+  CHAR16  Name[NIC_NAME_SIZE];
+  CHAR16  Current[MAC_STRING_SIZE];
+  CHAR16  Permanent[MAC_STRING_SIZE];
+  
+  FormatNicName (Nic, Name, NIC_NAME_SIZE);
+  if (Nic->PermanentKey == 0) {
+    Print (L"Note: %s does not report a permanent MAC address\n", Name);
+    return TRUE;
   }
-
-  // Копируем найденную строку в выходной буфер с преобразованием в UCS-2.
-  for (i = 0; i < StringBufferSize - 1 && StringTable[i] != 0; i++) {
-    StringBuffer[i] = (CHAR16)StringTable[i];
+  
+  if (Nic->PermanentKey == Nic->Key) {
+    return TRUE;
   }
-  StringBuffer[i] = 0;
-
-  return EFI_SUCCESS;
+  
+  FormatMacKey (Nic->Key, Current, MAC_STRING_SIZE);
+  FormatMacKey (Nic->PermanentKey, Permanent, MAC_STRING_SIZE);
+  Print (L"Warning: %s current MAC %s differs from permanent MAC %s\n",
+         Name, Current, Permanent);
+  return FALSE;
 }
 
-
 /**
-  Получает серийный номер системы из SMBIOS.
+  Проверяет, соответствует ли MAC-адрес из UEFI переменной MAC-адресу сетевой карты.
+  Совпадать с целевым должны и текущий, и заводской адреса интерфейса.
   
-  @param SystemSerialNumber   Буфер для серийного номера системы
-  @param BufferSize           Размер буфера
+  @param Context       Контекст проверки (сетевые интерфейсы перечисляются один раз)
+  @param MacKey        Ключ MAC-адреса из UEFI переменной
+  @param DeviceName    Буфер для имени устройства с совпадающим MAC (может быть NULL)
+  @param DeviceNameSize Размер буфера для имени устройства
   
-  @retval EFI_SUCCESS         Серийный номер успешно получен
-  @retval другое              Ошибка при получении серийного номера
+  @retval TRUE         MAC-адрес совпадает с MAC-адресами сетевой карты
+  @retval FALSE        MAC-адрес не совпадает ни с одним MAC-адресом или
+                       совпадает только один из адресов интерфейса
 **/
-EFI_STATUS
-GetSystemSerialNumber (
-  OUT CHAR16    *SystemSerialNumber,
-  IN  UINTN     BufferSize
+BOOLEAN
+CheckMacAddressAgainstNetworkDevices (
+  IN OUT VERIFY_CONTEXT  *Context,
+  IN     UINT64          MacKey,
+  OUT    CHAR16          *DeviceName OPTIONAL,
+  IN     UINTN           DeviceNameSize
   )
 {
-  EFI_STATUS                Status;
-  EFI_SMBIOS_PROTOCOL       *Smbios;
-  EFI_SMBIOS_HANDLE         SmbiosHandle;
-  EFI_SMBIOS_TABLE_HEADER   *Record;
-  SMBIOS_TABLE_TYPE1        *Type1Record;
-  CHAR8                     *StringTable;
+  EFI_STATUS         Status;
+  CONST NIC_ADDRESS  *Nic;
+  CHAR16             Name[NIC_NAME_SIZE];
+  CHAR16             MacText[MAC_STRING_SIZE];
+  UINTN              Index;
+  
+  // Сетевые интерфейсы перечисляются один раз за проверку
+  Status = VerifyContextGetNics (Context);
+  if (EFI_ERROR(Status) || Context->NicCount == 0) {
+    Print(L"Warning: No network interfaces found on this system! Status: %r\n", Status);
+    return FALSE;
+  }
   
-  // Инициализируем выходной буфер
-  ZeroMem (SystemSerialNumber, BufferSize * sizeof(CHAR16));
+  Print(L"Found %d network interfaces\n", Context->NicCount);
   
-  // Получаем доступ к SMBIOS протоколу
-  Status = gBS->LocateProtocol (
-                &gEfiSmbiosProtocolGuid,
-                NULL,
-                (VOID **)&Smbios
-                );
-                
-  if (EFI_ERROR (Status)) {
-    Print (L"Error: Failed to locate SMBIOS protocol: %r\n", Status);
-    return Status;
+  Nic = FindNicByKey (Context, MacKey);
+  if (Nic == NULL) {
+    // Перечисляем интерфейсы, чтобы несовпадение указывало на слот без повторного запуска
+    for (Index = 0; Index < Context->NicCount; Index++) {
+      FormatNicName (&Context->Nics[Index], Name, NIC_NAME_SIZE);
+      FormatMacKey (Context->Nics[Index].Key, MacText, MAC_STRING_SIZE);
+      Print (L"  %s: MAC %s\n", Name, MacText);
+      
+      // Текущий адрес мог быть переопределён, хотя в EEPROM записан целевой
+      if (Context->Nics[Index].PermanentKey == MacKey) {
+        Print (L"Warning: %s has the target MAC as permanent address, but its current MAC is %s\n",
+               Name, MacText);
+      }
+    }
+    return FALSE;
   }
   
-  // Находим запись с информацией о системе (Type 1)
-  SmbiosHandle = SMBIOS_HANDLE_PI_RESERVED;
-  Status = Smbios->GetNext (Smbios, &SmbiosHandle, NULL, &Record, NULL);
+  // Текущий адрес совпал, но в EEPROM может быть записан другой
+  if (!CheckNicPermanentAddress (Nic)) {
+    return FALSE;
+  }
   
-  while (!EFI_ERROR (Status) && Record->Type != SMBIOS_TYPE_SYSTEM_INFORMATION) {
-    Status = Smbios->GetNext (Smbios, &SmbiosHandle, NULL, &Record, NULL);
+  // Если запрошено имя устройства, формируем его из расположения и MAC-адреса
+  if (DeviceName != NULL && DeviceNameSize > 0) {
+    FormatNicName (Nic, Name, NIC_NAME_SIZE);
+    FormatMacKey (Nic->Key, MacText, MAC_STRING_SIZE);
+    UnicodeSPrint(DeviceName, DeviceNameSize * sizeof(CHAR16),
+                  L"%s (MAC: %s)", Name, MacText);
   }
   
-  if (EFI_ERROR (Status)) {
-    Print (L"Error: System Information record not found in SMBIOS: %r\n", Status);
-    return Status;
+  return TRUE;
+}
+
+/**
+  Проверяет блок MAC-адресов многопортовой платы: порт N получает адрес BaseKey + N.
+  За один проход по упорядоченной таблице интерфейсов проверяется, что каждый
+  интерфейс SNP попадает в блок, каждый порт занят ровно одним интерфейсом и
+  заводской адрес интерфейса совпадает с текущим. Выводится состояние каждого
+  порта и интерфейсы вне блока.
+  
+  @param Context    Контекст проверки
+  @param BaseKey    Ключ базового MAC-адреса (порт 0)
+  @param PortCount  Количество портов в блоке
+  
+  @retval TRUE      Все порты заняты, дубликатов, переопределённых адресов и
+                    интерфейсов вне блока нет
+  @retval FALSE     Блок не совпадает с интерфейсами системы
+**/
+BOOLEAN
+CheckMacBlock (
+  IN OUT VERIFY_CONTEXT  *Context,
+  IN     UINT64          BaseKey,
+  IN     UINTN           PortCount
+  )
+{
+  EFI_STATUS         Status;
+  CONST NIC_ADDRESS  *Nic;
+  CHAR16             Name[NIC_NAME_SIZE];
+  CHAR16             Other[NIC_NAME_SIZE];
+  CHAR16             MacText[MAC_STRING_SIZE];
+  UINTN              Index;
+  UINTN              Port;              // Следующий порт, для которого ещё не найден интерфейс
+  UINTN              Offset;
+  UINTN              Present = 0;
+  UINTN              Missing = 0;
+  UINTN              Duplicates = 0;
+  UINTN              Outside = 0;
+  UINTN              Overridden = 0;
+  
+  if (PortCount == 0 || PortCount - 1 > MAC_KEY_MAX - BaseKey) {
+    Print (L"Error: MAC block of %u ports does not fit into the 48-bit address space\n", PortCount);
+    return FALSE;
   }
   
-  // Получаем запись Type 1 (System Information)
-  Type1Record = (SMBIOS_TABLE_TYPE1 *)Record;
+  Status = VerifyContextGetNics (Context);
+  if (EFI_ERROR (Status)) {
+    Print (L"Warning: No network interfaces found on this system! Status: %r\n", Status);
+    Context->NicCount = 0;
+  }
   
-  // Находим таблицу строк (она идет сразу после структуры)
-  StringTable = (CHAR8 *)((UINT8 *)Type1Record + Type1Record->Hdr.Length);
+  // Интерфейсы упорядочены по адресу, поэтому порты блока проходятся одновременно с ними
+  Port = 0;
+  for (Index = 0; Index < Context->NicCount; Index++) {
+    Nic = &Context->Nics[Index];
+    FormatNicName (Nic, Name, NIC_NAME_SIZE);
+    FormatMacKey (Nic->Key, MacText, MAC_STRING_SIZE);
+    
+    if (Nic->Key < BaseKey || Nic->Key - BaseKey >= PortCount) {
+      Print (L"%s (%s): OUT OF RANGE\n", Name, MacText);
+      CheckNicPermanentAddress (Nic);
+      Outside++;
+      continue;
+    }
+    Offset = (UINTN)(Nic->Key - BaseKey);
+    
+    if (Index > 0 && Context->Nics[Index - 1].Key == Nic->Key) {
+      FormatNicName (&Context->Nics[Index - 1], Other, NIC_NAME_SIZE);
+      Print (L"Port %u (%s): DUPLICATE on %s and %s\n", Offset, MacText, Other, Name);
+      Duplicates++;
+      continue;
+    }
+    
+    for ( ; Port < Offset; Port++) {
+      FormatMacKey (BaseKey + Port, MacText, MAC_STRING_SIZE);
+      Print (L"Port %u (%s): MISSING\n", Port, MacText);
+      Missing++;
+    }
+    
+    FormatMacKey (Nic->Key, MacText, MAC_STRING_SIZE);
+    Print (L"Port %u (%s): %s\n", Offset, MacText, Name);
+    if (!CheckNicPermanentAddress (Nic)) {
+      Overridden++;
+    }
+    Present++;
+    Port = Offset + 1;
+  }
   
-  // Получаем строку с серийным номером
-  Status = GetSmbiosString (
-             Type1Record->SerialNumber,
-             StringTable,
-             SystemSerialNumber,
-             BufferSize
-             );
-             
-  if (EFI_ERROR (Status)) {
-    Print (L"Error: Failed to get System Serial Number string: %r\n", Status);
-    return Status;
+  for ( ; Port < PortCount; Port++) {
+    FormatMacKey (BaseKey + Port, MacText, MAC_STRING_SIZE);
+    Print (L"Port %u (%s): MISSING\n", Port, MacText);
+    Missing++;
   }
   
-  return EFI_SUCCESS;
+  Print (L"MAC block: %u of %u ports present, %u missing, %u duplicate, %u out of range, %u overridden\n",
+         Present, PortCount, Missing, Duplicates, Outside, Overridden);
+  
+  return (Missing == 0 && Duplicates == 0 && Outside == 0 && Overridden == 0);
 }
 
 /**
-  Получает серийный номер материнской платы из SMBIOS.
-  
-  @param BaseBoardSerialNumber  Буфер для серийного номера материнской платы
-  @param BufferSize             Размер буфера
-  
-  @retval EFI_SUCCESS           Серийный номер успешно получен
-  @retval другое                Ошибка при получении серийного номера
+  Проверяет список независимо назначенных MAC-адресов портов платы.
+  Порядок адресов в списке задаёт номера портов. Список упорядочивается
+  по ключу и за один проход сопоставляется с упорядоченной таблицей
+  интерфейсов, после чего результат выводится для каждого порта.
+  Интерфейсы, адресов которых нет в списке, только перечисляются.
+  
+  @param Context    Контекст проверки
+  @param Keys       Ключи MAC-адресов портов
+  @param KeyCount   Количество портов (не больше MAC_LIST_MAX)
+  
+  @retval TRUE      Каждому порту соответствует интерфейс с тем же текущим и заводским адресом
+  @retval FALSE     Есть отсутствующие, повторяющиеся или переопределённые адреса
 **/
-EFI_STATUS
-GetBaseBoardSerialNumber (
-  OUT CHAR16    *BaseBoardSerialNumber,
-  IN  UINTN     BufferSize
+BOOLEAN
+CheckMacList (
+  IN OUT VERIFY_CONTEXT  *Context,
+  IN     CONST UINT64    *Keys,
+  IN     UINTN           KeyCount
   )
 {
-  EFI_STATUS                Status;
-  EFI_SMBIOS_PROTOCOL       *Smbios;
-  EFI_SMBIOS_HANDLE         SmbiosHandle;
-  EFI_SMBIOS_TABLE_HEADER   *Record;
-  SMBIOS_TABLE_TYPE2        *Type2Record;
-  CHAR8                     *StringTable;
-  
-  // Инициализируем выходной буфер
-  ZeroMem (BaseBoardSerialNumber, BufferSize * sizeof(CHAR16));
+  EFI_STATUS         Status;
+  CONST NIC_ADDRESS  *Nic;
+  CHAR16             Name[NIC_NAME_SIZE];
+  CHAR16             Other[NIC_NAME_SIZE];
+  CHAR16             MacText[MAC_STRING_SIZE];
+  UINTN              Order[MAC_LIST_MAX];     // Номера портов по возрастанию ключа
+  UINTN              Found[MAC_LIST_MAX];     // Индекс интерфейса в Context->Nics для порта
+  UINTN              Index;
+  UINTN              Slot;
+  UINTN              Port;
+  UINTN              NicIndex;
+  UINTN              Failed = 0;
+  UINTN              Extra = 0;
+  
+  if (KeyCount == 0 || KeyCount > MAC_LIST_MAX) {
+    return FALSE;
+  }
   
-  // Получаем доступ к SMBIOS протоколу
-  Status = gBS->LocateProtocol (
-                &gEfiSmbiosProtocolGuid,
-                NULL,
-                (VOID **)&Smbios
-                );
-                
+  Status = VerifyContextGetNics (Context);
   if (EFI_ERROR (Status)) {
-    Print (L"Error: Failed to locate SMBIOS protocol: %r\n", Status);
-    return Status;
+    Print (L"Warning: No network interfaces found on this system! Status: %r\n", Status);
   }
   
-  // Находим запись с информацией о материнской плате (Type 2)
-  SmbiosHandle = SMBIOS_HANDLE_PI_RESERVED;
-  Status = Smbios->GetNext (Smbios, &SmbiosHandle, NULL, &Record, NULL);
+  // Портов немного - упорядочиваем номера портов вставками
+  for (Index = 0; Index < KeyCount; Index++) {
+    for (Slot = Index; Slot > 0 && Keys[Order[Slot - 1]] > Keys[Index]; Slot--) {
+      Order[Slot] = Order[Slot - 1];
+    }
+    Order[Slot] = Index;
+    Found[Index] = MAX_UINTN;
+  }
   
-  while (!EFI_ERROR (Status) && Record->Type != SMBIOS_TYPE_BASEBOARD_INFORMATION) {
-    Status = Smbios->GetNext (Smbios, &SmbiosHandle, NULL, &Record, NULL);
+  // Один проход слиянием двух упорядоченных последовательностей
+  NicIndex = 0;
+  for (Index = 0; Index < KeyCount; Index++) {
+    Port = Order[Index];
+    while (NicIndex < Context->NicCount && Context->Nics[NicIndex].Key < Keys[Port]) {
+      if (Index == 0 || Context->Nics[NicIndex].Key != Keys[Order[Index - 1]]) {
+        FormatNicName (&Context->Nics[NicIndex], Name, NIC_NAME_SIZE);
+        FormatMacKey (Context->Nics[NicIndex].Key, MacText, MAC_STRING_SIZE);
+        Print (L"Note: %s (%s) is not in the MAC list\n", Name, MacText);
+        Extra++;
+      }
+      NicIndex++;
+    }
+    if (NicIndex < Context->NicCount && Context->Nics[NicIndex].Key == Keys[Port]) {
+      Found[Port] = NicIndex;
+    }
+  }
+  for ( ; NicIndex < Context->NicCount; NicIndex++) {
+    if (Context->Nics[NicIndex].Key == Keys[Order[KeyCount - 1]]) {
+      continue;
+    }
+    FormatNicName (&Context->Nics[NicIndex], Name, NIC_NAME_SIZE);
+    FormatMacKey (Context->Nics[NicIndex].Key, MacText, MAC_STRING_SIZE);
+    Print (L"Note: %s (%s) is not in the MAC list\n", Name, MacText);
+    Extra++;
   }
   
-  if (EFI_ERROR (Status)) {
-    Print (L"Error: Baseboard Information record not found in SMBIOS: %r\n", Status);
-    return Status;
+  // Результат по портам в порядке списка
+  for (Port = 0; Port < KeyCount; Port++) {
+    FormatMacKey (Keys[Port], MacText, MAC_STRING_SIZE);
+    
+    // Повторы адреса в списке и в таблице интерфейсов
+    for (Index = 0; Index < Port; Index++) {
+      if (Keys[Index] == Keys[Port]) {
+        break;
+      }
+    }
+    if (Index < Port) {
+      Print (L"Port %u (%s): DUPLICATE of port %u\n", Port, MacText, Index);
+      Failed++;
+      continue;
+    }
+    if (Found[Port] == MAX_UINTN) {
+      Print (L"Port %u (%s): MISSING\n", Port, MacText);
+      Failed++;
+      continue;
+    }
+    
+    Nic = &Context->Nics[Found[Port]];
+    FormatNicName (Nic, Name, NIC_NAME_SIZE);
+    if (Found[Port] + 1 < Context->NicCount && Context->Nics[Found[Port] + 1].Key == Nic->Key) {
+      FormatNicName (&Context->Nics[Found[Port] + 1], Other, NIC_NAME_SIZE);
+      Print (L"Port %u (%s): DUPLICATE on %s and %s\n", Port, MacText, Name, Other);
+      Failed++;
+      continue;
+    }
+    
+    Print (L"Port %u (%s): %s\n", Port, MacText, Name);
+    if (!CheckNicPermanentAddress (Nic)) {
+      Failed++;
+    }
   }
   
-  // Получаем запись Type 2 (Baseboard Information)
-  Type2Record = (SMBIOS_TABLE_TYPE2 *)Record;
+  Print (L"MAC list: %u of %u ports match, %u other interfaces\n", KeyCount - Failed, KeyCount, Extra);
+  
+  return (Failed == 0);
+}
+
+/**
+  Проверяет MAC-адреса, закреплённые за физическими портами (--mac-at).
+  Порт ищется по расположению на PCI, поэтому результат не зависит от
+  порядка подключения драйверов.
   
-  // Находим таблицу строк (она идет сразу после структуры)
-  StringTable = (CHAR8 *)((UINT8 *)Type2Record + Type2Record->Hdr.Length);
+  @param Context    Контекст проверки
+  @param Pins       Ожидаемые адреса портов
+  @param PinCount   Количество портов
   
-  // Получаем строку с серийным номером
-  Status = GetSmbiosString (
-             Type2Record->SerialNumber,
-             StringTable,
-             BaseBoardSerialNumber,
-             BufferSize
-             );
-             
+  @retval TRUE      Во всех расположениях найден интерфейс с ожидаемым адресом
+  @retval FALSE     Порт отсутствует или его адрес отличается
+**/
+BOOLEAN
+CheckMacPins (
+  IN OUT VERIFY_CONTEXT  *Context,
+  IN     CONST MAC_PIN   *Pins,
+  IN     UINTN           PinCount
+  )
+{
+  EFI_STATUS         Status;
+  CONST NIC_ADDRESS  *Nic;
+  CHAR16             Location[NIC_NAME_SIZE];
+  CHAR16             Name[NIC_NAME_SIZE];
+  CHAR16             Expected[MAC_STRING_SIZE];
+  CHAR16             Actual[MAC_STRING_SIZE];
+  UINTN              Index;
+  UINTN              Failed = 0;
+  
+  Status = VerifyContextGetNics (Context);
   if (EFI_ERROR (Status)) {
-    Print (L"Error: Failed to get Baseboard Serial Number string: %r\n", Status);
-    return Status;
+    Print (L"Warning: No network interfaces found on this system! Status: %r\n", Status);
   }
   
-  return EFI_SUCCESS;
+  for (Index = 0; Index < PinCount; Index++) {
+    FormatNicLocation (&Pins[Index].Location, Location, NIC_NAME_SIZE);
+    FormatMacKey (Pins[Index].Key, Expected, MAC_STRING_SIZE);
+    
+    Nic = FindNicByLocation (Context, &Pins[Index].Location);
+    if (Nic == NULL) {
+      Print (L"%s (%s): MISSING\n", Location, Expected);
+      Failed++;
+      continue;
+    }
+    
+    FormatNicName (Nic, Name, NIC_NAME_SIZE);
+    if (Nic->Key != Pins[Index].Key) {
+      FormatMacKey (Nic->Key, Actual, MAC_STRING_SIZE);
+      Print (L"%s: MISMATCH, expected %s, found %s\n", Name, Expected, Actual);
+      Failed++;
+      continue;
+    }
+    
+    Print (L"%s (%s): MATCH\n", Name, Expected);
+    if (!CheckNicPermanentAddress (Nic)) {
+      Failed++;
+    }
+  }
+  
+  Print (L"Pinned ports: %u of %u match\n", PinCount - Failed, PinCount);
+  
+  return (Failed == 0);
 }
 
 /**
-  Выводит информацию о системе из SMBIOS Type 1 записи.
+  Проверяет, совпадает ли серийный номер с серийными номерами в SMBIOS информации.
+  Сверяются все записи Type 1 и все платы, выбранные IsBaseBoardSelected: на
+  многоузловом шасси совпадение одного узла не должно скрывать ошибку другого.
+  
+  @param Target           Целевой серийный номер (данные переменной или строка)
+  @param BoardLocation    Расположение платы для сверки (NULL - основные платы)
+  
+  @retval TRUE            Серийный номер совпадает во всех сверяемых экземплярах
+  @retval FALSE           Хотя бы один экземпляр не совпадает, не читается
+                          или сверять было не с чем
 **/
-VOID
-PrintSystemInfo (
-  VOID
+BOOLEAN
+CheckSerialNumber (
+  IN  CONST TEXT_VIEW *Target,
+  IN  CONST CHAR16    *BoardLocation OPTIONAL
   )
 {
-  EFI_STATUS                Status;
-  EFI_SMBIOS_PROTOCOL       *Smbios;
-  EFI_SMBIOS_HANDLE         SmbiosHandle;
-  EFI_SMBIOS_TABLE_HEADER   *Record;
-  SMBIOS_TABLE_TYPE1        *Type1Record;
-  CHAR8                     *StringTable;
-  CHAR16                    TempString[MAX_BUFFER_SIZE];
-  
-  // Получаем доступ к SMBIOS протоколу
-  Status = gBS->LocateProtocol (
-                &gEfiSmbiosProtocolGuid,
-                NULL,
-                (VOID **)&Smbios
-                );
-                
-  if (EFI_ERROR (Status)) {
-    return;
+  EFI_STATUS          Status;
+  TEXT_VIEW           Actual;           // Серийный номер из SMBIOS
+  CONST SMBIOS_RECORD *Record;
+  UINTN               Checked = 0;      // Сверенные экземпляры Type 1 и Type 2
+  UINTN               Failed = 0;       // Из них не совпавшие или нечитаемые
+  BASEBOARD_INSTANCE  *Boards = NULL;   // Все платы (записи Type 2)
+  UINTN               InstanceCount;
+  UINTN               Index;
+  ASCII_VIEW          View;
+  ASCII_VIEW          Location;
+  BOOLEAN             BoardChecked;     // Хотя бы одна плата участвовала в сверке
+  
+  // Сверяем серийные номера всех записей Type 1
+  InstanceCount = SmbiosRecordCount (SMBIOS_TYPE_SYSTEM_INFORMATION);
+  if (InstanceCount == 0) {
+    Print(L"Warning: Could not retrieve System Serial Number from SMBIOS.\n");
+  }
+  for (Index = 0; Index < InstanceCount; Index++) {
+    SmbiosFindRecord (SMBIOS_TYPE_SYSTEM_INFORMATION, Index, &Record);
+    Checked++;
+    Status = SmbiosGetString (Record, OFFSET_OF (SMBIOS_TABLE_TYPE1, SerialNumber), &View);
+    if (EFI_ERROR(Status)) {
+      Print(L"Warning: Could not retrieve System Serial Number %u from SMBIOS.\n", Index + 1);
+      Failed++;
+      continue;
+    }
+    TextViewFromAscii (&View, &Actual);
+    
+    if (InstanceCount > 1) {
+      Print(L"System Serial Number %u of %u from SMBIOS: %.*a\n", Index + 1, InstanceCount, View.Length, View.Text);
+    } else {
+      Print(L"System Serial Number from SMBIOS: %.*a\n", View.Length, View.Text);
+    }
+    
+    // Сравниваем с целевым серийным номером
+    if (SnEquals(&Actual, Target)) {
+      Print(L"System Serial Number matches the target value.\n");
+    } else {
+      Print(L"System Serial Number does NOT match the target value.\n");
+      Failed++;
+    }
   }
   
-  // Находим запись с информацией о системе (Type 1)
-  SmbiosHandle = SMBIOS_HANDLE_PI_RESERVED;
-  Status = Smbios->GetNext (Smbios, &SmbiosHandle, NULL, &Record, NULL);
+  // Сверяем платы: все экземпляры Type 2 собираются за один проход, результат по каждой плате
+  Status = CollectBaseBoards (&Boards, &InstanceCount);
+  if (EFI_ERROR(Status)) {
+    Print(L"Warning: Could not retrieve Baseboard Serial Number from SMBIOS.\n");
+    InstanceCount = 0;
+  }
   
-  while (!EFI_ERROR (Status) && Record->Type != SMBIOS_TYPE_SYSTEM_INFORMATION) {
-    Status = Smbios->GetNext (Smbios, &SmbiosHandle, NULL, &Record, NULL);
+  BoardChecked = FALSE;
+  for (Index = 0; Index < InstanceCount; Index++) {
+    Status = SmbiosGetString (Boards[Index].Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, SerialNumber), &View);
+    if (EFI_ERROR(Status)) {
+      Print(L"Warning: Could not retrieve Serial Number of baseboard 0x%04X.\n", Boards[Index].Handle);
+      // Нечитаемый серийный номер выбранной платы - ошибка сверки
+      if (IsBaseBoardSelected (Boards, InstanceCount, Index, BoardLocation)) {
+        BoardChecked = TRUE;
+        Checked++;
+        Failed++;
+      }
+      continue;
+    }
+    
+    if (EFI_ERROR (SmbiosGetString (Boards[Index].Record, OFFSET_OF (SMBIOS_TABLE_TYPE2, LocationInChassis), &Location))) {
+      Location.Text = "";
+      Location.Length = 0;
+    }
+    Print(L"Baseboard 0x%04X (%.*a) Serial Number from SMBIOS: %.*a\n",
+          Boards[Index].Handle, Location.Length, Location.Text, View.Length, View.Text);
+    
+    // Вложенные платы (райзеры, дочерние платы) и платы в другом месте шасси только выводим
+    if (!IsBaseBoardSelected (Boards, InstanceCount, Index, BoardLocation)) {
+      Print(L"Baseboard 0x%04X is not checked (%a).\n",
+            Boards[Index].Handle,
+            BoardLocation != NULL ? "other location" : "not a hosting board");
+      continue;
+    }
+    BoardChecked = TRUE;
+    Checked++;
+    
+    // Сравниваем с целевым серийным номером
+    TextViewFromAscii (&View, &Actual);
+    if (SnEquals(&Actual, Target)) {
+      Print(L"Baseboard 0x%04X Serial Number matches the target value.\n", Boards[Index].Handle);
+    } else {
+      Print(L"Baseboard 0x%04X Serial Number does NOT match the target value.\n", Boards[Index].Handle);
+      Failed++;
+    }
   }
   
-  if (EFI_ERROR (Status)) {
-    return;
+  // Запрошенной платы нет - сверка не выполнена
+  if (BoardLocation != NULL && !BoardChecked) {
+    Print(L"Warning: No baseboard found at location '%s'.\n", BoardLocation);
+    Failed++;
   }
   
-  // Получаем запись Type 1 (System Information)
-  Type1Record = (SMBIOS_TABLE_TYPE1 *)Record;
+  if (Boards != NULL) {
+    FreePool(Boards);
+  }
   
-  Print (L"\n===== System Information =====\n\n");
+  if (Checked > 1) {
+    Print(L"Serial Number matches %u of %u checked SMBIOS instances.\n", Checked - Failed, Checked);
+  }
   
-  // Находим таблицу строк (она идет сразу после структуры)
-  StringTable = (CHAR8 *)((UINT8 *)Type1Record + Type1Record->Hdr.Length);
+  return (Checked > 0 && Failed == 0);
+}
+
+// Поля SMBIOS, которые можно сверять; имя поля - "тип.поле", регистр не важен
+static CONST VERIFY_FIELD mVerifyFields[] = {
+  { L"1.Manufacturer", 1, OFFSET_OF (SMBIOS_TABLE_TYPE1, Manufacturer),      VERIFY_FIELD_STRING },
+  { L"1.Product",      1, OFFSET_OF (SMBIOS_TABLE_TYPE1, ProductName),       VERIFY_FIELD_STRING },
+  { L"1.Version",      1, OFFSET_OF (SMBIOS_TABLE_TYPE1, Version),           VERIFY_FIELD_STRING },
+  { L"1.Serial",       1, OFFSET_OF (SMBIOS_TABLE_TYPE1, SerialNumber),      VERIFY_FIELD_SERIAL },
+  { L"1.UUID",         1, OFFSET_OF (SMBIOS_TABLE_TYPE1, Uuid),              VERIFY_FIELD_UUID   },
+  { L"1.SKU",          1, OFFSET_OF (SMBIOS_TABLE_TYPE1, SKUNumber),         VERIFY_FIELD_STRING },
+  { L"1.Family",       1, OFFSET_OF (SMBIOS_TABLE_TYPE1, Family),            VERIFY_FIELD_STRING },
+  { L"2.Manufacturer", 2, OFFSET_OF (SMBIOS_TABLE_TYPE2, Manufacturer),      VERIFY_FIELD_STRING },
+  { L"2.Product",      2, OFFSET_OF (SMBIOS_TABLE_TYPE2, ProductName),       VERIFY_FIELD_STRING },
+  { L"2.Version",      2, OFFSET_OF (SMBIOS_TABLE_TYPE2, Version),           VERIFY_FIELD_STRING },
+  { L"2.Serial",       2, OFFSET_OF (SMBIOS_TABLE_TYPE2, SerialNumber),      VERIFY_FIELD_SERIAL },
+  { L"2.AssetTag",     2, OFFSET_OF (SMBIOS_TABLE_TYPE2, AssetTag),          VERIFY_FIELD_STRING },
+  { L"2.Location",     2, OFFSET_OF (SMBIOS_TABLE_TYPE2, LocationInChassis), VERIFY_FIELD_STRING },
+  { L"3.Manufacturer", 3, OFFSET_OF (SMBIOS_TABLE_TYPE3, Manufacturer),      VERIFY_FIELD_STRING },
+  { L"3.Version",      3, OFFSET_OF (SMBIOS_TABLE_TYPE3, Version),           VERIFY_FIELD_STRING },
+  { L"3.Serial",       3, OFFSET_OF (SMBIOS_TABLE_TYPE3, SerialNumber),      VERIFY_FIELD_SERIAL },
+  { L"3.AssetTag",     3, OFFSET_OF (SMBIOS_TABLE_TYPE3, AssetTag),          VERIFY_FIELD_STRING }
+};
+
+// Названия результатов сверки (в порядке VERIFY_RESULT)
+static CONST CHAR16 *CONST mVerifyResultNames[] = {
+  L"MATCH", L"MISMATCH", L"NO-SOURCE", L"NO-FIELD", L"PENDING"
+};
+
+/**
+  Сравнивает две строки без учёта регистра (для UUID).
   
-  // Выводим информацию о производителе
-  if (Type1Record->Manufacturer != 0) {
-    ZeroMem (TempString, sizeof(TempString));
-    GetSmbiosString (Type1Record->Manufacturer, StringTable, TempString, MAX_BUFFER_SIZE);
-    Print (L"Manufacturer: %s\n", TempString);
-  } else {
-    Print (L"Manufacturer: <Not Specified>\n");
-  }
+  @param First    Первая строка
+  @param Second   Вторая строка
   
-  // Выводим информацию о продукте
-  if (Type1Record->ProductName != 0) {
-    ZeroMem (TempString, sizeof(TempString));
-    GetSmbiosString (Type1Record->ProductName, StringTable, TempString, MAX_BUFFER_SIZE);
-    Print (L"Product Name: %s\n", TempString);
-  } else {
-    Print (L"Product Name: <Not Specified>\n");
+  @retval TRUE    Строки совпадают
+  @retval FALSE   Строки различаются
+**/
+BOOLEAN
+TextEqualsNoCase (
+  IN CONST CHAR16  *First,
+  IN CONST CHAR16  *Second
+  )
+{
+  while (*First != L'\0' && CharToUpper (*First) == CharToUpper (*Second)) {
+    First++;
+    Second++;
   }
   
-  // Выводим информацию о версии
-  if (Type1Record->Version != 0) {
-    ZeroMem (TempString, sizeof(TempString));
-    GetSmbiosString (Type1Record->Version, StringTable, TempString, MAX_BUFFER_SIZE);
-    Print (L"Version: %s\n", TempString);
-  } else {
-    Print (L"Version: <Not Specified>\n");
-  }
+  return (CharToUpper (*First) == CharToUpper (*Second));
+}
+
+/**
+  Преобразует данные переменной в строку в кодировке, определённой TextClassify.
   
-  // Выводим серийный номер
-  if (Type1Record->SerialNumber != 0) {
-    ZeroMem (TempString, sizeof(TempString));
-    GetSmbiosString (Type1Record->SerialNumber, StringTable, TempString, MAX_BUFFER_SIZE);
-    Print (L"Serial Number: %s\n", TempString);
-  } else {
-    Print (L"Serial Number: <Not Specified>\n");
-  }
+  @param Data       Данные переменной
+  @param DataSize   Размер данных
+  @param Text       Буфер строки
+  @param TextSize   Размер буфера в символах
+**/
+VOID
+VariableDataToText (
+  IN  CONST VOID  *Data,
+  IN  UINTN       DataSize,
+  OUT CHAR16      *Text,
+  IN  UINTN       TextSize
+  )
+{
+  TEXT_INFO  Info;
   
-  // Выводим UUID если он доступен
-  if (!Type1Record->Uuid.Data1) {
-    Print (L"UUID: <Not Specified>\n");
-  } else {
-    Print (L"UUID: %08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X\n",
-           Type1Record->Uuid.Data1, Type1Record->Uuid.Data2, Type1Record->Uuid.Data3,
-           Type1Record->Uuid.Data4[0], Type1Record->Uuid.Data4[1], Type1Record->Uuid.Data4[2],
-           Type1Record->Uuid.Data4[3], Type1Record->Uuid.Data4[4], Type1Record->Uuid.Data4[5],
-           Type1Record->Uuid.Data4[6], Type1Record->Uuid.Data4[7]);
-  }
+  TextClassify (Data, DataSize, &Info);
+  TextDecode (Data, &Info, Text, TextSize);
 }
 
 /**
-  Выводит подробную информацию о материнской плате из SMBIOS.
+  Добавляет в таблицу сверки строку вида ПОЛЕ=ИСТОЧНИК.
+  Источник: var:ИМЯ[@GUID], lit:ТЕКСТ или file:ПУТЬ; без префикса - имя переменной.
   
-  @retval EFI_SUCCESS         Информация успешно выведена
-  @retval другое              Ошибка при получении информации
+  @param Plan   Таблица сверки
+  @param Spec   Спецификация строки
+  
+  @retval EFI_SUCCESS           Строка добавлена
+  @retval EFI_INVALID_PARAMETER Неизвестное поле или неверный источник
+  @retval EFI_OUT_OF_RESOURCES  Недостаточно памяти
 **/
 EFI_STATUS
-DisplayBaseBoardInfo (
-  VOID
+VerifyPlanAdd (
+  IN OUT VERIFY_PLAN   *Plan,
+  IN     CONST CHAR16  *Spec
   )
 {
-  EFI_STATUS                Status;
-  EFI_SMBIOS_PROTOCOL       *Smbios;
-  EFI_SMBIOS_HANDLE         SmbiosHandle;
-  EFI_SMBIOS_TABLE_HEADER   *Record;
-  SMBIOS_TABLE_TYPE2        *Type2Record;
-  CHAR8                     *StringTable;
-  CHAR16                    TempString[MAX_BUFFER_SIZE];
-  
-  // Получаем доступ к SMBIOS протоколу
-  Status = gBS->LocateProtocol (
-                &gEfiSmbiosProtocolGuid,
-                NULL,
-                (VOID **)&Smbios
-                );
-                
-  if (EFI_ERROR (Status)) {
-    Print (L"Error: Failed to locate SMBIOS protocol: %r\n", Status);
-    return Status;
+  CONST CHAR16  *Separator;
+  CONST CHAR16  *Source;
+  VERIFY_ENTRY  *Entry;
+  VERIFY_ENTRY  *NewEntries;
+  CHAR16        FieldName[32];
+  CHAR16        *At;
+  UINTN         Length;
+  UINTN         Index;
+  
+  Separator = StrStr (Spec, L"=");
+  if (Separator == NULL || Separator == Spec || (UINTN)(Separator - Spec) >= ARRAY_SIZE (FieldName)) {
+    Print (L"Error: Verify entry '%s' must look like FIELD=SOURCE\n", Spec);
+    return EFI_INVALID_PARAMETER;
   }
   
-  // Находим запись с информацией о материнской плате (Type 2)
-  SmbiosHandle = SMBIOS_HANDLE_PI_RESERVED;
-  Status = Smbios->GetNext (Smbios, &SmbiosHandle, NULL, &Record, NULL);
-  
-  while (!EFI_ERROR (Status) && Record->Type != SMBIOS_TYPE_BASEBOARD_INFORMATION) {
-    Status = Smbios->GetNext (Smbios, &SmbiosHandle, NULL, &Record, NULL);
-  }
+  Length = Separator - Spec;
+  CopyMem (FieldName, Spec, Length * sizeof (CHAR16));
+  FieldName[Length] = L'\0';
   
-  if (EFI_ERROR (Status)) {
-    Print (L"Error: Baseboard Information record not found in SMBIOS: %r\n", Status);
-    return Status;
+  if (Plan->Count == Plan->Capacity) {
+    NewEntries = ReallocatePool (
+                   Plan->Capacity * sizeof (VERIFY_ENTRY),
+                   (Plan->Capacity + 8) * sizeof (VERIFY_ENTRY),
+                   Plan->Entries
+                   );
+    if (NewEntries == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Plan->Entries = NewEntries;
+    Plan->Capacity += 8;
   }
   
-  // Получаем запись Type 2 (Baseboard Information)
-  Type2Record = (SMBIOS_TABLE_TYPE2 *)Record;
-  
-  Print (L"\n===== Baseboard Information =====\n\n");
+  Entry = &Plan->Entries[Plan->Count];
+  ZeroMem (Entry, sizeof (VERIFY_ENTRY));
   
-  // Находим таблицу строк (она идет сразу после структуры)
-  StringTable = (CHAR8 *)((UINT8 *)Type2Record + Type2Record->Hdr.Length);
-  
-  // Выводим информацию о производителе
-  if (Type2Record->Manufacturer != 0) {
-    ZeroMem (TempString, sizeof(TempString));
-    GetSmbiosString (Type2Record->Manufacturer, StringTable, TempString, MAX_BUFFER_SIZE);
-    Print (L"Manufacturer: %s\n", TempString);
-  } else {
-    Print (L"Manufacturer: <Not Specified>\n");
-  }
-  
-  // Выводим информацию о продукте
-  if (Type2Record->ProductName != 0) {
-    ZeroMem (TempString, sizeof(TempString));
-    GetSmbiosString (Type2Record->ProductName, StringTable, TempString, MAX_BUFFER_SIZE);
-    Print (L"Product Name: %s\n", TempString);
-  } else {
-    Print (L"Product Name: <Not Specified>\n");
+  for (Index = 0; Index < ARRAY_SIZE (mVerifyFields); Index++) {
+    if (TextEqualsNoCase (mVerifyFields[Index].Name, FieldName)) {
+      Entry->Field = &mVerifyFields[Index];
+      break;
+    }
   }
-  
-  // Выводим информацию о версии
-  if (Type2Record->Version != 0) {
-    ZeroMem (TempString, sizeof(TempString));
-    GetSmbiosString (Type2Record->Version, StringTable, TempString, MAX_BUFFER_SIZE);
-    Print (L"Version: %s\n", TempString);
-  } else {
-    Print (L"Version: <Not Specified>\n");
+  if (Entry->Field == NULL) {
+    Print (L"Error: Unknown SMBIOS field '%s' (see --help for the list)\n", FieldName);
+    return EFI_INVALID_PARAMETER;
   }
   
-  // Выводим серийный номер
-  if (Type2Record->SerialNumber != 0) {
-    ZeroMem (TempString, sizeof(TempString));
-    GetSmbiosString (Type2Record->SerialNumber, StringTable, TempString, MAX_BUFFER_SIZE);
-    Print (L"Serial Number: %s\n", TempString);
+  Source = Separator + 1;
+  if (StrnCmp (Source, L"lit:", 4) == 0) {
+    Entry->SourceKind = VERIFY_SOURCE_LITERAL;
+    Source += 4;
+  } else if (StrnCmp (Source, L"file:", 5) == 0) {
+    Entry->SourceKind = VERIFY_SOURCE_FILE;
+    Source += 5;
   } else {
-    Print (L"Serial Number: <Not Specified>\n");
+    Entry->SourceKind = VERIFY_SOURCE_VARIABLE;
+    if (StrnCmp (Source, L"var:", 4) == 0) {
+      Source += 4;
+    }
   }
   
-  // Выводим тег актива
-  if (Type2Record->AssetTag != 0) {
-    ZeroMem (TempString, sizeof(TempString));
-    GetSmbiosString (Type2Record->AssetTag, StringTable, TempString, MAX_BUFFER_SIZE);
-    Print (L"Asset Tag: %s\n", TempString);
-  } else {
-    Print (L"Asset Tag: <Not Specified>\n");
+  Entry->Source = AllocateCopyPool (StrSize (Source), Source);
+  if (Entry->Source == NULL) {
+    return EFI_OUT_OF_RESOURCES;
   }
   
-  // Выводим особенности платы
-  Print (L"Feature Flags: 0x%02X\n", Type2Record->FeatureFlag);
-  if (Type2Record->FeatureFlag.Motherboard)            Print(L"  - Hosting Board\n");
-  if (Type2Record->FeatureFlag.RequiresDaughterCard)   Print(L"  - Requires Daughter Board\n");
-  if (Type2Record->FeatureFlag.Removable)              Print(L"  - Removable\n");
-  if (Type2Record->FeatureFlag.Replaceable)            Print(L"  - Replaceable\n");
-  if (Type2Record->FeatureFlag.HotSwappable)           Print(L"  - Hot Swappable\n");
-
-
-  
-  // Выводим расположение в шасси
-  if (Type2Record->LocationInChassis != 0) {
-    ZeroMem (TempString, sizeof(TempString));
-    GetSmbiosString (Type2Record->LocationInChassis, StringTable, TempString, MAX_BUFFER_SIZE);
-    Print (L"Location in Chassis: %s\n", TempString);
-  } else {
-    Print (L"Location in Chassis: <Not Specified>\n");
-  }
-  
-  // Выводим тип платы
-  CONST CHAR16 *BoardTypes[] = {
-    L"Unknown",
-    L"Other",
-    L"Server Blade",
-    L"Connectivity Switch",
-    L"System Management Module",
-    L"Processor Module",
-    L"I/O Module",
-    L"Memory Module",
-    L"Daughter Board",
-    L"Motherboard",
-    L"Processor/Memory Module",
-    L"Processor/IO Module",
-    L"Interconnect Board"
-  };
-  
-  UINT8 BoardType = Type2Record->BoardType;
-  if (BoardType < (sizeof(BoardTypes) / sizeof(BoardTypes[0]))) {
-    Print (L"Board Type: %s\n", BoardTypes[BoardType]);
-  } else {
-    Print (L"Board Type: Unknown (%d)\n", BoardType);
+  // Для переменной после '@' может идти префикс GUID
+  if (Entry->SourceKind == VERIFY_SOURCE_VARIABLE) {
+    At = StrStr (Entry->Source, L"@");
+    if (At != NULL) {
+      *At = L'\0';
+      if (!ParseGuidPattern (At + 1, &Entry->Guid)) {
+        Print (L"Error: Invalid GUID prefix '%s' in verify entry '%s'\n", At + 1, Spec);
+        FreePool (Entry->Source);
+        return EFI_INVALID_PARAMETER;
+      }
+      Entry->GuidSpecified = TRUE;
+    }
+    if (Entry->Source[0] == L'\0') {
+      Print (L"Error: Missing variable name in verify entry '%s'\n", Spec);
+      FreePool (Entry->Source);
+      return EFI_INVALID_PARAMETER;
+    }
   }
   
-  // Выводим дополнительную информацию о системе из Type 1
-  PrintSystemInfo();
-  
+  Plan->Count++;
   return EFI_SUCCESS;
 }
 
 /**
-  Сравнивает два MAC-адреса в формате ASCII строк с учетом разных форматов.
+  Добавляет в таблицу сверки строки из текстового файла (по одной ПОЛЕ=ИСТОЧНИК
+  в строке, '#' - комментарий, пустые строки пропускаются).
   
-  @param Mac1     Первый MAC-адрес
-  @param Mac2     Второй MAC-адрес
+  @param Plan       Таблица сверки
+  @param FilePath   Путь к файлу
   
-  @retval TRUE    MAC-адреса совпадают
-  @retval FALSE   MAC-адреса не совпадают
+  @retval EFI_SUCCESS   Строки добавлены
+  @retval другое        Ошибка чтения файла или разбора строки
 **/
-BOOLEAN
-CompareMacAddresses (
-  IN CONST CHAR8  *Mac1,
-  IN CONST CHAR8  *Mac2
+EFI_STATUS
+VerifyPlanAddFromFile (
+  IN OUT VERIFY_PLAN   *Plan,
+  IN     CONST CHAR16  *FilePath
   )
 {
-  UINT8 BinaryMac1[6] = {0};
-  UINT8 BinaryMac2[6] = {0};
-  CHAR8 NormalizedMac1[13] = {0}; // 12 hex chars + null terminator
-  CHAR8 NormalizedMac2[13] = {0}; // 12 hex chars + null terminator
-  UINTN Mac1Len, Mac2Len;
-  UINTN Index, OutIndex;
-  
-  if (Mac1 == NULL || Mac2 == NULL) {
-    return FALSE;
+  EFI_STATUS         Status;
+  SHELL_FILE_HANDLE  FileHandle;
+  CHAR16             *Line;
+  CHAR16             *Text;
+  UINTN              Length;
+  BOOLEAN            Ascii;
+  
+  Status = ShellOpenFileByName (FilePath, &FileHandle, EFI_FILE_MODE_READ, 0);
+  if (EFI_ERROR (Status)) {
+    Print (L"Error: Failed to open '%s': %r\n", FilePath, Status);
+    return Status;
   }
   
-  Mac1Len = AsciiStrLen(Mac1);
-  Mac2Len = AsciiStrLen(Mac2);
-  
-  // Нормализация первого MAC - удаляем разделители и преобразуем в верхний регистр
-  OutIndex = 0;
-  for (Index = 0; Index < Mac1Len && OutIndex < 12; Index++) {
-    // Пропускаем разделители и пробелы
-    if (Mac1[Index] == ':' || Mac1[Index] == '-' || Mac1[Index] == ' ' || Mac1[Index] == '.') {
-      continue;
+  while (!EFI_ERROR (Status) && !ShellFileHandleEof (FileHandle)) {
+    Line = ShellFileHandleReadLine (FileHandle, &Ascii);
+    if (Line == NULL) {
+      break;
     }
     
-    // Преобразуем строчные буквы в заглавные
-    if (Mac1[Index] >= 'a' && Mac1[Index] <= 'f') {
-      NormalizedMac1[OutIndex++] = Mac1[Index] - ('a' - 'A');
-    } else {
-      NormalizedMac1[OutIndex++] = Mac1[Index];
+    Text = Line;
+    while (*Text == L' ' || *Text == L'\t') {
+      Text++;
     }
-  }
-  NormalizedMac1[OutIndex] = '\0';
-  
-  // Нормализация второго MAC - удаляем разделители и преобразуем в верхний регистр
-  OutIndex = 0;
-  for (Index = 0; Index < Mac2Len && OutIndex < 12; Index++) {
-    // Пропускаем разделители и пробелы
-    if (Mac2[Index] == ':' || Mac2[Index] == '-' || Mac2[Index] == ' ' || Mac2[Index] == '.') {
-      continue;
+    Length = StrLen (Text);
+    while (Length > 0 && (Text[Length - 1] == L' ' || Text[Length - 1] == L'\t' || Text[Length - 1] == L'\r')) {
+      Text[--Length] = L'\0';
     }
-    
-    // Преобразуем строчные буквы в заглавные
-    if (Mac2[Index] >= 'a' && Mac2[Index] <= 'f') {
-      NormalizedMac2[OutIndex++] = Mac2[Index] - ('a' - 'A');
-    } else {
-      NormalizedMac2[OutIndex++] = Mac2[Index];
+    if (Length > 0 && *Text != L'#') {
+      Status = VerifyPlanAdd (Plan, Text);
     }
-  }
-  NormalizedMac2[OutIndex] = '\0';
-  
-  // Если нормализованные строки имеют по 12 символов (6 байт MAC), сравниваем их
-  if (AsciiStrLen(NormalizedMac1) == 12 && AsciiStrLen(NormalizedMac2) == 12) {
-    // Для отладки
-    Print(L"Normalized MAC 1: %a\n", NormalizedMac1);
-    Print(L"Normalized MAC 2: %a\n", NormalizedMac2);
     
-    return (AsciiStrnCmp(NormalizedMac1, NormalizedMac2, 12) == 0);
-  }
-  
-  // Если нормализация не сработала, попробуем преобразовать их в бинарный формат
-  // и затем сравнить
-  
-  // Преобразуем нормализованный первый MAC в бинарный формат
-  if (AsciiStrLen(NormalizedMac1) == 12) {
-    for (Index = 0; Index < 6; Index++) {
-      CHAR8 HexByte[3] = {NormalizedMac1[Index*2], NormalizedMac1[Index*2+1], '\0'};
-      UINT8 Value = 0;
-      
-      // Первый символ
-      if (HexByte[0] >= '0' && HexByte[0] <= '9') {
-        Value = (HexByte[0] - '0') << 4;
-      } else if (HexByte[0] >= 'A' && HexByte[0] <= 'F') {
-        Value = (HexByte[0] - 'A' + 10) << 4;
-      } else {
-        return FALSE; // Некорректный символ
-      }
-      
-      // Второй символ
-      if (HexByte[1] >= '0' && HexByte[1] <= '9') {
-        Value |= (HexByte[1] - '0');
-      } else if (HexByte[1] >= 'A' && HexByte[1] <= 'F') {
-        Value |= (HexByte[1] - 'A' + 10);
-      } else {
-        return FALSE; // Некорректный символ
-      }
-      
-      BinaryMac1[Index] = Value;
-    }
-  }
-  
-  // Преобразуем нормализованный второй MAC в бинарный формат
-  if (AsciiStrLen(NormalizedMac2) == 12) {
-    for (Index = 0; Index < 6; Index++) {
-      CHAR8 HexByte[3] = {NormalizedMac2[Index*2], NormalizedMac2[Index*2+1], '\0'};
-      UINT8 Value = 0;
-      
-      // Первый символ
-      if (HexByte[0] >= '0' && HexByte[0] <= '9') {
-        Value = (HexByte[0] - '0') << 4;
-      } else if (HexByte[0] >= 'A' && HexByte[0] <= 'F') {
-        Value = (HexByte[0] - 'A' + 10) << 4;
-      } else {
-        return FALSE; // Некорректный символ
-      }
-      
-      // Второй символ
-      if (HexByte[1] >= '0' && HexByte[1] <= '9') {
-        Value |= (HexByte[1] - '0');
-      } else if (HexByte[1] >= 'A' && HexByte[1] <= 'F') {
-        Value |= (HexByte[1] - 'A' + 10);
-      } else {
-        return FALSE; // Некорректный символ
-      }
-      
-      BinaryMac2[Index] = Value;
-    }
-  }
-  
-  // Для отладки
-  if (AsciiStrLen(NormalizedMac1) == 12 && AsciiStrLen(NormalizedMac2) == 12) {
-    Print(L"Binary MAC 1: %02X:%02X:%02X:%02X:%02X:%02X\n",
-          BinaryMac1[0], BinaryMac1[1], BinaryMac1[2],
-          BinaryMac1[3], BinaryMac1[4], BinaryMac1[5]);
-    Print(L"Binary MAC 2: %02X:%02X:%02X:%02X:%02X:%02X\n",
-          BinaryMac2[0], BinaryMac2[1], BinaryMac2[2],
-          BinaryMac2[3], BinaryMac2[4], BinaryMac2[5]);
+    FreePool (Line);
   }
   
-  // Сравниваем бинарные MAC-адреса
-  return (CompareMem(BinaryMac1, BinaryMac2, 6) == 0);
+  ShellCloseFile (&FileHandle);
+  return Status;
 }
 
 /**
-  Преобразует бинарный MAC-адрес в строку формата XX:XX:XX:XX:XX:XX.
+  Освобождает таблицу сверки.
   
-  @param MacAddr       Указатель на бинарный MAC-адрес (6 байт)
-  @param MacAddrStr    Буфер для строки (минимум 18 байт)
+  @param Plan   Таблица сверки
 **/
 VOID
-FormatMacAddress (
-  IN  UINT8   *MacAddr,
-  OUT CHAR8   *MacAddrStr
+FreeVerifyPlan (
+  IN OUT VERIFY_PLAN  *Plan
   )
 {
-  if (MacAddr == NULL || MacAddrStr == NULL) {
-    return;
-  }
+  UINTN  Index;
   
-  AsciiSPrint(
-    MacAddrStr,
-    18, // 17 символов + нулевой байт
-    "%02X:%02X:%02X:%02X:%02X:%02X",
-    MacAddr[0], MacAddr[1], MacAddr[2],
-    MacAddr[3], MacAddr[4], MacAddr[5]
-  );
+  for (Index = 0; Index < Plan->Count; Index++) {
+    FreePool (Plan->Entries[Index].Source);
+  }
+  if (Plan->Entries != NULL) {
+    FreePool (Plan->Entries);
+  }
+  ZeroMem (Plan, sizeof (VERIFY_PLAN));
 }
 
 /**
-  Получает MAC-адрес из переменной UEFI и преобразует его в ASCII формат.
+  Читает первую строку файла как ожидаемое значение (ASCII или UCS-2 с BOM).
   
-  @param VariableName    Имя переменной UEFI с MAC-адресом
-  @param VariableGuid    GUID переменной UEFI (может быть NULL для поиска по всем GUID)
-  @param MacString       Буфер для MAC-адреса в ASCII формате
-  @param MacStringSize   Размер буфера
-  @param FoundGuid       Указатель на буфер для найденного GUID (может быть NULL)
+  @param FilePath   Путь к файлу
+  @param Text       Буфер значения
+  @param TextSize   Размер буфера в символах
   
-  @retval EFI_SUCCESS    MAC-адрес успешно получен и преобразован
-  @retval другое         Ошибка при получении или преобразовании
+  @retval EFI_SUCCESS   Значение прочитано
+  @retval другое        Ошибка открытия или чтения файла
 **/
 EFI_STATUS
-GetMacAddressAsAscii (
-  IN  CONST CHAR16    *VariableName,
-  IN  EFI_GUID        *VariableGuid,
-  OUT CHAR8           *MacString,
-  IN  UINTN           MacStringSize,
-  OUT EFI_GUID        *FoundGuid OPTIONAL
+ReadVerifyFileValue (
+  IN  CONST CHAR16  *FilePath,
+  OUT CHAR16        *Text,
+  IN  UINTN         TextSize
   )
 {
-  EFI_STATUS  Status;
-  VOID        *MacData = NULL;
-  UINTN       MacDataSize = 0;
-  UINTN       StringLen = 0;
-  UINTN       Index;
-  
-  // Проверяем входные параметры
-  if (VariableName == NULL || MacString == NULL || MacStringSize == 0) {
-    return EFI_INVALID_PARAMETER;
-  }
-  
-  // Инициализируем выходной буфер
-  ZeroMem (MacString, MacStringSize);
+  EFI_STATUS         Status;
+  SHELL_FILE_HANDLE  FileHandle;
+  CHAR16             *Line;
+  UINTN              Length;
+  BOOLEAN            Ascii;
   
-  // Получаем данные MAC-адреса из переменной UEFI
-  Status = GetVariableData (
-            VariableName,
-            VariableGuid,
-            &MacData,
-            &MacDataSize,
-            FoundGuid
-            );
-            
+  Status = ShellOpenFileByName (FilePath, &FileHandle, EFI_FILE_MODE_READ, 0);
   if (EFI_ERROR (Status)) {
     return Status;
   }
   
-  Print(L"DEBUG: MAC variable size: %d bytes\n", MacDataSize);
-  Print(L"DEBUG: MAC variable raw data: ");
-  for (Index = 0; Index < MIN(MacDataSize, 20); Index++) {
-    Print(L"%02X ", ((UINT8*)MacData)[Index]);
+  Line = ShellFileHandleReadLine (FileHandle, &Ascii);
+  ShellCloseFile (&FileHandle);
+  if (Line == NULL) {
+    return EFI_END_OF_FILE;
   }
-  Print(L"\n");
   
-  // Проверяем размер данных для разных форматов
-  if (MacDataSize == 6) {
-    // Бинарный MAC-адрес (6 байт)
-    Print(L"DEBUG: Detected binary MAC format (6 bytes)\n");
-    FormatMacAddress((UINT8*)MacData, MacString);
-  } else if (MacDataSize >= 2 && ((CHAR16*)MacData)[MacDataSize/2 - 1] == 0) {
-    // Данные в UCS-2 формате, конвертируем в ASCII
-    Print(L"DEBUG: Detected UCS-2 string format\n");
-    CHAR16 *UnicodeData = (CHAR16*)MacData;
-    StringLen = StrLen(UnicodeData);
-    
-    Print(L"DEBUG: UCS-2 MAC string: %s\n", UnicodeData);
-    
-    // Проверяем, что буфер достаточного размера
-    if (StringLen >= MacStringSize) {
-      StringLen = MacStringSize - 1;
-    }
+  Length = StrLen (Line);
+  while (Length > 0 && (Line[Length - 1] == L'\r' || Line[Length - 1] == L'\n')) {
+    Line[--Length] = L'\0';
+  }
+  StrnCpyS (Text, TextSize, Line, MIN (Length, TextSize - 1));
+  FreePool (Line);
+  
+  return EFI_SUCCESS;
+}
+
+/**
+  Получает ожидаемые значения всех строк таблицы. Переменные без полного GUID
+  разрешаются по одному индексу хранилища, построенному за один проход.
+  Строки с полученным значением получают результат VERIFY_PENDING.
+  
+  @param Plan   Таблица сверки
+**/
+VOID
+VerifyPlanLoadExpected (
+  IN OUT VERIFY_PLAN  *Plan
+  )
+{
+  EFI_STATUS       Status;
+  VERIFY_ENTRY     *Entry;
+  VAR_STORE_INDEX  *VarIndex;
+  VAR_INDEX_ENTRY  *IndexEntry;
+  EFI_GUID         Guid;
+  VOID             *Data;
+  UINTN            DataSize;
+  UINTN            Index;
+  
+  VarIndex = NULL;
+  
+  for (Index = 0; Index < Plan->Count; Index++) {
+    Entry = &Plan->Entries[Index];
+    Entry->Result = VERIFY_NO_SOURCE;
     
-    // Конвертируем Unicode в ASCII
-    for (Index = 0; Index < StringLen; Index++) {
-      MacString[Index] = (CHAR8)UnicodeData[Index];
-    }
-    MacString[StringLen] = '\0';
-  } else {
-    // Предполагаем, что данные уже в ASCII формате
-    Print(L"DEBUG: Assuming ASCII string format\n");
-    StringLen = MacDataSize < MacStringSize ? MacDataSize : MacStringSize - 1;
-    
-    // Если последний байт равен 0, это может быть ASCII строка с нулевым завершением
-    if (MacDataSize > 0 && ((UINT8*)MacData)[MacDataSize-1] == 0) {
-      // Это ASCII строка с нулевым завершением, копируем её
-      AsciiStrCpyS(MacString, MacStringSize, (CHAR8*)MacData);
-      Print(L"DEBUG: Found null-terminated ASCII string\n");
-    } else {
-      // Копируем данные как есть
-      CopyMem(MacString, MacData, StringLen);
-      MacString[StringLen] = '\0';
+    switch (Entry->SourceKind) {
+    case VERIFY_SOURCE_LITERAL:
+      // Длина текста в командной строке не ограничена, копируем не больше поля
+      if (StrLen (Entry->Source) >= MAX_BUFFER_SIZE) {
+        Print (L"Warning: Value for %s is longer than %u characters and is truncated\n",
+               Entry->Field->Name, MAX_BUFFER_SIZE - 1);
+      }
+      StrnCpyS (Entry->Expected, MAX_BUFFER_SIZE, Entry->Source, MAX_BUFFER_SIZE - 1);
+      Entry->Result = VERIFY_PENDING;
+      break;
+      
+    case VERIFY_SOURCE_FILE:
+      if (!EFI_ERROR (ReadVerifyFileValue (Entry->Source, Entry->Expected, MAX_BUFFER_SIZE))) {
+        Entry->Result = VERIFY_PENDING;
+      }
+      break;
+      
+    case VERIFY_SOURCE_VARIABLE:
+      // Полный GUID читается напрямую, остальные имена - через общий индекс хранилища
+      if (!Entry->GuidSpecified || !GuidPatternToGuid (&Entry->Guid, &Guid)) {
+        if (VarIndex == NULL && EFI_ERROR (GetVariableIndex (&VarIndex))) {
+          break;
+        }
+        IndexEntry = VarIndexResolveName (VarIndex, Entry->Source, Entry->GuidSpecified ? &Entry->Guid : NULL);
+        if (IndexEntry == NULL) {
+          break;
+        }
+        CopyGuid (&Guid, &IndexEntry->Guid);
+      }
+      
+      Status = ReadVariablePooled (Entry->Source, &Guid, &Data, &DataSize, NULL);
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+      
+      // UUID может храниться в переменной двоичным GUID
+      if (Entry->Field->Kind == VERIFY_FIELD_UUID && DataSize == sizeof (EFI_GUID)) {
+        UnicodeSPrint (Entry->Expected, sizeof (Entry->Expected), L"%g", Data);
+      } else {
+        VariableDataToText (Data, DataSize, Entry->Expected, MAX_BUFFER_SIZE);
+      }
+      Entry->Result = VERIFY_PENDING;
+      break;
     }
   }
+}
+
+/**
+  Получает значения полей SMBIOS для всех строк таблицы из общего индекса SMBIOS
+  и сверяет их с ожидаемыми. Поля Type 2 берутся с первой платы, выбранной так же,
+  как в CheckSerialNumber.
   
-  Print(L"DEBUG: Final ASCII MAC string: %a\n", MacString);
+  @param Plan           Таблица сверки
+  @param BoardLocation  Расположение платы (NULL - основная плата)
+**/
+VOID
+VerifyPlanCompare (
+  IN OUT VERIFY_PLAN   *Plan,
+  IN     CONST CHAR16  *BoardLocation OPTIONAL
+  )
+{
+  VERIFY_ENTRY         *Entry;
+  CONST SMBIOS_RECORD  *Record;
+  BASEBOARD_INSTANCE   *Boards;
+  UINTN                BoardCount;
+  UINTN                Board;
+  ASCII_VIEW           View;
+  TEXT_VIEW            ExpectedView;
+  TEXT_VIEW            ActualView;
+  EFI_GUID             Uuid;
+  UINTN                Index;
+  BOOLEAN              Found;
+  
+  if (EFI_ERROR (CollectBaseBoards (&Boards, &BoardCount))) {
+    Boards = NULL;
+    BoardCount = 0;
+  }
   
-  // Проверяем, что получившаяся строка является валидным MAC-адресом
-  // и добавляем разделители, если их нет
-  if (AsciiStrLen(MacString) == 12) {
-    // Формат без разделителей (AABBCCDDEEFF), преобразуем в формат с разделителями
-    CHAR8 TempMacString[18];
+  for (Index = 0; Index < Plan->Count; Index++) {
+    Entry = &Plan->Entries[Index];
+    if (Entry->Result != VERIFY_PENDING) {
+      continue;
+    }
     
-    // Проверяем, что все символы являются шестнадцатеричными
-    for (Index = 0; Index < 12; Index++) {
-      if (!((MacString[Index] >= '0' && MacString[Index] <= '9') ||
-            (MacString[Index] >= 'A' && MacString[Index] <= 'F') ||
-            (MacString[Index] >= 'a' && MacString[Index] <= 'f'))) {
-        break;
+    // Находим запись: для плат - выбранную плату, для остальных типов - первую запись
+    Record = NULL;
+    if (Entry->Field->Type == SMBIOS_TYPE_BASEBOARD_INFORMATION) {
+      for (Board = 0; Board < BoardCount; Board++) {
+        if (IsBaseBoardSelected (Boards, BoardCount, Board, BoardLocation)) {
+          Record = Boards[Board].Record;
+          break;
+        }
       }
+    } else if (EFI_ERROR (SmbiosFindRecord (Entry->Field->Type, 0, &Record))) {
+      Record = NULL;
     }
     
-    // Если все символы шестнадцатеричные, форматируем строку
-    if (Index == 12) {
-      AsciiSPrint(
-        TempMacString,
-        sizeof(TempMacString),
-        "%c%c:%c%c:%c%c:%c%c:%c%c:%c%c",
-        MacString[0], MacString[1], MacString[2], MacString[3],
-        MacString[4], MacString[5], MacString[6], MacString[7],
-        MacString[8], MacString[9], MacString[10], MacString[11]
-      );
-      
-      AsciiStrCpyS(MacString, MacStringSize, TempMacString);
-      Print(L"DEBUG: Reformatted MAC with separators: %a\n", MacString);
+    Found = FALSE;
+    if (Record != NULL) {
+      if (Entry->Field->Kind == VERIFY_FIELD_UUID) {
+        if (SmbiosReadField (Record, Entry->Field->Offset, sizeof (EFI_GUID), &Uuid)) {
+          UnicodeSPrint (Entry->Actual, sizeof (Entry->Actual), L"%g", &Uuid);
+          Found = TRUE;
+        }
+      } else if (!EFI_ERROR (SmbiosGetString (Record, Entry->Field->Offset, &View))) {
+        AsciiViewToUnicode (&View, Entry->Actual, MAX_BUFFER_SIZE);
+        Found = TRUE;
+      }
+    }
+    
+    if (!Found) {
+      Entry->Result = VERIFY_NO_FIELD;
+    } else if (Entry->Field->Kind == VERIFY_FIELD_UUID) {
+      Entry->Result = TextEqualsNoCase (Entry->Expected, Entry->Actual) ? VERIFY_MATCH : VERIFY_MISMATCH;
+    } else {
+      // Правила серийного номера - только для полей Serial, остальные строки сравниваются как есть
+      TextViewFromString (Entry->Expected, &ExpectedView);
+      TextViewFromAscii (&View, &ActualView);
+      if (Entry->Field->Kind == VERIFY_FIELD_SERIAL) {
+        Entry->Result = SnEquals (&ExpectedView, &ActualView) ? VERIFY_MATCH : VERIFY_MISMATCH;
+      } else {
+        Entry->Result = TextEqualsTrimmed (&ExpectedView, &ActualView) ? VERIFY_MATCH : VERIFY_MISMATCH;
+      }
     }
   }
   
-  // Освобождаем память
-  if (MacData != NULL) {
-    FreePool (MacData);
+  if (Boards != NULL) {
+    FreePool (Boards);
   }
-  
-  return EFI_SUCCESS;
 }
 
 /**
-  Выводит MAC-адрес в читаемом формате.
+  Сверяет поля SMBIOS с ожидаемыми значениями по таблице сверки и выводит отчёт
+  по каждому полю. Хранилище переменных и SMBIOS обходятся по одному разу.
+  
+  @param Plan           Таблица сверки
+  @param BoardLocation  Расположение платы для полей Type 2 (NULL - основная плата)
   
-  @param MacAddr  Указатель на строку с MAC-адресом
+  @retval EFI_SUCCESS       Все поля совпадают
+  @retval EFI_NOT_FOUND     Ожидаемое значение или поле SMBIOS не получено
+  @retval EFI_DEVICE_ERROR  Есть несовпадения
 **/
-VOID
-PrintMacAddress (
-  IN CONST CHAR8  *MacAddr
+EFI_STATUS
+RunVerifyPlan (
+  IN OUT VERIFY_PLAN   *Plan,
+  IN     CONST CHAR16  *BoardLocation OPTIONAL
   )
 {
-  // Проверяем входной параметр
-  if (MacAddr == NULL) {
-    Print (L"<Invalid MAC Address>\n");
-    return;
+  VERIFY_ENTRY  *Entry;
+  UINTN         Index;
+  UINTN         Counts[ARRAY_SIZE (mVerifyResultNames)];
+  
+  VerifyPlanLoadExpected (Plan);
+  VerifyPlanCompare (Plan, BoardLocation);
+  
+  ZeroMem (Counts, sizeof (Counts));
+  
+  Print (L"%-16s %-10s %s\n", L"Field", L"Result", L"Expected / SMBIOS");
+  for (Index = 0; Index < Plan->Count; Index++) {
+    Entry = &Plan->Entries[Index];
+    Counts[Entry->Result]++;
+    
+    Print (L"%-16s %-10s ", Entry->Field->Name, mVerifyResultNames[Entry->Result]);
+    switch (Entry->Result) {
+    case VERIFY_NO_SOURCE:
+      Print (L"cannot read %s '%s'\n",
+             Entry->SourceKind == VERIFY_SOURCE_FILE ? L"file" : L"variable",
+             Entry->Source);
+      break;
+    case VERIFY_NO_FIELD:
+      Print (L"\"%s\" / <not present>\n", Entry->Expected);
+      break;
+    default:
+      Print (L"\"%s\" / \"%s\"\n", Entry->Expected, Entry->Actual);
+      break;
+    }
   }
   
-  // Выводим MAC-адрес, преобразуя ASCII в CHAR16 для Print
-  UINTN i;
-  for (i = 0; MacAddr[i] != '\0' && i < 100; i++) {
-    Print (L"%c", (CHAR16)MacAddr[i]);
+  Print (L"\n%u fields: %u match, %u mismatch, %u without source, %u missing in SMBIOS\n",
+         Plan->Count, Counts[VERIFY_MATCH], Counts[VERIFY_MISMATCH],
+         Counts[VERIFY_NO_SOURCE], Counts[VERIFY_NO_FIELD]);
+  
+  if (Counts[VERIFY_MISMATCH] != 0) {
+    return EFI_DEVICE_ERROR;
   }
-  Print (L"\n");
+  if (Counts[VERIFY_NO_SOURCE] != 0 || Counts[VERIFY_NO_FIELD] != 0) {
+    return EFI_NOT_FOUND;
+  }
+  return EFI_SUCCESS;
 }
 
 /**
-  Проверяет, соответствует ли MAC-адрес из UEFI переменной MAC-адресу сетевой карты.
-  
-  @param MacString     ASCII строка с MAC-адресом из UEFI переменной
-  @param DeviceName    Буфер для имени устройства с совпадающим MAC (может быть NULL)
-  @param DeviceNameSize Размер буфера для имени устройства
-  
-  @retval TRUE         MAC-адрес совпадает с MAC-адресом сетевой карты
-  @retval FALSE        MAC-адрес не совпадает ни с одним MAC-адресом
+  Проверяет серийный номер после прошивки. Таблица SMBIOS в памяти на многих
+  прошивках обновляется только после перезагрузки, поэтому в режиме AUTO при
+  несовпадении значения System и Baseboard Serial Number дополнительно читаются
+  через AMIDEEFI из постоянного хранилища DMI. AMIDEEFI /BS пишет и читает
+  только основную плату, поэтому при --board-loc чтение через AMIDEEFI
+  проверяет не ту плату, что сверка по SMBIOS; это сообщается в выводе.
+  
+  @param Config     Конфигурация проверки
+  @param SnString   Прошитый серийный номер
+  
+  @retval TRUE      Прошивка подтверждена
+  @retval FALSE     Прошитое значение не подтверждено
 **/
 BOOLEAN
-CheckMacAddressAgainstNetworkDevices (
-  IN  CONST CHAR8    *MacString,
-  OUT CHAR16         *DeviceName OPTIONAL,
-  IN  UINTN          DeviceNameSize
+VerifyFlashedSerial (
+  IN CHECK_CONFIG  *Config,
+  IN CONST CHAR16  *SnString
   )
 {
-  EFI_STATUS                     Status;
-  EFI_HANDLE                     *HandleBuffer;
-  UINTN                          HandleCount;
-  UINTN                          Index;
-  EFI_SIMPLE_NETWORK_PROTOCOL    *Snp;
-  EFI_DEVICE_PATH_PROTOCOL       *DevicePath;
-  CHAR8                          CurrentMacStr[18];
-  BOOLEAN                        Found = FALSE;
+  EFI_STATUS  Status;
+  CHAR16      Value[MAX_BUFFER_SIZE];
+  TEXT_VIEW   ValueView;
+  TEXT_VIEW   TargetView;
+  BOOLEAN     Matches;
+  UINTN       Index;
   
-  // Для отладки
-  Print(L"Target MAC: %a\n", MacString);
+  // Опции AMIDEEFI, которыми прошивается серийный номер (см. RunAmideefi)
+  STATIC CONST CHAR16 *CONST  ReadbackOptions[] = { L"/SS", L"/BS" };
+  STATIC CONST CHAR16 *CONST  ReadbackNames[] = { L"System", L"Baseboard" };
+  STATIC CONST CHAR16 *CONST  ReadbackLabels[] = { L"System Serial", L"Baseboard Serial" };
   
-  // Получаем список всех устройств с Simple Network Protocol
-  Status = gBS->LocateHandleBuffer(
-                  ByProtocol,
-                  &gEfiSimpleNetworkProtocolGuid,
-                  NULL,
-                  &HandleCount,
-                  &HandleBuffer
-                  );
-                  
-  if (EFI_ERROR(Status) || HandleCount == 0) {
-    Print(L"Warning: No network interfaces found on this system! Status: %r\n", Status);
-    return FALSE;
+  TextViewFromString (SnString, &TargetView);
+  
+  if (Config->VerifyMode != FLASH_VERIFY_READBACK) {
+    if (CheckSerialNumber (&TargetView, Config->BoardLocation)) {
+      return TRUE;
+    }
+    if (Config->VerifyMode == FLASH_VERIFY_SMBIOS) {
+      return FALSE;
+    }
+    Print (L"In-memory SMBIOS table may be stale, checking the DMI store through AMIDEEFI...\n");
   }
   
-  Print(L"Found %d network interfaces\n", HandleCount);
+  if (Config->BoardLocation != NULL) {
+    Print (L"Note: AMIDEEFI read-back covers only the primary baseboard, not the board at '%s'\n", Config->BoardLocation);
+  }
   
-  // Перебираем все сетевые устройства
-  for (Index = 0; Index < HandleCount; Index++) {
-    Status = gBS->HandleProtocol(
-                    HandleBuffer[Index],
-                    &gEfiSimpleNetworkProtocolGuid,
-                    (VOID **)&Snp
-                    );
-                    
-    if (EFI_ERROR(Status) || Snp == NULL) {
-      Print(L"Warning: Failed to get SNP for interface %d. Status: %r\n", Index, Status);
-      continue;
-    }
-    
-    // Проверяем, инициализирован ли протокол
-    if (Snp->Mode == NULL) {
-      Print(L"Warning: SNP Mode is NULL for interface %d\n", Index);
+  Matches = TRUE;
+  for (Index = 0; Index < ARRAY_SIZE (ReadbackOptions); Index++) {
+    Status = ReadAmideefiString (
+               Config->AmideEfiPath,
+               ReadbackOptions[Index],
+               ReadbackLabels[Index],
+               Value,
+               MAX_BUFFER_SIZE
+               );
+    if (EFI_ERROR (Status)) {
+      Print (L"%s Serial Number read-back (%s) failed: %r\n", ReadbackNames[Index], ReadbackOptions[Index], Status);
+      Matches = FALSE;
       continue;
     }
     
-    // Выводим информацию о состоянии сетевого интерфейса
-    Print(L"Network Interface %d State: %d\n", Index, Snp->Mode->State);
-    
-    // Выводим информацию о MAC-адресе
-    Print(L"Network Interface %d MAC: ", Index);
-    
-    // Преобразуем бинарный MAC-адрес в строку
-    FormatMacAddress(
-      &Snp->Mode->CurrentAddress.Addr[0],
-      CurrentMacStr
-    );
-    
-    // Выводим MAC-адрес
-    Print(L"%a\n", CurrentMacStr);
-    
-    // Сравниваем MAC-адреса
-    if (CompareMacAddresses(MacString, CurrentMacStr)) {
-      Print(L"MAC MATCH FOUND for interface %d!\n", Index);
-      Found = TRUE;
-      
-      // Если запрошено имя устройства, получаем его
-      if (DeviceName != NULL && DeviceNameSize > 0) {
-        ZeroMem(DeviceName, DeviceNameSize * sizeof(CHAR16));
-        
-        // Пытаемся получить Device Path для более дружественного имени
-        Status = gBS->HandleProtocol(
-                        HandleBuffer[Index],
-                        &gEfiDevicePathProtocolGuid,
-                        (VOID **)&DevicePath
-                        );
-                        
-        if (!EFI_ERROR(Status) && DevicePath != NULL) {
-          // Для простоты просто используем номер интерфейса
-          UnicodeSPrint(DeviceName, DeviceNameSize * sizeof(CHAR16), 
-                        L"Network Interface %u (MAC: ", Index);
-                        
-          // Добавляем MAC-адрес к имени
-          for (UINTN i = 0; i < AsciiStrLen(CurrentMacStr); i++) {
-            DeviceName[StrLen(DeviceName)] = (CHAR16)CurrentMacStr[i];
-          }
-          
-          // Закрываем скобку и завершаем строку
-          StrCatS(DeviceName, DeviceNameSize, L")");
-        } else {
-          // Если не удалось получить Device Path, используем индекс
-          UnicodeSPrint(DeviceName, DeviceNameSize * sizeof(CHAR16), 
-                        L"Network Interface %u (MAC: ", Index);
-                        
-          // Добавляем MAC-адрес к имени
-          for (UINTN i = 0; i < AsciiStrLen(CurrentMacStr); i++) {
-            DeviceName[StrLen(DeviceName)] = (CHAR16)CurrentMacStr[i];
-          }
-          
-          // Закрываем скобку и завершаем строку
-          StrCatS(DeviceName, DeviceNameSize, L")");
-        }
-      }
-      
-      break; // Нашли совпадение, выходим из цикла
+    TextViewFromString (Value, &ValueView);
+    if (SnEquals (&ValueView, &TargetView)) {
+      Print (L"%s Serial Number in DMI store: %s - MATCH\n", ReadbackNames[Index], Value);
+    } else {
+      Print (L"%s Serial Number in DMI store: %s - MISMATCH\n", ReadbackNames[Index], Value);
+      Matches = FALSE;
     }
   }
   
-  // Освобождаем буфер handles
-  FreePool(HandleBuffer);
-  
-  return Found;
+  return Matches;
 }
 
 /**
-  Проверяет, совпадает ли серийный номер из указанной EFI переменной с 
-  серийными номерами в SMBIOS информации.
+  Записывает серийный номер в таблицу SMBIOS в памяти через EFI_SMBIOS_PROTOCOL,
+  чтобы последующие проверки в этом же запуске видели прошитое значение.
+  Обновляются все записи Type 1 и платы, выбранные для сверки (см. IsBaseBoardSelected).
   
-  @param SerialVarName    Имя переменной UEFI с серийным номером
-  @param SerialVarGuid    GUID переменной UEFI (может быть NULL для поиска по всем GUID)
+  @param SnString       Серийный номер
+  @param BoardLocation  Расположение платы (NULL - основные платы)
   
-  @retval TRUE            Серийный номер совпадает
-  @retval FALSE           Серийный номер не совпадает или произошла ошибка
+  @retval EFI_SUCCESS   Таблица обновлена
+  @retval другое        Протокол SMBIOS недоступен или ошибка обновления строки
 **/
-BOOLEAN
-CheckSerialNumber (
-  IN  CONST CHAR16    *SerialVarName,
-  IN  EFI_GUID        *SerialVarGuid
+EFI_STATUS
+SyncSmbiosSerial (
+  IN CONST CHAR16  *SnString,
+  IN CONST CHAR16  *BoardLocation OPTIONAL
   )
 {
-  EFI_STATUS  Status;
-  VOID        *SnVarData = NULL;
-  UINTN       SnVarSize = 0;
-  CHAR16      SnString[MAX_BUFFER_SIZE];
-  CHAR16      SystemSn[MAX_BUFFER_SIZE];
-  CHAR16      BaseBoardSn[MAX_BUFFER_SIZE];
-  BOOLEAN     SnMatches = FALSE;
-  EFI_GUID    FoundGuid;
-  
-  // Получаем серийный номер из переменной UEFI
-  Status = GetVariableData (
-            SerialVarName,
-            SerialVarGuid,
-            &SnVarData,
-            &SnVarSize,
-            &FoundGuid
-            );
-            
+  EFI_STATUS           Status;
+  EFI_STATUS           Result;
+  EFI_SMBIOS_PROTOCOL  *Smbios;
+  BASEBOARD_INSTANCE   *Boards;
+  UINTN                BoardCount;
+  CONST SMBIOS_RECORD  *Record;
+  EFI_SMBIOS_HANDLE    Handle;
+  UINTN                Count;
+  UINTN                Index;
+  UINTN                TargetCount;
+  CHAR8                AsciiSn[MAX_BUFFER_SIZE];
+  SMBIOS_STRING_TARGET *Targets;
+  
+  Status = gBS->LocateProtocol (&gEfiSmbiosProtocolGuid, NULL, (VOID **)&Smbios);
   if (EFI_ERROR (Status)) {
-    Print (L"Error: Failed to get Serial Number from variable '%s': %r\n", SerialVarName, Status);
-    return FALSE;
+    Print (L"Warning: SMBIOS protocol not available, in-memory table not updated: %r\n", Status);
+    return Status;
   }
   
-  // Для информации, выводим GUID найденной переменной, если GUID не был указан явно
-  if (SerialVarGuid == NULL) {
-    Print (L"Found variable '%s' with GUID: %08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X\n",
-           SerialVarName,
-           FoundGuid.Data1, FoundGuid.Data2, FoundGuid.Data3,
-           FoundGuid.Data4[0], FoundGuid.Data4[1], FoundGuid.Data4[2],
-           FoundGuid.Data4[3], FoundGuid.Data4[4], FoundGuid.Data4[5],
-           FoundGuid.Data4[6], FoundGuid.Data4[7]);
+  for (Index = 0; SnString[Index] != L'\0' && Index + 1 < MAX_BUFFER_SIZE; Index++) {
+    AsciiSn[Index] = (SnString[Index] < 0x80) ? (CHAR8)SnString[Index] : '?';
+  }
+  AsciiSn[Index] = '\0';
+  
+  // Сначала собираем дескрипторы и номера строк: UpdateString перестраивает
+  // таблицу, после чего указатели индекса на записи становятся недействительными
+  Count = SmbiosRecordCount (SMBIOS_TYPE_SYSTEM_INFORMATION);
+  if (EFI_ERROR (CollectBaseBoards (&Boards, &BoardCount))) {
+    Boards = NULL;
+    BoardCount = 0;
   }
   
-  // Конвертируем данные в строку
-  ZeroMem(SnString, sizeof(SnString));
-  
-  // Проверяем формат данных (UCS-2 или ASCII)
-  if (SnVarSize >= 2 && ((CHAR16*)SnVarData)[SnVarSize/2 - 1] == 0) {
-    // Данные в UCS-2 формате
-    StrCpyS(SnString, MAX_BUFFER_SIZE, (CHAR16*)SnVarData);
-  } else {
-    // Предполагаем ASCII формат или бинарные данные, конвертируем в строку
-    for (UINTN i = 0; i < MIN(SnVarSize, MAX_BUFFER_SIZE-1); i++) {
-      SnString[i] = ((UINT8*)SnVarData)[i];
+  Targets = AllocateZeroPool ((Count + BoardCount + 1) * sizeof (*Targets));
+  if (Targets == NULL) {
+    if (Boards != NULL) {
+      FreePool (Boards);
     }
-    SnString[MIN(SnVarSize, MAX_BUFFER_SIZE-1)] = 0;
+    return EFI_OUT_OF_RESOURCES;
   }
   
-  // Получаем серийный номер системы из SMBIOS
-  Status = GetSystemSerialNumber(SystemSn, MAX_BUFFER_SIZE);
-  if (!EFI_ERROR(Status)) {
-    Print(L"System Serial Number from SMBIOS: %s\n", SystemSn);
-    
-    // Сравниваем с целевым серийным номером
-    if (StrCmp(SystemSn, SnString) == 0) {
-      Print(L"System Serial Number matches the target value.\n");
-      SnMatches = TRUE;
+  TargetCount = 0;
+  for (Index = 0; Index < Count + BoardCount; Index++) {
+    if (Index < Count) {
+      SmbiosFindRecord (SMBIOS_TYPE_SYSTEM_INFORMATION, Index, &Record);
+      Targets[TargetCount].StringNumber = ((SMBIOS_TABLE_TYPE1 *)Record->Header)->SerialNumber;
     } else {
-      Print(L"System Serial Number does NOT match the target value.\n");
+      if (!IsBaseBoardSelected (Boards, BoardCount, Index - Count, BoardLocation)) {
+        continue;
+      }
+      Record = Boards[Index - Count].Record;
+      Targets[TargetCount].StringNumber = ((SMBIOS_TABLE_TYPE2 *)Record->Header)->SerialNumber;
     }
-  } else {
-    Print(L"Warning: Could not retrieve System Serial Number from SMBIOS.\n");
+    Targets[TargetCount].Handle = Record->Header->Handle;
+    TargetCount++;
+  }
+  
+  if (Boards != NULL) {
+    FreePool (Boards);
   }
   
-  // Получаем серийный номер материнской платы из SMBIOS
-  Status = GetBaseBoardSerialNumber(BaseBoardSn, MAX_BUFFER_SIZE);
-  if (!EFI_ERROR(Status)) {
-    Print(L"Baseboard Serial Number from SMBIOS: %s\n", BaseBoardSn);
+  Result = EFI_SUCCESS;
+  for (Index = 0; Index < TargetCount; Index++) {
+    // Поле без строки нельзя обновить через UpdateString
+    Handle = Targets[Index].Handle;
+    if (Targets[Index].StringNumber == 0) {
+      Print (L"Warning: SMBIOS record 0x%04X has no serial number string to update\n", Handle);
+      continue;
+    }
     
-    // Сравниваем с целевым серийным номером
-    if (StrCmp(BaseBoardSn, SnString) == 0) {
-      Print(L"Baseboard Serial Number matches the target value.\n");
-      SnMatches = TRUE;
+    Status = Smbios->UpdateString (Smbios, &Handle, &Targets[Index].StringNumber, AsciiSn);
+    if (EFI_ERROR (Status)) {
+      Print (L"Warning: Failed to update serial number of SMBIOS record 0x%04X: %r\n", Handle, Status);
+      Result = Status;
     } else {
-      Print(L"Baseboard Serial Number does NOT match the target value.\n");
+      Print (L"Updated in-memory SMBIOS record 0x%04X serial number\n", Handle);
     }
-  } else {
-    Print(L"Warning: Could not retrieve Baseboard Serial Number from SMBIOS.\n");
   }
   
-  if (SnVarData != NULL) {
-    FreePool(SnVarData);
-  }
+  FreePool (Targets);
+  
+  // Записи SMBIOS изменились, индекс нужно построить заново
+  InvalidateSmbiosIndex ();
   
-  return SnMatches;
+  return Result;
 }
+
 /**
   Проверяет серийный номер и MAC-адрес, перепрошивает при необходимости.
   
@@ -1761,20 +9149,28 @@ CheckAndFlashValues (
   )
 {
   EFI_STATUS     Status;
-  VOID           *SnVarData = NULL;         // Данные из переменной SerialVarName
-  UINTN          SnVarSize = 0;
+  EFI_STATUS     BudgetStatus;              // Результат проверки запаса NV хранилища
+  BOOLEAN        DiffStore = FALSE;         // Сравнивать хранилище до и после прошивки
+  VAR_STORE_INDEX StoreBefore;              // Слепок хранилища до попытки прошивки
+  VAR_STORE_INDEX StoreAfter;               // Слепок хранилища после попытки прошивки
+  VERIFY_CONTEXT Context;                   // Значения, прочитанные за время проверки
   BOOLEAN        SnMatches = FALSE;
   BOOLEAN        MacMatches = FALSE;
   UINTN          RetryCount;
   CHAR16         SnString[MAX_BUFFER_SIZE]; // Строка с серийным номером
-  CHAR8          MacString[MAX_BUFFER_SIZE]; // Строка с MAC-адресом в ASCII
+  TEXT_INFO      SnInfo;                    // Кодировка переменной с серийным номером
+  TEXT_VIEW      SnView;                    // Данные переменной как строка
+  TEXT_VIEW      SnCore;                    // Значимая часть целевого серийного номера
+  UINT64         MacKeys[MAC_LIST_MAX];     // MAC-адреса портов из переменной (MacToKey)
+  UINTN          MacKeyCount = 0;           // Количество адресов в переменной
+  UINTN          MacIndex;
+  CHAR16         MacText[MAC_STRING_SIZE];  // Адрес для вывода
   CHAR16         MacDeviceName[MAX_BUFFER_SIZE]; // Имя устройства для MAC
-  EFI_GUID       FoundGuid;
-  BOOLEAN        SerialGuidAllocated = FALSE;
-  BOOLEAN        MacGuidAllocated = FALSE;
   BOOLEAN        SnFlashed = FALSE;         // Флаг успешной прошивки SN
   EFI_INPUT_KEY  Key;                       // Для ожидания нажатия клавиши
   
+  ZeroMem (&Context, sizeof (VERIFY_CONTEXT));
+  
   if (Config->CheckOnly) {
     Print (L"Starting Serial Number and MAC verification (Check-Only Mode)...\n\n");
   } else {
@@ -1784,131 +9180,112 @@ CheckAndFlashValues (
   // Проверяем, нужно ли проверять серийный номер
   if (Config->CheckSn) {
     // Получаем серийный номер из переменной UEFI (который нужно прошить/проверить)
-    Status = GetVariableData (
-              Config->SerialVarName,
-              Config->SerialVarGuid,
-              &SnVarData,
-              &SnVarSize,
-              &FoundGuid
-              );
-              
+    Status = VerifyContextGetVariable (&Context.Serial, Config->SerialVarName, Config->SerialVarGuid);
     if (EFI_ERROR (Status)) {
       Print (L"Error: Failed to get Serial Number from variable '%s': %r\n", Config->SerialVarName, Status);
+      FreeVerifyContext (&Context);
       return Status;
     }
     
-    // Если GUID не был указан явно, сохраняем найденный GUID
-    if (Config->SerialVarGuid == NULL) {
-      Config->SerialVarGuid = AllocateZeroPool(sizeof(EFI_GUID));
-      if (Config->SerialVarGuid == NULL) {
-        Print(L"Error: Failed to allocate memory for GUID\n");
-        FreePool(SnVarData);
-        return EFI_OUT_OF_RESOURCES;
-      }
-      CopyMem(Config->SerialVarGuid, &FoundGuid, sizeof(EFI_GUID));
-      SerialGuidAllocated = TRUE;
-      
-      Print(L"Found variable '%s' with GUID: %08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X\n",
-            Config->SerialVarName,
-            Config->SerialVarGuid->Data1, Config->SerialVarGuid->Data2, Config->SerialVarGuid->Data3,
-            Config->SerialVarGuid->Data4[0], Config->SerialVarGuid->Data4[1], Config->SerialVarGuid->Data4[2],
-            Config->SerialVarGuid->Data4[3], Config->SerialVarGuid->Data4[4], Config->SerialVarGuid->Data4[5],
-            Config->SerialVarGuid->Data4[6], Config->SerialVarGuid->Data4[7]);
+    // Двоичные данные обрезались бы на первом нулевом байте: такое значение не прошиваем
+    TextClassify (Context.Serial.Data, Context.Serial.Size, &SnInfo);
+    if (SnInfo.Encoding == TEXT_ENCODING_BINARY) {
+      Print (L"Error: Serial Number variable '%s' is not text (%u bytes of binary data)\n",
+             Config->SerialVarName, Context.Serial.Size);
+      FreeVerifyContext (&Context);
+      return EFI_INVALID_PARAMETER;
     }
     
-    // Конвертируем данные в строку
-    ZeroMem(SnString, sizeof(SnString));
-    
-    // Проверяем формат данных (UCS-2 или ASCII)
-    if (SnVarSize >= 2 && ((CHAR16*)SnVarData)[SnVarSize/2 - 1] == 0) {
-      // Данные в UCS-2 формате
-      StrCpyS(SnString, MAX_BUFFER_SIZE, (CHAR16*)SnVarData);
-    } else {
-      // Предполагаем ASCII формат или бинарные данные, конвертируем в строку
-      for (UINTN i = 0; i < MIN(SnVarSize, MAX_BUFFER_SIZE-1); i++) {
-        SnString[i] = ((UINT8*)SnVarData)[i];
-      }
-      SnString[MIN(SnVarSize, MAX_BUFFER_SIZE-1)] = 0;
-    }
+    // Конвертируем данные в строку для AMIDEEFI (без пробелов и заполнения по краям)
+    TextViewFromData (Context.Serial.Data, Context.Serial.Size, &SnView);
+    SnCopyForFlash (&SnView, SnString, MAX_BUFFER_SIZE);
     
     Print (L"Target Serial Number from EFI variable '%s': %s\n", 
            Config->SerialVarName, SnString);
     
-    // Проверяем серийные номера в SMBIOS
-    SnMatches = CheckSerialNumber(Config->SerialVarName, Config->SerialVarGuid);
+    // Пустую (стёртую) переменную или заглушку не сравниваем и не прошиваем
+    if (SnNormalize (&SnView, &mSnMatchRules, &SnCore) || SnCore.Length == 0) {
+      Print (L"Error: Serial Number variable '%s' is empty, erased or a placeholder\n",
+             Config->SerialVarName);
+      FreeVerifyContext (&Context);
+      return EFI_INVALID_PARAMETER;
+    }
+    
+    // Проверяем серийные номера в SMBIOS (данные переменной уже прочитаны)
+    SnMatches = CheckSerialNumber(&SnView, Config->BoardLocation);
   } else {
     // Если не проверяем SN, считаем его совпадающим
     SnMatches = TRUE;
     Print (L"Serial Number check skipped.\n");
   }
   
-  // Проверяем, нужно ли проверять MAC-адрес
-  if (Config->CheckMac) {
-    // Получаем MAC-адрес из переменной UEFI и преобразуем в ASCII строку
-    Status = GetMacAddressAsAscii (
-              Config->MacVarName,
-              Config->MacVarGuid,
-              MacString,
-              sizeof(MacString),
-              &FoundGuid
-              );
-              
+  // Проверяем, нужно ли проверять MAC-адрес из переменной или командной строки
+  ZeroMem(MacDeviceName, sizeof(MacDeviceName));
+  if (Config->MacBase != NULL || Config->MacVarName != NULL) {
+    // Получаем MAC-адрес из строки --mac-base или из переменной UEFI и разбираем его один раз
+    if (Config->MacBase != NULL) {
+      Status = MacTextToKeys (Config->MacBase, MacKeys, MAC_LIST_MAX, &MacKeyCount);
+    } else {
+      Status = VerifyContextGetVariable (&Context.Mac, Config->MacVarName, Config->MacVarGuid);
+      if (!EFI_ERROR (Status)) {
+        Status = MacDataToKeys (Context.Mac.Data, Context.Mac.Size, MacKeys, MAC_LIST_MAX, &MacKeyCount);
+      }
+    }
+    
+    // Блок портов задаётся одним базовым адресом
+    if (!EFI_ERROR (Status) && Config->MacCount > 0 && MacKeyCount != 1) {
+      Print (L"Error: --mac-count needs a single base MAC address, %u given\n", MacKeyCount);
+      Status = EFI_INVALID_PARAMETER;
+    }
+    
     if (EFI_ERROR (Status)) {
-      Print (L"Error: Failed to get MAC Address from variable '%s': %r\n", Config->MacVarName, Status);
+      Print (L"Error: Failed to get MAC Address from %s '%s': %r\n",
+             Config->MacBase != NULL ? L"--mac-base" : L"variable",
+             Config->MacBase != NULL ? Config->MacBase : Config->MacVarName,
+             Status);
       
       // Если SN не прошит и не совпадает, попробуем прошить его независимо от MAC
       if (Config->CheckSn && !SnMatches && !Config->CheckOnly) {
         goto FlashSerial;
       }
       
-      if (SnVarData != NULL) {
-        FreePool (SnVarData);
-      }
-      // Освобождаем память GUID, если была выделена
-      if (SerialGuidAllocated && Config->SerialVarGuid != NULL) {
-        FreePool(Config->SerialVarGuid);
-      }
+      FreeVerifyContext (&Context);
       return Status;
     }
     
-    // Если GUID не был указан явно, сохраняем найденный GUID
-    if (Config->MacVarGuid == NULL) {
-      Config->MacVarGuid = AllocateZeroPool(sizeof(EFI_GUID));
-      if (Config->MacVarGuid == NULL) {
-        Print(L"Error: Failed to allocate memory for GUID\n");
-        if (SnVarData != NULL) {
-          FreePool(SnVarData);
-        }
-        // Освобождаем память GUID, если была выделена
-        if (SerialGuidAllocated && Config->SerialVarGuid != NULL) {
-          FreePool(Config->SerialVarGuid);
-        }
-        return EFI_OUT_OF_RESOURCES;
+    // Выводим целевые MAC-адреса
+    for (MacIndex = 0; MacIndex < MacKeyCount; MacIndex++) {
+      FormatMacKey (MacKeys[MacIndex], MacText, MAC_STRING_SIZE);
+      if (MacKeyCount == 1) {
+        Print (L"Target MAC Address from %s: %s\n", Config->MacBase != NULL ? L"command line" : L"EFI variable", MacText);
+      } else {
+        Print (L"Target MAC Address %u from %s: %s\n", MacIndex, Config->MacBase != NULL ? L"command line" : L"EFI variable", MacText);
       }
-      CopyMem(Config->MacVarGuid, &FoundGuid, sizeof(EFI_GUID));
-      MacGuidAllocated = TRUE;
-      
-      Print(L"Found variable '%s' with GUID: %08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X\n",
-            Config->MacVarName,
-            Config->MacVarGuid->Data1, Config->MacVarGuid->Data2, Config->MacVarGuid->Data3,
-            Config->MacVarGuid->Data4[0], Config->MacVarGuid->Data4[1], Config->MacVarGuid->Data4[2],
-            Config->MacVarGuid->Data4[3], Config->MacVarGuid->Data4[4], Config->MacVarGuid->Data4[5],
-            Config->MacVarGuid->Data4[6], Config->MacVarGuid->Data4[7]);
-    }
-    
-    // Выводим целевой MAC-адрес
-    Print (L"Target MAC Address from EFI variable: ");
-    PrintMacAddress(MacString);
-    
-    // Проверяем, совпадает ли MAC-адрес с каким-либо MAC-адресом сетевой карты
-    ZeroMem(MacDeviceName, sizeof(MacDeviceName));
-    MacMatches = CheckMacAddressAgainstNetworkDevices(
-                   MacString,
-                   MacDeviceName,
-                   MAX_BUFFER_SIZE
-                   );
+    }
+    
+    if (Config->MacCount > 0) {
+      // Блок адресов многопортовой платы: порт N - базовый адрес + N
+      Print (L"Checking MAC block of %u ports starting at %s\n", Config->MacCount, MacText);
+      MacMatches = CheckMacBlock (&Context, MacKeys[0], Config->MacCount);
+      UnicodeSPrint (MacDeviceName, sizeof (MacDeviceName), L"All %u ports of the MAC block", Config->MacCount);
+    } else if (MacKeyCount > 1) {
+      // Список независимо назначенных адресов портов
+      MacMatches = CheckMacList (&Context, MacKeys, MacKeyCount);
+      UnicodeSPrint (MacDeviceName, sizeof (MacDeviceName), L"All %u ports of the MAC list", MacKeyCount);
+    } else {
+      // Проверяем, совпадает ли MAC-адрес с каким-либо MAC-адресом сетевой карты
+      MacMatches = CheckMacAddressAgainstNetworkDevices(
+                     &Context,
+                     MacKeys[0],
+                     MacDeviceName,
+                     MAX_BUFFER_SIZE
+                     );
+    }
                    
-    if (MacMatches) {
+    if (Config->MacCount > 0 || MacKeyCount > 1) {
+      Print (L"MAC %a %a the network interfaces.\n",
+             Config->MacCount > 0 ? "block" : "list", MacMatches ? "matches" : "does NOT match");
+    } else if (MacMatches) {
       Print (L"MAC Address matches the network interface: %s\n", MacDeviceName);
     } else {
       Print (L"MAC Address does NOT match any network interface in the system.\n");
@@ -1917,7 +9294,20 @@ CheckAndFlashValues (
   } else {
     // Если не проверяем MAC, считаем его совпадающим
     MacMatches = TRUE;
-    Print (L"MAC Address check skipped.\n");
+    if (Config->MacPinCount == 0) {
+      Print (L"MAC Address check skipped.\n");
+    }
+  }
+  
+  // MAC-адреса, закреплённые за физическими портами
+  if (Config->MacPinCount > 0) {
+    Print (L"Checking MAC addresses of %u pinned ports\n", Config->MacPinCount);
+    if (!CheckMacPins (&Context, Config->MacPins, Config->MacPinCount)) {
+      MacMatches = FALSE;
+    }
+    if (MacDeviceName[0] == L'\0') {
+      UnicodeSPrint (MacDeviceName, sizeof (MacDeviceName), L"All %u pinned ports", Config->MacPinCount);
+    }
   }
   
   // Если работаем в режиме только проверки, выводим результат и завершаем работу
@@ -1934,16 +9324,7 @@ CheckAndFlashValues (
       }
     }
     
-    if (SnVarData != NULL) {
-      FreePool (SnVarData);
-    }
-    // Освобождаем память GUID, если была выделена
-    if (SerialGuidAllocated && Config->SerialVarGuid != NULL) {
-      FreePool(Config->SerialVarGuid);
-    }
-    if (MacGuidAllocated && Config->MacVarGuid != NULL) {
-      FreePool(Config->MacVarGuid);
-    }
+    FreeVerifyContext (&Context);
     
     return (SnMatches && MacMatches) ? EFI_SUCCESS : EFI_DEVICE_ERROR;
   }
@@ -1958,16 +9339,7 @@ CheckAndFlashValues (
     // Если указан флаг --pw, выключаем систему
     if (Config->PowerDown) {
       Print (L"Power down flag is set. Shutting down system...\n");
-      if (SnVarData != NULL) {
-        FreePool (SnVarData);
-      }
-      // Освобождаем память GUID, если была выделена
-      if (SerialGuidAllocated && Config->SerialVarGuid != NULL) {
-        FreePool(Config->SerialVarGuid);
-      }
-      if (MacGuidAllocated && Config->MacVarGuid != NULL) {
-        FreePool(Config->MacVarGuid);
-      }
+      FreeVerifyContext (&Context);
       return PowerDownSystem();
     }
     
@@ -1976,16 +9348,7 @@ CheckAndFlashValues (
     gBS->WaitForEvent (1, &gST->ConIn->WaitForKey, NULL);
     gST->ConIn->ReadKeyStroke (gST->ConIn, &Key);
     
-    if (SnVarData != NULL) {
-      FreePool (SnVarData);
-    }
-    // Освобождаем память GUID, если была выделена
-    if (SerialGuidAllocated && Config->SerialVarGuid != NULL) {
-      FreePool(Config->SerialVarGuid);
-    }
-    if (MacGuidAllocated && Config->MacVarGuid != NULL) {
-      FreePool(Config->MacVarGuid);
-    }
+    FreeVerifyContext (&Context);
     return EFI_SUCCESS;
   }
   
@@ -1993,11 +9356,21 @@ CheckAndFlashValues (
   
 FlashSerial:
   // Если серийный номер не совпадает, пытаемся его прошить
-  if (!SnMatches && SnVarData != NULL) {
+  if (!SnMatches && Context.Serial.Data != NULL) {
     Print (L"\nAttempting to flash Serial Number...\n");
     
+    // AMIDEEFI пишет в NV хранилище; reclaim посреди прошивки недопустим
+    BudgetStatus = CheckNvWriteBudget (NV_WRITE_ESTIMATE_AMIDEEFI, L"AMIDEEFI flashing", Config->ForceWrite);
+    
+    // Слепок хранилища до прошивки, чтобы видеть, что меняет каждая попытка
+    DiffStore = Config->DiffStore && !EFI_ERROR (BudgetStatus);
+    if (DiffStore && EFI_ERROR (BuildStoreDigest (&StoreBefore))) {
+      Print (L"Warning: Cannot take variable store digest, store diff is disabled\n");
+      DiffStore = FALSE;
+    }
+    
     // Пытаемся перепрошить серийный номер до 3 раз
-    for (RetryCount = 0; RetryCount < 3; RetryCount++) {
+    for (RetryCount = 0; RetryCount < 3 && !EFI_ERROR (BudgetStatus); RetryCount++) {
       Print (L"Flashing attempt %d...\n", RetryCount + 1);
       
       // Запускаем AMIDEEFIx64.efi через Shell
@@ -2005,14 +9378,37 @@ FlashSerial:
                 Config->AmideEfiPath,
                 SnString
                 );
+      
+      // Прошивка меняет только DMI: переменные-источники и сетевые карты не перечитываются
+      VerifyContextInvalidate (&Context, VERIFY_CACHE_FLASHED);
                 
+      // Сравниваем хранилище с состоянием до этой попытки
+      if (DiffStore) {
+        if (EFI_ERROR (BuildStoreDigest (&StoreAfter))) {
+          Print (L"Warning: Cannot take variable store digest, store diff is disabled\n");
+          FreeVariableIndex (&StoreBefore);
+          DiffStore = FALSE;
+        } else {
+          Print (L"Variable store changes after attempt %d:\n", RetryCount + 1);
+          PrintStoreDiff (&StoreBefore, &StoreAfter);
+          FreeVariableIndex (&StoreBefore);
+          CopyMem (&StoreBefore, &StoreAfter, sizeof (VAR_STORE_INDEX));
+          ZeroMem (&StoreAfter, sizeof (VAR_STORE_INDEX));
+        }
+      }
+      
       if (!EFI_ERROR (Status)) {
-        // Проверяем, был ли серийный номер прошит успешно
-        SnMatches = CheckSerialNumber(Config->SerialVarName, Config->SerialVarGuid);
+        // Проверяем, был ли серийный номер прошит успешно (SMBIOS в памяти или чтение через AMIDEEFI)
+        SnMatches = VerifyFlashedSerial(Config, SnString);
         
         if (SnMatches) {
           Print (L"Serial Number was successfully flashed!\n");
           SnFlashed = TRUE;
+          
+          // Обновляем таблицу SMBIOS в памяти, чтобы дальнейшие проверки видели новое значение
+          if (Config->SyncSmbios) {
+            SyncSmbiosSerial (SnString, Config->BoardLocation);
+          }
           break;  // Прерываем цикл, так как серийник успешно прошит
         }
         
@@ -2022,9 +9418,17 @@ FlashSerial:
       }
     }
     
+    if (DiffStore) {
+      FreeVariableIndex (&StoreBefore);
+    }
+    
     // Если не удалось прошить серийный номер после 3 попыток
     if (!SnFlashed) {
-      Print (L"\nCRITICAL ERROR: Failed to flash Serial Number after 3 attempts!\n");
+      if (EFI_ERROR (BudgetStatus)) {
+        Print (L"\nCRITICAL ERROR: Serial Number was not flashed, NV store check failed: %r\n", BudgetStatus);
+      } else {
+        Print (L"\nCRITICAL ERROR: Failed to flash Serial Number after 3 attempts!\n");
+      }
       
       // Выводим итоговую информацию о проверке
       Print (L"\n=== Verification Results ===\n");
@@ -2035,16 +9439,7 @@ FlashSerial:
       
       // Если включен флаг выключения, выключаем систему
       if (Config->PowerDown) {
-        if (SnVarData != NULL) {
-          FreePool (SnVarData);
-        }
-        // Освобождаем память GUID, если была выделена
-        if (SerialGuidAllocated && Config->SerialVarGuid != NULL) {
-          FreePool(Config->SerialVarGuid);
-        }
-        if (MacGuidAllocated && Config->MacVarGuid != NULL) {
-          FreePool(Config->MacVarGuid);
-        }
+        FreeVerifyContext (&Context);
         return PowerDownSystem();
       }
       
@@ -2053,16 +9448,7 @@ FlashSerial:
       gBS->WaitForEvent (1, &gST->ConIn->WaitForKey, NULL);
       gST->ConIn->ReadKeyStroke (gST->ConIn, &Key);
       
-      if (SnVarData != NULL) {
-        FreePool (SnVarData);
-      }
-      // Освобождаем память GUID, если была выделена
-      if (SerialGuidAllocated && Config->SerialVarGuid != NULL) {
-        FreePool(Config->SerialVarGuid);
-      }
-      if (MacGuidAllocated && Config->MacVarGuid != NULL) {
-        FreePool(Config->MacVarGuid);
-      }
+      FreeVerifyContext (&Context);
       return EFI_DEVICE_ERROR;
     }
   }
@@ -2091,16 +9477,7 @@ FlashSerial:
     // Если указан флаг --pw, выключаем систему
     if (Config->PowerDown) {
       Print (L"Power down flag is set.\n");
-      if (SnVarData != NULL) {
-        FreePool (SnVarData);
-      }
-      // Освобождаем память GUID, если была выделена
-      if (SerialGuidAllocated && Config->SerialVarGuid != NULL) {
-        FreePool(Config->SerialVarGuid);
-      }
-      if (MacGuidAllocated && Config->MacVarGuid != NULL) {
-        FreePool(Config->MacVarGuid);
-      }
+      FreeVerifyContext (&Context);
       return PowerDownSystem();
     }
     
@@ -2109,16 +9486,7 @@ FlashSerial:
     gBS->WaitForEvent (1, &gST->ConIn->WaitForKey, NULL);
     gST->ConIn->ReadKeyStroke (gST->ConIn, &Key);
     
-    if (SnVarData != NULL) {
-      FreePool (SnVarData);
-    }
-    // Освобождаем память GUID, если была выделена
-    if (SerialGuidAllocated && Config->SerialVarGuid != NULL) {
-      FreePool(Config->SerialVarGuid);
-    }
-    if (MacGuidAllocated && Config->MacVarGuid != NULL) {
-      FreePool(Config->MacVarGuid);
-    }
+    FreeVerifyContext (&Context);
     return EFI_SUCCESS;
   }
   
@@ -2127,17 +9495,8 @@ FlashSerial:
     Print (L"\nSerial Number is correct, but MAC Address needs to be updated.\n");
     if (Config->PowerDown) {
       Print (L"Rebooting to system for MAC Address update...\n");
-      if (SnVarData != NULL) {
-        FreePool (SnVarData);
-      }
-      // Освобождаем память GUID, если была выделена
-      if (SerialGuidAllocated && Config->SerialVarGuid != NULL) {
-        FreePool(Config->SerialVarGuid);
-      }
-      if (MacGuidAllocated && Config->MacVarGuid != NULL) {
-        FreePool(Config->MacVarGuid);
-      }
-      return RebootToBoot();
+      FreeVerifyContext (&Context);
+      return RebootToBoot (Config->ForceWrite);
     } else {
       Print (L"Use --pw flag to reboot and update MAC.\n");
       
@@ -2148,16 +9507,7 @@ FlashSerial:
     }
   }
   
-  if (SnVarData != NULL) {
-    FreePool (SnVarData);
-  }
-  // Освобождаем память GUID, если была выделена
-  if (SerialGuidAllocated && Config->SerialVarGuid != NULL) {
-    FreePool(Config->SerialVarGuid);
-  }
-  if (MacGuidAllocated && Config->MacVarGuid != NULL) {
-    FreePool(Config->MacVarGuid);
-  }
+  FreeVerifyContext (&Context);
   return EFI_SUCCESS;
 }
 
@@ -2178,6 +9528,9 @@ PowerDownSystem (
   gBS->WaitForEvent (1, &gST->ConIn->WaitForKey, NULL);
   gST->ConIn->ReadKeyStroke (gST->ConIn, &Key);
   
+  // ResetSystem не возвращает управление, поэтому статистику реестра сохраняем до него
+  SaveGuidRegistryStats ();
+  
   Print (L"Shutting down system...\n");
   gRT->ResetSystem (EfiResetShutdown, EFI_SUCCESS, 0, NULL);
   
@@ -2193,29 +9546,81 @@ PrintUsage (
   )
 {
   Print (L"SNSniff - UEFI Serial Number and MAC Address Tool\n");
-  Print (L"Usage: snsniff [variable_name] [options]\n\n");
+  Print (L"Usage: snsniff [variable_name|pattern] [options]\n\n");
   Print (L"Standard Options:\n");
-  Print (L"  --guid GUID      : Specify GUID prefix or full GUID\n");
-  Print (L"  --rawtype TYPE   : Output only in specified format (hex, ascii, ucs)\n\n");
+  Print (L"  --guid GUID      : Specify GUID prefix or full GUID (a prefix matches any GUID starting with it)\n");
+  Print (L"  --rawtype TYPE   : Output only in specified format (hex, ascii, ucs)\n");
+  Print (L"  --guid-db FILE   : Vendor GUID registry file (default: %s)\n", GUID_REGISTRY_FILE);
+  Print (L"  --offset N       : Dump variable data starting at byte N (decimal or 0x hex)\n");
+  Print (L"  --length N       : Dump only N bytes of variable data\n");
+  Print (L"  --out FILE       : Write the variable or SMBIOS dump to FILE instead of the screen\n");
+  Print (L"                     (--rawtype ascii/ucs write the range as an ASCII/UCS-2 string)\n\n");
   
   Print (L"Verification and Flashing Options:\n");
   Print (L"  --check          : Verify and flash if needed the SN and MAC\n");
   Print (L"  --check-only     : Verify but DO NOT flash SN and MAC (just report status)\n");
   Print (L"  --vsn VARNAME    : Name of EFI variable containing the serial number to flash\n");
   Print (L"  --vmac VARNAME   : Name of EFI variable containing the MAC address to check\n");
+  Print (L"                     (6*N raw bytes or a list separated by ',', ';' or new lines\n");
+  Print (L"                     checks N ports, one address per port)\n");
+  Print (L"  --mac-base MAC   : Check this MAC address (or list) instead of reading it from --vmac\n");
+  Print (L"  --mac-count N    : Check a block of N ports: port K must have MAC base+K and every\n");
+  Print (L"                     network interface must fall inside the block\n");
+  Print (L"  --mac-at LOC=MAC : Expect MAC on the port at PCI location [SSSS:]BB:DD.F[/PORT]\n");
+  Print (L"                     (hex location, decimal port; may be repeated)\n");
+  Print (L"  --board-loc L    : Check the SN against the baseboard at chassis location L\n");
+  Print (L"                     (default: hosting boards that are not part of another board)\n");
   Print (L"  --amid PATH      : Path to AMIDEEFIx64.efi (default: current directory)\n");
-  Print (L"  --pw             : Power down/reboot system after operation (if needed)\n\n");
+  Print (L"  --verify-mode M  : Post-flash SN check: auto, smbios, readback (default: auto)\n");
+  Print (L"                     (readback reads /SS and /BS back from the DMI store through AMIDEEFI;\n");
+  Print (L"                      /BS covers only the primary baseboard, not --board-loc)\n");
+  Print (L"  --sync-smbios    : Update the in-memory SMBIOS table after a successful flash\n");
+  Print (L"  --sn-match RULES : SN comparison rules: exact or a comma list of trim, nocase,\n");
+  Print (L"                     pad, placeholder (default: trim,pad)\n");
+  Print (L"  --sn-pad N       : Padding character stripped by the pad rule (default: 0xFF)\n");
+  Print (L"  --pw             : Power down/reboot system after operation (if needed)\n");
+  Print (L"  --force-write    : Write to the NV store even if it is close to a reclaim\n");
+  Print (L"  --diff-store     : Show variables added/removed/changed by each flashing attempt\n\n");
+  
+  Print (L"Field Verification Options:\n");
+  Print (L"  --verify F=SRC   : Check SMBIOS field F against SRC (repeatable)\n");
+  Print (L"  --verify-file F  : Read FIELD=SOURCE lines from file F\n");
+  Print (L"                     SRC: var:NAME[@GUID], lit:TEXT or file:PATH (first line)\n");
+  Print (L"                     Fields: 1.Manufacturer 1.Product 1.Version 1.Serial 1.UUID\n");
+  Print (L"                     1.SKU 1.Family 2.Manufacturer 2.Product 2.Version 2.Serial\n");
+  Print (L"                     2.AssetTag 2.Location 3.Manufacturer 3.Version 3.Serial 3.AssetTag\n\n");
+  
+  Print (L"Batch Options:\n");
+  Print (L"  --batch N1,N2,.. : Print several variables resolved in one store pass\n");
+  Print (L"  --batch-file F   : Read variable names for batch mode from file F\n\n");
+  
+  Print (L"Variable Store Options:\n");
+  Print (L"  --snapshot FILE  : Save the whole variable store to a binary snapshot (decode with snsnap)\n");
+  Print (L"  --store-stats    : Show variable store capacity and usage per vendor GUID\n");
+  Print (L"  --find-value VAL : Find VAL in the data of all variables (ASCII, UCS-2, binary/hex for MACs)\n\n");
   
   Print (L"System Information:\n");
-  Print (L"  --board-info     : Display detailed information about the motherboard\n\n");
+  Print (L"  --board-info     : Display detailed information about the motherboard\n");
+  Print (L"  --smbios-dump    : Decode all SMBIOS records (use --out FILE to save them)\n");
+  Print (L"  --smbios-raw     : Dump SMBIOS records as raw bytes (binary with --out)\n\n");
   
   Print (L"Examples:\n");
   Print (L"  snsniff SerialNumber\n");
   Print (L"  snsniff SerialNumber --guid 12345678\n");
+  Print (L"  snsniff Serial* --guid EC87D643\n");
+  Print (L"  snsniff dbx --offset 0x1000 --length 64\n");
+  Print (L"  snsniff db --out fs0:\\db.txt\n");
+  Print (L"  snsniff --batch SerialNumber,BaseMac,AssetTag --rawtype ascii\n");
   Print (L"  snsniff --check --vsn SerialToFlash --vmac MacToCheck\n");
   Print (L"  snsniff --check-only --vsn SerialToFlash\n");
+  Print (L"  snsniff --check-only --vsn SerialToFlash --board-loc Node2\n");
+  Print (L"  snsniff --verify 1.Serial=var:SerialToFlash --verify 2.AssetTag=lit:A1234\n");
   Print (L"  snsniff --check --vsn SerialToFlash --vmac MacToCheck --pw\n");
   Print (L"  snsniff --board-info\n");
+  Print (L"  snsniff --smbios-dump --out fs0:\\smbios.txt\n");
+  Print (L"  snsniff --snapshot fs0:\\store.snap\n");
+  Print (L"  snsniff --store-stats\n");
+  Print (L"  snsniff --find-value 00:11:22:33:44:55\n");
 }
 
 /**
@@ -2241,10 +9646,26 @@ ShellAppMain (
   BOOLEAN      CheckMode = FALSE;
   BOOLEAN      CheckOnlyMode = FALSE;  // Флаг для режима только проверки
   BOOLEAN      BoardInfoMode = FALSE;  // Флаг для вывода информации о плате
+  BOOLEAN      BatchMode = FALSE;      // Флаг пакетного режима
+  BOOLEAN      StoreStatsMode = FALSE; // Флаг вывода статистики хранилища
+  BOOLEAN      SmbiosDumpMode = FALSE; // Флаг дампа всех записей SMBIOS
+  BOOLEAN      SmbiosRawMode = FALSE;  // Дамп SMBIOS в сыром виде
+  NAME_LIST    BatchNames;             // Имена переменных для пакетного режима
+  VERIFY_PLAN  VerifyPlan;             // Таблица сверки полей SMBIOS (--verify)
+  GUID_PATTERN GuidPattern;            // Префикс GUID из --guid
+  EFI_GUID     SerialGuid;             // GUID переменной SN, разрешённый по префиксу
+  EFI_GUID     MacGuid;                // GUID переменной MAC, разрешённый по префиксу
+  CONST CHAR16 *SnapshotPath = NULL;   // Файл снимка хранилища (--snapshot)
+  CONST CHAR16 *FindValue = NULL;      // Значение для поиска по данным (--find-value)
+  BOOLEAN      DumpMode = FALSE;       // Дамп диапазона переменной (--offset/--length/--out)
+  UINTN        DumpOffset = 0;         // Смещение начала дампа
+  UINTN        DumpLength = 0;         // Длина дампа (0 - до конца переменной)
+  UINTN        PadChar;                // Код символа заполнения (--sn-pad)
+  CONST CHAR16 *DumpOutPath = NULL;    // Файл для дампа
   CHECK_CONFIG Config;
   
-  // Очищаем экран
-  gST->ConOut->ClearScreen (gST->ConOut);
+  ZeroMem (&BatchNames, sizeof (NAME_LIST));
+  ZeroMem (&VerifyPlan, sizeof (VERIFY_PLAN));
   
   // Инициализируем конфигурацию проверки
   ZeroMem (&Config, sizeof (CHECK_CONFIG));
@@ -2257,9 +9678,20 @@ ShellAppMain (
   Config.CheckMac = FALSE;
   Config.CheckOnly = FALSE;
   Config.PowerDown = FALSE;     // По умолчанию не выключаем/перезагружаем систему
+  Config.ForceWrite = FALSE;    // По умолчанию не пишем в почти заполненное NV хранилище
+  Config.DiffStore = FALSE;     // По умолчанию не сравниваем хранилище до и после прошивки
+  Config.BoardLocation = NULL;  // По умолчанию сверяем основные платы
+  Config.VerifyMode = FLASH_VERIFY_AUTO;  // SMBIOS в памяти, затем чтение через AMIDEEFI
+  Config.SyncSmbios = FALSE;    // По умолчанию не изменяем таблицу SMBIOS в памяти
+  Config.MacBase = NULL;        // По умолчанию MAC-адрес берётся из переменной --vmac
+  Config.MacCount = 0;          // По умолчанию проверяется один MAC-адрес
+  Config.MacPinCount = 0;       // По умолчанию MAC-адреса не закреплены за портами
   
   // Проверяем аргументы командной строки
   if (Argc == 1) {
+    // Очищаем экран
+    gST->ConOut->ClearScreen (gST->ConOut);
+    
     // Нет аргументов, используем значения по умолчанию
     PrintUsage();
     Print (L"\nUsing default values...\n\n");
@@ -2273,6 +9705,8 @@ ShellAppMain (
     for (Index = 1; Index < Argc; Index++) {
       if (StrCmp (Argv[Index], L"--help") == 0 || StrCmp (Argv[Index], L"-h") == 0) {
         PrintUsage();
+        FreeVerifyPlan (&VerifyPlan);
+        FreeNameList (&BatchNames);
         return EFI_SUCCESS;
       } else if (StrCmp (Argv[Index], L"--guid") == 0) {
         // Проверяем, что есть следующий аргумент
@@ -2282,6 +9716,8 @@ ShellAppMain (
         } else {
           Print (L"Error: Missing GUID value\n");
           PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
           return EFI_INVALID_PARAMETER;
         }
       } else if (StrCmp (Argv[Index], L"--rawtype") == 0) {
@@ -2296,12 +9732,16 @@ ShellAppMain (
           } else {
             Print (L"Error: Invalid rawtype value. Must be 'hex', 'ascii', or 'ucs'\n");
             PrintUsage();
+            FreeVerifyPlan (&VerifyPlan);
+            FreeNameList (&BatchNames);
             return EFI_INVALID_PARAMETER;
           }
           Index++; // Пропускаем значение опции
         } else {
           Print (L"Error: Missing rawtype value\n");
           PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
           return EFI_INVALID_PARAMETER;
         }
       } else if (StrCmp (Argv[Index], L"--check") == 0) {
@@ -2313,6 +9753,13 @@ ShellAppMain (
       } else if (StrCmp (Argv[Index], L"--board-info") == 0) {
         // Включаем режим вывода информации о материнской плате
         BoardInfoMode = TRUE;
+      } else if (StrCmp (Argv[Index], L"--smbios-dump") == 0) {
+        // Включаем дамп всех записей SMBIOS
+        SmbiosDumpMode = TRUE;
+      } else if (StrCmp (Argv[Index], L"--smbios-raw") == 0) {
+        // Включаем дамп всех записей SMBIOS в сыром виде
+        SmbiosDumpMode = TRUE;
+        SmbiosRawMode = TRUE;
       } else if (StrCmp (Argv[Index], L"--vsn") == 0) {
         // Проверяем, что есть следующий аргумент
         if (Index + 1 < Argc) {
@@ -2322,6 +9769,8 @@ ShellAppMain (
         } else {
           Print (L"Error: Missing serial variable name\n");
           PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
           return EFI_INVALID_PARAMETER;
         }
       } else if (StrCmp (Argv[Index], L"--vmac") == 0) {
@@ -2333,6 +9782,112 @@ ShellAppMain (
         } else {
           Print (L"Error: Missing MAC variable name\n");
           PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_INVALID_PARAMETER;
+        }
+      } else if (StrCmp (Argv[Index], L"--mac-base") == 0) {
+        // Проверяем, что есть следующий аргумент
+        if (Index + 1 < Argc) {
+          Config.MacBase = Argv[Index + 1];
+          Config.CheckMac = TRUE;
+          Index++; // Пропускаем значение опции
+        } else {
+          Print (L"Error: Missing base MAC address\n");
+          PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_INVALID_PARAMETER;
+        }
+      } else if (StrCmp (Argv[Index], L"--mac-at") == 0) {
+        // Проверяем, что есть следующий аргумент и в конфигурации есть место
+        if (Index + 1 >= Argc || Config.MacPinCount >= MAC_PIN_MAX) {
+          Print (L"Error: --mac-at needs a value and may be given at most %u times\n", MAC_PIN_MAX);
+          PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_INVALID_PARAMETER;
+        }
+        if (!ParseMacPin (Argv[Index + 1], &Config.MacPins[Config.MacPinCount])) {
+          Print (L"Error: Invalid --mac-at value '%s', expected [SSSS:]BB:DD.F[/PORT]=MAC\n", Argv[Index + 1]);
+          PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_INVALID_PARAMETER;
+        }
+        Config.MacPinCount++;
+        Config.CheckMac = TRUE;
+        Index++; // Пропускаем значение опции
+      } else if (StrCmp (Argv[Index], L"--mac-count") == 0) {
+        // Проверяем, что есть следующий аргумент и это положительное число
+        if (Index + 1 < Argc && ParseNumber (Argv[Index + 1], &Config.MacCount) && Config.MacCount > 0) {
+          Index++; // Пропускаем значение опции
+        } else {
+          Print (L"Error: --mac-count needs a positive port count\n");
+          PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_INVALID_PARAMETER;
+        }
+      } else if (StrCmp (Argv[Index], L"--board-loc") == 0) {
+        // Проверяем, что есть следующий аргумент
+        if (Index + 1 < Argc) {
+          Config.BoardLocation = Argv[Index + 1];
+          Index++; // Пропускаем значение опции
+        } else {
+          Print (L"Error: Missing board location\n");
+          PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_INVALID_PARAMETER;
+        }
+      } else if (StrCmp (Argv[Index], L"--verify-mode") == 0) {
+        // Проверяем, что есть следующий аргумент
+        if (Index + 1 < Argc) {
+          if (StrCmp (Argv[Index + 1], L"auto") == 0) {
+            Config.VerifyMode = FLASH_VERIFY_AUTO;
+          } else if (StrCmp (Argv[Index + 1], L"smbios") == 0) {
+            Config.VerifyMode = FLASH_VERIFY_SMBIOS;
+          } else if (StrCmp (Argv[Index + 1], L"readback") == 0) {
+            Config.VerifyMode = FLASH_VERIFY_READBACK;
+          } else {
+            Print (L"Error: Invalid verify mode '%s'\n", Argv[Index + 1]);
+            PrintUsage();
+            FreeVerifyPlan (&VerifyPlan);
+            FreeNameList (&BatchNames);
+            return EFI_INVALID_PARAMETER;
+          }
+          Index++; // Пропускаем значение опции
+        } else {
+          Print (L"Error: Missing verify mode\n");
+          PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_INVALID_PARAMETER;
+        }
+      } else if (StrCmp (Argv[Index], L"--sync-smbios") == 0) {
+        Config.SyncSmbios = TRUE;
+      } else if (StrCmp (Argv[Index], L"--sn-match") == 0) {
+        // Проверяем, что есть следующий аргумент и это список правил
+        if (Index + 1 < Argc && !EFI_ERROR (ParseSnMatchRules (Argv[Index + 1], &mSnMatchRules.Rules))) {
+          Index++; // Пропускаем значение опции
+        } else {
+          Print (L"Error: --sn-match needs exact or a comma list of trim, nocase, pad, placeholder\n");
+          PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_INVALID_PARAMETER;
+        }
+      } else if (StrCmp (Argv[Index], L"--sn-pad") == 0) {
+        // Проверяем, что есть следующий аргумент и это код символа
+        if (Index + 1 < Argc && ParseNumber (Argv[Index + 1], &PadChar) && PadChar <= MAX_UINT16) {
+          mSnMatchRules.PadChar = (CHAR16)PadChar;
+          Index++; // Пропускаем значение опции
+        } else {
+          Print (L"Error: --sn-pad needs a character code (decimal or 0x-prefixed hex)\n");
+          PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
           return EFI_INVALID_PARAMETER;
         }
       } else if (StrCmp (Argv[Index], L"--amid") == 0) {
@@ -2343,40 +9898,196 @@ ShellAppMain (
         } else {
           Print (L"Error: Missing AMIDE EFI path\n");
           PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_INVALID_PARAMETER;
+        }
+      } else if (StrCmp (Argv[Index], L"--batch") == 0 || StrCmp (Argv[Index], L"--batch-file") == 0) {
+        // Проверяем, что есть следующий аргумент
+        if (Index + 1 < Argc) {
+          if (StrCmp (Argv[Index], L"--batch") == 0) {
+            Status = NameListAddSeparated (&BatchNames, Argv[Index + 1]);
+          } else {
+            Status = NameListAddFromFile (&BatchNames, Argv[Index + 1]);
+          }
+          if (EFI_ERROR (Status)) {
+            FreeVerifyPlan (&VerifyPlan);
+            FreeNameList (&BatchNames);
+            return Status;
+          }
+          BatchMode = TRUE;
+          Index++; // Пропускаем значение опции
+        } else {
+          Print (L"Error: Missing batch variable list\n");
+          PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_INVALID_PARAMETER;
+        }
+      } else if (StrCmp (Argv[Index], L"--verify") == 0 || StrCmp (Argv[Index], L"--verify-file") == 0) {
+        // Проверяем, что есть следующий аргумент
+        if (Index + 1 < Argc) {
+          if (StrCmp (Argv[Index], L"--verify") == 0) {
+            Status = VerifyPlanAdd (&VerifyPlan, Argv[Index + 1]);
+          } else {
+            Status = VerifyPlanAddFromFile (&VerifyPlan, Argv[Index + 1]);
+          }
+          if (EFI_ERROR (Status)) {
+            FreeVerifyPlan (&VerifyPlan);
+            FreeNameList (&BatchNames);
+            return Status;
+          }
+          Index++; // Пропускаем значение опции
+        } else {
+          Print (L"Error: Missing verify entry\n");
+          PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_INVALID_PARAMETER;
+        }
+      } else if (StrCmp (Argv[Index], L"--guid-db") == 0) {
+        // Проверяем, что есть следующий аргумент
+        if (Index + 1 < Argc) {
+          mGuidRegistry.FilePath = Argv[Index + 1];
+          Index++; // Пропускаем значение опции
+        } else {
+          Print (L"Error: Missing GUID registry file path\n");
+          PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_INVALID_PARAMETER;
+        }
+      } else if (StrCmp (Argv[Index], L"--snapshot") == 0) {
+        // Проверяем, что есть следующий аргумент
+        if (Index + 1 < Argc) {
+          SnapshotPath = Argv[Index + 1];
+          Index++; // Пропускаем значение опции
+        } else {
+          Print (L"Error: Missing snapshot file path\n");
+          PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_INVALID_PARAMETER;
+        }
+      } else if (StrCmp (Argv[Index], L"--offset") == 0 || StrCmp (Argv[Index], L"--length") == 0) {
+        // Проверяем, что есть следующий аргумент и это число
+        if (Index + 1 < Argc && ParseNumber (Argv[Index + 1], StrCmp (Argv[Index], L"--offset") == 0 ? &DumpOffset : &DumpLength)) {
+          DumpMode = TRUE;
+          Index++; // Пропускаем значение опции
+        } else {
+          Print (L"Error: %s needs a decimal or 0x-prefixed hex number\n", Argv[Index]);
+          PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_INVALID_PARAMETER;
+        }
+      } else if (StrCmp (Argv[Index], L"--out") == 0) {
+        // Проверяем, что есть следующий аргумент
+        if (Index + 1 < Argc) {
+          DumpOutPath = Argv[Index + 1];
+          DumpMode = TRUE;
+          Index++; // Пропускаем значение опции
+        } else {
+          Print (L"Error: Missing output file path\n");
+          PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_INVALID_PARAMETER;
+        }
+      } else if (StrCmp (Argv[Index], L"--find-value") == 0) {
+        // Проверяем, что есть следующий аргумент
+        if (Index + 1 < Argc) {
+          FindValue = Argv[Index + 1];
+          Index++; // Пропускаем значение опции
+        } else {
+          Print (L"Error: Missing search value\n");
+          PrintUsage();
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
           return EFI_INVALID_PARAMETER;
         }
+      } else if (StrCmp (Argv[Index], L"--store-stats") == 0) {
+        // Включаем режим вывода статистики хранилища переменных
+        StoreStatsMode = TRUE;
+      } else if (StrCmp (Argv[Index], L"--diff-store") == 0) {
+        // Показываем изменения хранилища переменных после каждой попытки прошивки
+        Config.DiffStore = TRUE;
+      } else if (StrCmp (Argv[Index], L"--force-write") == 0) {
+        // Разрешаем запись в NV хранилище даже при риске reclaim
+        Config.ForceWrite = TRUE;
       } else if (StrCmp (Argv[Index], L"--pw") == 0) {
         // Включаем флаг выключения/перезагрузки системы
         Config.PowerDown = TRUE;
       }
     }
-  }
-  
-  // Если указан GUID, пытаемся его распарсить и устанавливаем его для обоих параметров
-  if (GuidPrefix != NULL) {
-    EFI_GUID *TempGuid = AllocateZeroPool(sizeof(EFI_GUID));
-    if (TempGuid == NULL) {
-      Print (L"Error: Failed to allocate memory for GUID\n");
-      return EFI_OUT_OF_RESOURCES;
-    }
     
-    if (ParseGuidPrefix (GuidPrefix, TempGuid)) {
-      Config.SerialVarGuid = TempGuid;
-      Config.MacVarGuid = TempGuid;
-    } else {
-      Print (L"Error: Invalid GUID prefix '%s'\n", GuidPrefix);
-      FreePool(TempGuid);
-      return EFI_INVALID_PARAMETER;
+    // Очищаем экран (в пакетном режиме, при снятии снимка, дампе SMBIOS и сверке вывод идёт в скрипт, экран не трогаем)
+    if (!BatchMode && SnapshotPath == NULL && !SmbiosDumpMode && VerifyPlan.Count == 0) {
+      gST->ConOut->ClearScreen (gST->ConOut);
     }
   }
   
+  // Если указан GUID, проверяем, что префикс корректен
+  if (GuidPrefix != NULL && !ParseGuidPattern (GuidPrefix, &GuidPattern)) {
+    Print (L"Error: Invalid GUID prefix '%s'\n", GuidPrefix);
+    FreeVerifyPlan (&VerifyPlan);
+    FreeNameList (&BatchNames);
+    return EFI_INVALID_PARAMETER;
+  }
+  
+  // Сверка полей SMBIOS по таблице (--verify, --verify-file)
+  if (VerifyPlan.Count > 0) {
+    Status = RunVerifyPlan (&VerifyPlan, Config.BoardLocation);
+    FreeVerifyPlan (&VerifyPlan);
+    FreeNameList (&BatchNames);
+    return (INTN)Status;
+  }
+  
   // Режим вывода информации о материнской плате
   if (BoardInfoMode) {
     Status = DisplayBaseBoardInfo();
-    // Освобождаем выделенную память для GUID, если была выделена
-    if (GuidPrefix != NULL && Config.SerialVarGuid != NULL) {
-      FreePool(Config.SerialVarGuid);
-    }
+    FreeVerifyPlan (&VerifyPlan);
+    FreeNameList (&BatchNames);
+    return (INTN)Status;
+  }
+  
+  // Дамп всех записей SMBIOS на экран или в файл
+  if (SmbiosDumpMode) {
+    Status = DumpSmbiosTable (DumpOutPath, SmbiosRawMode);
+    FreeVerifyPlan (&VerifyPlan);
+    FreeNameList (&BatchNames);
+    return (INTN)Status;
+  }
+  
+  // Статистика хранилища переменных
+  if (StoreStatsMode) {
+    Status = PrintStoreStats ();
+    FreeVerifyPlan (&VerifyPlan);
+    FreeNameList (&BatchNames);
+    return (INTN)Status;
+  }
+  
+  // Поиск значения по данным всех переменных
+  if (FindValue != NULL) {
+    Status = FindValueInVariables (FindValue);
+    FreeVerifyPlan (&VerifyPlan);
+    FreeNameList (&BatchNames);
+    return (INTN)Status;
+  }
+  
+  // Снимок всего хранилища переменных в файл
+  if (SnapshotPath != NULL) {
+    Status = WriteVariableSnapshot (SnapshotPath);
+    FreeVerifyPlan (&VerifyPlan);
+    FreeNameList (&BatchNames);
+    return (INTN)Status;
+  }
+  
+  // Пакетный режим - все переменные из списка за один проход по хранилищу
+  if (BatchMode) {
+    Status = PrintVariableBatch (&BatchNames, GuidPrefix, OutputType);
+    FreeVerifyPlan (&VerifyPlan);
+    FreeNameList (&BatchNames);
     return (INTN)Status;
   }
   
@@ -2384,30 +10095,57 @@ ShellAppMain (
   if (CheckMode || CheckOnlyMode) {
     // Режим проверки и перепрошивки или только проверки
     if (!Config.CheckSn && !Config.CheckMac) {
-      Print (L"Error: You must specify at least one value to check (--vsn or --vmac)\n");
+      Print (L"Error: You must specify at least one value to check (--vsn, --vmac, --mac-base or --mac-at)\n");
       PrintUsage();
-      // Освобождаем выделенную память для GUID, если была выделена
-      if (GuidPrefix != NULL && Config.SerialVarGuid != NULL) {
-        FreePool(Config.SerialVarGuid);
-      }
+      FreeVerifyPlan (&VerifyPlan);
+      FreeNameList (&BatchNames);
       return EFI_INVALID_PARAMETER;
     }
     
+    // Блок MAC строится от базового адреса, без --vmac/--mac-base ему не от чего отсчитывать
+    if (Config.MacCount > 0 && Config.MacBase == NULL && Config.MacVarName == NULL) {
+      Print (L"Error: --mac-count needs a base MAC address from --vmac or --mac-base\n");
+      PrintUsage();
+      FreeVerifyPlan (&VerifyPlan);
+      FreeNameList (&BatchNames);
+      return EFI_INVALID_PARAMETER;
+    }
+
+    // Если указан GUID, разрешаем его для каждой переменной (префикс сопоставляется с хранилищем)
+    if (GuidPrefix != NULL) {
+      if (Config.CheckSn) {
+        Status = ResolveVariableGuid (Config.SerialVarName, &GuidPattern, &SerialGuid);
+        if (EFI_ERROR (Status)) {
+          Print (L"Error: Variable '%s' not found with GUID prefix '%s'\n", Config.SerialVarName, GuidPrefix);
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_NOT_FOUND;
+        }
+        Config.SerialVarGuid = &SerialGuid;
+      }
+      if (Config.MacVarName != NULL && Config.MacBase == NULL) {
+        Status = ResolveVariableGuid (Config.MacVarName, &GuidPattern, &MacGuid);
+        if (EFI_ERROR (Status)) {
+          Print (L"Error: Variable '%s' not found with GUID prefix '%s'\n", Config.MacVarName, GuidPrefix);
+          FreeVerifyPlan (&VerifyPlan);
+          FreeNameList (&BatchNames);
+          return EFI_NOT_FOUND;
+        }
+        Config.MacVarGuid = &MacGuid;
+      }
+    }
+    
     // Устанавливаем флаг CheckOnly для передачи в CheckAndFlashValues
     Config.CheckOnly = CheckOnlyMode;
     
     // Проверяем и перепрошиваем значения (если не CheckOnlyMode)
     Status = CheckAndFlashValues (&Config);
-    
-    // Здесь не нужно освобождать Config.SerialVarGuid, так как это делается в CheckAndFlashValues
+  } else if (DumpMode) {
+    // Дамп диапазона одной переменной на экран или в файл
+    Status = DumpVariableRange (VariableName, GuidPrefix, DumpOffset, DumpLength, DumpOutPath, OutputType);
   } else {
     // Стандартный режим - просто отображаем переменную
     Status = FindAndPrintVariable (VariableName, GuidPrefix, OutputType);
-    
-    // Освобождаем выделенную память для GUID, если была выделена
-    if (GuidPrefix != NULL && Config.SerialVarGuid != NULL) {
-      FreePool(Config.SerialVarGuid);
-    }
   }
   
   // Ждем нажатия клавиши, если не используется rawtype
@@ -2452,6 +10190,16 @@ UefiMain (
   }
   
   // Вызываем основную функцию приложения, которая обрабатывает аргументы
-  return (EFI_STATUS)ShellAppMain(gEfiShellParametersProtocol->Argc,
-                                  gEfiShellParametersProtocol->Argv);
+  Status = (EFI_STATUS)ShellAppMain(gEfiShellParametersProtocol->Argc,
+                                    gEfiShellParametersProtocol->Argv);
+  
+  // Освобождаем общие ресурсы запуска
+  CheckProbedVariableNames ();
+  FreeVariableIndex (&mVarIndex);
+  FreeVariableReadBuffer ();
+  FreeSmbiosIndex ();
+  SaveGuidRegistryStats ();
+  FreeGuidRegistry ();
+  
+  return Status;
 }
\ No newline at end of file
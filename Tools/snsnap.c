@@ -0,0 +1,536 @@
+/**
+  snsnap - разбор снимков хранилища переменных, сохранённых SNSniff --snapshot.
+
+  Утилита для хоста (Linux), собирается без EDK2:
+
+    cc -O2 -Wall -o snsnap snsnap.c
+
+  Команды:
+
+    snsnap list FILE                 - список переменных
+    snsnap grep FILE TEXT            - поиск по имени и по данным (ASCII и UCS-2)
+    snsnap dump FILE NAME [GUID]     - шестнадцатеричный дамп переменной
+    snsnap diff FILE_A FILE_B        - различия двух снимков по имени и GUID
+
+  Формат файла должен совпадать с SNAPSHOT_* в SNSniff.c.
+**/
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SNAPSHOT_SIGNATURE          "SNSNAP01"
+#define SNAPSHOT_INDEX_SIGNATURE    "SNSNIDX1"
+#define SNAPSHOT_VERSION            1
+#define SNAPSHOT_HEADER_SIZE        40
+#define SNAPSHOT_RECORD_SIZE        40
+#define SNAPSHOT_FOOTER_SIZE        24
+#define SNAPSHOT_RECORD_READ_ERROR  0x00000001
+
+// Разобранная запись снимка (указатели ссылаются на отображённый файл)
+typedef struct {
+  uint32_t       Attributes;
+  const uint8_t  *Guid;         // 16 байт в формате EFI_GUID
+  const uint8_t  *Name;         // UCS-2 LE, NameSize байт, включая NUL
+  uint32_t       NameSize;
+  const uint8_t  *Data;
+  uint32_t       DataSize;
+  uint32_t       DataCrc32;
+  uint32_t       Flags;
+  char           NameUtf8[512]; // Имя для вывода и сортировки
+} SNAP_RECORD;
+
+// Открытый снимок
+typedef struct {
+  const char     *Path;
+  const uint8_t  *Base;
+  size_t         Size;
+  SNAP_RECORD    *Records;
+  uint32_t       Count;
+} SNAPSHOT;
+
+static uint32_t
+ReadU32 (const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t
+ReadU64 (const uint8_t *p)
+{
+  return (uint64_t)ReadU32 (p) | ((uint64_t)ReadU32 (p + 4) << 32);
+}
+
+// CRC32 (IEEE 802.3), совпадает с gBS->CalculateCrc32
+static uint32_t
+Crc32 (const uint8_t *Data, size_t Size)
+{
+  static uint32_t  Table[256];
+  static int       Ready;
+  uint32_t         Crc;
+  size_t           i;
+  int              k;
+
+  if (!Ready) {
+    for (i = 0; i < 256; i++) {
+      Crc = (uint32_t)i;
+      for (k = 0; k < 8; k++) {
+        Crc = (Crc & 1) ? (Crc >> 1) ^ 0xEDB88320u : (Crc >> 1);
+      }
+      Table[i] = Crc;
+    }
+    Ready = 1;
+  }
+
+  Crc = 0xFFFFFFFFu;
+  for (i = 0; i < Size; i++) {
+    Crc = Table[(Crc ^ Data[i]) & 0xFF] ^ (Crc >> 8);
+  }
+  return Crc ^ 0xFFFFFFFFu;
+}
+
+static void
+FormatGuid (const uint8_t *g, char *Out)
+{
+  sprintf (
+    Out,
+    "%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+    ReadU32 (g),
+    (unsigned)(g[4] | (g[5] << 8)),
+    (unsigned)(g[6] | (g[7] << 8)),
+    g[8], g[9], g[10], g[11], g[12], g[13], g[14], g[15]
+    );
+}
+
+// Имя UCS-2 LE -> UTF-8 (символы вне BMP заменяются на '?')
+static void
+NameToUtf8 (const uint8_t *Name, uint32_t NameSize, char *Out, size_t OutSize)
+{
+  size_t    Used = 0;
+  uint32_t  i;
+  unsigned  c;
+
+  for (i = 0; i + 1 < NameSize; i += 2) {
+    c = Name[i] | (Name[i + 1] << 8);
+    if (c == 0) {
+      break;
+    }
+    if (c >= 0xD800 && c <= 0xDFFF) {
+      c = '?';
+    }
+    if (c < 0x80) {
+      if (Used + 1 >= OutSize) break;
+      Out[Used++] = (char)c;
+    } else if (c < 0x800) {
+      if (Used + 2 >= OutSize) break;
+      Out[Used++] = (char)(0xC0 | (c >> 6));
+      Out[Used++] = (char)(0x80 | (c & 0x3F));
+    } else {
+      if (Used + 3 >= OutSize) break;
+      Out[Used++] = (char)(0xE0 | (c >> 12));
+      Out[Used++] = (char)(0x80 | ((c >> 6) & 0x3F));
+      Out[Used++] = (char)(0x80 | (c & 0x3F));
+    }
+  }
+  Out[Used] = '\0';
+}
+
+static void
+FormatAttributes (uint32_t Attributes, char *Out)
+{
+  Out[0] = '\0';
+  if (Attributes & 0x01) strcat (Out, "NV ");
+  if (Attributes & 0x02) strcat (Out, "BS ");
+  if (Attributes & 0x04) strcat (Out, "RT ");
+  if (Attributes & 0x08) strcat (Out, "HR ");
+  if (Attributes & 0x20) strcat (Out, "AT ");
+  if (Attributes & 0x40) strcat (Out, "AW ");
+  if (Out[0] == '\0') strcat (Out, "-");
+  else Out[strlen (Out) - 1] = '\0';
+}
+
+/**
+  Отображает снимок в память и проверяет его структуру. Все смещения
+  проверяются до обращения к данным.
+**/
+static int
+OpenSnapshot (const char *Path, SNAPSHOT *Snap)
+{
+  struct stat     St;
+  int             Fd;
+  const uint8_t   *Footer;
+  uint64_t        IndexOffset;
+  uint64_t        Offset;
+  uint32_t        Count;
+  uint32_t        RecordSize;
+  uint32_t        i;
+  SNAP_RECORD     *Rec;
+  const uint8_t   *p;
+
+  memset (Snap, 0, sizeof (*Snap));
+  Snap->Path = Path;
+
+  Fd = open (Path, O_RDONLY);
+  if (Fd < 0 || fstat (Fd, &St) != 0) {
+    perror (Path);
+    if (Fd >= 0) close (Fd);
+    return -1;
+  }
+  Snap->Size = (size_t)St.st_size;
+  if (Snap->Size < SNAPSHOT_HEADER_SIZE + SNAPSHOT_FOOTER_SIZE) {
+    fprintf (stderr, "%s: file too small for a snapshot\n", Path);
+    close (Fd);
+    return -1;
+  }
+
+  Snap->Base = mmap (NULL, Snap->Size, PROT_READ, MAP_PRIVATE, Fd, 0);
+  close (Fd);
+  if (Snap->Base == MAP_FAILED) {
+    perror (Path);
+    Snap->Base = NULL;
+    return -1;
+  }
+
+  if (memcmp (Snap->Base, SNAPSHOT_SIGNATURE, 8) != 0) {
+    fprintf (stderr, "%s: bad signature\n", Path);
+    return -1;
+  }
+  if (ReadU32 (Snap->Base + 8) != SNAPSHOT_VERSION
+      || ReadU32 (Snap->Base + 12) != SNAPSHOT_HEADER_SIZE
+      || ReadU32 (Snap->Base + 16) != SNAPSHOT_RECORD_SIZE) {
+    fprintf (stderr, "%s: unsupported snapshot version or layout\n", Path);
+    return -1;
+  }
+
+  Footer = Snap->Base + Snap->Size - SNAPSHOT_FOOTER_SIZE;
+  if (memcmp (Footer + 16, SNAPSHOT_INDEX_SIGNATURE, 8) != 0) {
+    fprintf (stderr, "%s: missing index footer (truncated snapshot?)\n", Path);
+    return -1;
+  }
+  IndexOffset = ReadU64 (Footer);
+  Count = ReadU32 (Footer + 8);
+  if (IndexOffset < SNAPSHOT_HEADER_SIZE
+      || IndexOffset > Snap->Size - SNAPSHOT_FOOTER_SIZE
+      || (Snap->Size - SNAPSHOT_FOOTER_SIZE - IndexOffset) / 8 != Count
+      || (Snap->Size - SNAPSHOT_FOOTER_SIZE - IndexOffset) % 8 != 0) {
+    fprintf (stderr, "%s: index is out of bounds\n", Path);
+    return -1;
+  }
+  if (Count > 0 && Crc32 (Snap->Base + IndexOffset, (size_t)Count * 8) != ReadU32 (Footer + 12)) {
+    fprintf (stderr, "%s: index CRC mismatch\n", Path);
+    return -1;
+  }
+
+  Snap->Records = calloc (Count ? Count : 1, sizeof (SNAP_RECORD));
+  if (Snap->Records == NULL) {
+    fprintf (stderr, "out of memory\n");
+    return -1;
+  }
+
+  for (i = 0; i < Count; i++) {
+    Offset = ReadU64 (Snap->Base + IndexOffset + (uint64_t)i * 8);
+    if (Offset < SNAPSHOT_HEADER_SIZE || Offset > IndexOffset - SNAPSHOT_RECORD_SIZE) {
+      fprintf (stderr, "%s: record %u offset out of bounds\n", Path, i);
+      return -1;
+    }
+    p = Snap->Base + Offset;
+    Rec = &Snap->Records[i];
+    RecordSize = ReadU32 (p);
+    Rec->Attributes = ReadU32 (p + 4);
+    Rec->Guid = p + 8;
+    Rec->NameSize = ReadU32 (p + 24);
+    Rec->DataSize = ReadU32 (p + 28);
+    Rec->DataCrc32 = ReadU32 (p + 32);
+    Rec->Flags = ReadU32 (p + 36);
+
+    if (RecordSize < SNAPSHOT_RECORD_SIZE || RecordSize > IndexOffset - Offset
+        || Rec->NameSize < 2 || (Rec->NameSize & 1) != 0
+        || (uint64_t)Rec->NameSize + Rec->DataSize > RecordSize - SNAPSHOT_RECORD_SIZE) {
+      fprintf (stderr, "%s: record %u is malformed\n", Path, i);
+      return -1;
+    }
+    Rec->Name = p + SNAPSHOT_RECORD_SIZE;
+    Rec->Data = Rec->Name + Rec->NameSize;
+    if (Rec->Name[Rec->NameSize - 2] != 0 || Rec->Name[Rec->NameSize - 1] != 0) {
+      fprintf (stderr, "%s: record %u name is not terminated\n", Path, i);
+      return -1;
+    }
+    if (Rec->DataSize > 0 && Crc32 (Rec->Data, Rec->DataSize) != Rec->DataCrc32) {
+      fprintf (stderr, "%s: warning: record %u data CRC mismatch\n", Path, i);
+    }
+    NameToUtf8 (Rec->Name, Rec->NameSize, Rec->NameUtf8, sizeof (Rec->NameUtf8));
+  }
+
+  Snap->Count = Count;
+  return 0;
+}
+
+static void
+CloseSnapshot (SNAPSHOT *Snap)
+{
+  free (Snap->Records);
+  if (Snap->Base != NULL) {
+    munmap ((void *)Snap->Base, Snap->Size);
+  }
+}
+
+static void
+PrintRecordLine (const SNAP_RECORD *Rec)
+{
+  char  Guid[40];
+  char  Attr[32];
+
+  FormatGuid (Rec->Guid, Guid);
+  FormatAttributes (Rec->Attributes, Attr);
+  printf ("%-36s  %8u  %-14s  %s%s\n", Guid, Rec->DataSize, Attr, Rec->NameUtf8,
+          (Rec->Flags & SNAPSHOT_RECORD_READ_ERROR) ? "  <read error>" : "");
+}
+
+static int
+CmdList (const SNAPSHOT *Snap)
+{
+  uint32_t  i;
+
+  printf ("%-36s  %8s  %-14s  %s\n", "GUID", "Size", "Attributes", "Name");
+  for (i = 0; i < Snap->Count; i++) {
+    PrintRecordLine (&Snap->Records[i]);
+  }
+  printf ("%u variables\n", Snap->Count);
+  return 0;
+}
+
+// Поиск последовательности байт в данных (возвращает смещение или -1)
+static long
+FindBytes (const uint8_t *Data, size_t Size, const uint8_t *Needle, size_t NeedleSize)
+{
+  size_t  i;
+
+  if (NeedleSize == 0 || NeedleSize > Size) {
+    return -1;
+  }
+  for (i = 0; i + NeedleSize <= Size; i++) {
+    if (Data[i] == Needle[0] && memcmp (Data + i, Needle, NeedleSize) == 0) {
+      return (long)i;
+    }
+  }
+  return -1;
+}
+
+static int
+CmdGrep (const SNAPSHOT *Snap, const char *Text)
+{
+  size_t    Len = strlen (Text);
+  uint8_t   *Wide;
+  uint32_t  i;
+  size_t    k;
+  long      Offset;
+  unsigned  Matches = 0;
+
+  Wide = malloc (Len * 2 + 1);
+  if (Wide == NULL) {
+    return 1;
+  }
+  for (k = 0; k < Len; k++) {
+    Wide[k * 2] = (uint8_t)Text[k];
+    Wide[k * 2 + 1] = 0;
+  }
+
+  for (i = 0; i < Snap->Count; i++) {
+    const SNAP_RECORD  *Rec = &Snap->Records[i];
+
+    if (strstr (Rec->NameUtf8, Text) != NULL) {
+      printf ("name   ");
+      PrintRecordLine (Rec);
+      Matches++;
+    }
+    Offset = FindBytes (Rec->Data, Rec->DataSize, (const uint8_t *)Text, Len);
+    if (Offset >= 0) {
+      printf ("ascii  @0x%04lX  ", (unsigned long)Offset);
+      PrintRecordLine (Rec);
+      Matches++;
+    }
+    Offset = FindBytes (Rec->Data, Rec->DataSize, Wide, Len * 2);
+    if (Offset >= 0) {
+      printf ("ucs2   @0x%04lX  ", (unsigned long)Offset);
+      PrintRecordLine (Rec);
+      Matches++;
+    }
+  }
+
+  free (Wide);
+  printf ("%u matches\n", Matches);
+  return Matches > 0 ? 0 : 1;
+}
+
+static void
+HexDump (const uint8_t *Data, uint32_t Size)
+{
+  uint32_t  i;
+  uint32_t  j;
+
+  for (i = 0; i < Size; i += 16) {
+    printf ("%08X: ", i);
+    for (j = 0; j < 16; j++) {
+      if (i + j < Size) printf ("%02X ", Data[i + j]);
+      else printf ("   ");
+    }
+    printf (" ");
+    for (j = 0; j < 16 && i + j < Size; j++) {
+      putchar ((Data[i + j] >= 0x20 && Data[i + j] < 0x7F) ? Data[i + j] : '.');
+    }
+    putchar ('\n');
+  }
+}
+
+static int
+CmdDump (const SNAPSHOT *Snap, const char *Name, const char *GuidPrefix)
+{
+  char      Guid[40];
+  uint32_t  i;
+  unsigned  Matches = 0;
+
+  for (i = 0; i < Snap->Count; i++) {
+    const SNAP_RECORD  *Rec = &Snap->Records[i];
+
+    if (strcmp (Rec->NameUtf8, Name) != 0) {
+      continue;
+    }
+    FormatGuid (Rec->Guid, Guid);
+    if (GuidPrefix != NULL && strncasecmp (Guid, GuidPrefix, strlen (GuidPrefix)) != 0) {
+      continue;
+    }
+    PrintRecordLine (Rec);
+    HexDump (Rec->Data, Rec->DataSize);
+    putchar ('\n');
+    Matches++;
+  }
+
+  if (Matches == 0) {
+    fprintf (stderr, "%s: variable '%s' not found\n", Snap->Path, Name);
+    return 1;
+  }
+  return 0;
+}
+
+// Порядок записей для diff: GUID, затем имя
+static int
+CompareRecords (const void *A, const void *B)
+{
+  const SNAP_RECORD  *Ra = A;
+  const SNAP_RECORD  *Rb = B;
+  int                Result;
+
+  Result = memcmp (Ra->Guid, Rb->Guid, 16);
+  if (Result != 0) {
+    return Result;
+  }
+  return strcmp (Ra->NameUtf8, Rb->NameUtf8);
+}
+
+static int
+CmdDiff (SNAPSHOT *A, SNAPSHOT *B)
+{
+  uint32_t  i = 0;
+  uint32_t  j = 0;
+  unsigned  Added = 0, Removed = 0, Changed = 0;
+  int       Order;
+
+  qsort (A->Records, A->Count, sizeof (SNAP_RECORD), CompareRecords);
+  qsort (B->Records, B->Count, sizeof (SNAP_RECORD), CompareRecords);
+
+  while (i < A->Count || j < B->Count) {
+    if (i == A->Count) {
+      Order = 1;
+    } else if (j == B->Count) {
+      Order = -1;
+    } else {
+      Order = CompareRecords (&A->Records[i], &B->Records[j]);
+    }
+
+    if (Order < 0) {
+      printf ("- ");
+      PrintRecordLine (&A->Records[i++]);
+      Removed++;
+    } else if (Order > 0) {
+      printf ("+ ");
+      PrintRecordLine (&B->Records[j++]);
+      Added++;
+    } else {
+      const SNAP_RECORD  *Ra = &A->Records[i++];
+      const SNAP_RECORD  *Rb = &B->Records[j++];
+
+      if (Ra->Attributes != Rb->Attributes || Ra->DataSize != Rb->DataSize
+          || Ra->DataCrc32 != Rb->DataCrc32 || Ra->Flags != Rb->Flags
+          || memcmp (Ra->Data, Rb->Data, Ra->DataSize) != 0) {
+        printf ("~ ");
+        PrintRecordLine (Rb);
+        if (Ra->Attributes != Rb->Attributes) {
+          printf ("    attributes 0x%08X -> 0x%08X\n", Ra->Attributes, Rb->Attributes);
+        }
+        if (Ra->DataSize != Rb->DataSize) {
+          printf ("    size %u -> %u\n", Ra->DataSize, Rb->DataSize);
+        }
+        Changed++;
+      }
+    }
+  }
+
+  printf ("%u added, %u removed, %u changed\n", Added, Removed, Changed);
+  return (Added + Removed + Changed) > 0 ? 1 : 0;
+}
+
+static void
+Usage (void)
+{
+  fprintf (stderr,
+    "Usage: snsnap list FILE\n"
+    "       snsnap grep FILE TEXT\n"
+    "       snsnap dump FILE NAME [GUID]\n"
+    "       snsnap diff FILE_A FILE_B\n");
+}
+
+int
+main (int argc, char **argv)
+{
+  SNAPSHOT  A;
+  SNAPSHOT  B;
+  int       Result;
+
+  if (argc < 3) {
+    Usage ();
+    return 2;
+  }
+
+  if (OpenSnapshot (argv[2], &A) != 0) {
+    CloseSnapshot (&A);
+    return 2;
+  }
+
+  if (strcmp (argv[1], "list") == 0 && argc == 3) {
+    Result = CmdList (&A);
+  } else if (strcmp (argv[1], "grep") == 0 && argc == 4) {
+    Result = CmdGrep (&A, argv[3]);
+  } else if (strcmp (argv[1], "dump") == 0 && (argc == 4 || argc == 5)) {
+    Result = CmdDump (&A, argv[3], argc == 5 ? argv[4] : NULL);
+  } else if (strcmp (argv[1], "diff") == 0 && argc == 4) {
+    if (OpenSnapshot (argv[3], &B) != 0) {
+      CloseSnapshot (&B);
+      CloseSnapshot (&A);
+      return 2;
+    }
+    Result = CmdDiff (&A, &B);
+    CloseSnapshot (&B);
+  } else {
+    Usage ();
+    Result = 2;
+  }
+
+  CloseSnapshot (&A);
+  return Result;
+}